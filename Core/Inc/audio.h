@@ -36,11 +36,61 @@ typedef enum
     AUDIO_SUCCESS = 0,
     AUDIO_ERROR_UNABLE_TO_STREAM_BUFFER = -1,
     AUDIO_ERROR_NULL_BUFFER = -2,
+    AUDIO_ERROR_RATE_UNSUPPORTED = -3,
+    AUDIO_ERROR_UNABLE_TO_CONFIGURE = -4,
+    AUDIO_ERROR_FORMAT_UNSUPPORTED = -5,
     AUDIO_ERROR_GENERIC = -128
 } audio_ret_t;
 
 // TODO: rename this file maybe b/c I'm getting confused btwn this and codec lol
 
+/*
+ * What the bytes handed to Stream() actually mean.
+ *
+ * bits_per_sample is the number of *meaningful* bits, packing is how each sample sits in memory.
+ * For example, a 24-bit WAV is 24 bits in 3 packed bytes,
+ * but a 24-bit I2S DAC wants 24 bits left-justified in a 32-bit word.
+ * Same audio, different bytes -- which is exactly what the format negotiation needs to know.
+ *
+ * All samples are signed, little-endian and interleaved (L R L R ...).
+ */
+typedef enum
+{
+    AUDIO_PACKING_S16 = 0,          // 16-bit word
+    AUDIO_PACKING_S24_PACKED,       // 3 bytes, no padding (WAV)
+    AUDIO_PACKING_S24_IN_32,        // 32-bit word, sample in the top 24 bits
+    AUDIO_PACKING_S32               // 32-bit word
+} audio_packing_t;
+
+// A sink that can clock (almost) any rate advertises this instead of a list of rates
+#define AUDIO_RATE_ANY 0
+
+typedef struct
+{
+    uint32_t sample_rate;           // Hz, or AUDIO_RATE_ANY in a sink's advertised formats
+    uint16_t bits_per_sample;
+    uint16_t channels;
+    audio_packing_t packing;
+} audio_format_t;
+
+static inline uint32_t Audio_BytesPerSample(audio_packing_t packing)
+{
+    switch (packing)
+    {
+    case AUDIO_PACKING_S16:
+        return 2;
+    case AUDIO_PACKING_S24_PACKED:
+        return 3;
+    default:
+        return 4;
+    }
+}
+
+static inline uint32_t Audio_BytesPerFrame(const audio_format_t *format)
+{
+    return Audio_BytesPerSample(format->packing) * format->channels;
+}
+
 /*
  * It's bad practice to have a function pointer with, say, a void *buffer,
  * and then an implementation function pointer that defines it as a uint16_t *buffer.
@@ -56,6 +106,11 @@ typedef struct
 {
     audio_ret_t (*Open)(void);
     audio_ret_t (*Close)(void);
+    // The formats the sink can take without any help (see format.h for how one gets picked)
+    audio_ret_t (*GetFormats)(const audio_format_t **formats, size_t *count);
+    // Called on track open. Reports how far off the achievable rate is, in ppm.
+    audio_ret_t (*Configure)(const audio_format_t *format, int32_t *error_ppm);
+    // length is in bytes, in the format passed to Configure()
     audio_ret_t (*Stream)(void *buffer, size_t length);
 } audio_driver_t;
 
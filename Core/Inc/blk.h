@@ -0,0 +1,223 @@
+/*
+ * blk.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#ifndef INC_BLK_H_
+#define INC_BLK_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Block layer: sits between the FatFs disk driver and the card, and turns many small requests into few big ones.
+ *
+ * Every command costs the same fixed overhead on the bus whatever its size, so the fewer commands per megabyte,
+ * the better. FatFs doesn't help there: each f_read only asks for the sectors it needs right now, so a player
+ * reading a file a couple of KiB at a time ends up sending one single-block command after another for
+ * sectors that are right next to each other. Two things fix that:
+ *
+ *  - a request queue. Requests are submitted, then dispatched together; consecutive requests for adjacent
+ *    blocks in the same direction become one multi-block transfer (which the device announces with CMD23,
+ *    so there's no CMD12 at the end either). If their buffers are back to back in memory it's a single transfer
+ *    straight into them, otherwise it goes through the staging buffer and gets copied out.
+ *  - sequential read-ahead. When a read starts right where the previous one ended, we read a whole read-ahead
+ *    window's worth instead (the staging buffer, unless Blk_SetReadAhead says less), and serve the next requests
+ *    from it. This is what merges adjacent requests from separate f_read calls, which never sit in the queue
+ *    at the same time.
+ *
+ * Staging is also the bounce buffer for DMA. A device that can only take aligned buffers says so
+ * (blk_device_t alignment), and any run whose buffer isn't aligned goes through staging, as one multi-block
+ * transfer, and is copied in or out. FatFs hands the caller's buffer straight down for whole sectors, so that's
+ * whatever alignment f_read was given: a ring position after a 6-byte frame, a byte array in a struct, ...
+ * Requests bigger than staging are split up for that (Blk_Read/Blk_Write). The stats count how often it happens.
+ *
+ * Every request has an I/O class: real-time (the playback stream), normal, or idle (library scans and the like).
+ * The queue is served highest class first, and real-time requests earliest deadline first. Two things keep that
+ * from going wrong:
+ *
+ *  - nothing overtakes an earlier request for the same blocks if either of them writes, so a read after a write
+ *    always sees the new data (writes update the read-ahead copy too)
+ *  - starvation is bounded: a request that has been passed over BLK_MAX_BYPASS times goes next, whatever its class
+ *
+ * Reordering only helps with what's in the queue at the same time, though, and FatFs only ever has one request
+ * in flight. The main protection for playback is admission: background work asks Blk_Admit before each step,
+ * and is held back unless the real-time stream (its deadline, published with Blk_SetClass) has enough audio left
+ * to ride out two of the slowest requests the card can do (the background one, then the stream's own next read)
+ * plus BLK_REALTIME_GUARD_MS. A stream that can't buffer that much (a small ring, a slow card) is asked for no more
+ * than it does buffer: the most it has published lately, less BLK_REALTIME_GUARD_MS. So background work goes in
+ * while the ring's full, not never, though then no more than once per BLK_MAX_DEFER_*_MS, since each request is a
+ * chance of an underrun. Held back for at most BLK_MAX_DEFER_*_MS, so it gets somewhere even if playback never lets
+ * up, but only forced through while the stream could ride out one slowest request.
+ *
+ * Nothing here blocks on the card. A device transfer is started, then polled (Blk_Poll) until it's done, one run
+ * of merged requests at a time; the device is what enforces the timeouts, since only it has a clock to go by.
+ * Blk_Read/Blk_Write still look blocking to FatFs, but while they wait they call the yield hook, so the main
+ * loop's DSP and UI work carries on during a transfer or while the card is busy programming.
+ */
+
+#define BLK_BLOCK_SIZE 512
+#define BLK_QUEUE_DEPTH 8
+
+// Passed over this many times, a request goes next whatever its class
+#define BLK_MAX_BYPASS 4
+
+// On top of the worst latencies (Blk_SetWorstLatency): ordinary reads and the time it takes to notice
+#define BLK_REALTIME_GUARD_MS 30
+
+// The longest background work is held back for, per class, as long as the stream has a slowest request's slack
+#define BLK_MAX_DEFER_NORMAL_MS 50
+#define BLK_MAX_DEFER_IDLE_MS 250
+
+// How long the most audio the stream has had is kept as its capacity, so a ring that shrinks is seen to
+#define BLK_CAPACITY_WINDOW_MS 1000
+
+// 8 KiB: big enough that the per-command overhead is a small part of a transfer, small enough for our RAM
+#define BLK_STAGING_BLOCKS 16
+
+typedef enum
+{
+    BLK_SUCCESS = 0,
+    BLK_PENDING = 1,                    // not an error: still queued or in flight
+    BLK_ERROR_NULL_PARAMETER = -1,
+    BLK_ERROR_NOT_INITIALIZED = -2,
+    BLK_ERROR_QUEUE_FULL = -3,
+    BLK_ERROR_OUT_OF_RANGE = -4,
+    BLK_ERROR_DEVICE = -5,
+    BLK_ERROR_TIMEOUT = -6,
+    BLK_ERROR_ALIGNMENT = -7,           // submitted unaligned, and too big for staging to bounce
+    BLK_ERROR_GENERIC = -128
+} blk_ret_t;
+
+typedef enum
+{
+    BLK_READ = 0,
+    BLK_WRITE
+} blk_dir_t;
+
+// Highest priority first. Same order as fs_io_class_t.
+typedef enum
+{
+    BLK_CLASS_REALTIME = 0,
+    BLK_CLASS_NORMAL,
+    BLK_CLASS_IDLE,
+    BLK_NUM_CLASSES
+} blk_class_t;
+
+typedef struct
+{
+    blk_dir_t dir;
+    uint32_t lba;
+    uint32_t count;         // blocks
+    void *buffer;
+    blk_class_t io_class;
+    uint32_t deadline_ms;   // real-time only, in the device's clock (Now)
+    blk_ret_t status;       // BLK_PENDING until it's done
+
+    // Set on submit
+    uint32_t submitted_ms;
+    uint32_t bypassed;
+} blk_request_t;
+
+// What the block layer needs from the storage. One transfer (one command sequence) on the bus at a time.
+typedef struct
+{
+    // Start a transfer and return straight away (buffer is only read from on a write).
+    // A device with nothing asynchronous about it can do the whole thing here and report it on the next Poll.
+    blk_ret_t (*Start)(blk_dir_t dir, void *buffer, uint32_t lba, uint32_t count);
+
+    // BLK_PENDING until the transfer is over, card programming included, then its result. Has to time out by itself.
+    blk_ret_t (*Poll)(void);
+
+    // Commands sent so far, for the stats. NULL if the device doesn't count them: we estimate instead.
+    uint32_t (*Commands)(void);
+
+    // Milliseconds, for deadlines and waiting times. NULL: no deadlines, and background work is never held back.
+    uint32_t (*Now)(void);
+
+    // Buffers passed to Start have to be aligned to this many bytes (a power of two), e.g., 4 for word-wide DMA.
+    // 0 or 1: any buffer will do.
+    uint32_t alignment;
+} blk_device_t;
+
+typedef struct
+{
+    uint32_t requests;          // as submitted, including the ones served from read-ahead
+    uint32_t merged;            // requests that rode along in another one's transfer
+    uint32_t readahead_hits;    // requests served without touching the card
+    uint32_t transfers;
+    uint64_t blocks;            // actually transferred
+    uint32_t commands;
+
+    // Alignment (see blk_device_t alignment): the slow path, a copy through staging
+    uint32_t bounced;           // transfers that went through staging because their buffer wasn't aligned
+    uint32_t bounced_blocks;
+    uint32_t aligned;           // transfers that went straight into (or out of) the caller's buffer
+
+    // Scheduling
+    uint32_t class_requests[BLK_NUM_CLASSES];
+    uint32_t class_max_wait_ms[BLK_NUM_CLASSES];    // submit to done
+    uint32_t deadline_misses;   // real-time requests done after their deadline
+    uint32_t promotions;        // requests that went next because they'd been passed over too often
+    uint32_t deferrals;         // times background work was held back (Blk_Admit)
+    uint32_t forced;            // times it went ahead anyway, having waited as long as it may
+
+    // Derived
+    uint32_t avg_transfer_b;
+    uint32_t commands_per_mb;
+} blk_stats_t;
+
+blk_ret_t Blk_Init(const blk_device_t *device, uint32_t num_blocks);
+
+// Called while waiting on the card. Must not call back into the block layer (or FatFs): it's mid-request.
+typedef void (*blk_yield_t)(void);
+
+// Queue a request. request must stay valid until its status isn't BLK_PENDING any more.
+// If the device can't take its buffer (alignment), it can't be bigger than BLK_STAGING_BLOCKS.
+blk_ret_t Blk_Submit(blk_request_t *request);
+
+// Move things along without waiting: finish the transfer in flight if it's done, start the next run if there's
+// one. BLK_PENDING while anything is queued or in flight, else BLK_SUCCESS. Each request gets its own status.
+blk_ret_t Blk_Poll(void);
+
+// Poll (yielding in between) until the queue is empty. Returns the first error since the last call.
+blk_ret_t Blk_Dispatch(void);
+
+// Submit + wait for that one request, with sequential read-ahead for reads. Any size and alignment.
+blk_ret_t Blk_Read(void *buffer, uint32_t lba, uint32_t count);
+blk_ret_t Blk_Write(const void *buffer, uint32_t lba, uint32_t count);
+
+// How many blocks a sequential read fetches, at most BLK_STAGING_BLOCKS (the default); 0 or 1 turns read-ahead off.
+// A shorter window means shorter transfers, so less for a real-time read to wait behind, but more commands.
+void Blk_SetReadAhead(uint32_t blocks);
+uint32_t Blk_GetReadAhead(void);
+
+// NULL for none
+void Blk_SetYield(blk_yield_t yield);
+
+// The class Blk_Read/Blk_Write use from now on, until it's set again. Like ionice, for whoever runs next.
+// For BLK_CLASS_REALTIME, budget_ms is how long until the stream runs dry, which makes the deadline;
+// budget_ms = 0 means there's no real-time stream any more (and the class goes back to normal).
+void Blk_SetClass(blk_class_t io_class, uint32_t budget_ms);
+
+// 1 if background work of this class may go to the card now, 0 if it should yield to the real-time stream
+// and try again later. Always 1 for real-time, or after the class has been held back for its maximum with the
+// stream able to wait out a slowest request.
+uint8_t Blk_Admit(blk_class_t io_class);
+
+// The longest a single request can take on this card (e.g., sd_profile_t stall_us), 0 if unknown.
+// Background work is only let in while the stream could still wait that long.
+void Blk_SetWorstLatency(uint32_t latency_ms);
+
+// A single raw transfer on a device, start + poll, no queue or read-ahead (and no yield). For benchmarks and tools.
+// No bouncing either: buffer has to suit the device.
+blk_ret_t Blk_DeviceTransfer(const blk_device_t *device, blk_dir_t dir, void *buffer, uint32_t lba, uint32_t count);
+
+// Drop the read-ahead data, e.g., when the card may have changed under us
+void Blk_Invalidate(void);
+
+void Blk_GetStats(blk_stats_t *stats);
+
+#endif /* INC_BLK_H_ */
@@ -0,0 +1,87 @@
+/*
+ * bookmark.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#ifndef INC_BOOKMARK_H_
+#define INC_BOOKMARK_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "fs.h"
+
+/*
+ * Where playback was, kept on the card so it can carry on from there after a power cycle: the track and the frame
+ * in it, to the sample (Player_Seek).
+ *
+ * The file, BOOKMARK_FILE in the root, is made once at its full size, BOOKMARK_SLOTS records of a sector each, and
+ * from then on only ever written over in place (fs OpenFileForUpdate): a save is one record into the next slot round,
+ * one aligned sector, a single write. The FAT and the directory entry aren't touched, and no one sector is written
+ * more than every BOOKMARK_SLOTS-th save, which is what the card's own wear leveling copes with best.
+ *
+ * Each record has a sequence number and a CRC-32. Bookmark_Load takes the valid one with the highest sequence, so a
+ * save cut short by the power going (a torn sector, whatever got written) just leaves the one before it in charge.
+ * Saving the same thing twice running is skipped: nothing's written.
+ */
+
+#define BOOKMARK_FILE "MUPOD.BMK"
+
+// Records in the file, written round. Each is a sector.
+#define BOOKMARK_SLOTS 16
+#define BOOKMARK_RECORD_SIZE 512
+
+// Longest path kept, terminator included, like the library's (LIBRARY_MAX_PATH)
+#define BOOKMARK_MAX_PATH 256
+
+// Words the caller can keep alongside, e.g., a playlist entry or the shuffle's key and position
+#define BOOKMARK_USER_WORDS 8
+
+typedef enum
+{
+    BOOKMARK_SUCCESS = 0,
+    BOOKMARK_UNCHANGED = 1,                 // not an error: the same as the last one saved, so not written
+    BOOKMARK_ERROR_NULL_PARAMETER = -1,
+    BOOKMARK_ERROR_NOT_INITIALIZED = -2,
+    BOOKMARK_ERROR_NOT_OPEN = -3,
+    BOOKMARK_ERROR_UNABLE_TO_OPEN = -4,
+    BOOKMARK_ERROR_UNABLE_TO_READ = -5,
+    BOOKMARK_ERROR_UNABLE_TO_WRITE = -6,
+    BOOKMARK_ERROR_NONE_SAVED = -7,         // nothing valid in the file, e.g., a new card
+    BOOKMARK_ERROR_UNSUPPORTED = -8,        // the storage can't write over a file in place
+    BOOKMARK_ERROR_GENERIC = -128
+} bookmark_ret_t;
+
+typedef struct
+{
+    char path[BOOKMARK_MAX_PATH];           // relative to the root
+    uint64_t frame;                         // from the start of the track (Player_GetPosition)
+    uint32_t user[BOOKMARK_USER_WORDS];
+} bookmark_t;
+
+typedef struct
+{
+    uint32_t saves;                         // written
+    uint32_t unchanged;                     // skipped, the same as the last one
+    uint32_t valid;                         // records that checked out at Bookmark_Open
+    uint32_t invalid;                       // and ones that didn't (torn, or never written)
+    uint32_t sequence;                      // of the latest
+} bookmark_stats_t;
+
+bookmark_ret_t Bookmark_Init(fs_driver_t *fs);
+
+// Open the file, making it if it isn't there (or isn't the right size), and find the latest record in it
+bookmark_ret_t Bookmark_Open(void);
+bookmark_ret_t Bookmark_Close(void);
+
+// The latest saved. BOOKMARK_ERROR_NONE_SAVED if there isn't one.
+bookmark_ret_t Bookmark_Load(bookmark_t *bookmark);
+
+// Into the next slot. BOOKMARK_UNCHANGED if it's the same as the latest, which is left as it is.
+bookmark_ret_t Bookmark_Save(const bookmark_t *bookmark);
+
+bookmark_ret_t Bookmark_GetStats(bookmark_stats_t *stats);
+
+#endif /* INC_BOOKMARK_H_ */
@@ -11,28 +11,60 @@
 #include <stdint.h>
 #include <stddef.h>
 
+#include "audio.h"
 #include "fs.h"
 
 // TODO: remove the file-related errors?
 typedef enum
 {
+    CODEC_NEED_MORE = 1,                // not an error: the header goes on past the buffer (see ValidateHeader)
     CODEC_SUCCESS = 0,
     CODEC_ERROR_FILE_ALREADY_OPENED = -1,
     CODEC_ERROR_FILE_IS_NULL = -2,
     CODEC_ERROR_UNABLE_TO_DECODE = -3,
     CODEC_ERROR_NO_FILE_OPENED = -4,
     CODEC_ERROR_INVALID_FILE_FORMAT = -5,
+    CODEC_ERROR_UNABLE_TO_ENCODE = -6,
     CODEC_ERROR_GENERIC = -128
-} codec_ret_t; 
+} codec_ret_t;
+
+// What a file says about itself, for the library. Anything it doesn't say is left as it was.
+#define CODEC_MAX_TAG 64
+
+typedef struct
+{
+    char title[CODEC_MAX_TAG];
+    char artist[CODEC_MAX_TAG];
+    char album[CODEC_MAX_TAG];
+    uint16_t track_number;
+} codec_tags_t;
 
 typedef struct
 {
     codec_ret_t (*Open)(void);
     codec_ret_t (*Close)(void);
-    codec_ret_t (*ValidateHeader)(const void *buffer, void *metadata, size_t *bytes_read);
+
+    // A piece of the header at a time, metadata keeping where the codec has got to. *offset: in, where in the file
+    // buffer starts (0 to begin with); out, on CODEC_SUCCESS, where the audio starts. *bytes_read: in, how much of
+    // the file from *offset is in buffer. CODEC_NEED_MORE if the header goes on past that: call again with
+    // *bytes_read bytes from *offset. That's either the same *offset and more of the file, or a later one with
+    // whatever's in between skipped (a chunk the codec doesn't need), to be read from there instead.
+    codec_ret_t (*ValidateHeader)(const void *buffer, void *metadata, uint64_t *offset, size_t *bytes_read);
+    codec_ret_t (*GetFormat)(const void *metadata, audio_format_t *format);
     codec_ret_t (*Decode)(void *buffer, size_t length);
     codec_ret_t (*DecodeFrom)(void *buffer, size_t start, size_t length);
-    // codec_ret_t (*Encode)(uint8_t *dst, const uint8_t *src, size_t length);
+
+    // Encoding, NULL if the codec can't.
+    // EncodeHeader: the header for data_size bytes of audio in this format. *length: in, the room in buffer; out,
+    // the header's length, which doesn't depend on data_size, so the header can be written with 0 to start with
+    // and overwritten with the real size at the end.
+    // Encode: length bytes of audio as they go in the file, the same length. dst == src is fine.
+    codec_ret_t (*EncodeHeader)(const audio_format_t *format, uint64_t data_size, void *buffer, size_t *length);
+    codec_ret_t (*Encode)(uint8_t *dst, const uint8_t *src, size_t length);
+
+    // Optional: the tags among the first length bytes of the file, e.g., the header ValidateHeader accepted.
+    // Only what's there: tags after the audio aren't looked for.
+    codec_ret_t (*ReadTags)(const void *buffer, size_t length, codec_tags_t *tags);
 } codec_t;
 
 #endif /* INC_CODEC_H_ */
@@ -0,0 +1,28 @@
+/*
+ * crc32.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#ifndef INC_CRC32_H_
+#define INC_CRC32_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * CRC-32 (IEEE 802.3, the one zip/PNG use), for checking small records we persist ourselves.
+ *
+ * The F401 does have a CRC peripheral, but it only does the non-reflected variant, 32 bits at a time,
+ * so the result wouldn't match any standard tool. The records are small, so a 16-entry (nibble) table is plenty fast
+ * and costs 64 bytes of flash instead of 1 KB.
+ *
+ * Pass CRC32_INIT as crc for the first call; chain calls to checksum data in pieces.
+ */
+
+#define CRC32_INIT 0
+
+uint32_t CRC32_Update(uint32_t crc, const void *data, size_t length);
+
+#endif /* INC_CRC32_H_ */
@@ -0,0 +1,45 @@
+/*
+ * cycles.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#ifndef INC_CYCLES_H_
+#define INC_CYCLES_H_
+
+// Host builds (see Host/) have no DWT, just a stand-in counting at SystemCoreClock off the PC's clock
+#ifdef HOST_BUILD
+#include "host_cortex.h"
+#else
+#include "main.h"
+#endif
+
+/*
+ * Cycle-accurate timing using the DWT (Data Watchpoint and Trace) unit.
+ *
+ * The Cortex-M4 has a free-running 32-bit cycle counter (CYCCNT) that's part of the debug hardware.
+ * It's disabled by default -- we have to turn on trace (TRCENA) first, then the counter itself.
+ * At 84 MHz it wraps every ~51 seconds, which is fine for timing anything short.
+ * Like the ring counters, unsigned subtraction handles the wrap.
+ *
+ * HAL_GetTick() only has 1 ms resolution, which is useless for measuring DSP per block.
+ */
+
+static inline void Cycles_Init(void)
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+static inline uint32_t Cycles_Now(void)
+{
+#ifdef HOST_BUILD
+    return HostCortex_Cycles();
+#else
+    return DWT->CYCCNT;
+#endif
+}
+
+#endif /* INC_CYCLES_H_ */
@@ -0,0 +1,141 @@
+/*
+ * depth.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#ifndef INC_DEPTH_H_
+#define INC_DEPTH_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Adaptive playback buffer depth: how much of the output ring, and how long a read-ahead, this card needs.
+ *
+ * The card profile (sd_profile.h) gives one worst stall, measured once with a benchmark. What playback actually
+ * sees is different: FatFs reads the FAT now and then, the card does its housekeeping when it feels like it,
+ * and some cards get slower as they fill up. Sizing for the benchmark's worst case wastes SRAM on a good card,
+ * and isn't enough on a bad one.
+ *
+ * So the player times every read it does (Depth_Sample), into a histogram with log2 buckets (1 us, 2 us, 4 us, ...).
+ * It's halved every DEPTH_WINDOW samples, so it follows the card rather than remembering its whole life.
+ *
+ * The ring underruns when a read takes longer than the audio left in the ring lasts. When a read starts, the ring
+ * holds everything but the read itself, so for a target underrun probability p per read, the ring has to hold
+ * the latency that only a fraction p of reads go over (the histogram's 1 - p quantile), plus one read.
+ * With too few samples to tell a quantile that far out, that's simply the slowest read so far.
+ * Until there are DEPTH_MIN_SAMPLES, the profile's worst stall stands in.
+ *
+ * Ring sizes are powers of two (see ring.h), so the depth moves in doublings and halvings:
+ *
+ *  - grow as soon as the ring is smaller than needed, since that's what protects playback
+ *  - shrink only after DEPTH_SHRINK_HOLD samples in a row say half would still do, so a quiet spell on
+ *    the card doesn't give away the RAM the next stall needs
+ *  - ring + read-ahead stay within the RAM budget. When they don't both fit, the read-ahead gives way first
+ *    (down to DEPTH_MIN_READAHEAD_B): a short read-ahead costs commands, a shallow ring costs underruns.
+ *    Past that the ring is capped, and the decision log says so.
+ *
+ * Every change is logged (Depth_GetStats), for the UART stats dump.
+ */
+
+// log2 buckets: bucket b holds [2^b, 2^(b + 1)) us, the last one everything from ~1 s up
+#define DEPTH_BUCKETS 21
+
+// Halve the histogram once it holds this many samples
+#define DEPTH_WINDOW 4096
+
+// Fewer samples than this and the card profile's worst stall is used instead
+#define DEPTH_MIN_SAMPLES 64
+
+// Samples in a row that half the ring would have been enough for, before it's halved
+#define DEPTH_SHRINK_HOLD 512
+
+// Never smaller than these, whatever the histogram says
+#define DEPTH_MIN_RING_B 4096
+#define DEPTH_MIN_READAHEAD_B 2048
+
+// 100 ppm: an underrun every ~10,000 reads. At 8 KiB per read that's about once every 8 minutes of CD audio.
+#define DEPTH_DEFAULT_TARGET_PPM 100
+
+#define DEPTH_LOG_ENTRIES 8
+
+typedef enum
+{
+    DEPTH_SUCCESS = 0,
+    DEPTH_ERROR_NULL_PARAMETER = -1,
+    DEPTH_ERROR_NOT_INITIALIZED = -2,
+    DEPTH_ERROR_INVALID_CONFIG = -3,
+    DEPTH_ERROR_GENERIC = -128
+} depth_ret_t;
+
+typedef enum
+{
+    DEPTH_KEEP = 0,
+    DEPTH_GROW,             // ring doubled (or more)
+    DEPTH_SHRINK,           // ring halved
+    DEPTH_READAHEAD,        // only the read-ahead changed, to make room in the budget or take it back
+    DEPTH_CAPPED            // the ring needs more than the budget (or the buffer) allows
+} depth_decision_t;
+
+typedef struct
+{
+    uint32_t budget_b;          // ring + read-ahead, at most
+    uint32_t max_ring_b;        // what the ring's buffer holds, a power of two
+    uint32_t max_readahead_b;   // what the block layer's staging holds
+    uint32_t target_ppm;        // acceptable underruns, per million reads
+    uint32_t seed_us;           // worst stall to assume until there are samples (fs stall_us), 0 = unknown
+} depth_config_t;
+
+typedef struct
+{
+    depth_decision_t decision;
+    uint32_t sample;            // how many samples in it was taken
+    uint32_t latency_us;        // what it was sized for
+    uint32_t ring_b;
+    uint32_t readahead_b;
+} depth_log_entry_t;
+
+typedef struct
+{
+    // Where things stand
+    uint32_t ring_b;
+    uint32_t readahead_b;
+    uint32_t needed_b;          // what the target asks for: more than ring_b when capped
+    uint32_t latency_us;        // the quantile sized for
+    uint32_t risk_ppm;          // reads in the histogram that took longer than the ring lasts, per million
+
+    // Samples
+    uint32_t samples;           // since Depth_Init
+    uint32_t max_us;
+    uint32_t histogram[DEPTH_BUCKETS];
+
+    // Decisions
+    uint32_t grows;
+    uint32_t shrinks;
+    uint32_t readahead_changes;
+    uint32_t caps;
+    uint32_t logged;            // valid entries in log, oldest first
+    depth_log_entry_t log[DEPTH_LOG_ENTRIES];
+} depth_stats_t;
+
+// Budget = the whole ring buffer plus the whole staging buffer, 100 ppm, no seed
+void Depth_DefaultConfig(depth_config_t *config, uint32_t max_ring_b, uint32_t max_readahead_b);
+
+// Starts with the largest ring the budget allows, until the first Depth_Update
+depth_ret_t Depth_Init(const depth_config_t *config);
+
+// One read's latency, request to data
+void Depth_Sample(uint32_t latency_us);
+
+// Re-decide for a stream of bytes_per_s, read read_b at a time. The sizes to use are in ring_b and readahead_b
+// (either may be NULL, and both are left alone before Depth_Init). Cheap enough to call after every read.
+depth_decision_t Depth_Update(uint32_t bytes_per_s, uint32_t read_b, uint32_t *ring_b, uint32_t *readahead_b);
+
+depth_ret_t Depth_GetStats(depth_stats_t *stats);
+
+// For printing: "grow", "shrink", ...
+const char *Depth_DecisionName(depth_decision_t decision);
+
+#endif /* INC_DEPTH_H_ */
@@ -0,0 +1,131 @@
+/*
+ * extsort.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#ifndef INC_EXTSORT_H_
+#define INC_EXTSORT_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "fs.h"
+
+/*
+ * Sorting more fixed-size records than fit in RAM, with the card to hold what doesn't (an external merge sort).
+ *
+ * Records go in one at a time (ExtSort_Add) into the work buffer. Each time it's full, it's sorted (qsort) and
+ * written out as a run, all of them one after the other in a file. Once they're all in (ExtSort_Finish), the runs
+ * are merged: the work buffer is split into a read buffer per run, and a heap of the runs, keyed by each one's
+ * next record, picks the smallest of them every time. At least EXTSORT_MIN_READ of a run is read at a time, so
+ * if there are more runs than there's room for buffers of that, groups of them are merged into longer runs,
+ * in another file, until there aren't. Each pass merges as few runs at a time as still gets there in the fewest
+ * passes, so that what's read and written at a time is as big as it can be. The last merge is never written
+ * anywhere: ExtSort_Next hands the records over in order, as it goes.
+ *
+ * Everything written is written in order, from the start of a file fresh from CreateFile: the runs, then each merge
+ * pass's output (through a buffer of whole EXTSORT_WRITE_BYTES). That's whole sectors, in a run of clusters that
+ * nothing else is allocating from, which the card writes without having to erase and copy around what's in the way. Each
+ * file is opened again to be read, so that FatFs sees it's contiguous and reads it without the FAT (_FS_CONTIG).
+ *
+ * If it all fits in one run, it's sorted in RAM and the card isn't used at all.
+ *
+ * Records that compare the same come out in no particular order: make them differ, if that matters.
+ */
+
+// Least read from a run at a time, while merging: a sector
+#define EXTSORT_MIN_READ 512
+
+// Merge passes' output is written a multiple of this at a time: a sector
+#define EXTSORT_WRITE_BYTES 512
+
+// Smallest work buffer taken: enough to merge two runs at a time and write the output, however big the records
+// (up to this), in three even shares
+#define EXTSORT_MAX_RECORD 128
+#define EXTSORT_MIN_WORK (3 * (EXTSORT_MIN_READ + EXTSORT_MAX_RECORD + 32))
+
+typedef enum
+{
+    EXTSORT_SUCCESS = 0,
+    EXTSORT_END = 1,                        // not an error: every record's been handed over
+    EXTSORT_ERROR_NULL_PARAMETER = -1,
+    EXTSORT_ERROR_WORK_TOO_SMALL = -2,
+    EXTSORT_ERROR_UNSUPPORTED = -3,         // the storage can't read at an offset or remove files
+    EXTSORT_ERROR_UNABLE_TO_WRITE = -4,
+    EXTSORT_ERROR_UNABLE_TO_READ = -5,
+    EXTSORT_ERROR_NOT_FINISHED = -6,        // ExtSort_Next before ExtSort_Finish
+    EXTSORT_ERROR_GENERIC = -128
+} extsort_ret_t;
+
+typedef int (*extsort_compare_t)(const void *a, const void *b);
+
+typedef struct
+{
+    uint32_t records;
+    uint32_t runs;                          // as first written, 0 if it was all sorted in RAM
+    uint32_t passes;                        // merges written back to the card: not counting the last one
+    uint64_t written_b;
+    uint64_t read_b;
+} extsort_stats_t;
+
+// Where a merge is in a run
+typedef struct
+{
+    uint32_t next;                          // the next record to read from the file
+    uint32_t end;                           // the record after the run's last
+    uint32_t buffered;                      // records in the buffer
+    uint32_t at;                            // the next one to go
+} extsort_run_t;
+
+typedef struct
+{
+    fs_driver_t *fs;
+    char *files[2];                         // the runs go back and forth between these
+    file_t file[2];
+    uint8_t current;                        // which one has the runs
+    extsort_compare_t compare;
+    uint32_t record_size;
+    uint8_t *work;
+    size_t work_size;
+
+    uint32_t capacity;                      // records in a run, as first written
+    uint32_t buffered;                      // in the work buffer, still to be written
+    uint32_t run_records;                   // a run's records now (the last one may have fewer)
+    uint8_t finished;
+    uint8_t in_ram;
+
+    // The merge: a run's cursor, buffer and place in the heap each
+    uint32_t fan_in;                        // most runs merged at once
+    uint32_t buffer_records;
+    uint32_t write_records;                 // a pass's output buffer
+    extsort_run_t *runs;
+    uint32_t *heap;
+    uint8_t *buffers;
+    uint32_t heap_size;
+    uint32_t position;                      // sorted in RAM: the next one to go
+
+    extsort_stats_t stats;
+} extsort_t;
+
+// files: two names for the runs (they're created and removed as needed). work is trashed, and has to stay there
+// until ExtSort_Close.
+extsort_ret_t ExtSort_Init(extsort_t *sort, fs_driver_t *fs, char *file_a, char *file_b, uint32_t record_size,
+        extsort_compare_t compare, void *work, size_t work_size);
+
+extsort_ret_t ExtSort_Add(extsort_t *sort, const void *record);
+
+// No more records: sort what's left, and merge runs down to what can be merged in one go
+extsort_ret_t ExtSort_Finish(extsort_t *sort);
+
+// The next record, in order, into record. EXTSORT_END when there are no more.
+extsort_ret_t ExtSort_Next(extsort_t *sort, void *record);
+
+// Start handing them over again from the first
+extsort_ret_t ExtSort_Rewind(extsort_t *sort);
+
+// Close and remove the files, whether or not it got anywhere. stats may be NULL.
+extsort_ret_t ExtSort_Close(extsort_t *sort, extsort_stats_t *stats);
+
+#endif /* INC_EXTSORT_H_ */
@@ -0,0 +1,72 @@
+/*
+ * format.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#ifndef INC_FORMAT_H_
+#define INC_FORMAT_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "audio.h"
+#include "pcm.h"
+
+/*
+ * Format negotiation between a track and the audio sink.
+ *
+ * The sink advertises what it can take (audio_driver_t.GetFormats).
+ * For each of those, we work out which conversion stages the track would need to get there,
+ * add up a rough cost for each stage, and pick the cheapest.
+ *
+ * The ideal result is no stages at all: the track is already in a format the sink takes,
+ * so the player can read the file straight into the output ring (bit-perfect, zero copies).
+ *
+ * Costs are a mix of CPU time and what the stage does to the audio:
+ * lossless repacking is cheap, requantizing (dither) throws information away, and resampling is both slow and lossy.
+ */
+
+#define FORMAT_STAGE_NONE           0
+#define FORMAT_STAGE_REPACK         (1 << 0)    // lossless: widen/repack into a bigger word
+#define FORMAT_STAGE_REQUANTIZE     (1 << 1)    // lossy: reduce to 16 bits with dither
+#define FORMAT_STAGE_CHANNEL_MAP    (1 << 2)    // mono -> stereo
+#define FORMAT_STAGE_RESAMPLE       (1 << 3)    // sink can't be clocked at the track's rate
+
+#define FORMAT_COST_REPACK 1
+#define FORMAT_COST_CHANNEL_MAP 1
+#define FORMAT_COST_REQUANTIZE 4
+#define FORMAT_COST_RESAMPLE 16
+#define FORMAT_COST_IMPOSSIBLE UINT32_MAX
+
+typedef enum
+{
+    FORMAT_SUCCESS = 0,
+    FORMAT_ERROR_NULL_PARAMETER = -1,
+    FORMAT_ERROR_NO_CONVERSION = -2,
+    FORMAT_ERROR_STAGE_UNSUPPORTED = -3,
+    FORMAT_ERROR_GENERIC = -128
+} format_ret_t;
+
+typedef struct
+{
+    audio_format_t source;
+    audio_format_t sink;        // sink.sample_rate is always concrete (never AUDIO_RATE_ANY)
+    uint32_t stages;            // FORMAT_STAGE_* flags
+    uint32_t cost;
+} format_plan_t;
+
+/*
+ * Pick the cheapest sink format for a source.
+ * sink_rate forces the output rate (e.g., when the sink couldn't be clocked at the source's rate);
+ * pass AUDIO_RATE_ANY to keep the source's rate.
+ */
+format_ret_t Format_Negotiate(const audio_format_t *source, const audio_format_t *sink_formats, size_t count,
+        uint32_t sink_rate, format_plan_t *plan);
+
+// Convert frames from the source format to the sink format as described by the plan.
+// dst must hold frames * Audio_BytesPerFrame(&plan->sink) bytes.
+format_ret_t Format_Convert(const format_plan_t *plan, pcm_dither_t *dither, void *dst, const void *src, size_t frames);
+
+#endif /* INC_FORMAT_H_ */
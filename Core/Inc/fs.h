@@ -45,6 +45,13 @@ typedef enum
     FS_ERROR_UNABLE_TO_OPEN_FILE = -5,
     FS_ERROR_UNABLE_TO_READ_FILE = -6,
     FS_ERROR_UNABLE_TO_CLOSE_FILE = -7,
+    FS_ERROR_UNABLE_TO_WRITE_FILE = -8,
+    FS_ERROR_UNABLE_TO_RESERVE = -9,
+    FS_ERROR_UNABLE_TO_OPEN_DIR = -10,
+    FS_ERROR_UNABLE_TO_READ_DIR = -11,
+    FS_ERROR_UNABLE_TO_REMOVE = -12,
+    FS_ERROR_UNABLE_TO_RENAME = -13,
+    FS_ERROR_UNABLE_TO_SEEK = -14,
     FS_ERROR_GENERIC = -128
 } fs_ret_t;
 
@@ -56,16 +63,62 @@ struct file
     char *filename;
 };
 
+// Longest name in a directory, terminator included (FatFs: _MAX_LFN + 1)
+#define FS_MAX_NAME 256
+
+typedef struct fs_dir fs_dir_t;
+struct fs_dir
+{
+    void *handle;           // ex: DIR (fatfs)
+};
+
+// One directory entry, as FindFirst/FindNext return them. name is empty once there are no more.
+typedef struct
+{
+    char name[FS_MAX_NAME];
+    uint64_t size;          // bytes
+    uint32_t modified;      // FAT timestamp: date << 16 | time
+    uint8_t is_dir;
+    uint8_t hidden;         // hidden or system, e.g., "System Volume Information"
+} fs_entry_t;
+
+// Who the next reads/writes are for, highest priority first (see blk.h for how it's scheduled)
+typedef enum
+{
+    FS_IO_REALTIME = 0,     // playback: has a deadline
+    FS_IO_NORMAL,
+    FS_IO_IDLE              // background: library scans, indexing
+} fs_io_class_t;
+
 struct fs_operations;
 
 // For info on fields like block size and number of blocks,
 // see https://www.disca.upv.es/aperles/arm_cortex_m3/llibre/st/STM32F439xx_User_Manual/structhal__sd__cardinfotypedef.html
 
+// The link to the storage, as negotiated at mount time (see sd_bus.h). All 0 if not applicable.
+// The driver keeps this up to date if it has to slow the link down later on.
+typedef struct
+{
+    uint32_t clock_hz;
+    uint8_t width;          // data lines
+    uint8_t high_speed;
+    uint32_t throughput_kbps;   // measured at mount, KiB/s
+    uint32_t errors;        // CRC errors and timeouts since mount
+    uint32_t step_downs;    // times the clock was lowered because of them
+} fs_bus_t;
+
 typedef struct
 {
     uint32_t block_size_b;  // bytes
     uint32_t num_blocks;
     uint32_t fs_size_mb;    // megabytes
+    uint32_t volume_serial; // set when the volume was formatted, so tells one card from another (0 if unknown)
+    fs_bus_t bus;
+
+    // Performance hints for whoever reads from the file system, 0 if unknown (see sd_profile.h)
+    uint32_t read_size_b;   // smallest read that gets (nearly) full throughput
+    uint32_t stall_us;      // worst read latency to buffer against
+
     const struct fs_operations *ops;
 } fs_driver_t;
 
@@ -80,9 +133,49 @@ struct fs_operations {
     fs_ret_t (*OpenFile)(file_t *file, char *filename);
     fs_ret_t (*CloseFile)(file_t *file);
     fs_ret_t (*ReadFile)(file_t *file, void *buffer, size_t length);
-    // TODO: ReadFileFrom
-    // TODO: SeekFile
-    // TODO: fs_ret_t (*Write)(const uint8_t *buffer, size_t length);
+
+    // Optional (NULL if the storage doesn't schedule I/O).
+    // SetIOClass: the class for the caller's next reads/writes. For FS_IO_REALTIME, budget_ms is how long until
+    // the stream runs dry (0 = stream stopped). MayIssue: 0 if background work should wait, to leave the
+    // storage to the stream; it won't say so for long.
+    fs_ret_t (*SetIOClass)(fs_io_class_t io_class, uint32_t budget_ms);
+    uint8_t (*MayIssue)(fs_io_class_t io_class);
+
+    // Optional: how far ahead sequential reads should fetch, in bytes (0 = don't read ahead). Capped by the driver.
+    fs_ret_t (*SetReadAhead)(uint32_t bytes);
+
+    // Optional (NULL if the storage is read-only).
+    // CreateFile: a new, empty file (replacing any old one) open for writing, and for ReadFileFrom. WriteFile
+    // appends all of length, or fails. WriteFileAt overwrites what's at offset, e.g., a header, and the next
+    // WriteFile still goes on from the end. CloseFile is what makes sure it's all on the storage.
+    fs_ret_t (*CreateFile)(file_t *file, char *filename);
+    fs_ret_t (*WriteFile)(file_t *file, const void *buffer, size_t length);
+    fs_ret_t (*WriteFileAt)(file_t *file, uint64_t offset, const void *buffer, size_t length);
+
+    // Optional: allocate bytes for a file fresh from CreateFile, in one contiguous run, so that writing it never
+    // has to go looking for free space. CloseFile gives back whatever wasn't written.
+    fs_ret_t (*ReserveFile)(file_t *file, uint64_t bytes);
+
+    // Optional: all of length bytes from offset, or fails. Doesn't move where ReadFile goes on from.
+    fs_ret_t (*ReadFileFrom)(file_t *file, uint64_t offset, void *buffer, size_t length);
+
+    // Optional: directory listing. FindFirst opens path ("" is the root) and returns its first entry whose name
+    // matches pattern ("*" for all of them), FindNext the next one. CloseDir when done, even after an error.
+    fs_ret_t (*FindFirst)(fs_dir_t *dir, fs_entry_t *entry, const char *path, const char *pattern);
+    fs_ret_t (*FindNext)(fs_dir_t *dir, fs_entry_t *entry);
+    fs_ret_t (*CloseDir)(fs_dir_t *dir);
+
+    // Optional: delete a file (not open), or give it a new name (not one that's taken)
+    fs_ret_t (*RemoveFile)(const char *filename);
+    fs_ret_t (*RenameFile)(const char *from, const char *to);
+
+    // Optional: where ReadFile goes on from, in bytes from the start of the file (no further than its end)
+    fs_ret_t (*SeekFile)(file_t *file, uint64_t offset);
+
+    // Optional: an existing file, open to be written over in place (WriteFileAt) and read (ReadFileFrom). Its size
+    // and its clusters stay as they are, so a write of whole, aligned sectors changes nothing else on the storage:
+    // no FAT, no directory entry. WriteFile would go on from the end.
+    fs_ret_t (*OpenFileForUpdate)(file_t *file, char *filename);
 };
 
 #endif /* INC_FS_H_ */
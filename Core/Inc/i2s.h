@@ -12,6 +12,8 @@
 
 audio_ret_t I2S_Open(void);
 audio_ret_t I2S_Close(void);
+audio_ret_t I2S_GetFormats(const audio_format_t **formats, size_t *count);
+audio_ret_t I2S_Configure(const audio_format_t *format, int32_t *error_ppm);
 audio_ret_t I2S_Stream(void *buffer, size_t length);
 
 extern const audio_driver_t i2s_driver;
@@ -0,0 +1,76 @@
+/*
+ * i2s_clock.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#ifndef INC_I2S_CLOCK_H_
+#define INC_I2S_CLOCK_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * I2S sample clock planning for the STM32F401.
+ *
+ * The I2S peripheral doesn't run off SYSCLK: it has its own PLL (PLLI2S), fed from the same /M divider as the main PLL.
+ *
+ *   I2SCLK = (PLL input / M) * PLLI2SN / PLLI2SR
+ *   Fs     = I2SCLK / (k * (2 * I2SDIV + ODD))
+ *
+ * where k is 32 (16-bit channels), 64 (32-bit channels) or 256 (whenever MCLK is output to the DAC).
+ * See RM0368 section 20.4.4 "Clock generator".
+ *
+ * 44.1 kHz and 48 kHz aren't related by a nice ratio, so a single fixed PLLI2S setting can't hit both.
+ * Instead we search every N/R/DIV/ODD combination for the closest rate, once at boot, for all the standard rates.
+ * Picking a track's clock is then just a table lookup.
+ *
+ * Nothing in here touches hardware, so it can be compiled and checked on a host.
+ */
+
+// Hardware limits (RM0368, 6.3.23 RCC PLLI2S configuration register, and the datasheet)
+#define I2S_CLOCK_PLLN_MIN 50
+#define I2S_CLOCK_PLLN_MAX 432
+#define I2S_CLOCK_PLLR_MIN 2
+#define I2S_CLOCK_PLLR_MAX 7
+#define I2S_CLOCK_VCO_MIN_HZ 100000000UL
+#define I2S_CLOCK_VCO_MAX_HZ 432000000UL
+#define I2S_CLOCK_I2SCLK_MAX_HZ 192000000UL
+#define I2S_CLOCK_DIV_MIN 2
+#define I2S_CLOCK_DIV_MAX 255
+
+// Bits per stereo frame on the wire
+#define I2S_CLOCK_FRAME_16 32
+#define I2S_CLOCK_FRAME_32 64
+
+// The rates we precompute: both the 44.1 kHz and the 48 kHz families
+#define I2S_CLOCK_NUM_RATES 9
+
+typedef enum
+{
+    I2S_CLOCK_SUCCESS = 0,
+    I2S_CLOCK_ERROR_INVALID_PARAMETER = -1,
+    I2S_CLOCK_ERROR_NO_SOLUTION = -2,
+    I2S_CLOCK_ERROR_TABLE_NOT_BUILT = -3,
+    I2S_CLOCK_ERROR_GENERIC = -128
+} i2s_clock_ret_t;
+
+typedef struct
+{
+    uint32_t sample_rate;       // requested, Hz
+    uint32_t actual_rate_mhz;   // what the hardware will really produce, in millihertz
+    int32_t error_ppm;          // (actual - requested) / requested, parts per million
+    uint16_t plli2s_n;
+    uint8_t plli2s_r;
+    uint8_t i2s_div;
+    uint8_t i2s_odd;
+} i2s_clock_t;
+
+i2s_clock_ret_t I2SClock_Compute(uint32_t input_hz, uint32_t sample_rate, uint32_t frame_bits, uint8_t mclk_output,
+        i2s_clock_t *clock);
+
+i2s_clock_ret_t I2SClock_BuildTable(uint32_t input_hz, uint8_t mclk_output);
+i2s_clock_ret_t I2SClock_Lookup(uint32_t sample_rate, uint32_t frame_bits, i2s_clock_t *clock);
+
+#endif /* INC_I2S_CLOCK_H_ */
@@ -0,0 +1,29 @@
+/*
+ * internal_flash.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#ifndef INC_INTERNAL_FLASH_H_
+#define INC_INTERNAL_FLASH_H_
+
+#include "main.h"
+#include "settings.h"
+
+/*
+ * The F401RE's last two sectors, 6 and 7 (128 KiB each, from 0x08040000), as the settings store's pair
+ * (settings.h). The linker script (STM32F401RETX_FLASH.ld) stops the program short of them.
+ *
+ * Programmed a word at a time, which is what the flash takes at our supply (voltage range 3, 2.7-3.6 V): about 16 us
+ * a word. Erasing a sector takes a second or two. Either way there's only the one bank, so anything that reads the
+ * flash meanwhile (code, the vector table, constants) waits: DMA carries on, but the CPU doesn't.
+ */
+
+#define INTERNAL_FLASH_SETTINGS_SECTOR FLASH_SECTOR_6
+#define INTERNAL_FLASH_SETTINGS_BASE 0x08040000UL
+#define INTERNAL_FLASH_SETTINGS_SECTOR_SIZE (128 * 1024)
+
+extern const settings_flash_t internal_flash_settings;
+
+#endif /* INC_INTERNAL_FLASH_H_ */
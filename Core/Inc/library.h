@@ -0,0 +1,173 @@
+/*
+ * library.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#ifndef INC_LIBRARY_H_
+#define INC_LIBRARY_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "codec.h"
+#include "fs.h"
+
+/*
+ * The media library: every track on the card and its tags, in one index file at the root, so that what's on the
+ * card can be browsed at boot without looking at the tracks themselves.
+ *
+ * Library_Build walks the whole volume (FindFirst/FindNext), parses each track's header (tags included, see codec_t
+ * ReadTags) and writes the index. That takes a while on a big card, so it's only for when there's no index yet.
+ * Library_Update does the same walk, but only opens the tracks in folders that have changed since the index was
+ * built: for the rest, what the index already has is copied over. What's changed is told apart by what a folder
+ * listing has anyway (entry count, each entry's name, size and timestamp, and the folder's own), so finding out
+ * costs a directory read or two per folder, not a file open per track. The index also has the volume's serial
+ * number: a different card gets a whole new build.
+ * Library_Open reads nothing but the index's header; everything else is read when it's asked for, a record or
+ * a string at a time, each within a sector or two.
+ *
+ * The index (LIBRARY_INDEX_FILE) is a header sector, then these sections, each on a sector boundary:
+ *
+ *  - strings: the tags, NUL-terminated. An artist or album that's the same as the track before's is only stored
+ *    once, which, in walk order (folder by folder), it nearly always is.
+ *  - paths: front-coded, i.e., how many bytes a path has in common with the one before, then the rest.
+ *    Every LIBRARY_PATH_GROUP tracks there's a whole one, so getting at a path means decoding at most that many.
+ *  - records: one per track, all the same size, so a track's is at a known offset, and 16 fit in a sector
+ *  - folders: one per folder walked, with what was in it and which tracks are its own
+ *  - views: per library_view_t, the tracks' numbers in that order
+ *  - search: the title view's keys, front-coded in blocks of a sector: how many entries, then per entry the bytes
+ *    it has in common with the key before (none for a block's first), how many follow, those, and the track's
+ *    number. Then every so many blocks' first key (only the start of it), at most 64 of them.
+ *
+ * Tracks are numbered in walk order (a folder's tracks, then its subfolders'). A new index is written next to the old
+ * one, which is only replaced once it's done; a build that doesn't finish leaves the old one as it was.
+ *
+ * The views' keys are made during the walk, from the tags, and written to a file of their own. Each view is then
+ * sorted on the first LIBRARY_KEY_LEN bytes of its keys (case-insensitive for ASCII), then walk order: in RAM if
+ * the work buffer given to Library_Build holds LIBRARY_SORT_ENTRY_LEN bytes per track, else in runs the size of the
+ * work buffer, merged from the card (extsort.h). A bigger work buffer means fewer runs, and less to read and write.
+ *
+ * Library_Search finds the titles that start with what's been typed so far: the samples (kept in RAM, once read)
+ * narrow it down to the blocks between two of them, which are halved on the card down to the one it starts in.
+ * That's log2 of the blocks between two samples in sector reads (2 for 10 000 titles, 6 for 100 000), then one more
+ * per block's worth of results (40-odd titles) after that.
+ */
+
+#define LIBRARY_INDEX_FILE "MUPOD.IDX"
+
+// Where strings, paths and records go while the volume is walked, before they're copied into the index, and the
+// views' sort keys before they're sorted. The index is only written once the walk is done, so that, with nothing
+// else growing alongside it, it's all in one run of clusters, which FatFs reads without the FAT (_FS_CONTIG).
+#define LIBRARY_STRINGS_TEMP "MUPODSTR.TMP"
+#define LIBRARY_PATHS_TEMP "MUPODPTH.TMP"
+#define LIBRARY_RECORDS_TEMP "MUPODREC.TMP"
+#define LIBRARY_KEYS_TEMP "MUPODKEY.TMP"
+#define LIBRARY_FOLDERS_TEMP "MUPODDIR.TMP"
+#define LIBRARY_INDEX_TEMP "MUPODIDX.TMP"
+
+// Where a view's sort entries go when there are more than fit in the work buffer (see extsort.h)
+#define LIBRARY_RUNS_TEMP "MUPODRUN.TMP"
+#define LIBRARY_MERGE_TEMP "MUPODMRG.TMP"
+
+// Longest path indexed, terminator included: lengths in the paths section are a byte each
+#define LIBRARY_MAX_PATH 256
+
+// Folders this deep and deeper aren't walked. Each level holds a directory open, on top of the six files being
+// written, the old index and a track (see _FS_LOCK in ffconf.h).
+#define LIBRARY_MAX_DEPTH 8
+
+// A whole path every this many tracks
+#define LIBRARY_PATH_GROUP 16
+
+// Sorted on this much of the key, plus the track number to go with it
+#define LIBRARY_KEY_LEN 28
+#define LIBRARY_SORT_ENTRY_LEN (LIBRARY_KEY_LEN + 4)
+
+// Smallest work buffer Library_Build takes: a track's header has to fit, and a sort has to be able to merge
+// (EXTSORT_MIN_WORK)
+#define LIBRARY_MIN_WORK 2048
+
+typedef enum
+{
+    LIBRARY_SUCCESS = 0,
+    LIBRARY_ERROR_NULL_PARAMETER = -1,
+    LIBRARY_ERROR_NOT_INITIALIZED = -2,
+    LIBRARY_ERROR_NO_INDEX = -3,            // none on the card, or not a whole one
+    LIBRARY_ERROR_UNABLE_TO_READ = -4,
+    LIBRARY_ERROR_UNABLE_TO_WRITE = -5,
+    LIBRARY_ERROR_OUT_OF_RANGE = -6,
+    LIBRARY_ERROR_NO_VIEW = -7,             // built without it: there were no tracks
+    LIBRARY_ERROR_WORK_TOO_SMALL = -8,
+    LIBRARY_ERROR_UNSUPPORTED = -9,         // the storage can't list directories or read at an offset
+    LIBRARY_ERROR_GENERIC = -128
+} library_ret_t;
+
+typedef enum
+{
+    LIBRARY_VIEW_ARTIST = 0,                // then album, then track number
+    LIBRARY_VIEW_ALBUM,                     // then track number
+    LIBRARY_VIEW_TITLE,
+    LIBRARY_NUM_VIEWS
+} library_view_t;
+
+typedef struct
+{
+    char title[CODEC_MAX_TAG];
+    char artist[CODEC_MAX_TAG];
+    char album[CODEC_MAX_TAG];
+    uint32_t duration_ms;
+    uint32_t sample_rate;
+    uint16_t track_number;                  // 0 if unknown
+    uint8_t channels;
+    uint8_t bits_per_sample;
+} library_track_t;
+
+typedef struct
+{
+    uint32_t tracks;
+    uint32_t dirs;
+    uint32_t skipped;                       // files we can't play (or read), and paths too long to index
+    uint32_t too_deep;                      // folders not walked, see LIBRARY_MAX_DEPTH
+    uint32_t changed_dirs;                  // folders whose tracks were opened: all of them, without an index
+    uint32_t reused;                        // tracks copied over from the old index, see Library_Update
+    uint32_t views;                         // built, out of LIBRARY_NUM_VIEWS
+    uint32_t index_b;
+    uint32_t strings_b;
+    uint32_t paths_b;
+    uint32_t search_b;
+    uint32_t sort_runs;                     // written to the card by the views' sorts, 0 if they fit in RAM
+    uint32_t sort_passes;                   // of merging runs into longer ones, on the card
+} library_stats_t;
+
+library_ret_t Library_Init(fs_driver_t *fs, const codec_t *codec);
+
+// Open the index on the card: one sector read, and LIBRARY_ERROR_NO_INDEX if there isn't a valid one
+library_ret_t Library_Open(void);
+library_ret_t Library_Close(void);
+
+// Index the whole volume, replacing any index there was, then open it. work is trashed; the more there is
+// (up to LIBRARY_SORT_ENTRY_LEN bytes a track), the less the views' sorts use the card. stats may be NULL.
+library_ret_t Library_Build(void *work, size_t work_size, library_stats_t *stats);
+
+// Like Library_Build, but only looking again at the folders that changed since the index on the card was built.
+// With no index, or one from a different card, that's all of them.
+library_ret_t Library_Update(void *work, size_t work_size, library_stats_t *stats);
+
+// Tracks in the open index, 0 if none is open
+uint32_t Library_Count(void);
+
+library_ret_t Library_GetTrack(uint32_t index, library_track_t *track);
+
+// path must hold LIBRARY_MAX_PATH bytes. Relative to the root, e.g., "Artist/Album/01 Title.wav".
+library_ret_t Library_GetPath(uint32_t index, char *path, size_t size);
+
+// The track at position in a view
+library_ret_t Library_GetViewEntry(library_view_t view, uint32_t position, uint32_t *index);
+
+// The tracks whose titles start with prefix (case-insensitive for ASCII), in title order: up to max of them, after
+// the first skip (for the next page). LIBRARY_ERROR_NO_VIEW if the index was built without the title view.
+library_ret_t Library_Search(const char *prefix, uint32_t skip, uint32_t *indexes, uint32_t max, uint32_t *found);
+
+#endif /* INC_LIBRARY_H_ */
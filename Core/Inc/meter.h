@@ -0,0 +1,79 @@
+/*
+ * meter.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#ifndef INC_METER_H_
+#define INC_METER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "ring.h"
+
+/*
+ * Level (peak/RMS) and spectrum metering for the status display and diagnostics.
+ *
+ * The meter is a *tap* on the output ring: it never consumes anything and never copies PCM out.
+ * It looks at the block that's about to be played (between the ring's tail and head),
+ * which the producer can't touch until the sink has consumed it.
+ * If the sink and producer lap us while we're still crunching, we notice (the ring counters are free-running)
+ * and throw the result away instead of publishing garbage.
+ *
+ * Meter_Process() is meant to run from the main loop, i.e., at the lowest priority.
+ * Nothing is added to the audio interrupt path, so metering can never cause an underrun.
+ *
+ * Results are published through a double-buffered snapshot,
+ * so a reader (UART dump, display) never sees a half-written one and never blocks the meter.
+ */
+
+// 256-point real FFT -> 128 bins
+#define METER_FFT_LEN 256
+#define METER_FFT_BINS (METER_FFT_LEN / 2)
+
+// Decimate by 2 before the FFT: 48 kHz -> 24 kHz, so bins are ~94 Hz wide up to 12 kHz.
+// One FFT frame then covers METER_FFT_LEN * METER_DECIMATION input frames (~10.7 ms at 48 kHz).
+#define METER_DECIMATION 2
+#define METER_BLOCK_FRAMES (METER_FFT_LEN * METER_DECIMATION)
+
+#define METER_MAX_CHANNELS 2
+
+// Anything quieter than this is clamped, so silence doesn't show up as -inf
+#define METER_FLOOR_DB (-120.0f)
+
+typedef enum
+{
+    METER_SUCCESS = 0,
+    METER_ERROR_NULL_RING = -1,
+    METER_ERROR_INVALID_FORMAT = -2,
+    METER_ERROR_NOT_READY = -3,
+    METER_ERROR_GENERIC = -128
+} meter_ret_t;
+
+typedef struct
+{
+    uint32_t sequence;                      // increments on every publish, 0 = nothing published yet
+    uint16_t channels;
+    float peak[METER_MAX_CHANNELS];         // linear, 1.0 = full scale
+    float rms[METER_MAX_CHANNELS];          // linear, 1.0 = full scale
+    float spectrum_db[METER_FFT_BINS];      // dBFS, bin k is centered at k * bin_hz
+    float bin_hz;
+    uint32_t cycles;                        // CPU cycles spent on the last block
+    uint32_t cpu_permille;                  // cycles relative to the block's playback time
+    uint32_t avg_cycles;                    // over every block analyzed since Meter_Init
+    uint32_t max_cycles;
+    uint32_t avg_cpu_permille;
+    uint32_t max_cpu_permille;
+    uint32_t blocks;                        // blocks analyzed
+    uint32_t dropped;                       // blocks thrown away because they were overwritten mid-analysis
+} meter_snapshot_t;
+
+// Source format is whatever the output ring holds: interleaved signed 16-bit PCM (sample_bytes = 2)
+// or 32-bit words with the sample left-justified (sample_bytes = 4)
+meter_ret_t Meter_Init(const ring_t *ring, uint16_t channels, uint32_t sample_bytes, uint32_t sample_rate);
+meter_ret_t Meter_Process(void);
+meter_ret_t Meter_GetSnapshot(meter_snapshot_t *snapshot);
+
+#endif /* INC_METER_H_ */
@@ -10,6 +10,7 @@
 
 #include "fatfs.h"
 #include "fs.h"
+#include "sd_profile.h"
 
 // SD cards can run in two different modes: SPI or SDIO
 // https://stm32world.com/wiki/STM32_SD_card_with_FatFs
@@ -39,10 +40,30 @@ fs_ret_t MicroSD_Close(void);
 fs_ret_t MicroSD_OpenFile(file_t *file, char *filename);
 fs_ret_t MicroSD_CloseFile(file_t *file);
 fs_ret_t MicroSD_ReadFile(file_t *file, void *buffer, size_t length);
+fs_ret_t MicroSD_SetIOClass(fs_io_class_t io_class, uint32_t budget_ms);
+uint8_t MicroSD_MayIssue(fs_io_class_t io_class);
+fs_ret_t MicroSD_SetReadAhead(uint32_t bytes);
+fs_ret_t MicroSD_CreateFile(file_t *file, char *filename);
+fs_ret_t MicroSD_WriteFile(file_t *file, const void *buffer, size_t length);
+fs_ret_t MicroSD_WriteFileAt(file_t *file, uint64_t offset, const void *buffer, size_t length);
+fs_ret_t MicroSD_ReserveFile(file_t *file, uint64_t bytes);
+fs_ret_t MicroSD_ReadFileFrom(file_t *file, uint64_t offset, void *buffer, size_t length);
+fs_ret_t MicroSD_FindFirst(fs_dir_t *dir, fs_entry_t *entry, const char *path, const char *pattern);
+fs_ret_t MicroSD_FindNext(fs_dir_t *dir, fs_entry_t *entry);
+fs_ret_t MicroSD_CloseDir(fs_dir_t *dir);
+fs_ret_t MicroSD_RemoveFile(const char *filename);
+fs_ret_t MicroSD_RenameFile(const char *from, const char *to);
+fs_ret_t MicroSD_SeekFile(file_t *file, uint64_t offset);
+fs_ret_t MicroSD_OpenFileForUpdate(file_t *file, char *filename);
 
 // File methods
 fs_ret_t MicroSD_File_Read(file_t *file, void *buffer, size_t length);
 
+// Benchmark the card (see sd_bench.h), store its profile on the card, and update the hints in fs.
+// Only needed when Open() found no profile for this card, i.e., fs->read_size_b is still 0.
+// work must hold at least 32 KiB and is trashed.
+fs_ret_t MicroSD_Characterize(fs_driver_t *fs, void *work, size_t work_size, sd_profile_t *profile);
+
 extern fs_driver_t microsd_driver;
 
 #endif /* INC_MICROSD_H_ */
@@ -0,0 +1,71 @@
+/*
+ * pcm.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#ifndef INC_PCM_H_
+#define INC_PCM_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * PCM format conversion kernels: source sample format -> the 16-bit output word.
+ *
+ * Simply truncating a 24-bit sample to 16 bits makes the rounding error correlated with the signal,
+ * which shows up as distortion on quiet passages (fade-outs, reverb tails).
+ * Adding a little random noise (dither) before rounding decorrelates the error, turning it into a constant hiss.
+ * TPDF (triangular probability density) dither, i.e., the sum of two uniform randoms, is the standard choice
+ * because it makes both the mean and the variance of the error independent of the signal.
+ * See https://en.wikipedia.org/wiki/Dither#Digital_audio
+ *
+ * Noise shaping then feeds the rounding error back through a small filter so that the hiss
+ * is pushed up towards high frequencies where the ear is less sensitive.
+ *
+ * Everything is fused into the conversion loop: each sample is read, dithered, shaped, rounded and stored
+ * in one go, so dithering costs no extra pass over memory.
+ *
+ * Internally the kernels work at 24-bit precision in an int32_t, where one 16-bit LSB is 256 units.
+ * This keeps the error feedback well away from overflow and lets one 32-bit random number
+ * provide the dither for two samples.
+ */
+
+#define PCM_MAX_CHANNELS 2
+
+typedef enum
+{
+    PCM_SHAPING_NONE = 0,       // plain TPDF dither, flat noise floor
+    PCM_SHAPING_FIRST_ORDER,    // noise transfer 1 - z^-1
+    PCM_SHAPING_SECOND_ORDER    // noise transfer (1 - z^-1)^2, steeper push towards Nyquist
+} pcm_shaping_t;
+
+typedef struct
+{
+    uint32_t rng;                           // xorshift32 state, must never be 0
+    uint32_t random_bits;                   // leftover random bits from the last PRNG step
+    uint8_t random_left;                    // number of dither values left in random_bits
+    int8_t h1;                              // error feedback taps (see PCM_DitherInit)
+    int8_t h2;
+    int32_t error[PCM_MAX_CHANNELS][2];     // last two rounding errors, per channel
+} pcm_dither_t;
+
+void PCM_DitherInit(pcm_dither_t *dither, uint32_t seed, pcm_shaping_t shaping);
+void PCM_DitherReset(pcm_dither_t *dither);
+
+// All counts are in samples (frames * channels). Source and destination may not overlap.
+// Passing dither = NULL truncates (rounds) without dither, e.g., for comparison.
+void PCM_Convert16To16(int16_t *dst, const int16_t *src, size_t samples);
+void PCM_Convert24To16(pcm_dither_t *dither, int16_t *dst, const uint8_t *src, size_t samples, uint16_t channels);
+void PCM_Convert32To16(pcm_dither_t *dither, int16_t *dst, const int32_t *src, size_t samples, uint16_t channels);
+
+// Lossless widening into a 32-bit word (sample left-justified), for sinks that take 24/32-bit words
+void PCM_Widen16To32(int32_t *dst, const int16_t *src, size_t samples);
+void PCM_Repack24To32(int32_t *dst, const uint8_t *src, size_t samples);
+
+// Mono -> stereo by duplicating each sample, in place.
+// The buffer must have room for 2 * frames samples; only the first frames are read.
+void PCM_DuplicateMono(void *buffer, size_t frames, uint32_t bytes_per_sample);
+
+#endif /* INC_PCM_H_ */
@@ -0,0 +1,115 @@
+/*
+ * player.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#ifndef INC_PLAYER_H_
+#define INC_PLAYER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "audio.h"
+#include "codec.h"
+#include "format.h"
+#include "fs.h"
+#include "ring.h"
+#include "wav.h"
+
+/*
+ * Glue between the file system, the codec, the output ring and the audio sink.
+ *
+ * Opening a track negotiates a format with the sink (see format.h).
+ * When no conversion is needed, Player_Service() reads the file straight into the output ring:
+ * no scratch buffer, no copy, and the samples reach the sink bit-for-bit as they are in the file.
+ * Otherwise the file is read into a small scratch buffer and converted into the ring.
+ *
+ * Every read is timed, and the ring only uses as much of itself as it takes to ride out the reads the card
+ * actually does (see depth.h): deeper when they get slow, shallower again when they've been quick for a while,
+ * with the block layer's read-ahead making room when the RAM budget is tight. Until there are enough reads to go by,
+ * that's the card profile's worst stall (fs_driver_t stall_us, see sd_profile.h), or without one, the whole ring.
+ * The ring is only topped up once a read of the card's preferred size fits (read_size_b).
+ * The ring passed to Player_Init() is the most that will ever be used. Without Depth_Init(), it's all used.
+ *
+ * Reads are in the real-time I/O class, with a deadline of when the ring would run dry (fs SetIOClass),
+ * so background work on the same card can keep out of the way.
+ *
+ * Opening a track is in two halves: opening the file and checking its header (Player_PrepareTrack), then
+ * negotiating with the sink and starting (Player_OpenPrepared). The first half can be done for the next track while
+ * this one plays, e.g., by a playlist (see playlist.h), so that moving on to it doesn't wait on the card.
+ */
+
+// Rate to fall back to when the sink can't be clocked at the track's rate (needs resampling)
+#define PLAYER_FALLBACK_RATE 48000
+
+// Scratch space for the conversion path. 3072 is a whole number of frames for every packing (2, 3, 4, 6, 8 bytes).
+#define PLAYER_SCRATCH_BYTES 3072
+
+// How much is handed to the sink per Stream() call
+#define PLAYER_STREAM_BYTES 2048
+
+typedef enum
+{
+    PLAYER_SUCCESS = 0,
+    PLAYER_ERROR_NULL_PARAMETER = -1,
+    PLAYER_ERROR_UNABLE_TO_OPEN_TRACK = -2,
+    PLAYER_ERROR_INVALID_TRACK = -3,
+    PLAYER_ERROR_FORMAT_UNSUPPORTED = -4,
+    PLAYER_ERROR_UNABLE_TO_CONFIGURE = -5,
+    PLAYER_ERROR_UNABLE_TO_READ = -6,
+    PLAYER_ERROR_UNABLE_TO_STREAM = -7,
+    PLAYER_ERROR_NO_TRACK = -8,
+    PLAYER_ERROR_UNABLE_TO_SEEK = -9,
+    PLAYER_ERROR_GENERIC = -128
+} player_ret_t;
+
+player_ret_t Player_Init(fs_driver_t *fs, const codec_t *codec, const audio_driver_t *audio, ring_t *ring);
+
+// A track opened and its header read and checked, but not playing yet
+typedef struct
+{
+    uint8_t ready;
+    file_t file;                // at the start of the audio
+    wav_metadata_t metadata;    // TODO: only WAV for now
+    audio_format_t source;
+    uint32_t data_offset;       // where the audio starts in the file
+} player_track_t;
+
+// Player_PrepareTrack, then Player_OpenPrepared
+player_ret_t Player_OpenTrack(char *filename);
+player_ret_t Player_CloseTrack(void);
+
+// The first half of opening a track: doesn't touch the track that's playing, or the sink. Not from the yield hook.
+player_ret_t Player_PrepareTrack(char *filename, player_track_t *prepared);
+
+// The second half: closes the track that's playing, and starts this one. Its file is the player's from then on,
+// even if it can't be played after all.
+player_ret_t Player_OpenPrepared(player_track_t *prepared);
+
+// Close a prepared track that won't be played after all
+player_ret_t Player_DiscardPrepared(player_track_t *prepared);
+
+// Call from the main loop: tops up the ring from the file, then feeds the sink one block.
+// The track is closed automatically once the last sample has been streamed.
+player_ret_t Player_Service(void);
+
+// Just the second half: feeds the sink one block from what's already in the ring. Never touches the file system,
+// so it's what to run while a read is waiting on the card (Blk_SetYield): the ring drains, like it would into
+// a DMA, instead of the sink starving until the read is done.
+player_ret_t Player_Pump(void);
+
+uint8_t Player_IsPlaying(void);
+
+// Carry on from frame (from the start of the track) instead: sample-accurate, since the audio is read from right
+// there (fs SeekFile). What's in the ring from before is dropped. E.g., to resume where a bookmark says (bookmark.h).
+player_ret_t Player_Seek(uint64_t frame);
+
+// The frame the sink is handed next, from the start of the track: what's been read, less what's still in the ring
+player_ret_t Player_GetPosition(uint64_t *frame);
+
+// The plan the current track was opened with, and how far off the sink's clock is
+player_ret_t Player_GetPlan(format_plan_t *plan, int32_t *rate_error_ppm);
+
+#endif /* INC_PLAYER_H_ */
@@ -0,0 +1,111 @@
+/*
+ * playlist.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#ifndef INC_PLAYLIST_H_
+#define INC_PLAYLIST_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "codec.h"
+#include "fs.h"
+#include "player.h"
+
+/*
+ * Playlists on the card, M3U (M3U8 too) and PLS, played straight from the file however long they are.
+ *
+ * Nothing is loaded whole: the file is read a line at a time through a window of PLAYLIST_WINDOW bytes, and where
+ * the playlist is at is just offsets into it. Playlist_Open reads the first window and no more, so a playlist of ten
+ * thousand entries opens as fast as one of ten. An entry is only resolved when it's got to: a path relative to the
+ * playlist is put together with the playlist's folder, backslashes turned around and "." and ".." taken out. URLs,
+ * and anything else that doesn't turn out to be a track on the card, are skipped.
+ *
+ * The next PLAYLIST_PREFETCH tracks are opened and their headers read ahead of time (Player_PrepareTrack), one
+ * a Playlist_Service, in the idle I/O class, so that Playlist_Next hands over a track that's ready: going on to it is
+ * only Player_OpenPrepared, without the card. Playlist_Previous looks back through the file a window at a time.
+ *
+ * M3U: a path a line. Lines starting with '#' are comments, apart from #EXTINF:seconds,title, the next entry's title.
+ * PLS: FileN= and TitleN= lines, taken in the order they're in the file, which is N's in every PLS there is.
+ * A UTF-8 byte order mark is skipped; the paths are taken byte for byte otherwise, as the card's code page
+ * (_CODE_PAGE in ffconf.h). FatFs is built without relative paths (_FS_RPATH), hence resolving them here.
+ */
+
+// Read from the file at a time, a sector either side of where the parsing's at
+#define PLAYLIST_WINDOW 1024
+
+// Longer lines are skipped
+#define PLAYLIST_MAX_LINE 512
+
+// Longest path resolved, terminator included, like the library's (LIBRARY_MAX_PATH)
+#define PLAYLIST_MAX_PATH 256
+
+// Tracks kept ready ahead of the current one. Each holds a file open (see _FS_LOCK in ffconf.h).
+#define PLAYLIST_PREFETCH 2
+
+typedef enum
+{
+    PLAYLIST_SUCCESS = 0,
+    PLAYLIST_END = 1,                       // not an error: no more entries that way
+    PLAYLIST_READY = 2,                     // not an error: Playlist_Service has nothing left to get ready
+    PLAYLIST_ERROR_NULL_PARAMETER = -1,
+    PLAYLIST_ERROR_NOT_INITIALIZED = -2,
+    PLAYLIST_ERROR_NOT_OPEN = -3,
+    PLAYLIST_ERROR_UNABLE_TO_OPEN = -4,
+    PLAYLIST_ERROR_UNABLE_TO_READ = -5,
+    PLAYLIST_ERROR_UNSUPPORTED = -6,        // the storage can't list directories or read at an offset
+    PLAYLIST_ERROR_GENERIC = -128
+} playlist_ret_t;
+
+typedef enum
+{
+    PLAYLIST_M3U = 0,
+    PLAYLIST_PLS
+} playlist_kind_t;
+
+typedef struct
+{
+    player_track_t track;                   // for Player_OpenPrepared, or Player_DiscardPrepared
+    char path[PLAYLIST_MAX_PATH];           // relative to the root, as resolved
+    char title[CODEC_MAX_TAG];              // from #EXTINF or TitleN, empty if there wasn't one
+    uint32_t number;                        // which entry it is, from 0, counting the ones skipped
+    uint32_t offset;                        // where it starts in the file
+} playlist_entry_t;
+
+typedef struct
+{
+    uint32_t entries;                       // looked at, skipped ones included
+    uint32_t skipped;                       // not on the card, or not a track that can be played
+    uint32_t prefetched;                    // got ready by Playlist_Service
+    uint32_t ready;                         // Playlist_Next that had its track ready
+    uint32_t waited;                        // Playlist_Next that had to get it there and then
+    uint32_t window_reads;
+} playlist_stats_t;
+
+// The player has to be initialized too: it's what opens the tracks
+playlist_ret_t Playlist_Init(fs_driver_t *fs);
+
+// Open a playlist, relative to the root, e.g., "Lists/Road trip.m3u". PLS if it starts with [playlist] or is
+// named .pls, M3U otherwise. Playlist_Next is then its first entry.
+playlist_ret_t Playlist_Open(const char *filename);
+playlist_ret_t Playlist_Close(void);
+
+// Call from the main loop: gets the next track ready, if there's one to get ready and the card has time for it.
+// PLAYLIST_READY once there isn't.
+playlist_ret_t Playlist_Service(void);
+
+// The next (previous) track that can be played, into entry: its file is the caller's from then on.
+// PLAYLIST_END if there are no more.
+playlist_ret_t Playlist_Next(playlist_entry_t *entry);
+playlist_ret_t Playlist_Previous(playlist_entry_t *entry);
+
+// Back to before the first entry
+playlist_ret_t Playlist_Rewind(void);
+
+playlist_kind_t Playlist_Kind(void);
+playlist_ret_t Playlist_GetStats(playlist_stats_t *stats);
+
+#endif /* INC_PLAYLIST_H_ */
@@ -0,0 +1,103 @@
+/*
+ * recorder.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#ifndef INC_RECORDER_H_
+#define INC_RECORDER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "audio.h"
+#include "codec.h"
+#include "fs.h"
+#include "ring.h"
+
+/*
+ * Glue between a capture source (line-in), the capture ring, the codec and a file on the card: the player
+ * the other way around.
+ *
+ * The capture source hands over its samples with Recorder_Capture, e.g., from its DMA callback. That only ever copies
+ * into the ring and never waits on anything, so capture carries on at the sample clock whatever the card is doing.
+ * All the card work is in Recorder_Service, from the main loop, and the ring is what covers for the card meanwhile:
+ * it has to hold the longest a write can take (the card's worst stall, fs_driver_t stall_us) plus one write.
+ * If it still fills up, what doesn't fit is dropped, whole frames at a time, and counted: a gap in the recording,
+ * never a capture source that's held up.
+ *
+ * What keeps the writes short, and the same length every time:
+ *
+ *  - the file is allocated up front, in one contiguous run (fs ReserveFile), so a write never goes looking for
+ *    free clusters (and on exFAT, never reads the FAT)
+ *  - the header is a whole sector (WAV_ENCODED_HEADER_LEN), and the audio goes to the card straight out of
+ *    the ring, in blocks of RECORDER_WRITE_BYTES at the same offsets in the file (the first one fills up the header's).
+ *    Every write is whole sectors on a sector boundary, within a cluster: one multi-block transfer, with nothing
+ *    for FatFs to read first
+ *  - the header is written at the start with sizes of 0, and only patched with the real ones by Recorder_Stop,
+ *    which also gives back what wasn't used of the reservation. In between, nothing but audio goes to the file.
+ *  - writes are in the real-time I/O class, due by the time the ring would fill up
+ *
+ * Without a reservation (no room for one, or a storage that can't) it all still works, just with the allocator
+ * in the way now and then.
+ */
+
+// Per write: 16 sectors, the block layer's staging size. The ring has to hold at least two of these.
+#define RECORDER_WRITE_BYTES 8192
+
+// Room for the codec's header (WAV's is 512)
+#define RECORDER_HEADER_BYTES 512
+
+typedef enum
+{
+    RECORDER_SUCCESS = 0,
+    RECORDER_ERROR_NULL_PARAMETER = -1,
+    RECORDER_ERROR_NOT_INITIALIZED = -2,
+    RECORDER_ERROR_UNABLE_TO_CREATE = -3,
+    RECORDER_ERROR_UNABLE_TO_WRITE = -4,
+    RECORDER_ERROR_FORMAT_UNSUPPORTED = -5,
+    RECORDER_ERROR_RING_TOO_SMALL = -6,
+    RECORDER_ERROR_NOT_RECORDING = -7,
+    RECORDER_ERROR_ALREADY_RECORDING = -8,
+    RECORDER_ERROR_GENERIC = -128
+} recorder_ret_t;
+
+typedef struct
+{
+    uint64_t bytes;             // audio in the file
+    uint64_t reserved_b;        // allocated up front (0: no reservation)
+    uint32_t writes;
+    uint32_t max_write_us;
+    uint32_t avg_write_us;
+    uint32_t write_errors;
+
+    // The capture side
+    uint32_t max_used_b;        // the most the ring held
+    uint32_t ring_b;
+    uint32_t overruns;          // times capture didn't fit in the ring
+    uint64_t dropped_b;         // and how much didn't
+} recorder_stats_t;
+
+// ring is the capture ring. Its buffer is all used, and has to be at least 2 * RECORDER_WRITE_BYTES.
+recorder_ret_t Recorder_Init(fs_driver_t *fs, const codec_t *codec, ring_t *ring);
+
+// Create filename and start taking capture in this format. reserve_s: seconds of audio to allocate up front
+// (0 for none). More than that can still be recorded, just without the reservation's help.
+recorder_ret_t Recorder_Start(char *filename, const audio_format_t *format, uint32_t reserve_s);
+
+// From the capture source, whenever it has samples (whole frames): an interrupt is fine.
+// Returns how much was taken; the rest didn't fit and is dropped. 0 when not recording.
+uint32_t Recorder_Capture(const void *samples, uint32_t length);
+
+// Call from the main loop: writes whatever whole blocks the ring holds to the file
+recorder_ret_t Recorder_Service(void);
+
+// Stop taking capture, write what's left in the ring, and finish the file (header, size)
+recorder_ret_t Recorder_Stop(void);
+
+uint8_t Recorder_IsRecording(void);
+
+recorder_ret_t Recorder_GetStats(recorder_stats_t *stats);
+
+#endif /* INC_RECORDER_H_ */
@@ -0,0 +1,70 @@
+/*
+ * ring.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#ifndef INC_RING_H_
+#define INC_RING_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Single-producer, single-consumer byte ring.
+ *
+ * The decoder (producer) writes PCM into the ring from the main loop,
+ * and the audio sink (consumer) drains it, usually from a DMA callback.
+ * Since there is exactly one writer per index, no locking is needed:
+ * the producer only ever writes head and the consumer only ever writes tail.
+ *
+ * head and tail are free-running counters (they are never wrapped back to 0).
+ * The actual buffer position is (counter & (size - 1)), so size MUST be a power of two.
+ * This makes "how many bytes are queued" a single subtraction that stays correct across
+ * the 32-bit overflow, and lets observers (like the meter) tell if data they looked at
+ * has since been overwritten.
+ */
+
+typedef enum
+{
+    RING_SUCCESS = 0,
+    RING_ERROR_NULL_BUFFER = -1,
+    RING_ERROR_INVALID_SIZE = -2,
+    RING_ERROR_GENERIC = -128
+} ring_ret_t;
+
+typedef struct
+{
+    uint8_t *buffer;
+    uint32_t size;              // bytes, power of two
+    volatile uint32_t head;     // total bytes ever written (producer-owned)
+    volatile uint32_t tail;     // total bytes ever read (consumer-owned)
+} ring_t;
+
+ring_ret_t Ring_Init(ring_t *ring, uint8_t *buffer, uint32_t size);
+void Ring_Reset(ring_t *ring);
+
+// Empty, with the next byte going in at (position & (size - 1)), e.g., to line the buffer up with offsets in a file.
+// NOTE: like Ring_Reset, only safe when neither side is running
+void Ring_ResetTo(ring_t *ring, uint32_t position);
+
+// Change the size, keeping whatever's queued (it's moved to where the new size expects it).
+// The buffer must be big enough for the new size, and what's queued must fit in it (else RING_ERROR_INVALID_SIZE).
+// NOTE: like Ring_Reset, only safe when neither side is running
+ring_ret_t Ring_Resize(ring_t *ring, uint32_t size);
+
+uint32_t Ring_Used(const ring_t *ring);
+uint32_t Ring_Free(const ring_t *ring);
+
+// Copying interface
+uint32_t Ring_Write(ring_t *ring, const void *data, uint32_t length);
+uint32_t Ring_Read(ring_t *ring, void *data, uint32_t length);
+
+// Zero-copy interface: get a pointer to the largest contiguous region, then commit/consume it
+uint32_t Ring_PeekWrite(const ring_t *ring, uint8_t **region);
+void Ring_Commit(ring_t *ring, uint32_t length);
+uint32_t Ring_PeekRead(const ring_t *ring, const uint8_t **region);
+void Ring_Consume(ring_t *ring, uint32_t length);
+
+#endif /* INC_RING_H_ */
@@ -0,0 +1,46 @@
+/*
+ * sd_bench.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#ifndef INC_SD_BENCH_H_
+#define INC_SD_BENCH_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "sd_profile.h"
+
+/*
+ * On-target SD card characterization.
+ *
+ * Reads raw blocks from the card's block device (below FatFs and the block layer, so nothing on the card is
+ * touched, and neither file system overhead nor read-ahead muddy the numbers) and fills in an sd_profile_t:
+ *  - sequential throughput for each request size in SD_PROFILE_SIZES
+ *  - random-address throughput for the same sizes
+ *  - latency percentiles of single-block random reads, and the worst request overall
+ *
+ * It takes a few seconds, so it's meant to run once per card (see MicroSD_Characterize).
+ * The work buffer must hold the largest request (64 blocks = 32 KiB); the output ring is free at mount time.
+ */
+
+#define SD_BENCH_SEQUENTIAL_BYTES (512 * 1024)     // per request size
+#define SD_BENCH_RANDOM_READS 64                   // per request size
+#define SD_BENCH_TIMEOUT_MS 1000
+
+typedef enum
+{
+    SD_BENCH_SUCCESS = 0,
+    SD_BENCH_ERROR_NULL_PARAMETER = -1,
+    SD_BENCH_ERROR_BUFFER_TOO_SMALL = -2,
+    SD_BENCH_ERROR_CARD_TOO_SMALL = -3,
+    SD_BENCH_ERROR_UNABLE_TO_READ = -4,
+    SD_BENCH_ERROR_GENERIC = -128
+} sd_bench_ret_t;
+
+sd_bench_ret_t SDBench_Run(uint32_t num_blocks, const uint32_t cid[4], void *work, size_t work_size,
+        sd_profile_t *profile);
+
+#endif /* INC_SD_BENCH_H_ */
@@ -0,0 +1,68 @@
+/*
+ * sd_bus.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#ifndef INC_SD_BUS_H_
+#define INC_SD_BUS_H_
+
+#include <stdint.h>
+
+#include "blk.h"
+#include "fs.h"
+
+/*
+ * SDIO bus negotiation: bus width, high speed and clock.
+ *
+ * HAL_SD_Init leaves the card on a 1-bit bus at whatever ClockDiv says, which is a fraction of what the SDIO
+ * peripheral can do. After init we:
+ *
+ *  1) switch to a 4-bit bus (ACMD6), if the card supports it
+ *  2) ask the card to switch to high speed (CMD6, function group 1), which allows up to 50 MHz instead of 25
+ *  3) search for the fastest clock that actually works: starting from the top, each candidate has to read a few
+ *     blocks spread over the card and get the same data (and no CRC errors) as a read at a slow, safe clock.
+ *     The wiring, the card and the CPU's ability to empty the FIFO in time (polling, no flow control)
+ *     all limit this, and the test finds out about all three at once.
+ *
+ * The SDIO kernel clock is PLL48CK (48 MHz here), and SDIO_CK = 48 MHz / (ClockDiv + 2), or 48 MHz in bypass.
+ *
+ * At run time, read/write errors that look like the link's fault (CRC failures, timeouts, FIFO overruns)
+ * are retried, and after SD_BUS_ERRORS_TO_STEP_DOWN of them in a row the clock is stepped down a notch.
+ * This overrides the weak BSP_SD_ReadBlocks/BSP_SD_WriteBlocks that sd_diskio.c calls.
+ *
+ * With SD_BUS_USE_LL, the transfers themselves (and the card state polls in between) go through the low-level
+ * driver in sd_ll.h instead of HAL_SD_ReadBlocks/WriteBlocks. Negotiation still uses the HAL, it only runs once.
+ */
+
+// 1: data transfers through sd_ll (DMA, CMD23), 0: HAL polling
+#define SD_BUS_USE_LL 1
+
+// A few blocks at a time, spread over the card, so the test doesn't just hit one (possibly empty) area
+#define SD_BUS_TEST_BLOCKS 4
+#define SD_BUS_TEST_ROUNDS 8
+
+#define SD_BUS_ERRORS_TO_STEP_DOWN 3
+#define SD_BUS_RETRIES 3
+#define SD_BUS_TIMEOUT_MS 1000
+
+typedef enum
+{
+    SD_BUS_SUCCESS = 0,
+    SD_BUS_ERROR_NULL_PARAMETER = -1,
+    SD_BUS_ERROR_NOT_INITIALIZED = -2,
+    SD_BUS_ERROR_NO_WORKING_CLOCK = -3,
+    SD_BUS_ERROR_TIMEOUT = -4,
+    SD_BUS_ERROR_GENERIC = -128
+} sd_bus_ret_t;
+
+// The card as a block device, with the retries and step-downs above. One transfer at a time, started and
+// then polled (retries included), no read-ahead.
+// BSP_SD_ReadBlocks/WriteBlocks go through the block layer (blk.h) on top of this; Blk_Init it after negotiating.
+extern const blk_device_t sd_bus_device;
+
+// Call right after HAL_SD_Init, before mounting. The result is written to bus, and kept up to date afterwards.
+sd_bus_ret_t SDBus_Negotiate(fs_bus_t *bus);
+
+#endif /* INC_SD_BUS_H_ */
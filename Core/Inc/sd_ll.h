@@ -0,0 +1,136 @@
+/*
+ * sd_ll.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#ifndef INC_SD_LL_H_
+#define INC_SD_LL_H_
+
+#include <stdint.h>
+
+// Host builds run this against a register mock (see Host/Inc/sdio_mock.h)
+#ifdef HOST_BUILD
+#include "sdio_mock.h"
+#else
+#include "main.h"
+#endif
+
+/*
+ * Low-level SDIO block driver, straight on the registers (stm32f4xx_ll_sdmmc.h for the bit names).
+ *
+ * HAL_SD_ReadBlocks re-checks the handle state, re-sends CMD16, polls each command response through
+ * SDMMC_GetCmdResp1 (which counts down a timeout computed from SystemCoreClock), and empties the FIFO by hand,
+ * 8 words at a time. That's tens of microseconds per command before any data moves, which is most of the cost
+ * of a small read. Here:
+ *
+ *  - a command is three register writes and a short poll on STA
+ *  - multi-block transfers are announced with CMD23 (SET_BLOCK_COUNT) when the card supports it (SCR bit 33),
+ *    so the card stops by itself and there's no CMD12 round trip at the end
+ *  - data moves by DMA (DMA2 stream 3 or 6, channel 4, with the SDIO as flow controller), so the CPU is free
+ *    during the transfer and the FIFO can't overrun at high clocks
+ *  - the transfer is a small state machine: start it, then poll it until it's done. The blocking calls are
+ *    just start + poll in a loop.
+ *
+ * The card has to be initialized already (HAL_SD_Init and friends, see sd_bus.c): this only does data transfers.
+ * Everything goes through the pointers in the config, so it runs unchanged against the mock on a PC.
+ */
+
+#define SD_LL_BLOCK_SIZE 512
+#define SD_LL_CMD_TIMEOUT_MS 10
+
+// Start to finish, card programming included. SD cards may take up to 250 ms per write (SD spec 4.6.2.2).
+#define SD_LL_TRANSFER_TIMEOUT_MS 500
+
+typedef enum
+{
+    SD_LL_SUCCESS = 0,
+    SD_LL_PENDING = 1,                  // not an error: the transfer is still going, poll again
+    SD_LL_ERROR_NULL_PARAMETER = -1,
+    SD_LL_ERROR_BUSY = -2,              // a transfer is already in progress
+    SD_LL_ERROR_ALIGNMENT = -3,         // DMA needs a word-aligned buffer
+    SD_LL_ERROR_CMD_TIMEOUT = -4,       // no response
+    SD_LL_ERROR_CMD_CRC = -5,
+    SD_LL_ERROR_CARD = -6,              // the card responded, but flagged an error in its status
+    SD_LL_ERROR_DATA_CRC = -7,
+    SD_LL_ERROR_DATA_TIMEOUT = -8,
+    SD_LL_ERROR_OVERRUN = -9,           // FIFO over/underrun
+    SD_LL_ERROR_DMA = -10,
+    SD_LL_ERROR_TIMEOUT = -11,          // the whole transfer took too long
+    SD_LL_ERROR_GENERIC = -128
+} sd_ll_ret_t;
+
+typedef enum
+{
+    SD_LL_STATE_IDLE = 0,
+    SD_LL_STATE_DATA,           // data moving
+    SD_LL_STATE_PROGRAMMING     // write done on the bus, card still programming flash
+} sd_ll_state_t;
+
+typedef struct
+{
+    SDIO_TypeDef *sdio;
+    DMA_TypeDef *dma;
+    DMA_Stream_TypeDef *stream;
+    uint8_t stream_index;       // 0-7, to find the stream's flags in LISR/HISR
+    uint32_t rca;               // relative card address, from init
+    uint8_t high_capacity;      // SDHC/SDXC: block addresses instead of byte addresses
+    uint32_t timeout_ms;        // per transfer, 0 = SD_LL_TRANSFER_TIMEOUT_MS
+} sd_ll_config_t;
+
+typedef struct
+{
+    uint32_t commands;
+    uint32_t transfers;
+    uint32_t blocks;
+    uint32_t stops;             // CMD12s sent (0 if the card takes CMD23)
+    uint32_t bounced;           // blocks that went through the bounce buffer because of alignment
+    uint32_t errors;
+} sd_ll_stats_t;
+
+typedef struct
+{
+    sd_ll_config_t config;
+    uint8_t cmd23;              // card supports SET_BLOCK_COUNT
+    sd_ll_state_t state;
+
+    // Current transfer
+    uint8_t writing;
+    uint8_t open_ended;         // multi-block without CMD23: needs a CMD12 at the end
+    uint32_t count;
+    uint32_t start_tick;
+
+    uint32_t last_status;       // SDIO STA at the last failure, for debugging
+    sd_ll_stats_t stats;
+} sd_ll_t;
+
+// Reads the card's SCR to find out whether it takes CMD23. The SDIO clock and bus width are left as they are.
+sd_ll_ret_t SDLL_Init(sd_ll_t *ll, const sd_ll_config_t *config);
+
+// Start a transfer and return straight away. buffer must be word aligned and stay valid until it's done.
+sd_ll_ret_t SDLL_StartRead(sd_ll_t *ll, void *buffer, uint32_t block, uint32_t count);
+sd_ll_ret_t SDLL_StartWrite(sd_ll_t *ll, const void *buffer, uint32_t block, uint32_t count);
+
+// SD_LL_PENDING while the transfer is going, then SD_LL_SUCCESS or an error (once), then back to idle.
+// A transfer (or card programming) that goes on for longer than the timeout is aborted: SD_LL_ERROR_TIMEOUT.
+sd_ll_ret_t SDLL_Poll(sd_ll_t *ll);
+
+// Stop whatever is going on and get the card back to the transfer state
+void SDLL_Abort(sd_ll_t *ll);
+
+// Blocking versions. Any alignment: unaligned buffers go a block at a time through a bounce buffer.
+sd_ll_ret_t SDLL_ReadBlocks(sd_ll_t *ll, void *buffer, uint32_t block, uint32_t count, uint32_t timeout_ms);
+sd_ll_ret_t SDLL_WriteBlocks(sd_ll_t *ll, const void *buffer, uint32_t block, uint32_t count, uint32_t timeout_ms);
+
+// CMD13: 1 if the card is in the transfer state, i.e., ready for the next command
+sd_ll_ret_t SDLL_IsReady(sd_ll_t *ll, uint8_t *ready);
+
+// 1 if the error is something a slower/narrower bus might fix (as opposed to, e.g., a bad address)
+static inline uint8_t SDLL_IsLinkError(sd_ll_ret_t res)
+{
+    return res == SD_LL_ERROR_CMD_TIMEOUT || res == SD_LL_ERROR_CMD_CRC || res == SD_LL_ERROR_DATA_CRC
+            || res == SD_LL_ERROR_DATA_TIMEOUT || res == SD_LL_ERROR_OVERRUN;
+}
+
+#endif /* INC_SD_LL_H_ */
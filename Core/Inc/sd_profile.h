@@ -0,0 +1,83 @@
+/*
+ * sd_profile.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#ifndef INC_SD_PROFILE_H_
+#define INC_SD_PROFILE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Per-card performance profile.
+ *
+ * Cards differ by an order of magnitude in random-read latency and in how long they go quiet
+ * while doing internal housekeeping. sd_bench.h measures a card once, and the result is kept in a small file
+ * on the card itself. The profile is keyed by the card's CID (its factory-programmed, unique ID),
+ * so copying the files onto another card doesn't carry a wrong profile over: it's simply measured again.
+ *
+ * At mount time the profile turns into two hints in fs_driver_t:
+ *  - read_size_b: the smallest request that already gets (nearly) all of the card's sequential throughput
+ *  - stall_us: the worst latency seen, which the output buffer has to be able to ride out
+ */
+
+#define SD_PROFILE_PATH "muPod.sdp"
+
+#define SD_PROFILE_MAGIC 0x46504453     // "SDPF" (little-endian)
+#define SD_PROFILE_VERSION 1
+
+#define SD_PROFILE_BLOCK_SIZE 512
+
+// Request sizes the benchmark tries, in blocks
+#define SD_PROFILE_NUM_SIZES 4
+#define SD_PROFILE_SIZES { 1, 8, 32, 64 }
+
+// A request size is "good enough" once it reaches this fraction of the best sequential throughput
+#define SD_PROFILE_GOOD_ENOUGH_PERCENT 90
+
+typedef enum
+{
+    SD_PROFILE_SUCCESS = 0,
+    SD_PROFILE_ERROR_NULL_PARAMETER = -1,
+    SD_PROFILE_ERROR_NOT_FOUND = -2,
+    SD_PROFILE_ERROR_CORRUPT = -3,
+    SD_PROFILE_ERROR_WRONG_CARD = -4,
+    SD_PROFILE_ERROR_UNABLE_TO_WRITE = -5,
+    SD_PROFILE_ERROR_GENERIC = -128
+} sd_profile_ret_t;
+
+// Stored as-is in the file, so only fixed-size fields, and the layout only changes with the version
+typedef struct
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t size;                                  // sizeof(sd_profile_t), catches layout changes
+    uint32_t cid[4];
+
+    uint16_t request_blocks[SD_PROFILE_NUM_SIZES];
+    uint32_t sequential_kbps[SD_PROFILE_NUM_SIZES]; // KiB/s
+    uint32_t random_kbps[SD_PROFILE_NUM_SIZES];     // KiB/s, requests at random (aligned) addresses
+
+    // Single-block random reads
+    uint32_t p50_us;
+    uint32_t p95_us;
+    uint32_t p99_us;
+    uint32_t max_us;                                // worst request of the whole run, any size
+
+    // Derived, see SDProfile_Recommend()
+    uint32_t read_size_b;
+    uint32_t stall_us;
+
+    uint32_t crc;                                   // CRC-32 of everything above
+} sd_profile_t;
+
+// Fill in the recommendations from the measurements
+void SDProfile_Recommend(sd_profile_t *profile);
+
+sd_profile_ret_t SDProfile_Load(const uint32_t cid[4], sd_profile_t *profile);
+sd_profile_ret_t SDProfile_Save(sd_profile_t *profile);
+
+#endif /* INC_SD_PROFILE_H_ */
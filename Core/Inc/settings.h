@@ -0,0 +1,122 @@
+/*
+ * settings.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#ifndef INC_SETTINGS_H_
+#define INC_SETTINGS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Settings (volume, EQ, play mode...) as keys and small values, kept in a pair of flash sectors of their own, so
+ * they're there at boot before the card's even mounted. The board's are sectors 6 and 7 of the internal flash
+ * (internal_flash.h); the host has a RAM-backed one that behaves the same (host_flash.h).
+ *
+ * Flash can only be programmed from 1s to 0s and only erased a whole sector at a time, so nothing is ever written
+ * over: a change is a new record at the end of the log in the active sector, and the latest record for a key is its
+ * value. Settings_Init reads the log's record headers once, to know where each key's latest record is, so a
+ * Settings_Get after that is a lookup and a copy straight from the (memory-mapped) flash.
+ *
+ * When the active sector fills up, what's live in it is copied to the other one, which becomes the active sector:
+ * the sectors take turns, so they wear evenly. The old one then has to be erased before the next time, which stalls
+ * anything running from flash for a second or so (a 128 KiB sector): Settings_Service does it, to be called when
+ * nothing's playing. A Settings_Set that finds it not done yet has to do it there and then.
+ *
+ * Every record has a CRC-32 and every step is ordered so that power can go at any point: a record cut short fails
+ * its CRC and the one before it is the value; a copy cut short leaves the sector it was copying from active, since
+ * the new one is only marked active (and numbered one higher) once it's all there.
+ *
+ * Record: a header word (key, length, a check byte on those), the value padded out to words, then the CRC-32 of
+ * the header and value. A deleted key is a record with SETTINGS_DELETED as its length, and no value.
+ */
+
+// Longest value, in bytes
+#define SETTINGS_MAX_VALUE 64
+
+// Different keys there can be at once
+#define SETTINGS_MAX_KEYS 32
+
+// Not a key: a header of all 1s is erased flash
+#define SETTINGS_KEY_NONE 0xFFFF
+
+// The length of a deleted key's record
+#define SETTINGS_DELETED 0xFF
+
+// The keys the player uses. Anything else up to SETTINGS_KEY_NONE is free to use.
+typedef enum
+{
+    SETTINGS_KEY_VOLUME = 1,                // uint8_t, 0-100
+    SETTINGS_KEY_EQ,                        // int8_t per band, dB
+    SETTINGS_KEY_PLAY_MODE                  // uint8_t: in order, shuffle, repeat...
+} settings_key_t;
+
+typedef enum
+{
+    SETTINGS_SUCCESS = 0,
+    SETTINGS_UNCHANGED = 1,                 // not an error: already that value, so nothing was written
+    SETTINGS_READY = 2,                     // not an error: Settings_Service has nothing to do
+    SETTINGS_ERROR_NULL_PARAMETER = -1,
+    SETTINGS_ERROR_NOT_INITIALIZED = -2,
+    SETTINGS_ERROR_NOT_FOUND = -3,
+    SETTINGS_ERROR_INVALID = -4,            // a key or length that can't be stored
+    SETTINGS_ERROR_TOO_SMALL = -5,          // the value doesn't fit the buffer given
+    SETTINGS_ERROR_FULL = -6,               // SETTINGS_MAX_KEYS already, or what's live doesn't fit a sector
+    SETTINGS_ERROR_FLASH = -7,              // programming or erasing failed
+    SETTINGS_ERROR_GENERIC = -128
+} settings_ret_t;
+
+// What the store needs from the flash: two sectors the same size, read where they're mapped
+typedef struct
+{
+    uint32_t sector_size;                   // bytes, a multiple of 4
+
+    // Where sector 0 or 1 can be read, word-aligned
+    const uint8_t *(*Sector)(uint32_t sector);
+
+    // Program count words at offset (a multiple of 4), which have to be erased (or only go from 1s to 0s)
+    settings_ret_t (*Program)(uint32_t sector, uint32_t offset, const uint32_t *words, uint32_t count);
+
+    // Every byte back to 0xFF
+    settings_ret_t (*Erase)(uint32_t sector);
+} settings_flash_t;
+
+typedef struct
+{
+    uint32_t keys;                          // with a value
+    uint32_t used_b;                        // of the active sector, live records or not
+    uint32_t live_b;                        // what a compaction would copy
+    uint32_t sequence;                      // of the active sector, one more each compaction
+    uint32_t compactions;
+    uint32_t erases;
+    uint32_t inline_erases;                 // of those, the ones a Settings_Set had to wait for
+    uint32_t writes;                        // records written
+    uint32_t unchanged;                     // Settings_Set of the value already there
+
+    // Found by Settings_Init
+    uint32_t headers_read;                  // what reading the log cost
+    uint32_t torn;                          // records that failed their CRC, or a header that made no sense
+    uint8_t formatted;                      // no active sector: both erased and started over
+} settings_stats_t;
+
+// Find the active sector and read its log. Formats the pair if neither is active, e.g., the first boot.
+settings_ret_t Settings_Init(const settings_flash_t *flash);
+
+// Copy key's value into value (size bytes), and its length into length (may be NULL)
+settings_ret_t Settings_Get(uint16_t key, void *value, uint32_t size, uint32_t *length);
+
+// A new value for key, of length bytes up to SETTINGS_MAX_VALUE. SETTINGS_UNCHANGED if it already is.
+settings_ret_t Settings_Set(uint16_t key, const void *value, uint32_t length);
+settings_ret_t Settings_Delete(uint16_t key);
+
+// Erase the sector a compaction left behind, if there is one, so the next compaction doesn't have to. Blocks for as
+// long as the erase takes, with the CPU held up on anything in flash: call when nothing's playing.
+// SETTINGS_READY if there's nothing to erase.
+settings_ret_t Settings_Service(void);
+
+settings_ret_t Settings_GetStats(settings_stats_t *stats);
+
+#endif /* INC_SETTINGS_H_ */
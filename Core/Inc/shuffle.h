@@ -0,0 +1,71 @@
+/*
+ * shuffle.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#ifndef INC_SHUFFLE_H_
+#define INC_SHUFFLE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Shuffle play: which track plays at each position of a shuffled pass over the library, without a shuffled list
+ * of them anywhere (that'd be 4 bytes a track, 400 KB for 100 000 of them).
+ *
+ * A position is put through a keyed permutation of [0, count) instead: a Feistel network over the fewest bits that
+ * hold count - 1, so over at most twice as many numbers as there are tracks, with what lands past the end put
+ * through it again until it doesn't (cycle walking). That's under two goes on average, each SHUFFLE_ROUNDS rounds
+ * of a multiply-and-xorshift. The network works the other way just as well, so a track's position is as easy to get
+ * as a position's track: going backwards, or carrying on from the track that's playing, costs the same.
+ *
+ * The halves aren't the same size when the bits are odd: each round swaps them, and the halves are swapped back
+ * by the last one (SHUFFLE_ROUNDS is even).
+ *
+ * Every pass is a different shuffle, keyed by the seed and the pass's number: Shuffle_Next at the end of a pass starts
+ * the next one, and Shuffle_Previous at the start of one goes back to the end of the one before. Nothing repeats
+ * within a pass; a track can be the last of one pass and near the start of the next, like with any shuffle.
+ */
+
+#define SHUFFLE_ROUNDS 6
+
+typedef enum
+{
+    SHUFFLE_SUCCESS = 0,
+    SHUFFLE_ERROR_NULL_PARAMETER = -1,
+    SHUFFLE_ERROR_EMPTY = -2,
+    SHUFFLE_ERROR_OUT_OF_RANGE = -3,
+    SHUFFLE_ERROR_GENERIC = -128
+} shuffle_ret_t;
+
+typedef struct
+{
+    uint32_t count;
+    uint32_t seed;
+    uint32_t pass;
+    uint32_t position;                  // in the pass
+    uint8_t low_bits;                   // the halves' sizes: low_bits + high_bits hold count - 1
+    uint8_t high_bits;
+    uint32_t keys[SHUFFLE_ROUNDS];      // the pass's
+} shuffle_t;
+
+// A shuffle of count tracks, at the start of its first pass. The same seed gives the same passes.
+shuffle_ret_t Shuffle_Init(shuffle_t *shuffle, uint32_t count, uint32_t seed);
+
+// The track at position in the current pass, and the other way around: count if it's out of range
+uint32_t Shuffle_Track(const shuffle_t *shuffle, uint32_t position);
+uint32_t Shuffle_Position(const shuffle_t *shuffle, uint32_t track);
+
+// The track at the current position
+uint32_t Shuffle_Current(const shuffle_t *shuffle);
+
+// Move to the next (previous) position, across passes, and return its track
+uint32_t Shuffle_Next(shuffle_t *shuffle);
+uint32_t Shuffle_Previous(shuffle_t *shuffle);
+
+// Carry on from track: the current position becomes wherever it is in this pass
+shuffle_ret_t Shuffle_Seek(shuffle_t *shuffle, uint32_t track);
+
+#endif /* INC_SHUFFLE_H_ */
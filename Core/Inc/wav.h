@@ -8,26 +8,41 @@
 #ifndef INC_WAV_H_
 #define INC_WAV_H_
 
+#include "audio.h"
 #include "codec.h"
 
+// The canonical header: RIFF, fmt and data, nothing else
 #define WAV_HEADER_LEN 44
 
+// The most of a header ValidateHeader asks for at once: chunks it doesn't need (LIST, JUNK, album art, ...) that go
+// on past this are skipped over, by asking for what comes after them instead. The caller's buffer has to hold this.
+#define WAV_MAX_HEADER_LEN 2048
+
+// What WAV_EncodeHeader writes: room for RF64's ds64 chunk, and padded to a whole sector,
+// so that the audio after it can be written a whole sector at a time
+#define WAV_ENCODED_HEADER_LEN 512
+
 typedef struct {
-    uint32_t file_size;         // Overall file size minus 8 bytes
+    uint64_t file_size;         // Overall file size minus 8 bytes (from ds64 in an RF64)
     uint16_t nbr_channels;      // Number of channels
     uint32_t frequency;         // Sample rate (in hertz)
     uint32_t bytes_per_sec;     // Number of bytes to read per second (Frequency * BytePerBloc)
     uint16_t bytes_per_bloc;    // Number of bytes per block (NbrChannels * BitsPerSample / 8)
     uint16_t bits_per_sample;   // Number of bits per sample
-    uint32_t data_size;         // SampledData size
+    uint64_t data_size;         // SampledData size (from ds64 in an RF64)
+    uint8_t rf64;               // WAV_ValidateHeader's walk, from one call to the next
+    uint8_t found_format;
 } wav_metadata_t;
 
 codec_ret_t WAV_Open(void);
 codec_ret_t WAV_Close(void);
-codec_ret_t WAV_ValidateHeader(const void *buffer, void *metadata, size_t *bytes_read);
+codec_ret_t WAV_ValidateHeader(const void *buffer, void *metadata, uint64_t *offset, size_t *bytes_read);
 codec_ret_t WAV_Decode(void *buffer, size_t length);
 codec_ret_t WAV_DecodeFrom(void *buffer, size_t start, size_t length);
-// codec_ret_t WAV_Encode(uint8_t *dst, const uint8_t *src, size_t length);
+codec_ret_t WAV_EncodeHeader(const audio_format_t *format, uint64_t data_size, void *buffer, size_t *length);
+codec_ret_t WAV_Encode(uint8_t *dst, const uint8_t *src, size_t length);
+codec_ret_t WAV_ReadTags(const void *buffer, size_t length, codec_tags_t *tags);
+codec_ret_t WAV_GetFormat(const void *metadata, audio_format_t *format);
 
 extern const codec_t wav_codec;
 
@@ -0,0 +1,29 @@
+/*
+ * xorshift.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#ifndef INC_XORSHIFT_H_
+#define INC_XORSHIFT_H_
+
+#include <stdint.h>
+
+/*
+ * xorshift32: 3 shifts and 3 xors per 32 random bits, no multiply.
+ * Not cryptographic, but the spectrum is flat, which is all dither needs, and the same seed always gives the same
+ * sequence, which is what the benchmarks and the host models need. The state must never be 0: xorshift stays there.
+ * See https://www.jstatsoft.org/article/view/v008i14 (Marsaglia, "Xorshift RNGs")
+ */
+static inline uint32_t XorShift_Next(uint32_t *state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+#endif /* INC_XORSHIFT_H_ */
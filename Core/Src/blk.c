@@ -0,0 +1,753 @@
+/*
+ * blk.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#include "blk.h"
+
+#include <string.h>
+
+static const blk_device_t *device;
+static uint32_t device_blocks;
+
+// In submission order
+static blk_request_t *queue[BLK_QUEUE_DEPTH];
+static size_t queued;
+
+// The run in flight: queue[run_first..run_first + run_length - 1], run_blocks blocks in all,
+// straight into the first one's buffer or through staging
+static size_t run_first;
+static size_t run_length;
+static uint32_t run_blocks;
+static uint8_t run_staged;
+
+static blk_ret_t first_error;
+static blk_yield_t yield_hook;
+
+// What Blk_Read/Blk_Write submit as (Blk_SetClass)
+static blk_class_t current_class = BLK_CLASS_NORMAL;
+static uint32_t current_deadline;
+
+// The real-time stream's deadline, for admission
+static uint8_t realtime_active;
+static uint32_t realtime_deadline;
+
+// How much audio the stream must have left for background work to go ahead, and the slowest request, which a
+// held-back class is never forced through with less than
+static uint32_t guard_ms = BLK_REALTIME_GUARD_MS;
+static uint32_t worst_ms;
+
+// The most audio the stream has had in each of the last two BLK_CAPACITY_WINDOW_MS (its buffer full, at its current
+// format): however slow the card, the guard can't ask for more slack than this, or nothing would ever go ahead
+static uint32_t capacity_ms[2];
+static uint32_t capacity_window_start;
+
+// Per class, since when Blk_Admit has been holding it back, and when it last let it in
+static uint8_t deferring[BLK_NUM_CLASSES];
+static uint32_t deferred_since[BLK_NUM_CLASSES];
+static uint32_t admitted_at[BLK_NUM_CLASSES];
+
+static const uint32_t MAX_DEFER_MS[BLK_NUM_CLASSES] =
+{ 0, BLK_MAX_DEFER_NORMAL_MS, BLK_MAX_DEFER_IDLE_MS };
+
+// The read-ahead goes through the queue like anything else, into staging
+static blk_request_t readahead;
+
+// Shared by read-ahead and merged runs whose buffers aren't contiguous (which throws the read-ahead away)
+static uint32_t staging[BLK_STAGING_BLOCKS * BLK_BLOCK_SIZE / sizeof(uint32_t)];
+static uint32_t cache_lba;
+static uint32_t cache_count;    // 0 = nothing cached
+
+// How far ahead a sequential read fetches, at most all of staging (Blk_SetReadAhead)
+static uint32_t readahead_blocks = BLK_STAGING_BLOCKS;
+
+// Where the last read ended, to spot sequential streams
+static uint32_t next_lba;
+
+static blk_stats_t stats;
+static uint32_t commands_at_init;
+static uint32_t estimated_commands;
+
+blk_ret_t Blk_Init(const blk_device_t *new_device, uint32_t num_blocks)
+{
+    if (new_device == NULL || new_device->Start == NULL || new_device->Poll == NULL)
+    {
+        return BLK_ERROR_NULL_PARAMETER;
+    }
+
+    device = new_device;
+    device_blocks = num_blocks;
+    queued = 0;
+    run_length = 0;
+    first_error = BLK_SUCCESS;
+    realtime_active = 0;
+    memset(capacity_ms, 0, sizeof(capacity_ms));
+    memset(deferring, 0, sizeof(deferring));
+    cache_count = 0;
+    next_lba = UINT32_MAX;
+
+    memset(&stats, 0, sizeof(stats));
+    estimated_commands = 0;
+    commands_at_init = (device->Commands != NULL) ? device->Commands() : 0;
+
+    return BLK_SUCCESS;
+}
+
+void Blk_Invalidate(void)
+{
+    cache_count = 0;
+}
+
+void Blk_SetReadAhead(uint32_t blocks)
+{
+    // What's already cached stays valid, it's just the next read-ahead that's shorter (or longer)
+    readahead_blocks = (blocks < BLK_STAGING_BLOCKS) ? blocks : BLK_STAGING_BLOCKS;
+}
+
+uint32_t Blk_GetReadAhead(void)
+{
+    return readahead_blocks;
+}
+
+void Blk_SetYield(blk_yield_t yield)
+{
+    yield_hook = yield;
+}
+
+static inline uint32_t Now(void)
+{
+    return (device != NULL && device->Now != NULL) ? device->Now() : 0;
+}
+
+void Blk_SetClass(blk_class_t io_class, uint32_t budget_ms)
+{
+    if (io_class >= BLK_NUM_CLASSES)
+    {
+        return;
+    }
+
+    current_class = io_class;
+
+    if (io_class == BLK_CLASS_REALTIME)
+    {
+        uint32_t now = Now();
+
+        current_deadline = now + budget_ms;
+        realtime_deadline = current_deadline;
+
+        // A new stream starts its capacity over (each track is one: closing it publishes 0). Otherwise the windows
+        // roll, so that a ring that shrinks is seen to.
+        if (!realtime_active || now - capacity_window_start >= BLK_CAPACITY_WINDOW_MS)
+        {
+            capacity_ms[1] = realtime_active ? capacity_ms[0] : 0;
+            capacity_ms[0] = 0;
+            capacity_window_start = now;
+        }
+
+        capacity_ms[0] = (budget_ms > capacity_ms[0]) ? budget_ms : capacity_ms[0];
+        realtime_active = (budget_ms > 0);
+
+        // The stream is gone, so whoever's next isn't it
+        if (!realtime_active)
+        {
+            current_class = BLK_CLASS_NORMAL;
+        }
+    }
+}
+
+// The background request can stall, and then so can the stream's own next one
+void Blk_SetWorstLatency(uint32_t latency_ms)
+{
+    worst_ms = latency_ms;
+    guard_ms = 2 * latency_ms + BLK_REALTIME_GUARD_MS;
+}
+
+// The guard, but no more than the stream's buffer holds less the time it takes to notice (BLK_REALTIME_GUARD_MS)
+static uint32_t AdmitGuard(void)
+{
+    uint32_t capacity = (capacity_ms[0] > capacity_ms[1]) ? capacity_ms[0] : capacity_ms[1];
+    uint32_t cap = (capacity > BLK_REALTIME_GUARD_MS) ? capacity - BLK_REALTIME_GUARD_MS : 0;
+
+    return (guard_ms < cap) ? guard_ms : cap;
+}
+
+static uint8_t Admitted(blk_class_t io_class, uint32_t now)
+{
+    deferring[io_class] = 0;
+    admitted_at[io_class] = now;
+
+    return 1;
+}
+
+uint8_t Blk_Admit(blk_class_t io_class)
+{
+    if (io_class == BLK_CLASS_REALTIME || io_class >= BLK_NUM_CLASSES || !realtime_active || device == NULL
+            || device->Now == NULL)
+    {
+        return 1;
+    }
+
+    uint32_t now = device->Now();
+    int32_t slack_ms = (int32_t)(realtime_deadline - now);
+    uint32_t admit_guard_ms = AdmitGuard();
+
+    // Where even a full buffer can't ride out the whole guard, every request let in is a chance of an underrun (a
+    // slow one, then the stream's own next read slow too): no more than one per BLK_MAX_DEFER_*_MS then
+    uint8_t paced = (admit_guard_ms < guard_ms) && now - admitted_at[io_class] < MAX_DEFER_MS[io_class];
+
+    if (slack_ms >= (int32_t)admit_guard_ms && !paced)
+    {
+        return Admitted(io_class, now);
+    }
+
+    if (!deferring[io_class])
+    {
+        deferring[io_class] = 1;
+        deferred_since[io_class] = now;
+        stats.deferrals++;
+    }
+
+    // Bounded: the stream can be low for a long time (a slow card), background work can't wait forever. But never
+    // while one slow request would be enough to run the stream dry: then it waits on.
+    if (now - deferred_since[io_class] >= MAX_DEFER_MS[io_class] && slack_ms >= (int32_t)worst_ms)
+    {
+        stats.forced++;
+        return Admitted(io_class, now);
+    }
+
+    return 0;
+}
+
+blk_ret_t Blk_DeviceTransfer(const blk_device_t *dev, blk_dir_t dir, void *buffer, uint32_t lba, uint32_t count)
+{
+    if (dev == NULL || buffer == NULL)
+    {
+        return BLK_ERROR_NULL_PARAMETER;
+    }
+
+    blk_ret_t res = dev->Start(dir, buffer, lba, count);
+
+    if (res != BLK_SUCCESS)
+    {
+        return res;
+    }
+
+    while ((res = dev->Poll()) == BLK_PENDING)
+    {
+    }
+
+    return res;
+}
+
+// Can the device not take this buffer as it is?
+static inline uint8_t Misaligned(const void *buffer)
+{
+    return device->alignment > 1 && ((uintptr_t)buffer & (device->alignment - 1)) != 0;
+}
+
+// Keep the read-ahead copy in step with what's on the card
+static void UpdateCache(const void *buffer, uint32_t lba, uint32_t count)
+{
+    if (cache_count == 0 || lba >= cache_lba + cache_count || lba + count <= cache_lba)
+    {
+        return;
+    }
+
+    uint32_t first = (lba > cache_lba) ? lba : cache_lba;
+    uint32_t last = (lba + count < cache_lba + cache_count) ? lba + count : cache_lba + cache_count;
+
+    memcpy((uint8_t *)staging + (size_t)(first - cache_lba) * BLK_BLOCK_SIZE,
+            (const uint8_t *)buffer + (size_t)(first - lba) * BLK_BLOCK_SIZE, (size_t)(last - first) * BLK_BLOCK_SIZE);
+}
+
+blk_ret_t Blk_Submit(blk_request_t *request)
+{
+    if (request == NULL || request->buffer == NULL)
+    {
+        return BLK_ERROR_NULL_PARAMETER;
+    }
+
+    if (device == NULL)
+    {
+        return BLK_ERROR_NOT_INITIALIZED;
+    }
+
+    if (queued == BLK_QUEUE_DEPTH)
+    {
+        return BLK_ERROR_QUEUE_FULL;
+    }
+
+    // Has to fit in staging to be bounced
+    if (request->count > BLK_STAGING_BLOCKS && Misaligned(request->buffer))
+    {
+        return BLK_ERROR_ALIGNMENT;
+    }
+
+    if (request->io_class >= BLK_NUM_CLASSES)
+    {
+        request->io_class = BLK_CLASS_NORMAL;
+    }
+
+    request->status = BLK_PENDING;
+    request->submitted_ms = Now();
+    request->bypassed = 0;
+    queue[queued++] = request;
+    stats.requests++;
+    stats.class_requests[request->io_class]++;
+
+    return BLK_SUCCESS;
+}
+
+// Can b go in the same transfer as the run ending with a? Not the read-ahead: it owns staging.
+static inline uint8_t Adjacent(const blk_request_t *a, const blk_request_t *b, uint32_t blocks)
+{
+    return a->dir == b->dir && a->lba + a->count == b->lba && blocks + b->count <= UINT16_MAX
+            && a != &readahead && b != &readahead;
+}
+
+static inline uint8_t Contiguous(const blk_request_t *a, const blk_request_t *b)
+{
+    return (uint8_t *)a->buffer + (size_t)a->count * BLK_BLOCK_SIZE == (uint8_t *)b->buffer;
+}
+
+// Would running b before a (submitted earlier) change what either of them sees on the card?
+static inline uint8_t Conflict(const blk_request_t *a, const blk_request_t *b)
+{
+    return (a->dir == BLK_WRITE || b->dir == BLK_WRITE) && a->lba < b->lba + b->count && b->lba < a->lba + a->count;
+}
+
+// Does anything before first (not counting first..i - 1, which are in the same run) have to go before queue[i]?
+static uint8_t Blocked(size_t first, size_t i)
+{
+    for (size_t j = 0; j < first; j++)
+    {
+        if (Conflict(queue[j], queue[i]))
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+// Should a go before b?
+static inline uint8_t Before(const blk_request_t *a, const blk_request_t *b)
+{
+    if (a->io_class != b->io_class)
+    {
+        return a->io_class < b->io_class;
+    }
+
+    // Earliest deadline first among real-time; first come, first served otherwise
+    return a->io_class == BLK_CLASS_REALTIME && (int32_t)(a->deadline_ms - b->deadline_ms) < 0;
+}
+
+// Which request goes next
+static size_t Pick(void)
+{
+    size_t best = 0;
+
+    for (size_t i = 0; i < queued; i++)
+    {
+        // Oldest starving request first
+        if (queue[i]->bypassed >= BLK_MAX_BYPASS)
+        {
+            stats.promotions++;
+            best = i;
+            break;
+        }
+
+        if (Before(queue[i], queue[best]))
+        {
+            best = i;
+        }
+    }
+
+    // Can't overtake an earlier request for the same blocks: that one goes first (and so on, further back)
+    for (size_t j = 0; j < best;)
+    {
+        if (Conflict(queue[j], queue[best]))
+        {
+            best = j;
+            j = 0;
+        }
+        else
+        {
+            j++;
+        }
+    }
+
+    for (size_t j = 0; j < best; j++)
+    {
+        queue[j]->bypassed++;
+    }
+
+    return best;
+}
+
+// Take the finished run out of the queue
+static void CompleteRun(blk_ret_t res)
+{
+    blk_request_t **run = &queue[run_first];
+    blk_request_t *head = run[0];
+    uint32_t now = Now();
+
+    if (res == BLK_SUCCESS && run_staged && head->dir == BLK_READ)
+    {
+        // Scatter out of staging
+        size_t offset = 0;
+
+        for (size_t i = 0; i < run_length; i++)
+        {
+            memcpy(run[i]->buffer, (uint8_t *)staging + offset, (size_t)run[i]->count * BLK_BLOCK_SIZE);
+            offset += (size_t)run[i]->count * BLK_BLOCK_SIZE;
+        }
+    }
+
+    if (head == &readahead && res == BLK_SUCCESS)
+    {
+        cache_lba = head->lba;
+        cache_count = head->count;
+    }
+
+    for (size_t i = 0; i < run_length; i++)
+    {
+        blk_request_t *request = run[i];
+        uint32_t wait_ms = now - request->submitted_ms;
+
+        request->status = res;
+
+        if (res == BLK_SUCCESS && request->dir == BLK_WRITE)
+        {
+            UpdateCache(request->buffer, request->lba, request->count);
+        }
+
+        if (wait_ms > stats.class_max_wait_ms[request->io_class])
+        {
+            stats.class_max_wait_ms[request->io_class] = wait_ms;
+        }
+
+        if (request->io_class == BLK_CLASS_REALTIME && device->Now != NULL
+                && (int32_t)(now - request->deadline_ms) > 0)
+        {
+            stats.deadline_misses++;
+        }
+    }
+
+    if (res != BLK_SUCCESS && first_error == BLK_SUCCESS)
+    {
+        first_error = res;
+    }
+
+    stats.merged += (uint32_t)(run_length - 1);
+
+    queued -= run_length;
+    memmove(&queue[run_first], &queue[run_first + run_length], (queued - run_first) * sizeof(queue[0]));
+    run_length = 0;
+}
+
+// Pick the next request, merge what can be merged after it and start it on the device
+static blk_ret_t StartRun(void)
+{
+    // Grow a run of adjacent requests: as long as the buffers line up, or as long as it fits in staging
+    run_first = Pick();
+
+    blk_request_t *head = queue[run_first];
+    size_t last = run_first;
+
+    // A buffer the device can't take means staging (and then it's as if the buffers didn't line up)
+    uint8_t misaligned = Misaligned(head->buffer);
+    uint8_t contiguous = !misaligned;
+
+    run_blocks = head->count;
+
+    while (last + 1 < queued && Adjacent(queue[last], queue[last + 1], run_blocks) && !Blocked(run_first, last + 1))
+    {
+        uint8_t still_contiguous = contiguous && Contiguous(queue[last], queue[last + 1]);
+
+        if (!still_contiguous && run_blocks + queue[last + 1]->count > BLK_STAGING_BLOCKS)
+        {
+            break;
+        }
+
+        contiguous = still_contiguous;
+        run_blocks += queue[++last]->count;
+    }
+
+    run_length = last + 1 - run_first;
+    run_staged = !contiguous;
+
+    if ((uint64_t)head->lba + run_blocks > device_blocks)
+    {
+        return BLK_ERROR_OUT_OF_RANGE;
+    }
+
+    void *buffer = head->buffer;
+
+    if (run_staged)
+    {
+        // Gather before a write; either way the read-ahead copy is gone
+        size_t offset = 0;
+
+        cache_count = 0;
+        buffer = staging;
+
+        if (head->dir == BLK_WRITE)
+        {
+            for (size_t i = run_first; i <= last; i++)
+            {
+                memcpy((uint8_t *)staging + offset, queue[i]->buffer, (size_t)queue[i]->count * BLK_BLOCK_SIZE);
+                offset += (size_t)queue[i]->count * BLK_BLOCK_SIZE;
+            }
+        }
+    }
+
+    if (misaligned)
+    {
+        stats.bounced++;
+        stats.bounced_blocks += run_blocks;
+    }
+    else if (!run_staged && head != &readahead)
+    {
+        stats.aligned++;
+    }
+
+    stats.transfers++;
+    stats.blocks += run_blocks;
+
+    // CMD17/24 alone, or CMD23 + CMD18/25 (or CMD18/25 + CMD12)
+    estimated_commands += (run_blocks > 1) ? 2 : 1;
+
+    return device->Start(head->dir, buffer, head->lba, run_blocks);
+}
+
+blk_ret_t Blk_Poll(void)
+{
+    if (device == NULL)
+    {
+        return BLK_ERROR_NOT_INITIALIZED;
+    }
+
+    if (run_length == 0)
+    {
+        if (queued == 0)
+        {
+            return BLK_SUCCESS;
+        }
+
+        blk_ret_t res = StartRun();
+
+        if (res != BLK_SUCCESS)
+        {
+            CompleteRun(res);
+            return (queued > 0) ? BLK_PENDING : BLK_SUCCESS;
+        }
+    }
+
+    blk_ret_t res = device->Poll();
+
+    if (res == BLK_PENDING)
+    {
+        return BLK_PENDING;
+    }
+
+    // Stop here rather than starting the next run: whoever was waiting on this one gets to copy out of
+    // staging before anything else can reuse it
+    CompleteRun(res);
+
+    return (queued > 0) ? BLK_PENDING : BLK_SUCCESS;
+}
+
+// Until the request is done, letting the rest of the firmware run in between
+static blk_ret_t Wait(blk_request_t *request)
+{
+    while (request->status == BLK_PENDING)
+    {
+        if (Blk_Poll() == BLK_PENDING && request->status == BLK_PENDING && yield_hook != NULL)
+        {
+            yield_hook();
+        }
+    }
+
+    return request->status;
+}
+
+blk_ret_t Blk_Dispatch(void)
+{
+    if (device == NULL)
+    {
+        return BLK_ERROR_NOT_INITIALIZED;
+    }
+
+    while (Blk_Poll() == BLK_PENDING)
+    {
+        if (yield_hook != NULL)
+        {
+            yield_hook();
+        }
+    }
+
+    blk_ret_t res = first_error;
+    first_error = BLK_SUCCESS;
+
+    return res;
+}
+
+// An unaligned request too big to bounce, as a series of ones that aren't
+static blk_ret_t Split(blk_dir_t dir, void *buffer, uint32_t lba, uint32_t count)
+{
+    uint8_t *bytes = (uint8_t *)buffer;
+
+    for (uint32_t done = 0; done < count;)
+    {
+        uint32_t chunk = (count - done < BLK_STAGING_BLOCKS) ? count - done : BLK_STAGING_BLOCKS;
+        void *at = bytes + (size_t)done * BLK_BLOCK_SIZE;
+        blk_ret_t res = (dir == BLK_READ) ? Blk_Read(at, lba + done, chunk) : Blk_Write(at, lba + done, chunk);
+
+        if (res != BLK_SUCCESS)
+        {
+            return res;
+        }
+
+        done += chunk;
+    }
+
+    return BLK_SUCCESS;
+}
+
+blk_ret_t Blk_Read(void *buffer, uint32_t lba, uint32_t count)
+{
+    if (buffer == NULL)
+    {
+        return BLK_ERROR_NULL_PARAMETER;
+    }
+
+    if (device == NULL)
+    {
+        return BLK_ERROR_NOT_INITIALIZED;
+    }
+
+    // Too big to bounce in one go: a staging buffer's worth at a time (which still reads ahead when it can)
+    if (count > BLK_STAGING_BLOCKS && Misaligned(buffer))
+    {
+        return Split(BLK_READ, buffer, lba, count);
+    }
+
+    // Right after the last read, or right after the read-ahead (other reads, e.g., of the FAT, can come in between)
+    uint8_t sequential = (lba == next_lba) || (cache_count > 0 && lba == cache_lba + cache_count);
+    next_lba = lba + count;
+
+    // Already read ahead? Nothing queued can be newer than the copy: writes update it when they complete,
+    // and every Blk_Write has completed by the time it returns.
+    if (cache_count > 0 && lba >= cache_lba && lba + count <= cache_lba + cache_count)
+    {
+        memcpy(buffer, (uint8_t *)staging + (size_t)(lba - cache_lba) * BLK_BLOCK_SIZE,
+                (size_t)count * BLK_BLOCK_SIZE);
+
+        stats.requests++;
+        stats.readahead_hits++;
+
+        return BLK_SUCCESS;
+    }
+
+    // Part of a stream of small reads: fetch a read-ahead window's worth, this one and the next few
+    if (sequential && count < readahead_blocks && readahead.status != BLK_PENDING)
+    {
+        uint32_t ahead = readahead_blocks;
+
+        if ((uint64_t)lba + ahead > device_blocks)
+        {
+            ahead = device_blocks - lba;
+        }
+
+        if (ahead > count)
+        {
+            cache_count = 0;
+
+            readahead.dir = BLK_READ;
+            readahead.lba = lba;
+            readahead.count = ahead;
+            readahead.buffer = staging;
+            readahead.io_class = current_class;
+            readahead.deadline_ms = current_deadline;
+
+            blk_ret_t res = Blk_Submit(&readahead);
+
+            if (res == BLK_SUCCESS)
+            {
+                res = Wait(&readahead);
+            }
+
+            if (res != BLK_SUCCESS)
+            {
+                return res;
+            }
+
+            memcpy(buffer, staging, (size_t)count * BLK_BLOCK_SIZE);
+
+            return BLK_SUCCESS;
+        }
+    }
+
+    blk_request_t request =
+    { .dir = BLK_READ, .lba = lba, .count = count, .buffer = buffer, .io_class = current_class,
+            .deadline_ms = current_deadline };
+
+    blk_ret_t res = Blk_Submit(&request);
+
+    if (res != BLK_SUCCESS)
+    {
+        return res;
+    }
+
+    return Wait(&request);
+}
+
+blk_ret_t Blk_Write(const void *buffer, uint32_t lba, uint32_t count)
+{
+    if (buffer == NULL)
+    {
+        return BLK_ERROR_NULL_PARAMETER;
+    }
+
+    if (device == NULL)
+    {
+        return BLK_ERROR_NOT_INITIALIZED;
+    }
+
+    if (count > BLK_STAGING_BLOCKS && Misaligned(buffer))
+    {
+        return Split(BLK_WRITE, (void *)buffer, lba, count);
+    }
+
+    // The request only ever reads from the buffer for a write
+    blk_request_t request =
+    { .dir = BLK_WRITE, .lba = lba, .count = count, .buffer = (void *)buffer, .io_class = current_class,
+            .deadline_ms = current_deadline };
+
+    blk_ret_t res = Blk_Submit(&request);
+
+    if (res != BLK_SUCCESS)
+    {
+        return res;
+    }
+
+    return Wait(&request);
+}
+
+void Blk_GetStats(blk_stats_t *out)
+{
+    if (out == NULL)
+    {
+        return;
+    }
+
+    *out = stats;
+
+    out->commands = (device != NULL && device->Commands != NULL) ? device->Commands() - commands_at_init
+            : estimated_commands;
+    out->avg_transfer_b = (stats.transfers > 0) ? (uint32_t)((stats.blocks * BLK_BLOCK_SIZE) / stats.transfers) : 0;
+    out->commands_per_mb = (stats.blocks > 0) ? (uint32_t)(((uint64_t)out->commands * 2048) / stats.blocks) : 0;
+}
@@ -0,0 +1,333 @@
+/*
+ * bookmark.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#include "bookmark.h"
+
+#include <string.h>
+
+#include "crc32.h"
+
+// "MPBK", so a record is never mistaken for zeros, or for anything else that was on the card
+#define RECORD_MAGIC 0x4B42504DUL
+
+// No slot written yet
+#define NO_SLOT UINT32_MAX
+
+// Exactly a sector, the CRC last, over everything before it
+typedef struct
+{
+    uint32_t magic;
+    uint32_t sequence;
+    uint64_t frame;
+    uint32_t user[BOOKMARK_USER_WORDS];
+    char path[BOOKMARK_MAX_PATH];
+    uint8_t reserved[BOOKMARK_RECORD_SIZE - 16 - 4 * BOOKMARK_USER_WORDS - BOOKMARK_MAX_PATH - 4];
+    uint32_t crc;
+} bookmark_record_t;
+
+_Static_assert(sizeof(bookmark_record_t) == BOOKMARK_RECORD_SIZE, "a bookmark record is a sector");
+
+static fs_driver_t *bookmark_fs;
+
+static struct
+{
+    uint8_t open;
+    file_t file;
+    uint32_t latest;                        // the slot the latest record's in, NO_SLOT if none
+    bookmark_record_t record;               // the latest, as it is on the card; and the one being read or written
+    bookmark_stats_t stats;
+} bookmark;
+
+static inline uint32_t Checksum(const bookmark_record_t *record)
+{
+    return CRC32_Update(CRC32_INIT, record, offsetof(bookmark_record_t, crc));
+}
+
+static inline uint8_t IsValid(const bookmark_record_t *record)
+{
+    return record->magic == RECORD_MAGIC && record->crc == Checksum(record)
+            && memchr(record->path, '\0', sizeof(record->path)) != NULL;
+}
+
+// Whether sequence a came after b, the counter having gone round or not
+static inline uint8_t IsNewer(uint32_t a, uint32_t b)
+{
+    return (int32_t)(a - b) > 0;
+}
+
+static inline void SetIOClass(fs_io_class_t io_class)
+{
+    if (bookmark_fs->ops->SetIOClass != NULL)
+    {
+        bookmark_fs->ops->SetIOClass(io_class, 0);
+    }
+}
+
+/*
+ * Make the file at its full size, every slot zeros (so none of them is valid). Contiguous if the storage can reserve
+ * it, so that the slots are on consecutive sectors. Once, on a new card: the only time the FAT and directory get
+ * written.
+ */
+static bookmark_ret_t Create(void)
+{
+    const struct fs_operations *ops = bookmark_fs->ops;
+    bookmark_ret_t res = BOOKMARK_SUCCESS;
+
+    if (ops->CreateFile(&bookmark.file, BOOKMARK_FILE) != FS_SUCCESS)
+    {
+        return BOOKMARK_ERROR_UNABLE_TO_OPEN;
+    }
+
+    // Not having the space in one piece isn't a reason not to have a bookmark
+    if (ops->ReserveFile != NULL)
+    {
+        ops->ReserveFile(&bookmark.file, (uint64_t)BOOKMARK_SLOTS * BOOKMARK_RECORD_SIZE);
+    }
+
+    memset(&bookmark.record, 0, sizeof(bookmark.record));
+
+    for (uint32_t slot = 0; slot < BOOKMARK_SLOTS && res == BOOKMARK_SUCCESS; slot++)
+    {
+        if (ops->WriteFile(&bookmark.file, &bookmark.record, sizeof(bookmark.record)) != FS_SUCCESS)
+        {
+            res = BOOKMARK_ERROR_UNABLE_TO_WRITE;
+        }
+    }
+
+    if (ops->CloseFile(&bookmark.file) != FS_SUCCESS && res == BOOKMARK_SUCCESS)
+    {
+        res = BOOKMARK_ERROR_UNABLE_TO_WRITE;
+    }
+
+    return res;
+}
+
+// Read every slot and keep the valid record with the highest sequence
+static bookmark_ret_t Recover(void)
+{
+    bookmark_record_t *record = &bookmark.record;
+    uint32_t latest = NO_SLOT;
+    uint32_t sequence = 0;
+
+    bookmark.stats.valid = 0;
+    bookmark.stats.invalid = 0;
+
+    for (uint32_t slot = 0; slot < BOOKMARK_SLOTS; slot++)
+    {
+        if (bookmark_fs->ops->ReadFileFrom(&bookmark.file, (uint64_t)slot * BOOKMARK_RECORD_SIZE, record,
+                sizeof(*record)) != FS_SUCCESS)
+        {
+            return BOOKMARK_ERROR_UNABLE_TO_READ;
+        }
+
+        if (!IsValid(record))
+        {
+            bookmark.stats.invalid++;
+            continue;
+        }
+
+        bookmark.stats.valid++;
+
+        if (latest == NO_SLOT || IsNewer(record->sequence, sequence))
+        {
+            latest = slot;
+            sequence = record->sequence;
+        }
+    }
+
+    bookmark.latest = latest;
+    bookmark.stats.sequence = sequence;
+
+    // The record is kept as it is on the card: Bookmark_Load and Bookmark_Save go by it
+    if (latest != NO_SLOT && bookmark_fs->ops->ReadFileFrom(&bookmark.file,
+            (uint64_t)latest * BOOKMARK_RECORD_SIZE, record, sizeof(*record)) != FS_SUCCESS)
+    {
+        return BOOKMARK_ERROR_UNABLE_TO_READ;
+    }
+
+    return BOOKMARK_SUCCESS;
+}
+
+bookmark_ret_t Bookmark_Init(fs_driver_t *fs)
+{
+    if (fs == NULL || fs->ops == NULL)
+    {
+        return BOOKMARK_ERROR_NULL_PARAMETER;
+    }
+
+    bookmark_fs = fs;
+    bookmark.open = 0;
+    bookmark.latest = NO_SLOT;
+    memset(&bookmark.stats, 0, sizeof(bookmark.stats));
+
+    return BOOKMARK_SUCCESS;
+}
+
+bookmark_ret_t Bookmark_Open(void)
+{
+    if (bookmark_fs == NULL)
+    {
+        return BOOKMARK_ERROR_NOT_INITIALIZED;
+    }
+
+    const struct fs_operations *ops = bookmark_fs->ops;
+
+    if (ops->OpenFileForUpdate == NULL || ops->WriteFileAt == NULL || ops->ReadFileFrom == NULL
+            || ops->CreateFile == NULL || ops->WriteFile == NULL)
+    {
+        return BOOKMARK_ERROR_UNSUPPORTED;
+    }
+
+    if (bookmark.open)
+    {
+        Bookmark_Close();
+    }
+
+    SetIOClass(FS_IO_NORMAL);
+
+    // There but too short (cut off while it was being made, say) is as good as not there: the last slot tells
+    bookmark_ret_t res = BOOKMARK_SUCCESS;
+    fs_ret_t opened = ops->OpenFileForUpdate(&bookmark.file, BOOKMARK_FILE);
+
+    if (opened == FS_SUCCESS && ops->ReadFileFrom(&bookmark.file,
+            (uint64_t)(BOOKMARK_SLOTS - 1) * BOOKMARK_RECORD_SIZE, &bookmark.record, sizeof(bookmark.record))
+            != FS_SUCCESS)
+    {
+        ops->CloseFile(&bookmark.file);
+        opened = FS_ERROR_UNABLE_TO_READ_FILE;
+    }
+
+    if (opened != FS_SUCCESS)
+    {
+        res = Create();
+
+        if (res == BOOKMARK_SUCCESS && ops->OpenFileForUpdate(&bookmark.file, BOOKMARK_FILE) != FS_SUCCESS)
+        {
+            res = BOOKMARK_ERROR_UNABLE_TO_OPEN;
+        }
+    }
+
+    if (res == BOOKMARK_SUCCESS)
+    {
+        bookmark.open = 1;
+        res = Recover();
+
+        if (res != BOOKMARK_SUCCESS)
+        {
+            Bookmark_Close();
+        }
+    }
+
+    return res;
+}
+
+bookmark_ret_t Bookmark_Close(void)
+{
+    if (!bookmark.open)
+    {
+        return BOOKMARK_ERROR_NOT_OPEN;
+    }
+
+    bookmark.open = 0;
+    bookmark.latest = NO_SLOT;
+
+    // Its size is what it was opened with, so this only writes out the directory entry's time, if anything
+    if (bookmark_fs->ops->CloseFile(&bookmark.file) != FS_SUCCESS)
+    {
+        return BOOKMARK_ERROR_GENERIC;
+    }
+
+    return BOOKMARK_SUCCESS;
+}
+
+bookmark_ret_t Bookmark_Load(bookmark_t *out)
+{
+    if (out == NULL)
+    {
+        return BOOKMARK_ERROR_NULL_PARAMETER;
+    }
+
+    if (!bookmark.open)
+    {
+        return BOOKMARK_ERROR_NOT_OPEN;
+    }
+
+    if (bookmark.latest == NO_SLOT)
+    {
+        return BOOKMARK_ERROR_NONE_SAVED;
+    }
+
+    memcpy(out->path, bookmark.record.path, sizeof(out->path));
+    out->frame = bookmark.record.frame;
+    memcpy(out->user, bookmark.record.user, sizeof(out->user));
+
+    return BOOKMARK_SUCCESS;
+}
+
+bookmark_ret_t Bookmark_Save(const bookmark_t *in)
+{
+    if (in == NULL)
+    {
+        return BOOKMARK_ERROR_NULL_PARAMETER;
+    }
+
+    if (!bookmark.open)
+    {
+        return BOOKMARK_ERROR_NOT_OPEN;
+    }
+
+    bookmark_record_t *record = &bookmark.record;
+
+    if (bookmark.latest != NO_SLOT && record->frame == in->frame
+            && memcmp(record->user, in->user, sizeof(record->user)) == 0
+            && strncmp(record->path, in->path, sizeof(record->path)) == 0)
+    {
+        bookmark.stats.unchanged++;
+        return BOOKMARK_UNCHANGED;
+    }
+
+    uint32_t slot = (bookmark.latest == NO_SLOT) ? 0 : (bookmark.latest + 1) % BOOKMARK_SLOTS;
+    uint32_t sequence = (bookmark.latest == NO_SLOT) ? bookmark.stats.sequence + 1 : record->sequence + 1;
+
+    // Zeros after the path, so a record only ever depends on what it says
+    memset(record, 0, sizeof(*record));
+    record->magic = RECORD_MAGIC;
+    record->sequence = sequence;
+    record->frame = in->frame;
+    memcpy(record->user, in->user, sizeof(record->user));
+    memcpy(record->path, in->path, strnlen(in->path, sizeof(record->path) - 1));
+    record->crc = Checksum(record);
+
+    // One aligned sector, straight to the card. If it doesn't make it, the latest is still the one before: on the
+    // card it's the valid record with the highest sequence, so it's taken as that here too by reading it back.
+    SetIOClass(FS_IO_NORMAL);
+
+    if (bookmark_fs->ops->WriteFileAt(&bookmark.file, (uint64_t)slot * BOOKMARK_RECORD_SIZE, record,
+            sizeof(*record)) != FS_SUCCESS)
+    {
+        Recover();
+        return BOOKMARK_ERROR_UNABLE_TO_WRITE;
+    }
+
+    bookmark.latest = slot;
+    bookmark.stats.sequence = sequence;
+    bookmark.stats.saves++;
+
+    return BOOKMARK_SUCCESS;
+}
+
+bookmark_ret_t Bookmark_GetStats(bookmark_stats_t *stats)
+{
+    if (stats == NULL)
+    {
+        return BOOKMARK_ERROR_NULL_PARAMETER;
+    }
+
+    *stats = bookmark.stats;
+
+    return BOOKMARK_SUCCESS;
+}
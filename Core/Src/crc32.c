@@ -0,0 +1,31 @@
+/*
+ * crc32.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#include "crc32.h"
+
+// Reflected polynomial 0xEDB88320, one entry per nibble
+static const uint32_t CRC32_TABLE[16] =
+{
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+uint32_t CRC32_Update(uint32_t crc, const void *data, size_t length)
+{
+    const uint8_t *bytes = (const uint8_t *)data;
+
+    crc = ~crc;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        crc ^= bytes[i];
+        crc = (crc >> 4) ^ CRC32_TABLE[crc & 0x0F];
+        crc = (crc >> 4) ^ CRC32_TABLE[crc & 0x0F];
+    }
+
+    return ~crc;
+}
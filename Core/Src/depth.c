@@ -0,0 +1,437 @@
+/*
+ * depth.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#include "depth.h"
+
+#include <string.h>
+
+#define BLOCK_B 512
+
+static depth_config_t config;
+static uint8_t initialized;
+
+static uint32_t histogram[DEPTH_BUCKETS];
+static uint32_t window;         // samples in the histogram (halved along with it)
+static uint32_t samples;        // since Depth_Init
+static uint32_t max_us;
+
+// The current decision
+static uint32_t ring_b;
+static uint32_t readahead_b;
+static uint32_t needed_b;
+static uint32_t latency_us;
+static uint32_t risk_ppm;
+static uint8_t sized;           // 0 until the first Depth_Update: until then, ring_b is just the most there is
+static uint8_t capped;
+
+// For the shrink hysteresis: samples in a row that half the ring would have covered
+static uint32_t calm;
+static uint32_t samples_at_update;
+
+static uint32_t grows;
+static uint32_t shrinks;
+static uint32_t readahead_changes;
+static uint32_t caps;
+
+// Circular, next_log is where the next entry goes
+static depth_log_entry_t decisions[DEPTH_LOG_ENTRIES];
+static uint32_t logged;
+static uint32_t next_log;
+
+static inline uint32_t Min(uint32_t a, uint32_t b)
+{
+    return (a < b) ? a : b;
+}
+
+static inline uint32_t Bucket(uint32_t us)
+{
+    uint32_t bucket = 31 - (uint32_t)__builtin_clz(us | 1);
+
+    return Min(bucket, DEPTH_BUCKETS - 1);
+}
+
+// The slowest a sample in this bucket can have been: the top of the bucket, or the slowest read so far if that's less
+// (which also closes off the last bucket)
+static inline uint32_t UpperBound(uint32_t bucket)
+{
+    uint32_t top = (bucket == DEPTH_BUCKETS - 1) ? UINT32_MAX : (1UL << (bucket + 1));
+
+    return Min(top, max_us);
+}
+
+// Largest power of two <= x (x > 0)
+static inline uint32_t FloorPowerOfTwo(uint32_t x)
+{
+    return 1UL << (31 - __builtin_clz(x));
+}
+
+// Smallest power of two >= x, as far as limit (a power of two)
+static inline uint32_t CeilPowerOfTwo(uint32_t x, uint32_t limit)
+{
+    uint32_t p = DEPTH_MIN_RING_B;
+
+    while (p < x && p < limit)
+    {
+        p <<= 1;
+    }
+
+    return p;
+}
+
+void Depth_DefaultConfig(depth_config_t *out, uint32_t max_ring_b, uint32_t max_readahead_b)
+{
+    if (out == NULL)
+    {
+        return;
+    }
+
+    out->budget_b = max_ring_b + max_readahead_b;
+    out->max_ring_b = max_ring_b;
+    out->max_readahead_b = max_readahead_b;
+    out->target_ppm = DEPTH_DEFAULT_TARGET_PPM;
+    out->seed_us = 0;
+}
+
+// The ring that fits the budget next to the smallest read-ahead we'd go to
+static uint32_t MaxRing(void)
+{
+    uint32_t readahead_floor = Min(DEPTH_MIN_READAHEAD_B, config.max_readahead_b);
+    uint32_t most = Min(config.max_ring_b, config.budget_b - readahead_floor);
+
+    return (most >= DEPTH_MIN_RING_B) ? FloorPowerOfTwo(most) : DEPTH_MIN_RING_B;
+}
+
+// Whatever the budget leaves next to the ring, in whole blocks
+static uint32_t FitReadAhead(uint32_t ring)
+{
+    uint32_t left = (config.budget_b > ring) ? config.budget_b - ring : 0;
+    uint32_t readahead = Min(config.max_readahead_b, left);
+
+    return readahead - (readahead % BLOCK_B);
+}
+
+depth_ret_t Depth_Init(const depth_config_t *new_config)
+{
+    if (new_config == NULL)
+    {
+        return DEPTH_ERROR_NULL_PARAMETER;
+    }
+
+    // The ring's buffer has to hold at least the minimum, and the ring sizes are powers of two
+    if (new_config->max_ring_b < DEPTH_MIN_RING_B || (new_config->max_ring_b & (new_config->max_ring_b - 1)) != 0
+            || new_config->budget_b < DEPTH_MIN_RING_B || new_config->target_ppm >= 1000000)
+    {
+        return DEPTH_ERROR_INVALID_CONFIG;
+    }
+
+    config = *new_config;
+
+    memset(histogram, 0, sizeof(histogram));
+    window = 0;
+    samples = 0;
+    max_us = 0;
+
+    ring_b = MaxRing();
+    readahead_b = FitReadAhead(ring_b);
+    needed_b = 0;
+    latency_us = 0;
+    risk_ppm = 0;
+    sized = 0;
+    capped = 0;
+    calm = 0;
+    samples_at_update = 0;
+
+    grows = 0;
+    shrinks = 0;
+    readahead_changes = 0;
+    caps = 0;
+    logged = 0;
+    next_log = 0;
+
+    initialized = 1;
+
+    return DEPTH_SUCCESS;
+}
+
+void Depth_Sample(uint32_t latency)
+{
+    if (!initialized)
+    {
+        return;
+    }
+
+    histogram[Bucket(latency)]++;
+    window++;
+    samples++;
+
+    if (latency > max_us)
+    {
+        max_us = latency;
+    }
+
+    // Forget the past gradually: halving keeps the shape, and old samples count for less and less
+    if (window >= DEPTH_WINDOW)
+    {
+        window = 0;
+
+        for (uint32_t b = 0; b < DEPTH_BUCKETS; b++)
+        {
+            histogram[b] >>= 1;
+            window += histogram[b];
+        }
+    }
+}
+
+// The latency only a fraction target_ppm of reads go over, or 0 if it can't be told yet
+static uint32_t Quantile(void)
+{
+    if (samples < DEPTH_MIN_SAMPLES)
+    {
+        return 0;
+    }
+
+    // Walk down from the slowest bucket: the first one that would put more than the target above the line
+    // is the one the ring has to cover
+    uint64_t allowed = (uint64_t)window * config.target_ppm;
+    uint32_t above = 0;
+
+    for (int32_t b = DEPTH_BUCKETS - 1; b >= 0; b--)
+    {
+        if ((uint64_t)(above + histogram[b]) * 1000000 > allowed)
+        {
+            return UpperBound((uint32_t)b);
+        }
+
+        above += histogram[b];
+    }
+
+    return 0;
+}
+
+// Reads in the histogram that took longer than a ring of this size lasts, per million
+static uint32_t Risk(uint32_t ring, uint32_t bytes_per_s, uint32_t read_b)
+{
+    if (window == 0 || bytes_per_s == 0)
+    {
+        return 0;
+    }
+
+    uint32_t slack_b = ring - Min(read_b, ring / 2);
+    uint64_t lasts_us = ((uint64_t)slack_b * 1000000) / bytes_per_s;
+    uint32_t above = 0;
+
+    for (uint32_t b = 0; b < DEPTH_BUCKETS; b++)
+    {
+        if (UpperBound(b) > lasts_us)
+        {
+            above += histogram[b];
+        }
+    }
+
+    return (uint32_t)(((uint64_t)above * 1000000) / window);
+}
+
+static void Log(depth_decision_t decision)
+{
+    depth_log_entry_t *entry = &decisions[next_log];
+
+    entry->decision = decision;
+    entry->sample = samples;
+    entry->latency_us = latency_us;
+    entry->ring_b = ring_b;
+    entry->readahead_b = readahead_b;
+
+    next_log = (next_log + 1) % DEPTH_LOG_ENTRIES;
+
+    if (logged < DEPTH_LOG_ENTRIES)
+    {
+        logged++;
+    }
+}
+
+depth_decision_t Depth_Update(uint32_t bytes_per_s, uint32_t read_b, uint32_t *ring_out, uint32_t *readahead_out)
+{
+    depth_decision_t decision = DEPTH_KEEP;
+
+    if (!initialized)
+    {
+        return DEPTH_KEEP;
+    }
+
+    uint32_t most = MaxRing();
+    uint32_t quantile = Quantile();
+    uint32_t want;
+
+    // Not enough samples yet: the profile's worst stall, or if there isn't one, everything we've got
+    latency_us = (quantile > 0) ? quantile : config.seed_us;
+
+    if (latency_us == 0)
+    {
+        needed_b = most;
+        want = most;
+    }
+    else
+    {
+        uint64_t needed = ((uint64_t)bytes_per_s * latency_us) / 1000000 + read_b;
+
+        needed_b = (needed < UINT32_MAX) ? (uint32_t)needed : UINT32_MAX;
+        want = CeilPowerOfTwo(needed_b, 1UL << 31);
+    }
+
+    uint32_t ring = ring_b;
+    uint32_t new_samples = samples - samples_at_update;
+    samples_at_update = samples;
+
+    if (!sized || quantile == 0)
+    {
+        // Nothing measured to be careful about yet, so straight to what the seed says
+        ring = want;
+        calm = 0;
+    }
+    else if (want > ring_b)
+    {
+        ring = want;
+        calm = 0;
+    }
+    else if (want <= ring_b / 2)
+    {
+        calm += new_samples;
+
+        if (calm >= DEPTH_SHRINK_HOLD)
+        {
+            ring = ring_b / 2;
+            calm = 0;
+        }
+    }
+    else
+    {
+        calm = 0;
+    }
+
+    uint8_t was_capped = capped;
+    capped = (want > most);
+
+    if (ring > most)
+    {
+        ring = most;
+    }
+
+    if (ring < DEPTH_MIN_RING_B)
+    {
+        ring = DEPTH_MIN_RING_B;
+    }
+
+    uint32_t readahead = FitReadAhead(ring);
+
+    if (ring > ring_b)
+    {
+        decision = DEPTH_GROW;
+        grows++;
+    }
+    else if (ring < ring_b)
+    {
+        decision = DEPTH_SHRINK;
+        shrinks++;
+    }
+    else if (readahead != readahead_b)
+    {
+        decision = DEPTH_READAHEAD;
+    }
+
+    if (readahead != readahead_b)
+    {
+        readahead_changes++;
+    }
+
+    ring_b = ring;
+    readahead_b = readahead;
+    risk_ppm = Risk(ring_b, bytes_per_s, read_b);
+    sized = 1;
+
+    if (capped && !was_capped)
+    {
+        caps++;
+
+        if (decision == DEPTH_KEEP)
+        {
+            decision = DEPTH_CAPPED;
+        }
+    }
+
+    if (decision != DEPTH_KEEP)
+    {
+        Log(decision);
+    }
+
+    if (ring_out != NULL)
+    {
+        *ring_out = ring_b;
+    }
+
+    if (readahead_out != NULL)
+    {
+        *readahead_out = readahead_b;
+    }
+
+    return decision;
+}
+
+depth_ret_t Depth_GetStats(depth_stats_t *out)
+{
+    if (out == NULL)
+    {
+        return DEPTH_ERROR_NULL_PARAMETER;
+    }
+
+    if (!initialized)
+    {
+        return DEPTH_ERROR_NOT_INITIALIZED;
+    }
+
+    out->ring_b = ring_b;
+    out->readahead_b = readahead_b;
+    out->needed_b = needed_b;
+    out->latency_us = latency_us;
+    out->risk_ppm = risk_ppm;
+
+    out->samples = samples;
+    out->max_us = max_us;
+    memcpy(out->histogram, histogram, sizeof(histogram));
+
+    out->grows = grows;
+    out->shrinks = shrinks;
+    out->readahead_changes = readahead_changes;
+    out->caps = caps;
+    out->logged = logged;
+
+    // Oldest first
+    uint32_t first = (logged < DEPTH_LOG_ENTRIES) ? 0 : next_log;
+
+    for (uint32_t i = 0; i < logged; i++)
+    {
+        out->log[i] = decisions[(first + i) % DEPTH_LOG_ENTRIES];
+    }
+
+    return DEPTH_SUCCESS;
+}
+
+const char *Depth_DecisionName(depth_decision_t decision)
+{
+    switch (decision)
+    {
+    case DEPTH_GROW:
+        return "grow";
+    case DEPTH_SHRINK:
+        return "shrink";
+    case DEPTH_READAHEAD:
+        return "read-ahead";
+    case DEPTH_CAPPED:
+        return "capped";
+    default:
+        return "keep";
+    }
+}
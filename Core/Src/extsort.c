@@ -0,0 +1,502 @@
+/*
+ * extsort.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#include "extsort.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static inline uint32_t Min(uint32_t a, uint32_t b)
+{
+    return (a < b) ? a : b;
+}
+
+extsort_ret_t ExtSort_Init(extsort_t *sort, fs_driver_t *fs, char *file_a, char *file_b, uint32_t record_size,
+        extsort_compare_t compare, void *work, size_t work_size)
+{
+    if (sort == NULL)
+    {
+        return EXTSORT_ERROR_NULL_PARAMETER;
+    }
+
+    // Closing one that didn't start is fine
+    memset(sort, 0, sizeof(*sort));
+
+    if (fs == NULL || file_a == NULL || file_b == NULL || compare == NULL || work == NULL)
+    {
+        return EXTSORT_ERROR_NULL_PARAMETER;
+    }
+
+    if (record_size == 0 || record_size > EXTSORT_MAX_RECORD || work_size < EXTSORT_MIN_WORK)
+    {
+        return EXTSORT_ERROR_WORK_TOO_SMALL;
+    }
+
+    const struct fs_operations *ops = fs->ops;
+
+    if (ops->CreateFile == NULL || ops->WriteFile == NULL || ops->ReadFileFrom == NULL || ops->RemoveFile == NULL)
+    {
+        return EXTSORT_ERROR_UNSUPPORTED;
+    }
+
+    sort->fs = fs;
+    sort->files[0] = file_a;
+    sort->files[1] = file_b;
+    sort->compare = compare;
+    sort->record_size = record_size;
+    sort->work = (uint8_t *)work;
+    sort->work_size = work_size;
+    sort->capacity = (uint32_t)(work_size / record_size);
+
+    return EXTSORT_SUCCESS;
+}
+
+// What's in the work buffer, sorted, on the end of the first file
+static extsort_ret_t WriteRun(extsort_t *sort)
+{
+    const struct fs_operations *ops = sort->fs->ops;
+    uint32_t bytes = sort->buffered * sort->record_size;
+
+    qsort(sort->work, sort->buffered, sort->record_size, sort->compare);
+
+    if (sort->stats.runs == 0 && ops->CreateFile(&sort->file[0], sort->files[0]) != FS_SUCCESS)
+    {
+        return EXTSORT_ERROR_UNABLE_TO_WRITE;
+    }
+
+    if (ops->WriteFile(&sort->file[0], sort->work, bytes) != FS_SUCCESS)
+    {
+        return EXTSORT_ERROR_UNABLE_TO_WRITE;
+    }
+
+    sort->stats.runs++;
+    sort->stats.written_b += bytes;
+    sort->buffered = 0;
+
+    return EXTSORT_SUCCESS;
+}
+
+extsort_ret_t ExtSort_Add(extsort_t *sort, const void *record)
+{
+    if (sort == NULL || record == NULL)
+    {
+        return EXTSORT_ERROR_NULL_PARAMETER;
+    }
+
+    if (sort->buffered == sort->capacity)
+    {
+        extsort_ret_t res = WriteRun(sort);
+
+        if (res != EXTSORT_SUCCESS)
+        {
+            return res;
+        }
+    }
+
+    memcpy(sort->work + sort->buffered * sort->record_size, record, sort->record_size);
+    sort->buffered++;
+    sort->stats.records++;
+
+    return EXTSORT_SUCCESS;
+}
+
+/*
+ * Merging
+ */
+
+static inline uint32_t RunsNow(const extsort_t *sort)
+{
+    return (sort->stats.records + sort->run_records - 1) / sort->run_records;
+}
+
+static inline const uint8_t *Head(const extsort_t *sort, uint32_t run)
+{
+    return sort->buffers + (run * sort->buffer_records + sort->runs[run].at) * sort->record_size;
+}
+
+// The work buffer, for merging count runs: an even share each, and one for a pass's output (whole sectors of it),
+// if it's written. The output buffer, the runs' cursors, the heap, then the rest split evenly into read buffers, each
+// whole sectors too when the records fit them: a read that starts at a sector then ends at one.
+static void Lay(extsort_t *sort, uint32_t count, uint8_t output)
+{
+    uint32_t share = (uint32_t)(sort->work_size / (count + output));
+    uint32_t write_bytes = output ? share / EXTSORT_WRITE_BYTES * EXTSORT_WRITE_BYTES : 0;
+    uint32_t per_run = (uint32_t)((sort->work_size - write_bytes) / count);
+    uint32_t read_bytes = per_run - (uint32_t)(sizeof(extsort_run_t) + sizeof(uint32_t));
+
+    sort->write_records = write_bytes / sort->record_size;
+    sort->runs = (extsort_run_t *)(sort->work + write_bytes);
+    sort->heap = (uint32_t *)(sort->runs + count);
+    sort->buffers = (uint8_t *)(sort->heap + count);
+    sort->buffer_records = read_bytes / EXTSORT_MIN_READ * EXTSORT_MIN_READ / sort->record_size;
+
+    if (EXTSORT_MIN_READ % sort->record_size != 0)
+    {
+        sort->buffer_records = read_bytes / sort->record_size;
+    }
+}
+
+// The run's next records into its buffer: *empty once it's all been handed over
+static extsort_ret_t Refill(extsort_t *sort, uint32_t run, uint8_t *empty)
+{
+    extsort_run_t *cursor = &sort->runs[run];
+    uint32_t count = Min(sort->buffer_records, cursor->end - cursor->next);
+
+    *empty = (count == 0);
+
+    if (count == 0)
+    {
+        return EXTSORT_SUCCESS;
+    }
+
+    uint32_t bytes = count * sort->record_size;
+
+    if (sort->fs->ops->ReadFileFrom(&sort->file[sort->current], (uint64_t)cursor->next * sort->record_size,
+            sort->buffers + run * sort->buffer_records * sort->record_size, bytes) != FS_SUCCESS)
+    {
+        return EXTSORT_ERROR_UNABLE_TO_READ;
+    }
+
+    cursor->next += count;
+    cursor->buffered = count;
+    cursor->at = 0;
+    sort->stats.read_b += bytes;
+
+    return EXTSORT_SUCCESS;
+}
+
+static void SiftDown(extsort_t *sort, uint32_t slot)
+{
+    uint32_t *heap = sort->heap;
+
+    for (;;)
+    {
+        uint32_t smallest = slot;
+        uint32_t left = 2 * slot + 1;
+        uint32_t right = left + 1;
+
+        if (left < sort->heap_size && sort->compare(Head(sort, heap[left]), Head(sort, heap[smallest])) < 0)
+        {
+            smallest = left;
+        }
+
+        if (right < sort->heap_size && sort->compare(Head(sort, heap[right]), Head(sort, heap[smallest])) < 0)
+        {
+            smallest = right;
+        }
+
+        if (smallest == slot)
+        {
+            return;
+        }
+
+        uint32_t run = heap[slot];
+        heap[slot] = heap[smallest];
+        heap[smallest] = run;
+        slot = smallest;
+    }
+}
+
+// Runs first to first + count - 1 of the current file, each with its first records read, in the heap
+static extsort_ret_t StartMerge(extsort_t *sort, uint32_t first, uint32_t count, uint8_t output)
+{
+    Lay(sort, count, output);
+    sort->heap_size = 0;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        extsort_run_t *cursor = &sort->runs[i];
+        uint8_t empty;
+
+        cursor->next = (first + i) * sort->run_records;
+        cursor->end = Min(cursor->next + sort->run_records, sort->stats.records);
+
+        extsort_ret_t res = Refill(sort, i, &empty);
+
+        if (res != EXTSORT_SUCCESS)
+        {
+            return res;
+        }
+
+        if (!empty)
+        {
+            sort->heap[sort->heap_size++] = i;
+        }
+    }
+
+    for (uint32_t slot = sort->heap_size / 2; slot > 0; slot--)
+    {
+        SiftDown(sort, slot - 1);
+    }
+
+    return EXTSORT_SUCCESS;
+}
+
+// The smallest of the runs' next records, into record
+static extsort_ret_t Pop(extsort_t *sort, void *record)
+{
+    if (sort->heap_size == 0)
+    {
+        return EXTSORT_END;
+    }
+
+    uint32_t run = sort->heap[0];
+    extsort_run_t *cursor = &sort->runs[run];
+
+    memcpy(record, Head(sort, run), sort->record_size);
+
+    if (++cursor->at == cursor->buffered)
+    {
+        uint8_t empty;
+        extsort_ret_t res = Refill(sort, run, &empty);
+
+        if (res != EXTSORT_SUCCESS)
+        {
+            return res;
+        }
+
+        if (empty)
+        {
+            sort->heap[0] = sort->heap[--sort->heap_size];
+        }
+    }
+
+    SiftDown(sort, 0);
+
+    return EXTSORT_SUCCESS;
+}
+
+// Closed and opened again, to be read: only a file opened to be read is checked for being contiguous
+static extsort_ret_t Reopen(extsort_t *sort, uint32_t which)
+{
+    const struct fs_operations *ops = sort->fs->ops;
+
+    if (ops->CloseFile(&sort->file[which]) != FS_SUCCESS)
+    {
+        return EXTSORT_ERROR_UNABLE_TO_WRITE;
+    }
+
+    if (ops->OpenFile(&sort->file[which], sort->files[which]) != FS_SUCCESS)
+    {
+        return EXTSORT_ERROR_UNABLE_TO_READ;
+    }
+
+    return EXTSORT_SUCCESS;
+}
+
+// Whether merges of fan_in runs at a time, one after the other, get runs down to one
+static uint8_t Reaches(uint32_t fan_in, uint32_t merges, uint32_t runs)
+{
+    uint64_t reach = 1;
+
+    for (uint32_t i = 0; i < merges && reach < runs; i++)
+    {
+        reach *= fan_in;
+    }
+
+    return reach >= runs;
+}
+
+// Every fan_in runs into one, in the other file
+static extsort_ret_t MergePass(extsort_t *sort)
+{
+    const struct fs_operations *ops = sort->fs->ops;
+    uint32_t output = 1 - sort->current;
+    uint32_t runs = RunsNow(sort);
+    extsort_ret_t res = EXTSORT_SUCCESS;
+
+    if (ops->CreateFile(&sort->file[output], sort->files[output]) != FS_SUCCESS)
+    {
+        return EXTSORT_ERROR_UNABLE_TO_WRITE;
+    }
+
+    for (uint32_t first = 0; first < runs && res == EXTSORT_SUCCESS; first += sort->fan_in)
+    {
+        uint32_t pending = 0;
+
+        res = StartMerge(sort, first, Min(sort->fan_in, runs - first), 1);
+
+        while (res == EXTSORT_SUCCESS)
+        {
+            res = Pop(sort, sort->work + pending * sort->record_size);
+
+            if (res == EXTSORT_SUCCESS && ++pending < sort->write_records)
+            {
+                continue;
+            }
+
+            if (pending > 0 && ops->WriteFile(&sort->file[output], sort->work, pending * sort->record_size)
+                    != FS_SUCCESS)
+            {
+                return EXTSORT_ERROR_UNABLE_TO_WRITE;
+            }
+
+            sort->stats.written_b += pending * sort->record_size;
+            pending = 0;
+        }
+
+        res = (res == EXTSORT_END) ? EXTSORT_SUCCESS : res;
+    }
+
+    if (res != EXTSORT_SUCCESS)
+    {
+        return res;
+    }
+
+    // The new runs in place of the old
+    ops->CloseFile(&sort->file[sort->current]);
+    ops->RemoveFile(sort->files[sort->current]);
+
+    sort->current = (uint8_t)output;
+    sort->run_records *= sort->fan_in;
+    sort->stats.passes++;
+
+    return Reopen(sort, output);
+}
+
+extsort_ret_t ExtSort_Finish(extsort_t *sort)
+{
+    if (sort == NULL)
+    {
+        return EXTSORT_ERROR_NULL_PARAMETER;
+    }
+
+    extsort_ret_t res;
+
+    // All in one go: nothing to merge
+    if (sort->stats.runs == 0)
+    {
+        qsort(sort->work, sort->buffered, sort->record_size, sort->compare);
+
+        sort->in_ram = 1;
+        sort->finished = 1;
+        sort->position = 0;
+
+        return EXTSORT_SUCCESS;
+    }
+
+    if (sort->buffered > 0 && (res = WriteRun(sort)) != EXTSORT_SUCCESS)
+    {
+        return res;
+    }
+
+    if ((res = Reopen(sort, 0)) != EXTSORT_SUCCESS)
+    {
+        return res;
+    }
+
+    sort->current = 0;
+    sort->run_records = sort->capacity;
+
+    // At most as many runs at once as there's room for a read's worth of each, and of a pass's output. That many
+    // takes some number of passes to get down to one merge; the fewest runs at once that takes no more passes leaves
+    // the biggest reads and writes.
+    uint32_t most = (uint32_t)(sort->work_size
+            / (EXTSORT_MIN_READ + sort->record_size + sizeof(extsort_run_t) + sizeof(uint32_t))) - 1;
+    uint32_t runs = RunsNow(sort);
+    uint32_t merges = 1;
+
+    while (!Reaches(most, merges, runs))
+    {
+        merges++;
+    }
+
+    sort->fan_in = 2;
+
+    while (!Reaches(sort->fan_in, merges, runs))
+    {
+        sort->fan_in++;
+    }
+
+    while (RunsNow(sort) > sort->fan_in)
+    {
+        if ((res = MergePass(sort)) != EXTSORT_SUCCESS)
+        {
+            return res;
+        }
+    }
+
+    sort->finished = 1;
+
+    return StartMerge(sort, 0, RunsNow(sort), 0);
+}
+
+extsort_ret_t ExtSort_Next(extsort_t *sort, void *record)
+{
+    if (sort == NULL || record == NULL)
+    {
+        return EXTSORT_ERROR_NULL_PARAMETER;
+    }
+
+    if (!sort->finished)
+    {
+        return EXTSORT_ERROR_NOT_FINISHED;
+    }
+
+    if (!sort->in_ram)
+    {
+        return Pop(sort, record);
+    }
+
+    if (sort->position == sort->buffered)
+    {
+        return EXTSORT_END;
+    }
+
+    memcpy(record, sort->work + sort->position * sort->record_size, sort->record_size);
+    sort->position++;
+
+    return EXTSORT_SUCCESS;
+}
+
+extsort_ret_t ExtSort_Rewind(extsort_t *sort)
+{
+    if (sort == NULL)
+    {
+        return EXTSORT_ERROR_NULL_PARAMETER;
+    }
+
+    if (!sort->finished)
+    {
+        return EXTSORT_ERROR_NOT_FINISHED;
+    }
+
+    sort->position = 0;
+
+    return sort->in_ram ? EXTSORT_SUCCESS : StartMerge(sort, 0, RunsNow(sort), 0);
+}
+
+extsort_ret_t ExtSort_Close(extsort_t *sort, extsort_stats_t *stats)
+{
+    if (sort == NULL)
+    {
+        return EXTSORT_ERROR_NULL_PARAMETER;
+    }
+
+    for (uint32_t i = 0; i < 2 && sort->fs != NULL; i++)
+    {
+        if (sort->file[i].handle != NULL)
+        {
+            sort->fs->ops->CloseFile(&sort->file[i]);
+        }
+
+        // A run written means the files may be there
+        if (sort->stats.runs > 0)
+        {
+            sort->fs->ops->RemoveFile(sort->files[i]);
+        }
+    }
+
+    if (stats != NULL)
+    {
+        *stats = sort->stats;
+    }
+
+    memset(sort->file, 0, sizeof(sort->file));
+
+    return EXTSORT_SUCCESS;
+}
@@ -0,0 +1,179 @@
+/*
+ * format.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#include "format.h"
+
+#include <string.h>
+
+// A 24-bit sample left-justified in a 32-bit word IS a valid 32-bit sample (the bottom byte is just 0),
+// so as far as converting goes the two are the same thing
+static inline audio_packing_t Normalize(audio_packing_t packing)
+{
+    return (packing == AUDIO_PACKING_S24_IN_32) ? AUDIO_PACKING_S32 : packing;
+}
+
+static uint32_t SampleCost(const audio_format_t *source, const audio_format_t *sink, uint32_t *stages)
+{
+    audio_packing_t from = Normalize(source->packing);
+    audio_packing_t to = Normalize(sink->packing);
+
+    if (from == to)
+    {
+        // Same word, but the sink can't take more bits than it advertises (e.g., 32-bit data into a 24-bit slot)
+        if (source->bits_per_sample > sink->bits_per_sample)
+        {
+            return FORMAT_COST_IMPOSSIBLE;
+        }
+
+        return 0;
+    }
+
+    if (to == AUDIO_PACKING_S16)
+    {
+        // 24/32-bit down to 16: dither + noise shaping (see pcm.h)
+        *stages |= FORMAT_STAGE_REQUANTIZE;
+        return FORMAT_COST_REQUANTIZE;
+    }
+
+    if (to == AUDIO_PACKING_S32 && (from == AUDIO_PACKING_S16 || from == AUDIO_PACKING_S24_PACKED))
+    {
+        *stages |= FORMAT_STAGE_REPACK;
+        return FORMAT_COST_REPACK;
+    }
+
+    return FORMAT_COST_IMPOSSIBLE;
+}
+
+static uint32_t ChannelCost(const audio_format_t *source, const audio_format_t *sink, uint32_t *stages)
+{
+    if (source->channels == sink->channels)
+    {
+        return 0;
+    }
+
+    if (source->channels == 1 && sink->channels == 2)
+    {
+        *stages |= FORMAT_STAGE_CHANNEL_MAP;
+        return FORMAT_COST_CHANNEL_MAP;
+    }
+
+    // TODO: downmixing
+    return FORMAT_COST_IMPOSSIBLE;
+}
+
+format_ret_t Format_Negotiate(const audio_format_t *source, const audio_format_t *sink_formats, size_t count,
+        uint32_t sink_rate, format_plan_t *plan)
+{
+    if (source == NULL || sink_formats == NULL || plan == NULL)
+    {
+        return FORMAT_ERROR_NULL_PARAMETER;
+    }
+
+    uint32_t target_rate = (sink_rate != AUDIO_RATE_ANY) ? sink_rate : source->sample_rate;
+    uint8_t found = 0;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const audio_format_t *candidate = &sink_formats[i];
+        uint32_t stages = FORMAT_STAGE_NONE;
+
+        uint32_t sample_cost = SampleCost(source, candidate, &stages);
+        uint32_t channel_cost = ChannelCost(source, candidate, &stages);
+
+        if (sample_cost == FORMAT_COST_IMPOSSIBLE || channel_cost == FORMAT_COST_IMPOSSIBLE)
+        {
+            continue;
+        }
+
+        uint32_t rate = (candidate->sample_rate != AUDIO_RATE_ANY) ? candidate->sample_rate : target_rate;
+
+        // A sink with a fixed rate list only matches if it can take the rate we're targeting
+        if (candidate->sample_rate != AUDIO_RATE_ANY && sink_rate != AUDIO_RATE_ANY && rate != sink_rate)
+        {
+            continue;
+        }
+
+        uint32_t cost = sample_cost + channel_cost;
+
+        if (rate != source->sample_rate)
+        {
+            stages |= FORMAT_STAGE_RESAMPLE;
+            cost += FORMAT_COST_RESAMPLE;
+        }
+
+        // On a tie, keep the one with more bits: same work, more resolution
+        if (!found || cost < plan->cost
+                || (cost == plan->cost && candidate->bits_per_sample > plan->sink.bits_per_sample))
+        {
+            found = 1;
+            plan->source = *source;
+            plan->sink = *candidate;
+            plan->sink.sample_rate = rate;
+            plan->stages = stages;
+            plan->cost = cost;
+        }
+    }
+
+    if (!found)
+    {
+        return FORMAT_ERROR_NO_CONVERSION;
+    }
+
+    return FORMAT_SUCCESS;
+}
+
+format_ret_t Format_Convert(const format_plan_t *plan, pcm_dither_t *dither, void *dst, const void *src, size_t frames)
+{
+    if (plan == NULL || dst == NULL || src == NULL)
+    {
+        return FORMAT_ERROR_NULL_PARAMETER;
+    }
+
+    // TODO: resampler
+    if (plan->stages & FORMAT_STAGE_RESAMPLE)
+    {
+        return FORMAT_ERROR_STAGE_UNSUPPORTED;
+    }
+
+    size_t samples = frames * plan->source.channels;
+    audio_packing_t from = Normalize(plan->source.packing);
+
+    if (plan->stages & FORMAT_STAGE_REQUANTIZE)
+    {
+        if (from == AUDIO_PACKING_S24_PACKED)
+        {
+            PCM_Convert24To16(dither, (int16_t *)dst, (const uint8_t *)src, samples, plan->source.channels);
+        }
+        else
+        {
+            PCM_Convert32To16(dither, (int16_t *)dst, (const int32_t *)src, samples, plan->source.channels);
+        }
+    }
+    else if (plan->stages & FORMAT_STAGE_REPACK)
+    {
+        if (from == AUDIO_PACKING_S16)
+        {
+            PCM_Widen16To32((int32_t *)dst, (const int16_t *)src, samples);
+        }
+        else
+        {
+            PCM_Repack24To32((int32_t *)dst, (const uint8_t *)src, samples);
+        }
+    }
+    else
+    {
+        memcpy(dst, src, frames * Audio_BytesPerFrame(&plan->source));
+    }
+
+    // Done last, in place, on the already-converted samples
+    if (plan->stages & FORMAT_STAGE_CHANNEL_MAP)
+    {
+        PCM_DuplicateMono(dst, frames, Audio_BytesPerSample(plan->sink.packing));
+    }
+
+    return FORMAT_SUCCESS;
+}
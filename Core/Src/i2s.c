@@ -5,19 +5,147 @@
  *      Author: prestonmeek
  */
 #include "i2s.h"
+#include "i2s_clock.h"
 #include "main.h"
 
 // TODO:
 // extern I2S_HandleTypeDef hi2s2;
 
+// The I2S peripheral we use (I2S2 lives inside SPI2)
+#define I2S_INSTANCE SPI2
+
+// Set to 1 if the DAC needs a master clock (MCK pin). This changes every divider, see i2s_clock.h
+#define I2S_MCLK_OUTPUT 0
+
+// How far off the nominal rate we're willing to play before asking for resampling instead.
+// 250 ppm is ~0.4 cents of pitch, which nobody can hear, and is in the same ballpark as a cheap crystal.
+#define I2S_MAX_RATE_ERROR_PPM 250
+
+static inline uint32_t AbsPPM(int32_t ppm) {
+    return (ppm < 0) ? (uint32_t)(-ppm) : (uint32_t)ppm;
+}
+
+// PLLI2S shares the main PLL's input divider (PLLM), so read back whatever SystemClock_Config chose
+static uint32_t PLLI2S_InputHz(void) {
+    uint32_t source_hz = (RCC->PLLCFGR & RCC_PLLCFGR_PLLSRC) ? HSE_VALUE : HSI_VALUE;
+    uint32_t pllm = RCC->PLLCFGR & RCC_PLLCFGR_PLLM;
+
+    return source_hz / pllm;
+}
+
 audio_ret_t I2S_Open(void) {
-    // TODO
+    __HAL_RCC_SPI2_CLK_ENABLE();
+
+    // Work out the best clock for every standard rate now, so opening a track is just a lookup
+    if (I2SClock_BuildTable(PLLI2S_InputHz(), I2S_MCLK_OUTPUT) != I2S_CLOCK_SUCCESS) {
+        return AUDIO_ERROR_UNABLE_TO_CONFIGURE;
+    }
+
+    // TODO: GPIO + DMA setup
 
     return AUDIO_SUCCESS;
 }
 
 audio_ret_t I2S_Close(void) {
-    // TODO
+    I2S_INSTANCE->I2SCFGR &= ~SPI_I2SCFGR_I2SE;
+
+    // Nothing else uses PLLI2S, so stop it to save power
+    HAL_RCCEx_DisablePLLI2S();
+
+    return AUDIO_SUCCESS;
+}
+
+// I2S always sends a left and a right slot, so everything is stereo.
+// PLLI2S can get close to any rate, so Configure() is what finally decides whether a rate is OK.
+static const audio_format_t I2S_FORMATS[] =
+{
+    { .sample_rate = AUDIO_RATE_ANY, .bits_per_sample = 16, .channels = 2, .packing = AUDIO_PACKING_S16 },
+    { .sample_rate = AUDIO_RATE_ANY, .bits_per_sample = 24, .channels = 2, .packing = AUDIO_PACKING_S24_IN_32 },
+    { .sample_rate = AUDIO_RATE_ANY, .bits_per_sample = 32, .channels = 2, .packing = AUDIO_PACKING_S32 },
+};
+
+#define LEN(arr) (sizeof(arr) / sizeof(arr[0]))
+
+audio_ret_t I2S_GetFormats(const audio_format_t **formats, size_t *count) {
+    if (formats == NULL || count == NULL) {
+        return AUDIO_ERROR_NULL_BUFFER;
+    }
+
+    *formats = I2S_FORMATS;
+    *count = LEN(I2S_FORMATS);
+
+    return AUDIO_SUCCESS;
+}
+
+/*
+ * Reprogram PLLI2S and the I2S prescaler for a track.
+ *
+ * If the closest achievable rate is more than I2S_MAX_RATE_ERROR_PPM off,
+ * the clock is left alone and AUDIO_ERROR_RATE_UNSUPPORTED is returned so the caller can resample instead.
+ * Either way, *error_ppm reports how far off the best achievable clock is.
+ */
+audio_ret_t I2S_Configure(const audio_format_t *format, int32_t *error_ppm) {
+    if (format == NULL) {
+        return AUDIO_ERROR_NULL_BUFFER;
+    }
+
+    uint8_t supported = 0;
+
+    for (size_t i = 0; i < LEN(I2S_FORMATS); i++) {
+        if (I2S_FORMATS[i].bits_per_sample == format->bits_per_sample
+                && I2S_FORMATS[i].channels == format->channels
+                && I2S_FORMATS[i].packing == format->packing) {
+            supported = 1;
+            break;
+        }
+    }
+
+    if (!supported) {
+        return AUDIO_ERROR_FORMAT_UNSUPPORTED;
+    }
+
+    uint32_t frame_bits = (format->bits_per_sample > 16) ? I2S_CLOCK_FRAME_32 : I2S_CLOCK_FRAME_16;
+    i2s_clock_t clock;
+
+    if (I2SClock_Lookup(format->sample_rate, frame_bits, &clock) != I2S_CLOCK_SUCCESS) {
+        return AUDIO_ERROR_RATE_UNSUPPORTED;
+    }
+
+    if (error_ppm != NULL) {
+        *error_ppm = clock.error_ppm;
+    }
+
+    if (AbsPPM(clock.error_ppm) > I2S_MAX_RATE_ERROR_PPM) {
+        return AUDIO_ERROR_RATE_UNSUPPORTED;
+    }
+
+    // The prescaler can only be changed while the peripheral is disabled
+    I2S_INSTANCE->I2SCFGR &= ~SPI_I2SCFGR_I2SE;
+
+    // This stops PLLI2S, reprograms N and R, and waits for it to lock again
+    RCC_PeriphCLKInitTypeDef periph_clock = { 0 };
+    periph_clock.PeriphClockSelection = RCC_PERIPHCLK_I2S;
+    periph_clock.PLLI2S.PLLI2SN = clock.plli2s_n;
+    periph_clock.PLLI2S.PLLI2SR = clock.plli2s_r;
+
+    if (HAL_RCCEx_PeriphCLKConfig(&periph_clock) != HAL_OK) {
+        return AUDIO_ERROR_UNABLE_TO_CONFIGURE;
+    }
+
+    I2S_INSTANCE->I2SPR = ((uint32_t)clock.i2s_div << SPI_I2SPR_I2SDIV_Pos)
+            | ((uint32_t)clock.i2s_odd << SPI_I2SPR_ODD_Pos)
+            | (I2S_MCLK_OUTPUT ? SPI_I2SPR_MCKOE : 0);
+
+    // Channel length has to match the frame size the clock was computed for.
+    // DATLEN: 00 = 16-bit, 01 = 24-bit, 10 = 32-bit
+    uint32_t config = I2S_INSTANCE->I2SCFGR & ~(SPI_I2SCFGR_CHLEN | SPI_I2SCFGR_DATLEN);
+
+    if (frame_bits == I2S_CLOCK_FRAME_32) {
+        config |= SPI_I2SCFGR_CHLEN;
+        config |= (format->bits_per_sample > 24) ? SPI_I2SCFGR_DATLEN_1 : SPI_I2SCFGR_DATLEN_0;
+    }
+
+    I2S_INSTANCE->I2SCFGR = config;
 
     return AUDIO_SUCCESS;
 }
@@ -38,5 +166,6 @@ audio_ret_t I2S_Stream(void *buffer, size_t length) {
 }
 
 const audio_driver_t i2s_driver =
-{ .Open = I2S_Open, .Close = I2S_Close, .Stream = I2S_Stream };
+{ .Open = I2S_Open, .Close = I2S_Close, .GetFormats = I2S_GetFormats,
+        .Configure = I2S_Configure, .Stream = I2S_Stream };
 
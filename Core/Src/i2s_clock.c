@@ -0,0 +1,171 @@
+/*
+ * i2s_clock.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#include "i2s_clock.h"
+
+#include <string.h>
+
+#define MCLK_DIVIDER 256
+
+static const uint32_t STANDARD_RATES[I2S_CLOCK_NUM_RATES] =
+{ 8000, 11025, 16000, 22050, 32000, 44100, 48000, 88200, 96000 };
+
+// One table per frame size, since 16-bit and 24/32-bit tracks need different dividers
+static i2s_clock_t table_16[I2S_CLOCK_NUM_RATES];
+static i2s_clock_t table_32[I2S_CLOCK_NUM_RATES];
+static uint32_t table_input_hz;
+static uint8_t table_mclk_output;
+static uint8_t table_built;
+
+static inline uint32_t AbsPPM(int32_t ppm)
+{
+    return (ppm < 0) ? (uint32_t)(-ppm) : (uint32_t)ppm;
+}
+
+/*
+ * Brute force: ~380 values of N times 6 values of R, and for each one the best divider is a single rounding.
+ * That's only a couple of thousand iterations per rate, so it's cheap enough to do for the whole table at boot.
+ */
+i2s_clock_ret_t I2SClock_Compute(uint32_t input_hz, uint32_t sample_rate, uint32_t frame_bits, uint8_t mclk_output,
+        i2s_clock_t *clock)
+{
+    if (clock == NULL || input_hz == 0 || sample_rate == 0)
+    {
+        return I2S_CLOCK_ERROR_INVALID_PARAMETER;
+    }
+
+    if (frame_bits != I2S_CLOCK_FRAME_16 && frame_bits != I2S_CLOCK_FRAME_32)
+    {
+        return I2S_CLOCK_ERROR_INVALID_PARAMETER;
+    }
+
+    // With MCLK enabled the divider is always 256 * (2 * DIV + ODD), regardless of the frame size
+    uint64_t k = mclk_output ? MCLK_DIVIDER : frame_bits;
+    uint64_t target_mhz = (uint64_t)sample_rate * 1000;
+
+    uint8_t found = 0;
+    i2s_clock_t best = { 0 };
+
+    for (uint32_t n = I2S_CLOCK_PLLN_MIN; n <= I2S_CLOCK_PLLN_MAX; n++)
+    {
+        uint64_t vco_hz = (uint64_t)input_hz * n;
+
+        if (vco_hz < I2S_CLOCK_VCO_MIN_HZ || vco_hz > I2S_CLOCK_VCO_MAX_HZ)
+        {
+            continue;
+        }
+
+        for (uint32_t r = I2S_CLOCK_PLLR_MIN; r <= I2S_CLOCK_PLLR_MAX; r++)
+        {
+            uint64_t i2sclk_hz = vco_hz / r;
+
+            if (i2sclk_hz > I2S_CLOCK_I2SCLK_MAX_HZ)
+            {
+                continue;
+            }
+
+            // divider = 2 * DIV + ODD, rounded to the nearest integer
+            uint64_t divider = (i2sclk_hz + (k * sample_rate) / 2) / (k * sample_rate);
+
+            if (divider < 2 * I2S_CLOCK_DIV_MIN || divider > 2 * I2S_CLOCK_DIV_MAX + 1)
+            {
+                continue;
+            }
+
+            uint64_t actual_mhz = (i2sclk_hz * 1000) / (k * divider);
+            int64_t error_ppm = (((int64_t)actual_mhz - (int64_t)target_mhz) * 1000000) / (int64_t)target_mhz;
+
+            if (!found || AbsPPM((int32_t)error_ppm) < AbsPPM(best.error_ppm))
+            {
+                found = 1;
+                best.sample_rate = sample_rate;
+                best.actual_rate_mhz = (uint32_t)actual_mhz;
+                best.error_ppm = (int32_t)error_ppm;
+                best.plli2s_n = (uint16_t)n;
+                best.plli2s_r = (uint8_t)r;
+                best.i2s_div = (uint8_t)(divider / 2);
+                best.i2s_odd = (uint8_t)(divider & 1);
+            }
+        }
+    }
+
+    if (!found)
+    {
+        return I2S_CLOCK_ERROR_NO_SOLUTION;
+    }
+
+    *clock = best;
+
+    return I2S_CLOCK_SUCCESS;
+}
+
+i2s_clock_ret_t I2SClock_BuildTable(uint32_t input_hz, uint8_t mclk_output)
+{
+    table_built = 0;
+
+    for (size_t i = 0; i < I2S_CLOCK_NUM_RATES; i++)
+    {
+        i2s_clock_ret_t res;
+
+        res = I2SClock_Compute(input_hz, STANDARD_RATES[i], I2S_CLOCK_FRAME_16, mclk_output, &table_16[i]);
+        if (res != I2S_CLOCK_SUCCESS)
+        {
+            return res;
+        }
+
+        res = I2SClock_Compute(input_hz, STANDARD_RATES[i], I2S_CLOCK_FRAME_32, mclk_output, &table_32[i]);
+        if (res != I2S_CLOCK_SUCCESS)
+        {
+            return res;
+        }
+    }
+
+    table_input_hz = input_hz;
+    table_mclk_output = mclk_output;
+    table_built = 1;
+
+    return I2S_CLOCK_SUCCESS;
+}
+
+i2s_clock_ret_t I2SClock_Lookup(uint32_t sample_rate, uint32_t frame_bits, i2s_clock_t *clock)
+{
+    if (clock == NULL)
+    {
+        return I2S_CLOCK_ERROR_INVALID_PARAMETER;
+    }
+
+    if (!table_built)
+    {
+        return I2S_CLOCK_ERROR_TABLE_NOT_BUILT;
+    }
+
+    const i2s_clock_t *table;
+
+    switch (frame_bits)
+    {
+    case I2S_CLOCK_FRAME_16:
+        table = table_16;
+        break;
+    case I2S_CLOCK_FRAME_32:
+        table = table_32;
+        break;
+    default:
+        return I2S_CLOCK_ERROR_INVALID_PARAMETER;
+    }
+
+    for (size_t i = 0; i < I2S_CLOCK_NUM_RATES; i++)
+    {
+        if (table[i].sample_rate == sample_rate)
+        {
+            *clock = table[i];
+            return I2S_CLOCK_SUCCESS;
+        }
+    }
+
+    // Unusual rate: not worth a table slot, just search for it now
+    return I2SClock_Compute(table_input_hz, sample_rate, frame_bits, table_mclk_output, clock);
+}
@@ -0,0 +1,86 @@
+/*
+ * internal_flash.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#include "internal_flash.h"
+
+#define ERROR_FLAGS (FLASH_FLAG_OPERR | FLASH_FLAG_WRPERR | FLASH_FLAG_PGAERR | FLASH_FLAG_PGPERR | FLASH_FLAG_PGSERR)
+
+static const uint8_t *Sector(uint32_t sector)
+{
+    return (const uint8_t *)(INTERNAL_FLASH_SETTINGS_BASE + sector * INTERNAL_FLASH_SETTINGS_SECTOR_SIZE);
+}
+
+// The ART accelerator's data cache may still have what was there before: start it over
+static void FlushDataCache(void)
+{
+    if (FLASH->ACR & FLASH_ACR_DCEN)
+    {
+        __HAL_FLASH_DATA_CACHE_DISABLE();
+        __HAL_FLASH_DATA_CACHE_RESET();
+        __HAL_FLASH_DATA_CACHE_ENABLE();
+    }
+}
+
+static settings_ret_t Program(uint32_t sector, uint32_t offset, const uint32_t *words, uint32_t count)
+{
+    uint32_t address = INTERNAL_FLASH_SETTINGS_BASE + sector * INTERNAL_FLASH_SETTINGS_SECTOR_SIZE + offset;
+    settings_ret_t res = SETTINGS_SUCCESS;
+
+    if (sector > 1 || offset % 4 != 0 || offset + count * 4 > INTERNAL_FLASH_SETTINGS_SECTOR_SIZE)
+    {
+        return SETTINGS_ERROR_INVALID;
+    }
+
+    HAL_FLASH_Unlock();
+
+    // Anything left over from before would stop the next operation
+    __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_EOP | ERROR_FLAGS);
+
+    for (uint32_t i = 0; i < count && res == SETTINGS_SUCCESS; i++)
+    {
+        // Erased words are left alone: programming them would change nothing, and takes as long
+        if (words[i] != 0xFFFFFFFFUL && HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, address + i * 4, words[i]) != HAL_OK)
+        {
+            res = SETTINGS_ERROR_FLASH;
+        }
+    }
+
+    HAL_FLASH_Lock();
+    FlushDataCache();
+
+    return res;
+}
+
+static settings_ret_t Erase(uint32_t sector)
+{
+    FLASH_EraseInitTypeDef erase =
+    { 0 };
+    uint32_t error = 0;
+
+    if (sector > 1)
+    {
+        return SETTINGS_ERROR_INVALID;
+    }
+
+    erase.TypeErase = FLASH_TYPEERASE_SECTORS;
+    erase.Sector = INTERNAL_FLASH_SETTINGS_SECTOR + sector;
+    erase.NbSectors = 1;
+    erase.VoltageRange = FLASH_VOLTAGE_RANGE_3;
+
+    HAL_FLASH_Unlock();
+    __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_EOP | ERROR_FLAGS);
+
+    // Flushes the caches itself once it's done
+    HAL_StatusTypeDef res = HAL_FLASHEx_Erase(&erase, &error);
+
+    HAL_FLASH_Lock();
+
+    return (res == HAL_OK && error == 0xFFFFFFFFUL) ? SETTINGS_SUCCESS : SETTINGS_ERROR_FLASH;
+}
+
+const settings_flash_t internal_flash_settings =
+{ .sector_size = INTERNAL_FLASH_SETTINGS_SECTOR_SIZE, .Sector = Sector, .Program = Program, .Erase = Erase };
@@ -0,0 +1,1897 @@
+/*
+ * library.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#include "library.h"
+#include "crc32.h"
+#include "extsort.h"
+#include "wav.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// "MULB", little-endian
+#define LIBRARY_MAGIC 0x424C554D
+#define LIBRARY_VERSION 3
+
+#define LIBRARY_SECTOR 512
+
+// Copies (temporary files into the index) go through the work buffer this much at a time, at most
+#define LIBRARY_COPY_CHUNK 8192
+
+// What's read of the old index at a time while updating, per window (see build)
+#define LIBRARY_OLD_WINDOW LIBRARY_SECTOR
+
+// The search section's samples: up to this many blocks' first keys, this much of each. Kept in RAM once read.
+#define LIBRARY_SEARCH_SAMPLES 64
+#define LIBRARY_SEARCH_SAMPLE_KEY 16
+
+typedef struct
+{
+    uint32_t offset;            // from the start of the index
+    uint32_t length;            // bytes, 0 if there's no such section
+} section_t;
+
+typedef struct
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t record_size;
+    uint32_t tracks;
+    uint32_t volume_serial;     // of the card it was built on
+    section_t strings;
+    section_t paths;
+    section_t records;
+    section_t folders;
+    section_t views[LIBRARY_NUM_VIEWS];
+    section_t search;           // the title view's keys, front-coded a block (sector) at a time
+    section_t search_samples;   // every search_stride'th block's first key
+    uint32_t search_stride;
+    uint32_t crc;               // of all of the above
+} index_header_t;
+
+// 32 bytes, so a sector holds 16 and none straddles two
+typedef struct
+{
+    uint32_t path;              // where its group starts in the paths section
+    uint32_t title;             // offsets in the strings section
+    uint32_t artist;
+    uint32_t album;
+    uint32_t duration_ms;
+    uint32_t sample_rate;
+    uint32_t modified;          // the file's FAT timestamp
+    uint16_t track_number;
+    uint8_t channels;
+    uint8_t bits_per_sample;
+} record_t;
+
+// One per folder walked, in walk order: what Library_Update compares to tell what's changed
+typedef struct
+{
+    uint32_t path_crc;          // CRC-32 of its path, which is how it's found again
+    uint32_t modified;          // its own FAT timestamp, from the folder it's in (0 for the root)
+    uint32_t entries;           // hidden ones (and the library's own files) aside
+    uint32_t listing_crc;       // of every entry's name, size, timestamp and type, in directory order
+    uint32_t first_track;       // its tracks are all together, from here
+    uint32_t tracks;
+    uint16_t path_len;
+    uint16_t skipped;           // files that looked like tracks but weren't indexed
+} folder_t;
+
+typedef struct
+{
+    uint8_t key[LIBRARY_KEY_LEN];
+    uint32_t index;
+} sort_entry_t;
+
+// Part of the old index, as read last
+typedef struct
+{
+    uint32_t at;                // from the start of the index
+    uint32_t length;            // 0 if nothing's been read
+    uint8_t data[LIBRARY_OLD_WINDOW];
+} old_window_t;
+
+// Titles, artists and albums each go through a window of their own: they're all in the strings section, but an artist
+// is only stored once per run of tracks, so the tracks that follow point back at it
+enum
+{
+    OLD_TITLES = 0,
+    OLD_ARTISTS,
+    OLD_ALBUMS,
+    OLD_RECORDS,
+    OLD_FOLDERS,
+    OLD_NUM_WINDOWS
+};
+
+// Lowercase. TODO: only WAV for now
+static const char *const TRACK_EXTENSIONS[] = { ".wav" };
+
+static fs_driver_t *library_fs;
+static const codec_t *library_codec;
+
+static struct
+{
+    uint8_t open;
+    file_t file;
+    index_header_t header;
+
+    // Searching: the samples, read the first time they're needed, and the last block read
+    uint8_t samples_loaded;
+    uint8_t samples[LIBRARY_SEARCH_SAMPLES][LIBRARY_SEARCH_SAMPLE_KEY];
+    uint32_t block_at;
+    uint8_t block[LIBRARY_SECTOR];
+} library;
+
+// Everything Library_Build needs between the walk's steps
+static struct
+{
+    file_t index;               // written once the walk is done
+    file_t strings;
+    file_t paths;
+    file_t records;
+    file_t keys;                // every track's sort entries, one per view, for sorting once the walk is done
+    file_t folders;
+    uint32_t strings_b;         // the next string's offset
+    uint32_t paths_b;
+    uint32_t group;             // where the current path group started
+    uint8_t *work;
+    size_t work_size;
+    library_stats_t stats;
+
+    // Updating: the old index is open (library), and its folders are looked up from where the last one was found.
+    // It's read in the order it was written, give or take what's changed, so a window per kind of thing read saves
+    // a seek back and forth (along the FAT chain) per read.
+    uint8_t updating;
+    uint32_t old_cursor;
+    old_window_t old[OLD_NUM_WINDOWS];
+
+    char path[LIBRARY_MAX_PATH];        // of the entry being looked at
+    char last_path[LIBRARY_MAX_PATH];   // the last track's, to front-code against
+
+    // The last artist and album stored, and where
+    char last_artist[CODEC_MAX_TAG];
+    char last_album[CODEC_MAX_TAG];
+    uint32_t last_artist_at;
+    uint32_t last_album_at;
+
+    // The views' sort, and the search section, as it's written: the block being filled, the key before, the samples
+    extsort_t sort;
+    uint8_t block[LIBRARY_SECTOR];
+    uint32_t block_entries;
+    uint32_t block_used;
+    uint32_t blocks;
+    uint8_t last_key[LIBRARY_KEY_LEN];
+    uint32_t last_key_length;
+    uint8_t samples[LIBRARY_SEARCH_SAMPLES][LIBRARY_SEARCH_SAMPLE_KEY];
+    uint32_t num_samples;
+    uint32_t stride;
+
+    fs_entry_t entry;
+} build;
+
+// Everything a build writes, the index last: created in this order, and on a failure, all gone again
+static const struct
+{
+    file_t *file;
+    char *name;
+} BUILD_FILES[] =
+{
+    { &build.strings, LIBRARY_STRINGS_TEMP },
+    { &build.paths, LIBRARY_PATHS_TEMP },
+    { &build.records, LIBRARY_RECORDS_TEMP },
+    { &build.keys, LIBRARY_KEYS_TEMP },
+    { &build.folders, LIBRARY_FOLDERS_TEMP },
+    { &build.index, LIBRARY_INDEX_TEMP },
+};
+
+#define NUM_BUILD_FILES (sizeof(BUILD_FILES) / sizeof(BUILD_FILES[0]))
+
+static inline uint32_t Min(uint32_t a, uint32_t b)
+{
+    return (a < b) ? a : b;
+}
+
+static inline uint32_t RoundUpToSector(uint32_t bytes)
+{
+    return (bytes + LIBRARY_SECTOR - 1) & ~(uint32_t)(LIBRARY_SECTOR - 1);
+}
+
+// Browsing isn't in a hurry, but shouldn't wait behind background work either
+static void SetIOClass(fs_io_class_t io_class)
+{
+    if (library_fs->ops->SetIOClass != NULL)
+    {
+        library_fs->ops->SetIOClass(io_class, 0);
+    }
+}
+
+library_ret_t Library_Init(fs_driver_t *fs, const codec_t *codec)
+{
+    if (fs == NULL || codec == NULL)
+    {
+        return LIBRARY_ERROR_NULL_PARAMETER;
+    }
+
+    if (library.open)
+    {
+        Library_Close();
+    }
+
+    library_fs = fs;
+    library_codec = codec;
+
+    return LIBRARY_SUCCESS;
+}
+
+static uint32_t HeaderCRC(const index_header_t *header)
+{
+    return CRC32_Update(CRC32_INIT, header, offsetof(index_header_t, crc));
+}
+
+library_ret_t Library_Open(void)
+{
+    if (library_fs == NULL)
+    {
+        return LIBRARY_ERROR_NOT_INITIALIZED;
+    }
+
+    if (library_fs->ops->ReadFileFrom == NULL)
+    {
+        return LIBRARY_ERROR_UNSUPPORTED;
+    }
+
+    if (library.open)
+    {
+        Library_Close();
+    }
+
+    SetIOClass(FS_IO_NORMAL);
+
+    if (library_fs->ops->OpenFile(&library.file, LIBRARY_INDEX_FILE) != FS_SUCCESS)
+    {
+        return LIBRARY_ERROR_NO_INDEX;
+    }
+
+    index_header_t *header = &library.header;
+
+    if (library_fs->ops->ReadFileFrom(&library.file, 0, header, sizeof(*header)) != FS_SUCCESS
+            || header->magic != LIBRARY_MAGIC || header->version != LIBRARY_VERSION
+            || header->record_size != sizeof(record_t) || header->crc != HeaderCRC(header))
+    {
+        library_fs->ops->CloseFile(&library.file);
+        return LIBRARY_ERROR_NO_INDEX;
+    }
+
+    library.open = 1;
+    library.samples_loaded = 0;
+    library.block_at = UINT32_MAX;
+
+    return LIBRARY_SUCCESS;
+}
+
+library_ret_t Library_Close(void)
+{
+    if (!library.open)
+    {
+        return LIBRARY_SUCCESS;
+    }
+
+    library.open = 0;
+
+    return (library_fs->ops->CloseFile(&library.file) == FS_SUCCESS) ? LIBRARY_SUCCESS : LIBRARY_ERROR_GENERIC;
+}
+
+uint32_t Library_Count(void)
+{
+    return library.open ? library.header.tracks : 0;
+}
+
+static library_ret_t ReadRecord(file_t *file, const section_t *records, uint32_t index, record_t *record)
+{
+    uint32_t offset = records->offset + index * (uint32_t)sizeof(record_t);
+
+    if (library_fs->ops->ReadFileFrom(file, offset, record, sizeof(*record)) != FS_SUCCESS)
+    {
+        return LIBRARY_ERROR_UNABLE_TO_READ;
+    }
+
+    return LIBRARY_SUCCESS;
+}
+
+// Up to length - 1 bytes of the string at offset, always terminated
+static library_ret_t ReadString(file_t *file, const section_t *strings, uint32_t offset, char *string,
+        uint32_t length)
+{
+    if (offset >= strings->length)
+    {
+        return LIBRARY_ERROR_UNABLE_TO_READ;
+    }
+
+    length = Min(length, strings->length - offset);
+
+    if (library_fs->ops->ReadFileFrom(file, strings->offset + offset, string, length) != FS_SUCCESS)
+    {
+        return LIBRARY_ERROR_UNABLE_TO_READ;
+    }
+
+    string[length - 1] = '\0';
+
+    return LIBRARY_SUCCESS;
+}
+
+library_ret_t Library_GetTrack(uint32_t index, library_track_t *track)
+{
+    if (track == NULL)
+    {
+        return LIBRARY_ERROR_NULL_PARAMETER;
+    }
+
+    if (!library.open)
+    {
+        return LIBRARY_ERROR_NO_INDEX;
+    }
+
+    if (index >= library.header.tracks)
+    {
+        return LIBRARY_ERROR_OUT_OF_RANGE;
+    }
+
+    const index_header_t *header = &library.header;
+    record_t record;
+
+    SetIOClass(FS_IO_NORMAL);
+
+    if (ReadRecord(&library.file, &header->records, index, &record) != LIBRARY_SUCCESS
+            || ReadString(&library.file, &header->strings, record.title, track->title, CODEC_MAX_TAG)
+                    != LIBRARY_SUCCESS
+            || ReadString(&library.file, &header->strings, record.artist, track->artist, CODEC_MAX_TAG)
+                    != LIBRARY_SUCCESS
+            || ReadString(&library.file, &header->strings, record.album, track->album, CODEC_MAX_TAG)
+                    != LIBRARY_SUCCESS)
+    {
+        return LIBRARY_ERROR_UNABLE_TO_READ;
+    }
+
+    track->duration_ms = record.duration_ms;
+    track->sample_rate = record.sample_rate;
+    track->track_number = record.track_number;
+    track->channels = record.channels;
+    track->bits_per_sample = record.bits_per_sample;
+
+    return LIBRARY_SUCCESS;
+}
+
+library_ret_t Library_GetPath(uint32_t index, char *path, size_t size)
+{
+    if (path == NULL)
+    {
+        return LIBRARY_ERROR_NULL_PARAMETER;
+    }
+
+    if (size < LIBRARY_MAX_PATH)
+    {
+        return LIBRARY_ERROR_WORK_TOO_SMALL;
+    }
+
+    if (!library.open)
+    {
+        return LIBRARY_ERROR_NO_INDEX;
+    }
+
+    if (index >= library.header.tracks)
+    {
+        return LIBRARY_ERROR_OUT_OF_RANGE;
+    }
+
+    const index_header_t *header = &library.header;
+    record_t record;
+
+    SetIOClass(FS_IO_NORMAL);
+
+    if (ReadRecord(&library.file, &header->records, index, &record) != LIBRARY_SUCCESS)
+    {
+        return LIBRARY_ERROR_UNABLE_TO_READ;
+    }
+
+    // From the group's whole path, through each one after it up to ours
+    uint32_t offset = header->paths.offset + record.path;
+    uint32_t length = 0;
+
+    for (uint32_t i = 0; i <= index % LIBRARY_PATH_GROUP; i++)
+    {
+        uint8_t coded[2];           // bytes in common with the one before, then how many follow
+
+        if (library_fs->ops->ReadFileFrom(&library.file, offset, coded, sizeof(coded)) != FS_SUCCESS
+                || coded[0] > length
+                || library_fs->ops->ReadFileFrom(&library.file, offset + sizeof(coded), path + coded[0], coded[1])
+                        != FS_SUCCESS)
+        {
+            return LIBRARY_ERROR_UNABLE_TO_READ;
+        }
+
+        length = coded[0] + coded[1];
+        offset += sizeof(coded) + coded[1];
+    }
+
+    path[length] = '\0';
+
+    return LIBRARY_SUCCESS;
+}
+
+library_ret_t Library_GetViewEntry(library_view_t view, uint32_t position, uint32_t *index)
+{
+    if (index == NULL)
+    {
+        return LIBRARY_ERROR_NULL_PARAMETER;
+    }
+
+    if (!library.open)
+    {
+        return LIBRARY_ERROR_NO_INDEX;
+    }
+
+    if (view >= LIBRARY_NUM_VIEWS || library.header.views[view].length == 0)
+    {
+        return LIBRARY_ERROR_NO_VIEW;
+    }
+
+    if (position >= library.header.tracks)
+    {
+        return LIBRARY_ERROR_OUT_OF_RANGE;
+    }
+
+    SetIOClass(FS_IO_NORMAL);
+
+    uint32_t offset = library.header.views[view].offset + position * (uint32_t)sizeof(uint32_t);
+
+    if (library_fs->ops->ReadFileFrom(&library.file, offset, index, sizeof(*index)) != FS_SUCCESS)
+    {
+        return LIBRARY_ERROR_UNABLE_TO_READ;
+    }
+
+    return LIBRARY_SUCCESS;
+}
+
+/*
+ * Searching
+ */
+
+static inline char Fold(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+}
+
+static void FoldInto(uint8_t *key, uint32_t length, const char *string)
+{
+    uint32_t i = 0;
+
+    for (; i < length && string[i] != '\0'; i++)
+    {
+        key[i] = (uint8_t)Fold(string[i]);
+    }
+
+    memset(key + i, 0, length - i);
+}
+
+// A search block's entries one at a time: each one's key, zero-padded like a sort entry's, and track number
+typedef struct
+{
+    const uint8_t *block;
+    uint32_t at;
+    uint32_t left;
+    uint8_t key[LIBRARY_KEY_LEN];
+    uint32_t length;
+    uint32_t index;
+} block_cursor_t;
+
+static void StartBlock(block_cursor_t *cursor, const uint8_t *block)
+{
+    uint16_t count;
+
+    memcpy(&count, block, sizeof(count));
+
+    cursor->block = block;
+    cursor->at = sizeof(count);
+    cursor->left = count;
+    cursor->length = 0;
+}
+
+// 0 at the end of the block, or if what's there doesn't make sense
+static uint8_t NextInBlock(block_cursor_t *cursor)
+{
+    if (cursor->left == 0 || cursor->at + 2 > LIBRARY_SECTOR)
+    {
+        return 0;
+    }
+
+    const uint8_t *entry = cursor->block + cursor->at;
+
+    if (entry[0] > cursor->length || entry[0] + entry[1] > LIBRARY_KEY_LEN
+            || cursor->at + 2 + entry[1] + sizeof(cursor->index) > LIBRARY_SECTOR)
+    {
+        return 0;
+    }
+
+    memcpy(cursor->key + entry[0], entry + 2, entry[1]);
+    cursor->length = entry[0] + entry[1];
+    memset(cursor->key + cursor->length, 0, LIBRARY_KEY_LEN - cursor->length);
+    memcpy(&cursor->index, entry + 2 + entry[1], sizeof(cursor->index));
+
+    cursor->at += 2 + entry[1] + sizeof(cursor->index);
+    cursor->left--;
+
+    return 1;
+}
+
+static library_ret_t ReadBlock(uint32_t block)
+{
+    if (library.block_at == block)
+    {
+        return LIBRARY_SUCCESS;
+    }
+
+    library.block_at = UINT32_MAX;
+
+    if (library_fs->ops->ReadFileFrom(&library.file, library.header.search.offset + block * LIBRARY_SECTOR,
+            library.block, LIBRARY_SECTOR) != FS_SUCCESS)
+    {
+        return LIBRARY_ERROR_UNABLE_TO_READ;
+    }
+
+    library.block_at = block;
+
+    return LIBRARY_SUCCESS;
+}
+
+static library_ret_t LoadSamples(void)
+{
+    const section_t *samples = &library.header.search_samples;
+
+    if (library.samples_loaded)
+    {
+        return LIBRARY_SUCCESS;
+    }
+
+    if (samples->length > sizeof(library.samples) || samples->length == 0 || library.header.search_stride == 0
+            || library_fs->ops->ReadFileFrom(&library.file, samples->offset, library.samples, samples->length)
+                    != FS_SUCCESS)
+    {
+        return LIBRARY_ERROR_UNABLE_TO_READ;
+    }
+
+    library.samples_loaded = 1;
+
+    return LIBRARY_SUCCESS;
+}
+
+// Past the first LIBRARY_KEY_LEN bytes, only the title itself can tell
+static uint8_t TitleStartsWith(uint32_t index, const char *prefix)
+{
+    char title[CODEC_MAX_TAG];
+    record_t record;
+
+    if (ReadRecord(&library.file, &library.header.records, index, &record) != LIBRARY_SUCCESS
+            || ReadString(&library.file, &library.header.strings, record.title, title, sizeof(title))
+                    != LIBRARY_SUCCESS)
+    {
+        return 0;
+    }
+
+    for (uint32_t i = 0; prefix[i] != '\0'; i++)
+    {
+        if (Fold(title[i]) != Fold(prefix[i]))
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+library_ret_t Library_Search(const char *prefix, uint32_t skip, uint32_t *indexes, uint32_t max, uint32_t *found)
+{
+    if (prefix == NULL || indexes == NULL || found == NULL)
+    {
+        return LIBRARY_ERROR_NULL_PARAMETER;
+    }
+
+    *found = 0;
+
+    if (!library.open)
+    {
+        return LIBRARY_ERROR_NO_INDEX;
+    }
+
+    const index_header_t *header = &library.header;
+    uint32_t blocks = header->search.length / LIBRARY_SECTOR;
+
+    if (blocks == 0)
+    {
+        return LIBRARY_ERROR_NO_VIEW;
+    }
+
+    SetIOClass(FS_IO_NORMAL);
+
+    if (LoadSamples() != LIBRARY_SUCCESS)
+    {
+        return LIBRARY_ERROR_UNABLE_TO_READ;
+    }
+
+    // Keys are compared on as much of the prefix as they have; a longer one is checked against the titles
+    uint8_t key[LIBRARY_KEY_LEN];
+    uint32_t length = (uint32_t)strlen(prefix);
+    uint8_t whole = (length <= LIBRARY_KEY_LEN);
+
+    FoldInto(key, LIBRARY_KEY_LEN, prefix);
+    length = Min(length, LIBRARY_KEY_LEN);
+
+    // In RAM, the blocks it's between: the last sample before the prefix, the first one after it. A sample's only
+    // part of a key, so one that's the same as far as it goes could be either side.
+    uint32_t sampled = Min(length, LIBRARY_SEARCH_SAMPLE_KEY);
+    uint32_t samples = header->search_samples.length / LIBRARY_SEARCH_SAMPLE_KEY;
+    uint32_t low = 0;
+    uint32_t high = blocks;
+
+    for (uint32_t s = 0; s < samples; s++)
+    {
+        int order = memcmp(library.samples[s], key, sampled);
+
+        if (order < 0)
+        {
+            low = s * header->search_stride;
+        }
+        else if (order > 0)
+        {
+            high = Min(s * header->search_stride, blocks);
+            break;
+        }
+    }
+
+    // On the card, halving the blocks in between down to the last one that starts before the prefix (or the first
+    // one, if none does)
+    block_cursor_t cursor;
+
+    while (high - low > 1)
+    {
+        uint32_t middle = low + (high - low) / 2;
+
+        if (ReadBlock(middle) != LIBRARY_SUCCESS)
+        {
+            return LIBRARY_ERROR_UNABLE_TO_READ;
+        }
+
+        StartBlock(&cursor, library.block);
+
+        if (!NextInBlock(&cursor))
+        {
+            return LIBRARY_ERROR_UNABLE_TO_READ;
+        }
+
+        if (memcmp(cursor.key, key, length) < 0)
+        {
+            low = middle;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    // Then along from there: past what's before the prefix, and through what starts with it
+    for (uint32_t block = low; block < blocks; block++)
+    {
+        if (ReadBlock(block) != LIBRARY_SUCCESS)
+        {
+            return LIBRARY_ERROR_UNABLE_TO_READ;
+        }
+
+        StartBlock(&cursor, library.block);
+
+        while (NextInBlock(&cursor))
+        {
+            int order = memcmp(cursor.key, key, length);
+
+            if (order > 0)
+            {
+                return LIBRARY_SUCCESS;
+            }
+
+            if (order < 0 || (!whole && !TitleStartsWith(cursor.index, prefix)))
+            {
+                continue;
+            }
+
+            if (skip > 0)
+            {
+                skip--;
+            }
+            else if (*found < max)
+            {
+                indexes[(*found)++] = cursor.index;
+            }
+            else
+            {
+                return LIBRARY_SUCCESS;
+            }
+        }
+    }
+
+    return LIBRARY_SUCCESS;
+}
+
+/*
+ * Building
+ */
+
+static uint8_t IsTrack(const char *name)
+{
+    size_t length = strlen(name);
+
+    for (uint32_t i = 0; i < sizeof(TRACK_EXTENSIONS) / sizeof(TRACK_EXTENSIONS[0]); i++)
+    {
+        size_t extension = strlen(TRACK_EXTENSIONS[i]);
+
+        if (length <= extension)
+        {
+            continue;
+        }
+
+        uint32_t c = 0;
+
+        while (c < extension && Fold(name[length - extension + c]) == TRACK_EXTENSIONS[i][c])
+        {
+            c++;
+        }
+
+        if (c == extension)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+// The index and the build's files: they're in the root, and always different from the last time it was listed
+static uint8_t IsOwnFile(const char *name)
+{
+    for (uint32_t i = 0; i < NUM_BUILD_FILES; i++)
+    {
+        if (strcmp(name, BUILD_FILES[i].name) == 0)
+        {
+            return 1;
+        }
+    }
+
+    return strcmp(name, LIBRARY_INDEX_FILE) == 0 || strcmp(name, LIBRARY_RUNS_TEMP) == 0
+            || strcmp(name, LIBRARY_MERGE_TEMP) == 0;
+}
+
+static library_ret_t Write(file_t *file, const void *data, uint32_t length)
+{
+    if (length > 0 && library_fs->ops->WriteFile(file, data, length) != FS_SUCCESS)
+    {
+        return LIBRARY_ERROR_UNABLE_TO_WRITE;
+    }
+
+    return LIBRARY_SUCCESS;
+}
+
+// Zeros up to the next sector boundary, length being where the file is now
+static library_ret_t PadToSector(file_t *file, uint32_t length)
+{
+    static const uint8_t zeros[LIBRARY_SECTOR];
+
+    return Write(file, zeros, RoundUpToSector(length) - length);
+}
+
+// A string, or where the same one already is. Only artists and albums are looked for, as the last one of each.
+static library_ret_t WriteString(const char *string, char *last, uint32_t *last_at, uint32_t *offset)
+{
+    // Offset 0 is the empty string
+    if (string[0] == '\0')
+    {
+        *offset = 0;
+        return LIBRARY_SUCCESS;
+    }
+
+    if (last != NULL && strcmp(string, last) == 0)
+    {
+        *offset = *last_at;
+        return LIBRARY_SUCCESS;
+    }
+
+    uint32_t length = (uint32_t)strlen(string) + 1;
+
+    if (Write(&build.strings, string, length) != LIBRARY_SUCCESS)
+    {
+        return LIBRARY_ERROR_UNABLE_TO_WRITE;
+    }
+
+    *offset = build.strings_b;
+    build.strings_b += length;
+
+    if (last != NULL)
+    {
+        strcpy(last, string);
+        *last_at = *offset;
+    }
+
+    return LIBRARY_SUCCESS;
+}
+
+static library_ret_t WritePath(const char *path, uint32_t *group)
+{
+    uint32_t length = (uint32_t)strlen(path);
+    uint32_t shared = 0;
+
+    if (build.stats.tracks % LIBRARY_PATH_GROUP == 0)
+    {
+        build.group = build.paths_b;
+    }
+    else
+    {
+        while (shared < length && path[shared] == build.last_path[shared])
+        {
+            shared++;
+        }
+    }
+
+    uint8_t coded[2] = { (uint8_t)shared, (uint8_t)(length - shared) };
+
+    if (Write(&build.paths, coded, sizeof(coded)) != LIBRARY_SUCCESS
+            || Write(&build.paths, path + shared, length - shared) != LIBRARY_SUCCESS)
+    {
+        return LIBRARY_ERROR_UNABLE_TO_WRITE;
+    }
+
+    build.paths_b += sizeof(coded) + length - shared;
+    strcpy(build.last_path, path);
+    *group = build.group;
+
+    return LIBRARY_SUCCESS;
+}
+
+// The name of the folder up levels from the track (1: its own), or nothing if it's not that deep
+static void FolderName(const char *path, uint32_t up, char *name)
+{
+    const char *end = path + strlen(path);
+
+    // Back to the '/' after the folder's name
+    for (uint32_t level = 0; level < up; level++)
+    {
+        do
+        {
+            if (end == path)
+            {
+                name[0] = '\0';
+                return;
+            }
+
+            end--;
+        } while (*end != '/');
+    }
+
+    const char *start = end;
+
+    while (start > path && start[-1] != '/')
+    {
+        start--;
+    }
+
+    size_t length = Min((uint32_t)(end - start), CODEC_MAX_TAG - 1);
+    memcpy(name, start, length);
+    name[length] = '\0';
+}
+
+// Untagged tracks are named after their file, and usually sit in Artist/Album/ folders
+static void FillMissingTags(const char *path, codec_tags_t *tags)
+{
+    if (tags->title[0] == '\0')
+    {
+        const char *name = strrchr(path, '/');
+        const char *extension = strrchr(path, '.');
+
+        name = (name != NULL) ? name + 1 : path;
+        extension = (extension != NULL && extension > name) ? extension : name + strlen(name);
+
+        size_t length = Min((uint32_t)(extension - name), CODEC_MAX_TAG - 1);
+        memcpy(tags->title, name, length);
+        tags->title[length] = '\0';
+    }
+
+    if (tags->album[0] == '\0')
+    {
+        FolderName(path, 1, tags->album);
+    }
+
+    if (tags->artist[0] == '\0')
+    {
+        FolderName(path, 2, tags->artist);
+    }
+}
+
+// Lowercase (ASCII), zero-padded, into a key field
+static int CompareEntries(const void *a, const void *b)
+{
+    const sort_entry_t *x = (const sort_entry_t *)a;
+    const sort_entry_t *y = (const sort_entry_t *)b;
+    int order = memcmp(x->key, y->key, LIBRARY_KEY_LEN);
+
+    if (order != 0)
+    {
+        return order;
+    }
+
+    return (x->index > y->index) - (x->index < y->index);
+}
+
+// The artist view's key: artist, album, track number. The album view's: album, track number. The title view's: title.
+#define ARTIST_KEY_ARTIST 16
+#define ARTIST_KEY_ALBUM (LIBRARY_KEY_LEN - ARTIST_KEY_ARTIST - 2)
+#define KEY_TRACK_AT (LIBRARY_KEY_LEN - 2)
+
+// A track's sort entry for each view, from its tags while we have them
+static void MakeKeys(const codec_tags_t *tags, uint32_t index, sort_entry_t *keys)
+{
+    sort_entry_t *artist = &keys[LIBRARY_VIEW_ARTIST];
+    sort_entry_t *album = &keys[LIBRARY_VIEW_ALBUM];
+    sort_entry_t *title = &keys[LIBRARY_VIEW_TITLE];
+
+    FoldInto(artist->key, ARTIST_KEY_ARTIST, tags->artist);
+    FoldInto(artist->key + ARTIST_KEY_ARTIST, ARTIST_KEY_ALBUM, tags->album);
+    FoldInto(album->key, KEY_TRACK_AT, tags->album);
+    FoldInto(title->key, LIBRARY_KEY_LEN, tags->title);
+
+    // Big-endian, so it sorts as a number
+    artist->key[KEY_TRACK_AT] = album->key[KEY_TRACK_AT] = (uint8_t)(tags->track_number >> 8);
+    artist->key[KEY_TRACK_AT + 1] = album->key[KEY_TRACK_AT + 1] = (uint8_t)tags->track_number;
+
+    for (uint32_t view = 0; view < LIBRARY_NUM_VIEWS; view++)
+    {
+        keys[view].index = index;
+    }
+}
+
+// A track's path, tags (strings), record and sort keys. record has all but its path and strings filled in.
+static library_ret_t StoreTrack(const codec_tags_t *tags, record_t *record)
+{
+    sort_entry_t keys[LIBRARY_NUM_VIEWS];
+
+    if (WritePath(build.path, &record->path) != LIBRARY_SUCCESS
+            || WriteString(tags->title, NULL, NULL, &record->title) != LIBRARY_SUCCESS
+            || WriteString(tags->artist, build.last_artist, &build.last_artist_at, &record->artist) != LIBRARY_SUCCESS
+            || WriteString(tags->album, build.last_album, &build.last_album_at, &record->album) != LIBRARY_SUCCESS
+            || Write(&build.records, record, sizeof(*record)) != LIBRARY_SUCCESS)
+    {
+        return LIBRARY_ERROR_UNABLE_TO_WRITE;
+    }
+
+    MakeKeys(tags, build.stats.tracks, keys);
+
+    if (Write(&build.keys, keys, sizeof(keys)) != LIBRARY_SUCCESS)
+    {
+        return LIBRARY_ERROR_UNABLE_TO_WRITE;
+    }
+
+    build.stats.tracks++;
+
+    return LIBRARY_SUCCESS;
+}
+
+// One track: its header, then what's in it. A file we can't read or play is skipped, not an error.
+static library_ret_t AddTrack(const fs_entry_t *entry)
+{
+    const struct fs_operations *ops = library_fs->ops;
+    file_t file;
+
+    // Like Player_OpenTrack: as much of the header as the codec asks for, in the work buffer
+    // TODO: only WAV for now, so the metadata is a wav_metadata_t
+    wav_metadata_t metadata;
+    audio_format_t format;
+    uint8_t *header = build.work;
+    uint64_t header_offset = 0;
+    uint64_t offset = 0;
+    size_t header_read = 0;
+    size_t header_len = WAV_HEADER_LEN;
+    codec_ret_t parsed = CODEC_NEED_MORE;
+
+    if (ops->OpenFile(&file, build.path) != FS_SUCCESS)
+    {
+        build.stats.skipped++;
+        return LIBRARY_SUCCESS;
+    }
+
+    while (parsed == CODEC_NEED_MORE && header_len <= LIBRARY_MIN_WORK && offset + header_len <= entry->size)
+    {
+        if (offset != header_offset)
+        {
+            if (ops->SeekFile == NULL || ops->SeekFile(&file, offset) != FS_SUCCESS)
+            {
+                break;
+            }
+
+            header_offset = offset;
+            header_read = 0;
+        }
+
+        if (header_len <= header_read || ops->ReadFile(&file, header + header_read, header_len - header_read)
+                != FS_SUCCESS)
+        {
+            break;
+        }
+
+        header_read = header_len;
+        parsed = library_codec->ValidateHeader(header, &metadata, &offset, &header_len);
+    }
+
+    ops->CloseFile(&file);
+
+    if (parsed != CODEC_SUCCESS || library_codec->GetFormat(&metadata, &format) != CODEC_SUCCESS)
+    {
+        build.stats.skipped++;
+        return LIBRARY_SUCCESS;
+    }
+
+    codec_tags_t tags;
+    memset(&tags, 0, sizeof(tags));
+
+    // Only from a header that was read from the start: past a chunk too big to read, the tags go by the name
+    if (library_codec->ReadTags != NULL && header_offset == 0)
+    {
+        library_codec->ReadTags(header, header_read, &tags);
+    }
+
+    FillMissingTags(build.path, &tags);
+
+    record_t record;
+    memset(&record, 0, sizeof(record));
+
+    uint32_t bytes_per_s = format.sample_rate * Audio_BytesPerFrame(&format);
+
+    record.duration_ms = (bytes_per_s > 0) ? (uint32_t)((metadata.data_size * 1000) / bytes_per_s) : 0;
+    record.sample_rate = format.sample_rate;
+    record.modified = entry->modified;
+    record.track_number = tags.track_number;
+    record.channels = (uint8_t)format.channels;
+    record.bits_per_sample = (uint8_t)format.bits_per_sample;
+
+    return StoreTrack(&tags, &record);
+}
+
+// length bytes at offset in a section of the old index, through its window. Fewer if the section ends first.
+static library_ret_t ReadOld(uint32_t window, const section_t *section, uint32_t offset, void *data,
+        uint32_t length)
+{
+    old_window_t *old = &build.old[window];
+
+    if (offset + length > section->length)
+    {
+        if (offset >= section->length)
+        {
+            return LIBRARY_ERROR_UNABLE_TO_READ;
+        }
+
+        length = section->length - offset;
+    }
+
+    offset += section->offset;
+
+    if (old->length == 0 || offset < old->at || offset + length > old->at + old->length)
+    {
+        uint32_t end = section->offset + section->length;
+
+        // From the start of the sector it's in, if it fits
+        old->at = offset & ~(uint32_t)(LIBRARY_SECTOR - 1);
+        old->at = (offset + length > old->at + LIBRARY_OLD_WINDOW) ? offset : old->at;
+        old->length = Min(LIBRARY_OLD_WINDOW, end - old->at);
+
+        if (library_fs->ops->ReadFileFrom(&library.file, old->at, old->data, old->length) != FS_SUCCESS)
+        {
+            old->length = 0;
+            return LIBRARY_ERROR_UNABLE_TO_READ;
+        }
+    }
+
+    memcpy(data, old->data + (offset - old->at), length);
+
+    return LIBRARY_SUCCESS;
+}
+
+// A string of the old index's, always terminated
+static library_ret_t ReadOldString(uint32_t window, uint32_t offset, char *string)
+{
+    if (ReadOld(window, &library.header.strings, offset, string, CODEC_MAX_TAG) != LIBRARY_SUCCESS)
+    {
+        return LIBRARY_ERROR_UNABLE_TO_READ;
+    }
+
+    string[CODEC_MAX_TAG - 1] = '\0';
+
+    return LIBRARY_SUCCESS;
+}
+
+// A track in a folder that hasn't changed: what the old index has on it, without opening the file. If the old
+// index doesn't agree with the file after all, it's looked at like a new one.
+static library_ret_t ReuseTrack(uint32_t old_index, const fs_entry_t *entry)
+{
+    record_t record;
+    codec_tags_t tags;
+
+    memset(&tags, 0, sizeof(tags));
+
+    if (ReadOld(OLD_RECORDS, &library.header.records, old_index * (uint32_t)sizeof(record_t), &record,
+            sizeof(record)) != LIBRARY_SUCCESS || record.modified != entry->modified
+            || ReadOldString(OLD_TITLES, record.title, tags.title) != LIBRARY_SUCCESS
+            || ReadOldString(OLD_ARTISTS, record.artist, tags.artist) != LIBRARY_SUCCESS
+            || ReadOldString(OLD_ALBUMS, record.album, tags.album) != LIBRARY_SUCCESS)
+    {
+        return AddTrack(entry);
+    }
+
+    tags.track_number = record.track_number;
+    build.stats.reused++;
+
+    return StoreTrack(&tags, &record);
+}
+
+// path_len: the folder's path. 0 if it doesn't fit.
+static uint32_t AppendName(uint32_t path_len, const char *name)
+{
+    uint32_t separator = (path_len > 0) ? 1 : 0;
+    uint32_t length = (uint32_t)strlen(name);
+
+    if (path_len + separator + length >= LIBRARY_MAX_PATH)
+    {
+        return 0;
+    }
+
+    if (separator)
+    {
+        build.path[path_len] = '/';
+    }
+
+    memcpy(build.path + path_len + separator, name, length + 1);
+
+    return path_len + separator + length;
+}
+
+// What's in the folder at build.path, summed up, and how many of its entries are tracks and folders
+static library_ret_t ListFolder(fs_dir_t *dir, folder_t *folder, uint32_t *tracks, uint32_t *subfolders)
+{
+    const struct fs_operations *ops = library_fs->ops;
+    fs_entry_t *entry = &build.entry;
+    uint32_t crc = CRC32_INIT;
+    fs_ret_t found;
+
+    *tracks = 0;
+    *subfolders = 0;
+
+    for (found = ops->FindFirst(dir, entry, build.path, "*"); found == FS_SUCCESS && entry->name[0] != '\0';
+            found = ops->FindNext(dir, entry))
+    {
+        if (entry->hidden || (build.path[0] == '\0' && IsOwnFile(entry->name)))
+        {
+            continue;
+        }
+
+        folder->entries++;
+        crc = CRC32_Update(crc, entry->name, strlen(entry->name) + 1);
+        crc = CRC32_Update(crc, &entry->size, sizeof(entry->size));
+        crc = CRC32_Update(crc, &entry->modified, sizeof(entry->modified));
+        crc = CRC32_Update(crc, &entry->is_dir, sizeof(entry->is_dir));
+
+        if (entry->is_dir)
+        {
+            (*subfolders)++;
+        }
+        else if (IsTrack(entry->name))
+        {
+            (*tracks)++;
+        }
+    }
+
+    ops->CloseDir(dir);
+    folder->listing_crc = crc;
+
+    return (found == FS_SUCCESS) ? LIBRARY_SUCCESS : LIBRARY_ERROR_UNABLE_TO_READ;
+}
+
+// The old index's record of this folder, if it has one. Where the last one was found, then the one after it, is
+// nearly always it: only new folders get looked for all the way round.
+static uint8_t FindOldFolder(const folder_t *folder, folder_t *old)
+{
+    const section_t *folders = &library.header.folders;
+    uint32_t count = folders->length / sizeof(folder_t);
+
+    for (uint32_t tried = 0; build.updating && tried < count; tried++)
+    {
+        uint32_t i = (build.old_cursor + tried) % count;
+
+        if (ReadOld(OLD_FOLDERS, folders, i * (uint32_t)sizeof(folder_t), old, sizeof(*old)) != LIBRARY_SUCCESS)
+        {
+            return 0;
+        }
+
+        if (old->path_crc == folder->path_crc && old->path_len == folder->path_len)
+        {
+            build.old_cursor = i + 1;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * The folder at build.path (path_len long): listed once to see whether it's changed, then again for its tracks, which
+ * are taken from the old index if it hasn't. Then, if it has subfolders, dir is left open on its first entry (in
+ * build.entry) for Walk to go through them; if not, build.entry is empty.
+ */
+static library_ret_t ScanFolder(fs_dir_t *dir, uint32_t path_len, uint32_t modified)
+{
+    const struct fs_operations *ops = library_fs->ops;
+    fs_entry_t *entry = &build.entry;
+    library_ret_t res = LIBRARY_SUCCESS;
+    folder_t folder;
+    folder_t old;
+    uint32_t tracks;
+    uint32_t subfolders;
+
+    memset(&folder, 0, sizeof(folder));
+    folder.path_crc = CRC32_Update(CRC32_INIT, build.path, path_len);
+    folder.path_len = (uint16_t)path_len;
+    folder.modified = modified;
+
+    if (ListFolder(dir, &folder, &tracks, &subfolders) != LIBRARY_SUCCESS)
+    {
+        return LIBRARY_ERROR_UNABLE_TO_READ;
+    }
+
+    // The timestamp alone won't do: FAT doesn't update a folder's when what's in it changes (FatFs never does)
+    uint8_t unchanged = FindOldFolder(&folder, &old) && old.modified == folder.modified
+            && old.entries == folder.entries && old.listing_crc == folder.listing_crc && old.tracks == tracks
+            && old.skipped == 0;
+
+    uint32_t skipped = build.stats.skipped;
+
+    build.stats.dirs++;
+    build.stats.changed_dirs += !unchanged;
+    folder.first_track = build.stats.tracks;
+
+    if (tracks > 0)
+    {
+        uint32_t k = 0;
+        fs_ret_t found;
+
+        for (found = ops->FindFirst(dir, entry, build.path, "*");
+                found == FS_SUCCESS && entry->name[0] != '\0' && res == LIBRARY_SUCCESS;
+                found = ops->FindNext(dir, entry))
+        {
+            if (entry->hidden || entry->is_dir || !IsTrack(entry->name))
+            {
+                continue;
+            }
+
+            if (AppendName(path_len, entry->name) == 0)
+            {
+                build.stats.skipped++;
+                continue;
+            }
+
+            res = unchanged ? ReuseTrack(old.first_track + k++, entry) : AddTrack(entry);
+            build.path[path_len] = '\0';
+        }
+
+        ops->CloseDir(dir);
+
+        if (res == LIBRARY_SUCCESS && found != FS_SUCCESS)
+        {
+            res = LIBRARY_ERROR_UNABLE_TO_READ;
+        }
+    }
+
+    folder.tracks = build.stats.tracks - folder.first_track;
+    folder.skipped = (uint16_t)Min(build.stats.skipped - skipped, UINT16_MAX);
+
+    if (res == LIBRARY_SUCCESS)
+    {
+        res = Write(&build.folders, &folder, sizeof(folder));
+    }
+
+    if (res != LIBRARY_SUCCESS)
+    {
+        return res;
+    }
+
+    if (subfolders > 0)
+    {
+        return (ops->FindFirst(dir, entry, build.path, "*") == FS_SUCCESS) ? LIBRARY_SUCCESS
+                : LIBRARY_ERROR_UNABLE_TO_READ;
+    }
+
+    entry->name[0] = '\0';
+
+    return LIBRARY_SUCCESS;
+}
+
+/*
+ * Depth first, a directory open per level. A folder's tracks come first, in directory order, then its subfolders':
+ * that's the order tracks are numbered in, and the paths front-coded in.
+ */
+static library_ret_t Walk(void)
+{
+    const struct fs_operations *ops = library_fs->ops;
+    fs_entry_t *entry = &build.entry;
+
+    struct
+    {
+        fs_dir_t dir;
+        uint32_t path_len;
+    } stack[LIBRARY_MAX_DEPTH];
+
+    uint32_t depth = 0;
+
+    build.path[0] = '\0';
+    stack[0].path_len = 0;
+
+    library_ret_t res = ScanFolder(&stack[0].dir, 0, 0);
+
+    while (res == LIBRARY_SUCCESS)
+    {
+        // This folder's done: back to the one it's in
+        if (entry->name[0] == '\0')
+        {
+            ops->CloseDir(&stack[depth].dir);
+
+            if (depth == 0)
+            {
+                return LIBRARY_SUCCESS;
+            }
+
+            depth--;
+            build.path[stack[depth].path_len] = '\0';
+        }
+        else if (entry->is_dir && !entry->hidden)
+        {
+            uint32_t path_len = AppendName(stack[depth].path_len, entry->name);
+
+            if (path_len > 0 && depth + 1 < LIBRARY_MAX_DEPTH)
+            {
+                depth++;
+                stack[depth].path_len = path_len;
+                res = ScanFolder(&stack[depth].dir, path_len, entry->modified);
+                continue;
+            }
+
+            build.stats.too_deep += (path_len > 0);
+            build.path[stack[depth].path_len] = '\0';
+        }
+
+        if (ops->FindNext(&stack[depth].dir, entry) != FS_SUCCESS)
+        {
+            res = LIBRARY_ERROR_UNABLE_TO_READ;
+        }
+    }
+
+    for (uint32_t level = 0; level <= depth; level++)
+    {
+        ops->CloseDir(&stack[level].dir);
+    }
+
+    return res;
+}
+
+// A temporary file onto the end of the index, then gone. length: the index's, updated.
+static library_ret_t Append(file_t *temp, char *filename, uint32_t bytes, uint32_t *length)
+{
+    const struct fs_operations *ops = library_fs->ops;
+    uint32_t chunk = Min((uint32_t)build.work_size, LIBRARY_COPY_CHUNK);
+    library_ret_t res = LIBRARY_SUCCESS;
+
+    // Closed and opened again to read it from the start
+    if (ops->CloseFile(temp) != FS_SUCCESS || ops->OpenFile(temp, filename) != FS_SUCCESS)
+    {
+        return LIBRARY_ERROR_UNABLE_TO_READ;
+    }
+
+    for (uint32_t done = 0; done < bytes && res == LIBRARY_SUCCESS; done += chunk)
+    {
+        uint32_t piece = Min(chunk, bytes - done);
+
+        if (ops->ReadFile(temp, build.work, piece) != FS_SUCCESS)
+        {
+            res = LIBRARY_ERROR_UNABLE_TO_READ;
+        }
+        else
+        {
+            res = Write(&build.index, build.work, piece);
+        }
+    }
+
+    ops->CloseFile(temp);
+    ops->RemoveFile(filename);
+
+    if (res == LIBRARY_SUCCESS)
+    {
+        res = PadToSector(&build.index, *length + bytes);
+    }
+
+    *length = RoundUpToSector(*length + bytes);
+
+    return res;
+}
+
+// Every stride'th block's first key: as many as there's room for, so when it's full, every other one goes and the
+// stride doubles
+static void AddSample(uint32_t block, const uint8_t *key)
+{
+    if (block % build.stride != 0)
+    {
+        return;
+    }
+
+    if (build.num_samples == LIBRARY_SEARCH_SAMPLES)
+    {
+        for (uint32_t i = 0; i < LIBRARY_SEARCH_SAMPLES / 2; i++)
+        {
+            memcpy(build.samples[i], build.samples[2 * i], LIBRARY_SEARCH_SAMPLE_KEY);
+        }
+
+        build.num_samples = LIBRARY_SEARCH_SAMPLES / 2;
+        build.stride *= 2;
+    }
+
+    memcpy(build.samples[build.num_samples++], key, LIBRARY_SEARCH_SAMPLE_KEY);
+}
+
+static library_ret_t WriteBlock(void)
+{
+    uint16_t entries = (uint16_t)build.block_entries;
+
+    memcpy(build.block, &entries, sizeof(entries));
+
+    if (Write(&build.index, build.block, LIBRARY_SECTOR) != LIBRARY_SUCCESS)
+    {
+        return LIBRARY_ERROR_UNABLE_TO_WRITE;
+    }
+
+    build.blocks++;
+    build.block_entries = 0;
+    build.block_used = sizeof(entries);
+    memset(build.block, 0, sizeof(build.block));
+
+    return LIBRARY_SUCCESS;
+}
+
+static void StartSearch(void)
+{
+    build.blocks = 0;
+    build.block_entries = 0;
+    build.block_used = sizeof(uint16_t);
+    build.last_key_length = 0;
+    build.num_samples = 0;
+    build.stride = 1;
+    memset(build.block, 0, sizeof(build.block));
+}
+
+// The title view's entries, in order, make the search section: front-coded, as many as fit in a block, none
+// straddling two
+static library_ret_t AddToSearch(const sort_entry_t *sorted)
+{
+    const uint8_t *key = sorted->key;
+    uint32_t key_length = 0;
+    uint32_t shared = 0;
+
+    while (key_length < LIBRARY_KEY_LEN && key[key_length] != 0)
+    {
+        key_length++;
+    }
+
+    while (shared < key_length && shared < build.last_key_length && key[shared] == build.last_key[shared])
+    {
+        shared++;
+    }
+
+    // A block's first key is whole
+    if (build.block_entries > 0
+            && build.block_used + 2 + (key_length - shared) + sizeof(sorted->index) > LIBRARY_SECTOR)
+    {
+        if (WriteBlock() != LIBRARY_SUCCESS)
+        {
+            return LIBRARY_ERROR_UNABLE_TO_WRITE;
+        }
+    }
+
+    if (build.block_entries == 0)
+    {
+        shared = 0;
+        AddSample(build.blocks, key);
+    }
+
+    uint8_t *entry = build.block + build.block_used;
+
+    entry[0] = (uint8_t)shared;
+    entry[1] = (uint8_t)(key_length - shared);
+    memcpy(entry + 2, key + shared, key_length - shared);
+    memcpy(entry + 2 + entry[1], &sorted->index, sizeof(sorted->index));
+
+    build.block_used += 2 + entry[1] + sizeof(sorted->index);
+    build.block_entries++;
+    memcpy(build.last_key, key, LIBRARY_KEY_LEN);
+    build.last_key_length = key_length;
+
+    return LIBRARY_SUCCESS;
+}
+
+// The last block, then the samples
+static library_ret_t FinishSearch(index_header_t *header, uint32_t *length)
+{
+    if (build.block_entries > 0 && WriteBlock() != LIBRARY_SUCCESS)
+    {
+        return LIBRARY_ERROR_UNABLE_TO_WRITE;
+    }
+
+    header->search.offset = *length;
+    header->search.length = build.blocks * LIBRARY_SECTOR;
+    *length += header->search.length;
+
+    header->search_samples.offset = *length;
+    header->search_samples.length = build.num_samples * LIBRARY_SEARCH_SAMPLE_KEY;
+    header->search_stride = build.stride;
+
+    if (Write(&build.index, build.samples, header->search_samples.length) != LIBRARY_SUCCESS
+            || PadToSector(&build.index, *length + header->search_samples.length) != LIBRARY_SUCCESS)
+    {
+        return LIBRARY_ERROR_UNABLE_TO_WRITE;
+    }
+
+    *length = RoundUpToSector(*length + header->search_samples.length);
+
+    build.stats.search_b = header->search.length + header->search_samples.length;
+
+    return LIBRARY_SUCCESS;
+}
+
+// The view's sort entries (every track's) sorted: in the work buffer if they fit, else with the card's help
+// (extsort.h). The title view's go through the search section first.
+static library_ret_t SortView(library_view_t view, uint32_t tracks)
+{
+    const struct fs_operations *ops = library_fs->ops;
+    sort_entry_t keys[LIBRARY_NUM_VIEWS];
+    extsort_ret_t res;
+
+    if (ExtSort_Init(&build.sort, library_fs, LIBRARY_RUNS_TEMP, LIBRARY_MERGE_TEMP, sizeof(sort_entry_t),
+            CompareEntries, build.work, build.work_size) != EXTSORT_SUCCESS)
+    {
+        return LIBRARY_ERROR_WORK_TOO_SMALL;
+    }
+
+    // From the start, in order: small reads, but out of FatFs' sector buffer
+    if (ops->OpenFile(&build.keys, LIBRARY_KEYS_TEMP) != FS_SUCCESS)
+    {
+        return LIBRARY_ERROR_UNABLE_TO_READ;
+    }
+
+    for (uint32_t i = 0; i < tracks; i++)
+    {
+        if (ops->ReadFile(&build.keys, keys, sizeof(keys)) != FS_SUCCESS)
+        {
+            ops->CloseFile(&build.keys);
+            return LIBRARY_ERROR_UNABLE_TO_READ;
+        }
+
+        if (ExtSort_Add(&build.sort, &keys[view]) != EXTSORT_SUCCESS)
+        {
+            ops->CloseFile(&build.keys);
+            return LIBRARY_ERROR_UNABLE_TO_WRITE;
+        }
+    }
+
+    ops->CloseFile(&build.keys);
+
+    res = ExtSort_Finish(&build.sort);
+
+    return (res == EXTSORT_SUCCESS) ? LIBRARY_SUCCESS
+            : (res == EXTSORT_ERROR_UNABLE_TO_READ) ? LIBRARY_ERROR_UNABLE_TO_READ : LIBRARY_ERROR_UNABLE_TO_WRITE;
+}
+
+// Sorted, then just the track numbers written out in that order
+static library_ret_t WriteView(library_view_t view, index_header_t *header, uint32_t *length)
+{
+    uint32_t tracks = header->tracks;
+    library_ret_t res = SortView(view, tracks);
+    extsort_ret_t sorted = EXTSORT_SUCCESS;
+    sort_entry_t entry;
+
+    // The titles are searched, too: a pass of their own through the sorted entries
+    if (res == LIBRARY_SUCCESS && view == LIBRARY_VIEW_TITLE)
+    {
+        StartSearch();
+
+        while (res == LIBRARY_SUCCESS && (sorted = ExtSort_Next(&build.sort, &entry)) == EXTSORT_SUCCESS)
+        {
+            res = AddToSearch(&entry);
+        }
+
+        if (res == LIBRARY_SUCCESS && (sorted != EXTSORT_END || ExtSort_Rewind(&build.sort) != EXTSORT_SUCCESS))
+        {
+            res = LIBRARY_ERROR_UNABLE_TO_READ;
+        }
+
+        if (res == LIBRARY_SUCCESS)
+        {
+            res = FinishSearch(header, length);
+        }
+    }
+
+    header->views[view].offset = *length;
+    header->views[view].length = tracks * (uint32_t)sizeof(uint32_t);
+
+    // A sector of numbers at a time, through the search's block buffer
+    uint32_t *order = (uint32_t *)build.block;
+    uint32_t count = 0;
+    uint32_t written = 0;
+
+    while (res == LIBRARY_SUCCESS && (sorted = ExtSort_Next(&build.sort, &entry)) == EXTSORT_SUCCESS)
+    {
+        order[count++] = entry.index;
+
+        if (count == LIBRARY_SECTOR / sizeof(uint32_t))
+        {
+            res = Write(&build.index, order, count * (uint32_t)sizeof(uint32_t));
+            written += count;
+            count = 0;
+        }
+    }
+
+    if (res == LIBRARY_SUCCESS && (sorted != EXTSORT_END || written + count != tracks))
+    {
+        res = LIBRARY_ERROR_UNABLE_TO_READ;
+    }
+
+    if (res == LIBRARY_SUCCESS && (Write(&build.index, order, count * (uint32_t)sizeof(uint32_t)) != LIBRARY_SUCCESS
+            || PadToSector(&build.index, *length + header->views[view].length) != LIBRARY_SUCCESS))
+    {
+        res = LIBRARY_ERROR_UNABLE_TO_WRITE;
+    }
+
+    extsort_stats_t stats;
+
+    ExtSort_Close(&build.sort, &stats);
+    build.stats.sort_runs += stats.runs;
+    build.stats.sort_passes += stats.passes;
+
+    if (res == LIBRARY_SUCCESS)
+    {
+        *length = RoundUpToSector(*length + header->views[view].length);
+    }
+
+    return res;
+}
+
+static library_ret_t BuildIndex(index_header_t *header)
+{
+    const struct fs_operations *ops = library_fs->ops;
+    library_ret_t res;
+    uint32_t length = LIBRARY_SECTOR;
+    static const char empty = '\0';
+
+    // The strings start with the empty one
+    if (Write(&build.strings, &empty, sizeof(empty)) != LIBRARY_SUCCESS)
+    {
+        return LIBRARY_ERROR_UNABLE_TO_WRITE;
+    }
+
+    build.strings_b = sizeof(empty);
+
+    res = Walk();
+
+    if (res != LIBRARY_SUCCESS)
+    {
+        return res;
+    }
+
+    // The header's sector, invalid until the very end. Then each section in turn.
+    if (Write(&build.index, header, sizeof(*header)) != LIBRARY_SUCCESS
+            || PadToSector(&build.index, sizeof(*header)) != LIBRARY_SUCCESS)
+    {
+        return LIBRARY_ERROR_UNABLE_TO_WRITE;
+    }
+
+    header->tracks = build.stats.tracks;
+    header->strings.offset = length;
+    header->strings.length = build.strings_b;
+
+    res = Append(&build.strings, LIBRARY_STRINGS_TEMP, build.strings_b, &length);
+
+    if (res != LIBRARY_SUCCESS)
+    {
+        return res;
+    }
+
+    header->paths.offset = length;
+    header->paths.length = build.paths_b;
+
+    res = Append(&build.paths, LIBRARY_PATHS_TEMP, build.paths_b, &length);
+
+    if (res != LIBRARY_SUCCESS)
+    {
+        return res;
+    }
+
+    header->records.offset = length;
+    header->records.length = build.stats.tracks * (uint32_t)sizeof(record_t);
+
+    res = Append(&build.records, LIBRARY_RECORDS_TEMP, header->records.length, &length);
+
+    if (res != LIBRARY_SUCCESS)
+    {
+        return res;
+    }
+
+    header->folders.offset = length;
+    header->folders.length = build.stats.dirs * (uint32_t)sizeof(folder_t);
+
+    res = Append(&build.folders, LIBRARY_FOLDERS_TEMP, header->folders.length, &length);
+
+    if (res != LIBRARY_SUCCESS)
+    {
+        return res;
+    }
+
+    // Read back once per view
+    if (ops->CloseFile(&build.keys) != FS_SUCCESS)
+    {
+        return LIBRARY_ERROR_UNABLE_TO_WRITE;
+    }
+
+    if (header->tracks > 0)
+    {
+        for (library_view_t view = 0; view < LIBRARY_NUM_VIEWS && res == LIBRARY_SUCCESS; view++)
+        {
+            res = WriteView(view, header, &length);
+            build.stats.views += (res == LIBRARY_SUCCESS);
+        }
+    }
+
+    ops->RemoveFile(LIBRARY_KEYS_TEMP);
+
+    if (res != LIBRARY_SUCCESS)
+    {
+        return res;
+    }
+
+    header->magic = LIBRARY_MAGIC;
+    header->version = LIBRARY_VERSION;
+    header->record_size = sizeof(record_t);
+    header->volume_serial = library_fs->volume_serial;
+    header->crc = HeaderCRC(header);
+
+    if (ops->WriteFileAt(&build.index, 0, header, sizeof(*header)) != FS_SUCCESS)
+    {
+        return LIBRARY_ERROR_UNABLE_TO_WRITE;
+    }
+
+    build.stats.index_b = length;
+    build.stats.strings_b = build.strings_b;
+    build.stats.paths_b = build.paths_b;
+
+    return LIBRARY_SUCCESS;
+}
+
+static void RemoveBuildFiles(uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (BUILD_FILES[i].file->handle != NULL)
+        {
+            library_fs->ops->CloseFile(BUILD_FILES[i].file);
+        }
+
+        library_fs->ops->RemoveFile(BUILD_FILES[i].name);
+    }
+}
+
+static library_ret_t Build(void *work, size_t work_size, library_stats_t *stats, uint8_t update)
+{
+    if (work == NULL)
+    {
+        return LIBRARY_ERROR_NULL_PARAMETER;
+    }
+
+    if (library_fs == NULL)
+    {
+        return LIBRARY_ERROR_NOT_INITIALIZED;
+    }
+
+    if (work_size < LIBRARY_MIN_WORK)
+    {
+        return LIBRARY_ERROR_WORK_TOO_SMALL;
+    }
+
+    const struct fs_operations *ops = library_fs->ops;
+
+    if (ops->FindFirst == NULL || ops->FindNext == NULL || ops->CloseDir == NULL || ops->CreateFile == NULL
+            || ops->WriteFile == NULL || ops->WriteFileAt == NULL || ops->ReadFileFrom == NULL
+            || ops->RemoveFile == NULL || ops->RenameFile == NULL)
+    {
+        return LIBRARY_ERROR_UNSUPPORTED;
+    }
+
+    memset(&build, 0, sizeof(build));
+    build.work = (uint8_t *)work;
+    build.work_size = work_size;
+
+    // The index there is stays open, and stays the index until the new one's done. Only one of this card is any use.
+    build.updating = update && Library_Open() == LIBRARY_SUCCESS
+            && library.header.volume_serial == library_fs->volume_serial;
+
+    if (!build.updating)
+    {
+        Library_Close();
+    }
+
+    // Background work: playback, if there is any, goes first
+    SetIOClass(FS_IO_IDLE);
+
+    uint32_t created = 0;
+
+    while (created < NUM_BUILD_FILES && ops->CreateFile(BUILD_FILES[created].file, BUILD_FILES[created].name)
+            == FS_SUCCESS)
+    {
+        created++;
+    }
+
+    index_header_t header;
+    memset(&header, 0, sizeof(header));
+
+    library_ret_t res = (created == NUM_BUILD_FILES) ? BuildIndex(&header) : LIBRARY_ERROR_UNABLE_TO_WRITE;
+
+    if (res == LIBRARY_SUCCESS && ops->CloseFile(&build.index) != FS_SUCCESS)
+    {
+        res = LIBRARY_ERROR_UNABLE_TO_WRITE;
+    }
+
+    // The new index in place of the old one. In between, there's none: the next boot builds it again.
+    Library_Close();
+
+    if (res == LIBRARY_SUCCESS)
+    {
+        ops->RemoveFile(LIBRARY_INDEX_FILE);
+
+        if (ops->RenameFile(LIBRARY_INDEX_TEMP, LIBRARY_INDEX_FILE) != FS_SUCCESS)
+        {
+            res = LIBRARY_ERROR_UNABLE_TO_WRITE;
+        }
+    }
+
+    // Append closes and removes the temporary files it's done with; after a failure, the rest
+    if (res != LIBRARY_SUCCESS)
+    {
+        RemoveBuildFiles(created);
+    }
+
+    SetIOClass(FS_IO_NORMAL);
+
+    if (stats != NULL)
+    {
+        *stats = build.stats;
+    }
+
+    return (res == LIBRARY_SUCCESS) ? Library_Open() : res;
+}
+
+library_ret_t Library_Build(void *work, size_t work_size, library_stats_t *stats)
+{
+    return Build(work, work_size, stats, 0);
+}
+
+library_ret_t Library_Update(void *work, size_t work_size, library_stats_t *stats)
+{
+    return Build(work, work_size, stats, 1);
+}
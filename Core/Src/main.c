@@ -23,18 +23,62 @@
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
 #include <stdio.h>
-
+#include <string.h>
+
+#include "blk.h"
+#include "bookmark.h"
+#include "cycles.h"
+#include "depth.h"
+#include "i2s.h"
+#include "internal_flash.h"
+#include "library.h"
+#include "meter.h"
 #include "microsd.h"
+#include "player.h"
+#include "ring.h"
+#include "settings.h"
+#include "shuffle.h"
 #include "wav.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
 /* USER CODE BEGIN PTD */
-
+// What plays once a track ends, kept in the settings store (SETTINGS_KEY_PLAY_MODE) across power cycles
+typedef enum
+{
+    PLAY_MODE_IN_ORDER = 0,             // the artist view's order, round and round
+    PLAY_MODE_SHUFFLE                   // a shuffle over the same positions (shuffle.h)
+} play_mode_t;
 /* USER CODE END PTD */
 
 /* Private define ------------------------------------------------------------*/
 /* USER CODE BEGIN PD */
+// PCM queued between the decoder and the audio sink (must be a power of two, see ring.h).
+// This is the most the player will use: with a card profile it only takes what the card's stalls need.
+// Also the work buffer for the card benchmark, which needs 32 KiB.
+// It's also the ceiling on this board: of the 96 KiB of SRAM, the other modules' statics take ~48 KiB (the largest
+// FatFs's 12 KiB directory cache pool, _FS_DIRCACHE, and the block layer's 8 KiB of staging) and the linker script
+// keeps 1.5 KiB for the stack and heap, which leaves ~13 KiB past this ring: not enough for the next power of two.
+// 32 KiB lasts ~170 ms at 48 kHz 16-bit stereo, so a card whose stalls need more is capped (DumpStats says so).
+#define OUTPUT_RING_SIZE 32768
+
+// What the ring and the block layer's read-ahead may use between them, and the underruns to size them for
+// (see depth.h). The whole of both buffers by default: lower it to leave the rest of the ring buffer alone.
+#define PLAYBACK_BUDGET (OUTPUT_RING_SIZE + BLK_STAGING_BLOCKS * BLK_BLOCK_SIZE)
+#define PLAYBACK_UNDERRUN_PPM DEPTH_DEFAULT_TARGET_PPM
+
+// How often the buffer depth stats go out over the UART
+#define STATS_PERIOD_MS 10000
+
+// How often where we are in the track is saved to the card, to resume from after a power cycle (see bookmark.h)
+#define BOOKMARK_PERIOD_MS 5000
+
+// Where the bookmark keeps the play order's place alongside the track (see bookmark_t's user words)
+#define BOOKMARK_WORD_POSITION 0
+#define BOOKMARK_WORD_SHUFFLE_SEED 1
+
+// The user button (B1) has to stay put this long for a press to count
+#define BUTTON_DEBOUNCE_MS 50
 
 /* USER CODE END PD */
 
@@ -51,6 +95,24 @@ UART_HandleTypeDef huart2;
 /* USER CODE BEGIN PV */
 fs_driver_t *fs;
 const codec_t *codec;
+const audio_driver_t *audio;
+
+// Word-aligned: the player converts straight into it and the sink may take 32-bit words
+static uint8_t output_ring_buffer[OUTPUT_RING_SIZE] __attribute__((aligned(4)));
+
+// What's played at boot: the library's first track, or test.wav if there's no library
+static char track_path[LIBRARY_MAX_PATH] = "test.wav";
+
+// The bookmark resumed from at boot, then the one being saved
+static bookmark_t bookmark;
+static uint8_t bookmark_open;
+
+// The play order: the mode, and the playing track's position in the artist view, which the shuffle permutes
+static uint8_t play_mode = PLAY_MODE_IN_ORDER;
+static uint32_t play_position;
+static uint32_t shuffle_seed;
+static shuffle_t shuffle;
+static ring_t output_ring;
 /* USER CODE END PV */
 
 /* Private function prototypes -----------------------------------------------*/
@@ -80,6 +142,212 @@ int _write(int file, char *data, int len)
     HAL_UART_Transmit(&huart2, (uint8_t*) data, len, HAL_MAX_DELAY);
     return len;
 }
+
+/*
+ * Runs while FatFs waits on the card (see Blk_SetYield), so transfers and write programming don't stall everything.
+ * Only work that stays away from the file system: we're in the middle of an f_read/f_write.
+ * The sink keeps being fed from the ring, which is what makes the ring's depth the real slack for a slow read.
+ */
+static void WhileCardBusy(void)
+{
+    Player_Pump();
+    Meter_Process();
+}
+
+/*
+ * The buffer depth stats (see depth.h) over the UART, every STATS_PERIOD_MS: where the ring and read-ahead stand,
+ * the read latency histogram, how the block layer got on with the buffers it was given, the meter's share of the
+ * CPU, and the last decisions. printf blocks, ~7 ms a line at 115200 baud, so one line per main loop pass, with
+ * the player topping up the ring in between. All from a snapshot taken at the start.
+ */
+static void DumpStats(void)
+{
+    static depth_stats_t stats;
+    static blk_stats_t blk;
+    static meter_snapshot_t meter;
+    static uint32_t line;       // next line to print, 0 = not dumping
+    static uint32_t last_dump;
+
+    if (line == 0)
+    {
+        if (HAL_GetTick() - last_dump < STATS_PERIOD_MS || Depth_GetStats(&stats) != DEPTH_SUCCESS)
+        {
+            return;
+        }
+
+        Blk_GetStats(&blk);
+
+        if (Meter_GetSnapshot(&meter) != METER_SUCCESS)
+        {
+            meter.blocks = 0;
+        }
+
+        last_dump = HAL_GetTick();
+        line = 1;
+    }
+
+    if (line == 1)
+    {
+        printf("depth: ring %lu B (needs %lu%s), read-ahead %lu B, sized for %lu us, risk %lu ppm\r\n", stats.ring_b,
+                stats.needed_b, (stats.needed_b > stats.ring_b) ? ", capped" : "", stats.readahead_b, stats.latency_us,
+                stats.risk_ppm);
+    }
+    else if (line == 2)
+    {
+        printf("depth: %lu reads, max %lu us, %lu grows, %lu shrinks, %lu read-ahead changes, %lu capped\r\n",
+                stats.samples, stats.max_us, stats.grows, stats.shrinks, stats.readahead_changes, stats.caps);
+    }
+    else if (line == 3)
+    {
+        printf("depth: histogram (us: reads):");
+
+        for (uint32_t b = 0; b < DEPTH_BUCKETS; b++)
+        {
+            if (stats.histogram[b] > 0)
+            {
+                printf(" %lu: %lu", 1UL << b, stats.histogram[b]);
+            }
+        }
+
+        printf("\r\n");
+    }
+    else if (line == 4)
+    {
+        printf("blk: %lu transfers, %lu straight to the caller's buffer, %lu bounced for alignment (%lu blocks)\r\n",
+                blk.transfers, blk.aligned, blk.bounced, blk.bounced_blocks);
+    }
+    else if (line == 5)
+    {
+        printf("meter: %lu blocks (%lu dropped), %lu cycles a block on average, %lu at most, %lu.%lu%% of the CPU "
+                "on average, %lu.%lu%% at most\r\n", meter.blocks, meter.dropped, meter.avg_cycles, meter.max_cycles,
+                meter.avg_cpu_permille / 10, meter.avg_cpu_permille % 10, meter.max_cpu_permille / 10,
+                meter.max_cpu_permille % 10);
+    }
+    else if (line - 6 < stats.logged)
+    {
+        const depth_log_entry_t *entry = &stats.log[line - 6];
+
+        printf("depth: read %lu: %s, ring %lu B, read-ahead %lu B (%lu us)\r\n", entry->sample,
+                Depth_DecisionName(entry->decision), entry->ring_b, entry->readahead_b, entry->latency_us);
+    }
+
+    line = (line < 5 || line - 5 < stats.logged) ? line + 1 : 0;
+}
+
+/*
+ * Where we are in the track, to the card every BOOKMARK_PERIOD_MS while it plays. A sector write at most, and
+ * nothing at all if it hasn't moved since the last one (BOOKMARK_UNCHANGED).
+ */
+static void SaveBookmark(void)
+{
+    static uint32_t last_save;
+
+    if (!bookmark_open || !Player_IsPlaying() || HAL_GetTick() - last_save < BOOKMARK_PERIOD_MS)
+    {
+        return;
+    }
+
+    last_save = HAL_GetTick();
+
+    if (Player_GetPosition(&bookmark.frame) != PLAYER_SUCCESS)
+    {
+        return;
+    }
+
+    memcpy(bookmark.path, track_path, sizeof(bookmark.path));
+    bookmark.user[BOOKMARK_WORD_POSITION] = play_position;
+    bookmark.user[BOOKMARK_WORD_SHUFFLE_SEED] = shuffle_seed;
+
+    if (Bookmark_Save(&bookmark) < BOOKMARK_SUCCESS)
+    {
+        printf("Unable to save the bookmark\r\n");
+    }
+}
+
+// The library's track at position in the play order: the artist view's, or walk order without one
+static uint32_t TrackAt(uint32_t position)
+{
+    uint32_t index;
+
+    if (Library_GetViewEntry(LIBRARY_VIEW_ARTIST, position, &index) != LIBRARY_SUCCESS)
+    {
+        index = position;
+    }
+
+    return index;
+}
+
+// Carry on from position: in shuffle, the shuffle is keyed by shuffle_seed and picks up from wherever it has position
+static void SeekPlayOrder(uint32_t position)
+{
+    play_position = position;
+
+    if (play_mode == PLAY_MODE_SHUFFLE && (Shuffle_Init(&shuffle, Library_Count(), shuffle_seed) != SHUFFLE_SUCCESS
+            || Shuffle_Seek(&shuffle, position) != SHUFFLE_SUCCESS))
+    {
+        play_mode = PLAY_MODE_IN_ORDER;
+    }
+}
+
+/*
+ * B1 switches between in order and shuffle, from the track that's playing. The mode is saved straight away: a few
+ * words programmed, unless the log needs a sector erased first, which Settings_Service leaves for when nothing plays.
+ */
+static void PollButton(void)
+{
+    static GPIO_PinState last = GPIO_PIN_SET;
+    static uint32_t last_ms;
+    GPIO_PinState state = HAL_GPIO_ReadPin(B1_GPIO_Port, B1_Pin);
+
+    if (state == last || HAL_GetTick() - last_ms < BUTTON_DEBOUNCE_MS)
+    {
+        return;
+    }
+
+    last = state;
+    last_ms = HAL_GetTick();
+
+    // Pressed pulls it low
+    if (state != GPIO_PIN_RESET || Library_Count() == 0)
+    {
+        return;
+    }
+
+    play_mode = (play_mode == PLAY_MODE_SHUFFLE) ? PLAY_MODE_IN_ORDER : PLAY_MODE_SHUFFLE;
+    SeekPlayOrder(play_position);
+    printf("Play mode: %s\r\n", (play_mode == PLAY_MODE_SHUFFLE) ? "shuffle" : "in order");
+
+    if (Settings_Set(SETTINGS_KEY_PLAY_MODE, &play_mode, sizeof(play_mode)) < SETTINGS_SUCCESS)
+    {
+        printf("Unable to save the play mode\r\n");
+    }
+}
+
+/*
+ * Once a track has ended, the next one in the play order. One that won't open is skipped, but only up to a library's
+ * worth in a row: with nothing playable, it stops trying.
+ */
+static void PlayNext(void)
+{
+    static uint32_t skipped;
+
+    if (Player_IsPlaying() || Library_Count() == 0 || skipped >= Library_Count())
+    {
+        return;
+    }
+
+    play_position = (play_mode == PLAY_MODE_SHUFFLE) ? Shuffle_Next(&shuffle) : (play_position + 1) % Library_Count();
+
+    if (Library_GetPath(TrackAt(play_position), track_path, sizeof(track_path)) != LIBRARY_SUCCESS
+            || Player_OpenTrack(track_path) != PLAYER_SUCCESS)
+    {
+        skipped++;
+        return;
+    }
+
+    skipped = 0;
+    printf("Playing %s\r\n", track_path);
+}
 /* USER CODE END 0 */
 
 /**
@@ -115,6 +383,35 @@ int main(void)
     MX_FATFS_Init();
     MX_SDIO_SD_Init();
     /* USER CODE BEGIN 2 */
+    // Settings are in the internal flash, so they're there before the card is: only the log's headers are read.
+    // Timed in cycles, since it takes well under the 1 ms HAL_GetTick can see.
+    settings_stats_t settings_stats;
+
+    Cycles_Init();
+    uint32_t settings_start = Cycles_Now();
+    settings_ret_t settings_res = Settings_Init(&internal_flash_settings);
+    uint32_t settings_cycles = Cycles_Now() - settings_start;
+
+    if (settings_res != SETTINGS_SUCCESS || Settings_GetStats(&settings_stats) != SETTINGS_SUCCESS)
+    {
+        printf("Settings: unable to read or format the flash, going without\r\n");
+    }
+    else
+    {
+        printf("Settings: %lu keys from %lu B of log (%lu headers) in %lu us\r\n", settings_stats.keys,
+                settings_stats.used_b, settings_stats.headers_read, settings_cycles / (SystemCoreClock / 1000000));
+    }
+
+    // In order unless it was last left in shuffle (or the store's unreadable)
+    uint8_t saved_mode;
+    uint32_t saved_length;
+
+    if (Settings_Get(SETTINGS_KEY_PLAY_MODE, &saved_mode, sizeof(saved_mode), &saved_length) == SETTINGS_SUCCESS
+            && saved_length == sizeof(saved_mode) && saved_mode == PLAY_MODE_SHUFFLE)
+    {
+        play_mode = PLAY_MODE_SHUFFLE;
+    }
+
     // Select the file system implementation to use
     // This is fairly safe because if the implementation is not defined (i.e., microsd_driver), a compile-time error is thrown
     fs = &microsd_driver;
@@ -125,6 +422,37 @@ int main(void)
     }
 
     printf("SD Card Size (MB): %lu\r\n", fs->fs_size_mb);
+    printf("SD bus: %u-bit, %lu kHz%s, %lu KiB/s\r\n", fs->bus.width, fs->bus.clock_hz / 1000,
+            fs->bus.high_speed ? " (high speed)" : "", fs->bus.throughput_kbps);
+
+    // First time we see this card: measure it once, the profile is stored on the card (keyed by its CID)
+    if (fs->read_size_b == 0)
+    {
+        sd_profile_t profile;
+
+        printf("Benchmarking SD card...\r\n");
+
+        if (MicroSD_Characterize(fs, output_ring_buffer, OUTPUT_RING_SIZE, &profile) == FS_SUCCESS)
+        {
+            printf("Sequential %lu KiB/s, random 4K %lu KiB/s, p50 %lu us, p99 %lu us, max %lu us\r\n",
+                    profile.sequential_kbps[SD_PROFILE_NUM_SIZES - 1], profile.random_kbps[1], profile.p50_us,
+                    profile.p99_us, profile.max_us);
+        }
+    }
+
+    printf("SD read size %lu B, worst stall %lu us\r\n", fs->read_size_b, fs->stall_us);
+
+    // The player sizes its ring (and the read-ahead) by how long its reads take, starting from the profile's stall
+    depth_config_t depth_config;
+    Depth_DefaultConfig(&depth_config, OUTPUT_RING_SIZE, BLK_STAGING_BLOCKS * BLK_BLOCK_SIZE);
+    depth_config.budget_b = PLAYBACK_BUDGET;
+    depth_config.target_ppm = PLAYBACK_UNDERRUN_PPM;
+    depth_config.seed_us = fs->stall_us;
+
+    if (Depth_Init(&depth_config) != DEPTH_SUCCESS)
+    {
+        Error_Handler();
+    }
 
     // TODO: fix detection!
     // remove pulldown in ioc
@@ -138,28 +466,142 @@ int main(void)
         Error_Handler();
     }
 
-    // Read WAV file
-    file_t test_wav;
+    // Select the audio output implementation to use
+    audio = &i2s_driver;
 
-    if (fs->ops->OpenFile(&test_wav, "test.wav") != FS_SUCCESS)
+    if (audio->Open() != AUDIO_SUCCESS)
     {
         Error_Handler();
     }
 
-    uint8_t buf[WAV_HEADER_LEN];
+    // The library's index is on the card. It's there to browse as soon as it's open (only its header is read), then
+    // brought up to date: only folders that changed since (all of them if there's no index yet, or it's another
+    // card's) have their tracks opened. With the output ring as work: nothing's playing yet.
+    if (Library_Init(fs, codec) != LIBRARY_SUCCESS)
+    {
+        Error_Handler();
+    }
+
+    if (Library_Open() == LIBRARY_SUCCESS)
+    {
+        printf("Library: %lu tracks, checking for changes...\r\n", Library_Count());
+    }
+    else
+    {
+        printf("Indexing the library...\r\n");
+    }
+
+    library_stats_t library_stats;
+    uint32_t start_ms = HAL_GetTick();
+
+    if (Library_Update(output_ring_buffer, OUTPUT_RING_SIZE, &library_stats) == LIBRARY_SUCCESS)
+    {
+        printf("Indexed %lu tracks in %lu folders (%lu changed, %lu tracks kept, %lu skipped, %lu views) in %lu ms, "
+                "%lu B\r\n", library_stats.tracks, library_stats.dirs, library_stats.changed_dirs,
+                library_stats.reused, library_stats.skipped, library_stats.views, HAL_GetTick() - start_ms,
+                library_stats.index_b);
+    }
+
+    printf("Library: %lu tracks\r\n", Library_Count());
+
+    // First in the artist view (or in walk order without one), or the shuffle's first. A new shuffle each boot,
+    // unless a bookmark carries on with the one it was saved in.
+    if (Library_Count() > 0)
+    {
+        shuffle_seed = Cycles_Now();
+        SeekPlayOrder(0);
+
+        if (play_mode == PLAY_MODE_SHUFFLE)
+        {
+            SeekPlayOrder(Shuffle_Track(&shuffle, 0));
+        }
+
+        Library_GetPath(TrackAt(play_position), track_path, sizeof(track_path));
+    }
+
+    printf("Play mode: %s\r\n", (play_mode == PLAY_MODE_SHUFFLE) ? "shuffle" : "in order");
+
+    if (Ring_Init(&output_ring, output_ring_buffer, OUTPUT_RING_SIZE) != RING_SUCCESS)
+    {
+        Error_Handler();
+    }
 
-    if (fs->ops->ReadFile(&test_wav, &buf, WAV_HEADER_LEN) != FS_SUCCESS)
+    if (Player_Init(fs, codec, audio, &output_ring) != PLAYER_SUCCESS)
     {
         Error_Handler();
     }
 
-    wav_metadata_t metadata;
-    size_t bytes_read;
+    // Where the last power cycle left off, if anywhere: that track, from the frame it had got to. Without a bookmark
+    // (a new card), or with its track gone, the library's first track instead.
+    player_ret_t track_res = PLAYER_ERROR_NO_TRACK;
+
+    if (Bookmark_Init(fs) == BOOKMARK_SUCCESS && Bookmark_Open() == BOOKMARK_SUCCESS)
+    {
+        bookmark_open = 1;
+
+        if (Bookmark_Load(&bookmark) == BOOKMARK_SUCCESS)
+        {
+            track_res = Player_OpenTrack(bookmark.path);
+
+            if (track_res != PLAYER_SUCCESS)
+            {
+                printf("Unable to resume %s (%d)\r\n", bookmark.path, track_res);
+            }
+            else
+            {
+                memcpy(track_path, bookmark.path, sizeof(track_path));
+
+                // The play order from there too, if the library still has the track where the bookmark says
+                char path[LIBRARY_MAX_PATH];
+                uint32_t position = bookmark.user[BOOKMARK_WORD_POSITION];
+
+                if (position < Library_Count()
+                        && Library_GetPath(TrackAt(position), path, sizeof(path)) == LIBRARY_SUCCESS
+                        && strcmp(path, track_path) == 0)
+                {
+                    shuffle_seed = bookmark.user[BOOKMARK_WORD_SHUFFLE_SEED];
+                    SeekPlayOrder(position);
+                }
+
+                if (Player_Seek(bookmark.frame) == PLAYER_SUCCESS)
+                {
+                    printf("Resuming %s at frame %lu\r\n", track_path, (unsigned long)bookmark.frame);
+                }
+                else
+                {
+                    printf("Resuming %s from the start\r\n", track_path);
+                }
+            }
+        }
+    }
+
+    // Negotiates a format with the sink and clocks it at the track's own rate (PLLI2S is reprogrammed per track).
+    // The meter is pointed at the ring from in here too, since only the player knows what format the ring holds.
+    if (track_res != PLAYER_SUCCESS)
+    {
+        track_res = Player_OpenTrack(track_path);
+    }
 
-    if (codec->ValidateHeader(&buf, &metadata, &bytes_read) != CODEC_SUCCESS)
+    if (track_res == PLAYER_ERROR_FORMAT_UNSUPPORTED)
+    {
+        // TODO: resample to a rate the sink can hit exactly
+        printf("No way to play %s without resampling\r\n", track_path);
+    }
+    else if (track_res != PLAYER_SUCCESS)
     {
         Error_Handler();
     }
+    else
+    {
+        format_plan_t plan;
+        int32_t rate_error_ppm;
+
+        Player_GetPlan(&plan, &rate_error_ppm);
+        printf("Playing %lu Hz, %u-bit -> %u-bit (%ld ppm), stages 0x%lx\r\n", plan.sink.sample_rate,
+                plan.source.bits_per_sample, plan.sink.bits_per_sample, rate_error_ppm, plan.stages);
+    }
+
+    Blk_SetYield(WhileCardBusy);
 
     /* USER CODE END 2 */
 
@@ -170,6 +612,19 @@ int main(void)
         /* USER CODE END WHILE */
 
         /* USER CODE BEGIN 3 */
+        // Lowest priority work: anything time-critical happens in interrupts
+        Player_Service();
+        Meter_Process();
+        DumpStats();
+        SaveBookmark();
+        PollButton();
+        PlayNext();
+
+        // Erasing a sector holds up anything running from flash for a second or so: only with nothing playing
+        if (!Player_IsPlaying())
+        {
+            Settings_Service();
+        }
     }
     /* USER CODE END 3 */
 }
@@ -0,0 +1,347 @@
+/*
+ * meter.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#include "meter.h"
+#include "cycles.h"
+
+#include <math.h>
+#include <string.h>
+
+// A real FFT of length N can be done as a complex FFT of length N/2 plus a cheap "split" pass.
+// The even samples go in the real part and the odd samples in the imaginary part.
+// See https://www.dsprelated.com/showarticle/800.php
+#define FFT_HALF (METER_FFT_LEN / 2)
+
+#define PI_F 3.14159265358979f
+
+// Full-scale sine through a Hann window peaks at N/4 (coherent gain 0.5 times N/2),
+// so normalize to that to get dBFS
+#define FULL_SCALE_MAG ((float)METER_FFT_LEN / 4.0f)
+
+#define INT16_FULL_SCALE 32768.0f
+
+#define METER_BARRIER() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+// Everything here is static: there's only one output stream to meter,
+// and the tables are too big to want on the stack.
+static const ring_t *meter_ring;
+static uint16_t meter_channels;
+static uint32_t meter_sample_bytes;
+static uint32_t meter_sample_rate;
+static uint32_t meter_block_bytes;
+
+// Ring position at which the next block is due, so we analyze at most once per played block
+static uint32_t next_position;
+
+static float window[METER_FFT_LEN];
+static float twiddle_cos[FFT_HALF];
+static float twiddle_sin[FFT_HALF];
+static float fft_re[FFT_HALF];
+static float fft_im[FFT_HALF];
+
+static meter_snapshot_t slots[2];
+static volatile uint32_t published;
+static uint32_t sequence;
+static uint32_t blocks;
+static uint32_t dropped;
+static uint64_t total_cycles;
+static uint32_t max_cycles;
+
+static inline int16_t RingSample(uint32_t position)
+{
+    // Position is a free-running byte counter, mask it into the buffer.
+    // Frames are 2, 4 or 8 bytes and the ring size is a power of two, so a sample never straddles the wrap.
+    // For 32-bit words only the top half is read (little-endian): 16 bits is plenty for a meter.
+    int16_t sample;
+    position += meter_sample_bytes - sizeof(int16_t);
+    memcpy(&sample, &meter_ring->buffer[position & (meter_ring->size - 1)], sizeof(sample));
+    return sample;
+}
+
+static void BitReverse(float *re, float *im, uint32_t n)
+{
+    uint32_t j = 0;
+
+    for (uint32_t i = 0; i < n - 1; i++)
+    {
+        if (i < j)
+        {
+            float t = re[i];
+            re[i] = re[j];
+            re[j] = t;
+
+            t = im[i];
+            im[i] = im[j];
+            im[j] = t;
+        }
+
+        uint32_t k = n >> 1;
+        while (k <= j)
+        {
+            j -= k;
+            k >>= 1;
+        }
+        j += k;
+    }
+}
+
+// In-place iterative radix-2 complex FFT of length FFT_HALF.
+// Twiddles are stored for the full METER_FFT_LEN, so the FFT_HALF-point twiddle k is entry 2k.
+static void ComplexFFT(float *re, float *im)
+{
+    BitReverse(re, im, FFT_HALF);
+
+    for (uint32_t span = 1; span < FFT_HALF; span <<= 1)
+    {
+        uint32_t stride = FFT_HALF / span;     // twiddle step in the full-length table
+
+        for (uint32_t start = 0; start < FFT_HALF; start += span << 1)
+        {
+            for (uint32_t k = 0; k < span; k++)
+            {
+                float wr = twiddle_cos[k * stride];
+                float wi = -twiddle_sin[k * stride];
+
+                uint32_t a = start + k;
+                uint32_t b = a + span;
+
+                float tr = re[b] * wr - im[b] * wi;
+                float ti = re[b] * wi + im[b] * wr;
+
+                re[b] = re[a] - tr;
+                im[b] = im[a] - ti;
+                re[a] += tr;
+                im[a] += ti;
+            }
+        }
+    }
+}
+
+meter_ret_t Meter_Init(const ring_t *ring, uint16_t channels, uint32_t sample_bytes, uint32_t sample_rate)
+{
+    if (ring == NULL || ring->buffer == NULL)
+    {
+        return METER_ERROR_NULL_RING;
+    }
+
+    if (channels == 0 || channels > METER_MAX_CHANNELS || sample_rate == 0)
+    {
+        return METER_ERROR_INVALID_FORMAT;
+    }
+
+    if (sample_bytes != sizeof(int16_t) && sample_bytes != sizeof(int32_t))
+    {
+        return METER_ERROR_INVALID_FORMAT;
+    }
+
+    meter_ring = ring;
+    meter_channels = channels;
+    meter_sample_bytes = sample_bytes;
+    meter_sample_rate = sample_rate;
+    meter_block_bytes = METER_BLOCK_FRAMES * channels * sample_bytes;
+    next_position = ring->tail;
+
+    for (uint32_t n = 0; n < METER_FFT_LEN; n++)
+    {
+        window[n] = 0.5f - 0.5f * cosf(2.0f * PI_F * n / (METER_FFT_LEN - 1));
+    }
+
+    for (uint32_t k = 0; k < FFT_HALF; k++)
+    {
+        twiddle_cos[k] = cosf(2.0f * PI_F * k / METER_FFT_LEN);
+        twiddle_sin[k] = sinf(2.0f * PI_F * k / METER_FFT_LEN);
+    }
+
+    memset(slots, 0, sizeof(slots));
+    published = 0;
+    sequence = 0;
+    blocks = 0;
+    dropped = 0;
+    total_cycles = 0;
+    max_cycles = 0;
+
+    Cycles_Init();
+
+    return METER_SUCCESS;
+}
+
+meter_ret_t Meter_Process(void)
+{
+    if (meter_ring == NULL)
+    {
+        return METER_ERROR_NOT_READY;
+    }
+
+    uint32_t start = meter_ring->tail;
+
+    // Already analyzed the block that's playing now
+    if ((int32_t)(start - next_position) < 0)
+    {
+        return METER_ERROR_NOT_READY;
+    }
+
+    // Not a full block queued yet
+    if (meter_ring->head - start < meter_block_bytes)
+    {
+        return METER_ERROR_NOT_READY;
+    }
+
+    uint32_t cycles_start = Cycles_Now();
+
+    meter_snapshot_t *slot = &slots[published ^ 1];
+
+    // Mark the slot as being written (see Meter_GetSnapshot)
+    slot->sequence = 0;
+    METER_BARRIER();
+
+    float peak[METER_MAX_CHANNELS] = { 0 };
+    float sum_squares[METER_MAX_CHANNELS] = { 0 };
+
+    uint32_t frame_bytes = meter_channels * meter_sample_bytes;
+    uint32_t position = start;
+
+    // Peak/RMS over every frame, and a mono, decimated copy for the FFT in the same pass
+    for (uint32_t n = 0; n < METER_FFT_LEN; n++)
+    {
+        float mono = 0.0f;
+
+        for (uint32_t d = 0; d < METER_DECIMATION; d++)
+        {
+            for (uint16_t ch = 0; ch < meter_channels; ch++)
+            {
+                float sample = RingSample(position + ch * meter_sample_bytes) / INT16_FULL_SCALE;
+                float magnitude = fabsf(sample);
+
+                if (magnitude > peak[ch])
+                {
+                    peak[ch] = magnitude;
+                }
+
+                sum_squares[ch] += sample * sample;
+                mono += sample;
+            }
+
+            position += frame_bytes;
+        }
+
+        // Averaging the decimated frames is a crude (boxcar) anti-alias filter.
+        // Good enough for a display, and free.
+        mono *= window[n] / (float)(METER_DECIMATION * meter_channels);
+
+        if (n & 1)
+        {
+            fft_im[n >> 1] = mono;
+        }
+        else
+        {
+            fft_re[n >> 1] = mono;
+        }
+    }
+
+    ComplexFFT(fft_re, fft_im);
+
+    // Split the packed result into the real FFT's bins:
+    // X[k] = (Z[k] + Z*[M-k]) / 2 + W^k * (Z[k] - Z*[M-k]) / 2j
+    for (uint32_t k = 0; k < METER_FFT_BINS; k++)
+    {
+        uint32_t mk = (FFT_HALF - k) & (FFT_HALF - 1);
+
+        float even_re = 0.5f * (fft_re[k] + fft_re[mk]);
+        float even_im = 0.5f * (fft_im[k] - fft_im[mk]);
+        float odd_re = 0.5f * (fft_im[k] + fft_im[mk]);
+        float odd_im = -0.5f * (fft_re[k] - fft_re[mk]);
+
+        float wr = twiddle_cos[k];
+        float wi = -twiddle_sin[k];
+
+        float x_re = even_re + (odd_re * wr - odd_im * wi);
+        float x_im = even_im + (odd_re * wi + odd_im * wr);
+
+        float power = (x_re * x_re + x_im * x_im) / (FULL_SCALE_MAG * FULL_SCALE_MAG);
+        float db = (power > 0.0f) ? 10.0f * log10f(power) : METER_FLOOR_DB;
+
+        slot->spectrum_db[k] = (db < METER_FLOOR_DB) ? METER_FLOOR_DB : db;
+    }
+
+    // If the producer has written past where we started, part of our block was overwritten under us
+    if (meter_ring->head - start > meter_ring->size)
+    {
+        dropped++;
+        next_position = meter_ring->tail;
+        return METER_ERROR_NOT_READY;
+    }
+
+    for (uint16_t ch = 0; ch < meter_channels; ch++)
+    {
+        slot->peak[ch] = peak[ch];
+        slot->rms[ch] = sqrtf(sum_squares[ch] / METER_BLOCK_FRAMES);
+    }
+
+    uint32_t cycles = Cycles_Now() - cycles_start;
+
+    // Share of the CPU = cycles spent / cycles that elapse while the block plays
+    uint64_t block_cycles = (uint64_t)SystemCoreClock * METER_BLOCK_FRAMES / meter_sample_rate;
+
+    blocks++;
+    total_cycles += cycles;
+    max_cycles = (cycles > max_cycles) ? cycles : max_cycles;
+
+    slot->channels = meter_channels;
+    slot->bin_hz = (float)meter_sample_rate / METER_DECIMATION / METER_FFT_LEN;
+    slot->cycles = cycles;
+    slot->cpu_permille = (uint32_t)(((uint64_t)cycles * 1000) / block_cycles);
+    slot->avg_cycles = (uint32_t)(total_cycles / blocks);
+    slot->max_cycles = max_cycles;
+    slot->avg_cpu_permille = (uint32_t)(((total_cycles / blocks) * 1000) / block_cycles);
+    slot->max_cpu_permille = (uint32_t)(((uint64_t)max_cycles * 1000) / block_cycles);
+    slot->blocks = blocks;
+    slot->dropped = dropped;
+
+    METER_BARRIER();
+    slot->sequence = ++sequence;
+    METER_BARRIER();
+    published ^= 1;
+
+    next_position = start + meter_block_bytes;
+
+    return METER_SUCCESS;
+}
+
+meter_ret_t Meter_GetSnapshot(meter_snapshot_t *snapshot)
+{
+    if (snapshot == NULL)
+    {
+        return METER_ERROR_GENERIC;
+    }
+
+    // The meter only ever writes the slot that ISN'T published, so normally one copy is enough.
+    // If the meter published twice while we were copying (i.e., we got preempted for a long time),
+    // the sequence number changes under us and we simply try again.
+    uint32_t before;
+
+    do
+    {
+        const meter_snapshot_t *slot = &slots[published];
+
+        before = slot->sequence;
+        METER_BARRIER();
+        memcpy(snapshot, slot, sizeof(*snapshot));
+        METER_BARRIER();
+
+        if (slot->sequence == before)
+        {
+            break;
+        }
+    } while (1);
+
+    if (before == 0)
+    {
+        return METER_ERROR_NOT_READY;
+    }
+
+    return METER_SUCCESS;
+}
@@ -6,6 +6,11 @@
  */
 
 #include "microsd.h"
+#include "blk.h"
+#include "sd_bench.h"
+#include "sd_bus.h"
+
+#include <string.h>
 
 // Defined in main.c, used as an extern variable (just like here) in the built-in FATFS driver code
 // Declare it within the source file for encapsulation purposes
@@ -34,12 +39,18 @@ fs_ret_t MicroSD_Open(fs_driver_t *fs)
         return FS_ERROR_UNABLE_TO_INIT;
     }
 
-    // Now we can switch to 4-bit bus width
-    // TODO: configure 4-bit on hardware
-    /* if (HAL_SD_ConfigWideBusOperation(&hsd, SDIO_BUS_WIDE_4B) != HAL_OK)
-     {
-     return FS_ERROR_UNABLE_TO_INIT;
-     } */
+    // Now we can switch to 4-bit bus width, high speed, and the fastest clock the card and wiring can take.
+    // Each step is optional and falls back to what we had; this only fails if the card can't be read at all.
+    if (SDBus_Negotiate(&fs->bus) != SD_BUS_SUCCESS)
+    {
+        return FS_ERROR_UNABLE_TO_INIT;
+    }
+
+    // Everything FatFs reads and writes goes through the block layer from here on
+    if (Blk_Init(&sd_bus_device, hsd.SdCard.BlockNbr) != BLK_SUCCESS)
+    {
+        return FS_ERROR_UNABLE_TO_INIT;
+    }
 
     // Mount the FatFS file system
     // DELAYED_MOUNT (= 0) is default, so I just went with that
@@ -55,6 +66,56 @@ fs_ret_t MicroSD_Open(fs_driver_t *fs)
     fs->fs_size_mb = ((double) (fs->block_size_b) / MEGABYTES_TO_BYTES)
             * fs->num_blocks;
 
+    // Read from the boot sector, which the mount already has
+    DWORD serial;
+
+    fs->volume_serial = (f_getlabel((TCHAR const*) SDPath, NULL, &serial) == FR_OK) ? serial : 0;
+
+    // If this card has been benchmarked before, we already know how it likes to be read
+    sd_profile_t profile;
+
+    if (SDProfile_Load(hsd.CID, &profile) == SD_PROFILE_SUCCESS)
+    {
+        fs->read_size_b = profile.read_size_b;
+        fs->stall_us = profile.stall_us;
+    }
+    else
+    {
+        fs->read_size_b = 0;
+        fs->stall_us = 0;
+    }
+
+    // Background I/O has to leave playback enough slack for the card's worst stall
+    Blk_SetWorstLatency((fs->stall_us + 999) / 1000);
+
+    return FS_SUCCESS;
+}
+
+fs_ret_t MicroSD_Characterize(fs_driver_t *fs, void *work, size_t work_size, sd_profile_t *profile)
+{
+    if (fs == NULL || profile == NULL)
+    {
+        return FS_ERROR_GENERIC;
+    }
+
+    if (hsd.State != HAL_SD_STATE_READY)
+    {
+        return FS_ERROR_UNINITIALIZED;
+    }
+
+    if (SDBench_Run(hsd.SdCard.BlockNbr, hsd.CID, work, work_size, profile) != SD_BENCH_SUCCESS)
+    {
+        return FS_ERROR_GENERIC;
+    }
+
+    // Not being able to save it just means benchmarking again next time
+    SDProfile_Save(profile);
+
+    fs->read_size_b = profile->read_size_b;
+    fs->stall_us = profile->stall_us;
+
+    Blk_SetWorstLatency((fs->stall_us + 999) / 1000);
+
     return FS_SUCCESS;
 }
 
@@ -115,11 +176,26 @@ fs_ret_t MicroSD_CloseFile(file_t *file)
         return FS_ERROR_UNABLE_TO_CLOSE_FILE;
     }
 
+    FIL *handle = (FIL *)file->handle;
+    fs_ret_t res = FS_SUCCESS;
+
+    // A file we've been writing ends where the writing did: the rest of a reservation (ReserveFile) goes back.
+    // f_close then writes out the directory entry, which is when the file is really on the card.
+    if ((handle->flag & FA_WRITE) && f_truncate(handle) != FR_OK)
+    {
+        res = FS_ERROR_UNABLE_TO_CLOSE_FILE;
+    }
+
+    if (f_close(handle) != FR_OK)
+    {
+        res = FS_ERROR_UNABLE_TO_CLOSE_FILE;
+    }
+
     // Free memory and remove dangling pointer
     free(file->handle);
     file->handle = NULL;
 
-    return FS_SUCCESS;
+    return res;
 }
 
 fs_ret_t MicroSD_ReadFile(file_t *file, void *buffer, size_t length)
@@ -157,9 +233,330 @@ fs_ret_t MicroSD_ReadFile(file_t *file, void *buffer, size_t length)
     return FS_SUCCESS;
 }
 
+// The block layer's classes are in the same order
+fs_ret_t MicroSD_SetIOClass(fs_io_class_t io_class, uint32_t budget_ms)
+{
+    Blk_SetClass((blk_class_t)io_class, budget_ms);
+
+    return FS_SUCCESS;
+}
+
+uint8_t MicroSD_MayIssue(fs_io_class_t io_class)
+{
+    return Blk_Admit((blk_class_t)io_class);
+}
+
+fs_ret_t MicroSD_SetReadAhead(uint32_t bytes)
+{
+    Blk_SetReadAhead(bytes / BLK_BLOCK_SIZE);
+
+    return FS_SUCCESS;
+}
+
+fs_ret_t MicroSD_CreateFile(file_t *file, char *filename)
+{
+    if (hsd.State != HAL_SD_STATE_READY)
+    {
+        return FS_ERROR_UNINITIALIZED;
+    }
+
+    if (file == NULL)
+    {
+        return FS_ERROR_UNABLE_TO_OPEN_FILE;
+    }
+
+    // Same as MicroSD_OpenFile, but a new, empty file for writing
+    FIL *handle = malloc(sizeof(FIL));
+
+    if (handle == NULL)
+    {
+        return FS_ERROR_UNABLE_TO_OPEN_FILE;
+    }
+
+    if (f_open(handle, filename, FA_CREATE_ALWAYS | FA_WRITE | FA_READ) != FR_OK)
+    {
+        free(handle);
+        return FS_ERROR_UNABLE_TO_OPEN_FILE;
+    }
+
+    file->handle = handle;
+    file->filename = filename;
+
+    return FS_SUCCESS;
+}
+
+fs_ret_t MicroSD_WriteFile(file_t *file, const void *buffer, size_t length)
+{
+    if (file == NULL || file->handle == NULL || buffer == NULL)
+    {
+        return FS_ERROR_UNABLE_TO_WRITE_FILE;
+    }
+
+    /*
+     * Whole sectors at sector-aligned offsets go straight from buffer to the card, as one multi-block write
+     * per cluster (or per contiguous run, see ReserveFile). Anything else goes through the file's sector buffer,
+     * which costs a read of the sector first if the file already has data there (a reservation counts).
+     * See http://elm-chan.org/fsw/ff/doc/write.html
+     *
+     * Fewer bytes written than asked means the card is full.
+     */
+    UINT bytes_written;
+
+    if (f_write((FIL *)file->handle, buffer, length, &bytes_written) != FR_OK || bytes_written != length)
+    {
+        return FS_ERROR_UNABLE_TO_WRITE_FILE;
+    }
+
+    return FS_SUCCESS;
+}
+
+fs_ret_t MicroSD_WriteFileAt(file_t *file, uint64_t offset, const void *buffer, size_t length)
+{
+    if (file == NULL || file->handle == NULL || buffer == NULL)
+    {
+        return FS_ERROR_UNABLE_TO_WRITE_FILE;
+    }
+
+    FIL *handle = (FIL *)file->handle;
+    FSIZE_t end = f_tell(handle);
+    UINT bytes_written;
+
+    if (f_lseek(handle, offset) != FR_OK || f_write(handle, buffer, length, &bytes_written) != FR_OK
+            || bytes_written != length)
+    {
+        f_lseek(handle, end);
+        return FS_ERROR_UNABLE_TO_WRITE_FILE;
+    }
+
+    // Back to where WriteFile carries on from
+    if (f_lseek(handle, end) != FR_OK)
+    {
+        return FS_ERROR_UNABLE_TO_WRITE_FILE;
+    }
+
+    return FS_SUCCESS;
+}
+
+fs_ret_t MicroSD_ReserveFile(file_t *file, uint64_t bytes)
+{
+    if (file == NULL || file->handle == NULL)
+    {
+        return FS_ERROR_UNABLE_TO_RESERVE;
+    }
+
+    FIL *handle = (FIL *)file->handle;
+
+    // f_expand allocates a contiguous run of clusters, or nothing: the file has to be empty, and on FAT32 under 4 GB.
+    // On exFAT the file is then marked contiguous, so FatFs never reads the FAT for it again.
+    // See http://elm-chan.org/fsw/ff/doc/expand.html
+    if (f_expand(handle, (FSIZE_t)bytes, 1) != FR_OK)
+    {
+        return FS_ERROR_UNABLE_TO_RESERVE;
+    }
+
+    // So the allocation is on the card (with the file at its reserved size) even if we never get to close it
+    if (f_sync(handle) != FR_OK)
+    {
+        return FS_ERROR_UNABLE_TO_RESERVE;
+    }
+
+    return FS_SUCCESS;
+}
+
+fs_ret_t MicroSD_ReadFileFrom(file_t *file, uint64_t offset, void *buffer, size_t length)
+{
+    if (file == NULL || file->handle == NULL || buffer == NULL)
+    {
+        return FS_ERROR_UNABLE_TO_READ_FILE;
+    }
+
+    // Like MicroSD_WriteFileAt: there, then back. Within the file's current sector, both seeks are free.
+    FIL *handle = (FIL *)file->handle;
+    FSIZE_t position = f_tell(handle);
+    UINT bytes_read;
+    fs_ret_t res = FS_SUCCESS;
+
+    if (f_lseek(handle, offset) != FR_OK || f_read(handle, buffer, length, &bytes_read) != FR_OK
+            || bytes_read != length)
+    {
+        res = FS_ERROR_UNABLE_TO_READ_FILE;
+    }
+
+    if (f_lseek(handle, position) != FR_OK)
+    {
+        res = FS_ERROR_UNABLE_TO_READ_FILE;
+    }
+
+    return res;
+}
+
+static void ToEntry(const FILINFO *info, fs_entry_t *entry)
+{
+    strncpy(entry->name, info->fname, FS_MAX_NAME - 1);
+    entry->name[FS_MAX_NAME - 1] = '\0';
+    entry->size = info->fsize;
+    entry->modified = ((uint32_t)info->fdate << 16) | info->ftime;
+    entry->is_dir = (info->fattrib & AM_DIR) != 0;
+    entry->hidden = (info->fattrib & (AM_HID | AM_SYS)) != 0;
+}
+
+fs_ret_t MicroSD_FindFirst(fs_dir_t *dir, fs_entry_t *entry, const char *path, const char *pattern)
+{
+    if (hsd.State != HAL_SD_STATE_READY)
+    {
+        return FS_ERROR_UNINITIALIZED;
+    }
+
+    if (dir == NULL || entry == NULL || path == NULL || pattern == NULL)
+    {
+        return FS_ERROR_UNABLE_TO_OPEN_DIR;
+    }
+
+    // Same reasoning as for the FIL in MicroSD_OpenFile. FILINFO holds a whole long name, so it's only ever on
+    // the stack for as long as it takes to copy it out.
+    DIR *handle = malloc(sizeof(DIR));
+    FILINFO info;
+
+    dir->handle = handle;
+
+    if (handle == NULL)
+    {
+        return FS_ERROR_UNABLE_TO_OPEN_DIR;
+    }
+
+    // See http://elm-chan.org/fsw/ff/doc/findfirst.html
+    if (f_findfirst(handle, &info, path, pattern) != FR_OK)
+    {
+        free(handle);
+        dir->handle = NULL;
+        return FS_ERROR_UNABLE_TO_OPEN_DIR;
+    }
+
+    ToEntry(&info, entry);
+
+    return FS_SUCCESS;
+}
+
+fs_ret_t MicroSD_FindNext(fs_dir_t *dir, fs_entry_t *entry)
+{
+    if (dir == NULL || dir->handle == NULL || entry == NULL)
+    {
+        return FS_ERROR_UNABLE_TO_READ_DIR;
+    }
+
+    FILINFO info;
+
+    if (f_findnext((DIR *)dir->handle, &info) != FR_OK)
+    {
+        return FS_ERROR_UNABLE_TO_READ_DIR;
+    }
+
+    ToEntry(&info, entry);
+
+    return FS_SUCCESS;
+}
+
+fs_ret_t MicroSD_CloseDir(fs_dir_t *dir)
+{
+    if (dir == NULL || dir->handle == NULL)
+    {
+        return FS_SUCCESS;
+    }
+
+    FRESULT res = f_closedir((DIR *)dir->handle);
+
+    free(dir->handle);
+    dir->handle = NULL;
+
+    return (res == FR_OK) ? FS_SUCCESS : FS_ERROR_GENERIC;
+}
+
+fs_ret_t MicroSD_RemoveFile(const char *filename)
+{
+    if (hsd.State != HAL_SD_STATE_READY)
+    {
+        return FS_ERROR_UNINITIALIZED;
+    }
+
+    return (filename != NULL && f_unlink(filename) == FR_OK) ? FS_SUCCESS : FS_ERROR_UNABLE_TO_REMOVE;
+}
+
+fs_ret_t MicroSD_RenameFile(const char *from, const char *to)
+{
+    if (hsd.State != HAL_SD_STATE_READY)
+    {
+        return FS_ERROR_UNINITIALIZED;
+    }
+
+    return (from != NULL && to != NULL && f_rename(from, to) == FR_OK) ? FS_SUCCESS : FS_ERROR_UNABLE_TO_RENAME;
+}
+
+fs_ret_t MicroSD_SeekFile(file_t *file, uint64_t offset)
+{
+    if (file == NULL || file->handle == NULL)
+    {
+        return FS_ERROR_UNABLE_TO_SEEK;
+    }
+
+    FIL *handle = (FIL *)file->handle;
+
+    // f_lseek on a file opened to be read would stretch it no further than its end; past that is a mistake
+    if (offset > f_size(handle) || f_lseek(handle, offset) != FR_OK)
+    {
+        return FS_ERROR_UNABLE_TO_SEEK;
+    }
+
+    return FS_SUCCESS;
+}
+
+fs_ret_t MicroSD_OpenFileForUpdate(file_t *file, char *filename)
+{
+    if (hsd.State != HAL_SD_STATE_READY)
+    {
+        return FS_ERROR_UNINITIALIZED;
+    }
+
+    if (file == NULL)
+    {
+        return FS_ERROR_UNABLE_TO_OPEN_FILE;
+    }
+
+    // Same as MicroSD_OpenFile, but to be written too
+    FIL *handle = malloc(sizeof(FIL));
+
+    if (handle == NULL)
+    {
+        return FS_ERROR_UNABLE_TO_OPEN_FILE;
+    }
+
+    if (f_open(handle, filename, FA_OPEN_EXISTING | FA_WRITE | FA_READ) != FR_OK)
+    {
+        free(handle);
+        return FS_ERROR_UNABLE_TO_OPEN_FILE;
+    }
+
+    // At the end, where WriteFile carries on from, so that MicroSD_CloseFile's f_truncate leaves it all there
+    if (f_lseek(handle, f_size(handle)) != FR_OK)
+    {
+        f_close(handle);
+        free(handle);
+        return FS_ERROR_UNABLE_TO_OPEN_FILE;
+    }
+
+    file->handle = handle;
+    file->filename = filename;
+
+    return FS_SUCCESS;
+}
+
 const struct fs_operations fs_ops =
 { .Open = MicroSD_Open, .Close = MicroSD_Close, .OpenFile = MicroSD_OpenFile,
-        .CloseFile = MicroSD_CloseFile, .ReadFile = MicroSD_ReadFile };
+        .CloseFile = MicroSD_CloseFile, .ReadFile = MicroSD_ReadFile, .SetIOClass = MicroSD_SetIOClass,
+        .MayIssue = MicroSD_MayIssue, .SetReadAhead = MicroSD_SetReadAhead, .CreateFile = MicroSD_CreateFile,
+        .WriteFile = MicroSD_WriteFile, .WriteFileAt = MicroSD_WriteFileAt, .ReserveFile = MicroSD_ReserveFile,
+        .ReadFileFrom = MicroSD_ReadFileFrom, .FindFirst = MicroSD_FindFirst, .FindNext = MicroSD_FindNext,
+        .CloseDir = MicroSD_CloseDir, .RemoveFile = MicroSD_RemoveFile, .RenameFile = MicroSD_RenameFile,
+        .SeekFile = MicroSD_SeekFile, .OpenFileForUpdate = MicroSD_OpenFileForUpdate };
 
 fs_driver_t microsd_driver =
 { .ops = &fs_ops };
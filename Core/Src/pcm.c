@@ -0,0 +1,216 @@
+/*
+ * pcm.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#include "pcm.h"
+#include "xorshift.h"
+
+#include <string.h>
+
+// One 16-bit LSB expressed at the 24-bit working precision
+#define LSB_16 256
+#define HALF_LSB_16 (LSB_16 / 2)
+
+// Clamp the fed-back error so a clipped sample can't make the shaping filter ring
+#define ERROR_LIMIT (2 * LSB_16)
+
+#define DEFAULT_SEED 0x2545F491u
+
+// TPDF dither in [-255, 255] (i.e., +-1 LSB at 16 bits): the difference of two uniform bytes.
+// Each PRNG step holds 4 bytes, so it covers two samples.
+static inline int32_t TPDF(pcm_dither_t *dither)
+{
+    if (dither->random_left == 0)
+    {
+        dither->random_bits = XorShift_Next(&dither->rng);
+        dither->random_left = 2;
+    }
+
+    uint32_t bits = dither->random_bits;
+    dither->random_bits = bits >> 16;
+    dither->random_left--;
+
+    return (int32_t)(bits & 0xFF) - (int32_t)((bits >> 8) & 0xFF);
+}
+
+static inline int16_t Saturate16(int32_t value)
+{
+    if (value > INT16_MAX)
+    {
+        return INT16_MAX;
+    }
+
+    if (value < INT16_MIN)
+    {
+        return INT16_MIN;
+    }
+
+    return (int16_t)value;
+}
+
+/*
+ * The fused kernel: 24-bit sample in, 16-bit sample out.
+ *
+ * u = x - (h1 * e[n-1] + h2 * e[n-2])     shaped input
+ * y = round(u + tpdf)                      dithered quantizer
+ * e[n] = y - u                             error (including the dither) that gets fed back
+ *
+ * which gives y = x + e[n] - h1 * e[n-1] - h2 * e[n-2], i.e., a noise transfer function of 1 - h1 z^-1 - h2 z^-2.
+ */
+static inline int16_t Requantize(pcm_dither_t *dither, int32_t sample24, uint16_t channel)
+{
+    if (dither == NULL)
+    {
+        return Saturate16((sample24 + HALF_LSB_16) >> 8);
+    }
+
+    int32_t *error = dither->error[channel];
+
+    int32_t shaped = sample24 - (dither->h1 * error[0] + dither->h2 * error[1]);
+
+    // Arithmetic right shift rounds towards -inf, so adding half an LSB first rounds to nearest
+    int32_t quantized = (shaped + TPDF(dither) + HALF_LSB_16) >> 8;
+    int16_t output = Saturate16(quantized);
+
+    int32_t new_error = ((int32_t)output << 8) - shaped;
+
+    if (new_error > ERROR_LIMIT)
+    {
+        new_error = ERROR_LIMIT;
+    }
+    else if (new_error < -ERROR_LIMIT)
+    {
+        new_error = -ERROR_LIMIT;
+    }
+
+    error[1] = error[0];
+    error[0] = new_error;
+
+    return output;
+}
+
+void PCM_DitherInit(pcm_dither_t *dither, uint32_t seed, pcm_shaping_t shaping)
+{
+    memset(dither, 0, sizeof(*dither));
+
+    // xorshift gets stuck at 0 forever
+    dither->rng = (seed != 0) ? seed : DEFAULT_SEED;
+
+    switch (shaping)
+    {
+    case PCM_SHAPING_FIRST_ORDER:
+        dither->h1 = 1;
+        dither->h2 = 0;
+        break;
+    case PCM_SHAPING_SECOND_ORDER:
+        dither->h1 = 2;
+        dither->h2 = -1;
+        break;
+    case PCM_SHAPING_NONE:
+    default:
+        dither->h1 = 0;
+        dither->h2 = 0;
+        break;
+    }
+}
+
+// Call between tracks so the previous track's error doesn't leak into the next one
+void PCM_DitherReset(pcm_dither_t *dither)
+{
+    memset(dither->error, 0, sizeof(dither->error));
+}
+
+void PCM_Convert16To16(int16_t *dst, const int16_t *src, size_t samples)
+{
+    // Nothing to requantize. The pipeline should skip this stage entirely when it can.
+    memcpy(dst, src, samples * sizeof(int16_t));
+}
+
+void PCM_Convert24To16(pcm_dither_t *dither, int16_t *dst, const uint8_t *src, size_t samples, uint16_t channels)
+{
+    // The error history is per channel
+    if (channels == 0 || channels > PCM_MAX_CHANNELS)
+    {
+        return;
+    }
+
+    // 24-bit WAV samples are packed as 3 little-endian bytes with no padding
+    size_t frames = samples / channels;
+
+    for (size_t frame = 0; frame < frames; frame++)
+    {
+        for (uint16_t ch = 0; ch < channels; ch++)
+        {
+            // Assemble in the top of a 32-bit word, then shift down to sign-extend
+            int32_t sample = (int32_t)(((uint32_t)src[0] << 8) | ((uint32_t)src[1] << 16) | ((uint32_t)src[2] << 24)) >> 8;
+            src += 3;
+
+            *dst++ = Requantize(dither, sample, ch);
+        }
+    }
+}
+
+void PCM_Convert32To16(pcm_dither_t *dither, int16_t *dst, const int32_t *src, size_t samples, uint16_t channels)
+{
+    // The error history is per channel
+    if (channels == 0 || channels > PCM_MAX_CHANNELS)
+    {
+        return;
+    }
+
+    size_t frames = samples / channels;
+
+    for (size_t frame = 0; frame < frames; frame++)
+    {
+        for (uint16_t ch = 0; ch < channels; ch++)
+        {
+            // Anything below the 24th bit is ~-144 dBFS, far below the dither itself
+            *dst++ = Requantize(dither, *src++ >> 8, ch);
+        }
+    }
+}
+
+void PCM_Widen16To32(int32_t *dst, const int16_t *src, size_t samples)
+{
+    for (size_t i = 0; i < samples; i++)
+    {
+        dst[i] = (int32_t)((uint32_t)(uint16_t)src[i] << 16);
+    }
+}
+
+void PCM_Repack24To32(int32_t *dst, const uint8_t *src, size_t samples)
+{
+    for (size_t i = 0; i < samples; i++)
+    {
+        dst[i] = (int32_t)(((uint32_t)src[0] << 8) | ((uint32_t)src[1] << 16) | ((uint32_t)src[2] << 24));
+        src += 3;
+    }
+}
+
+void PCM_DuplicateMono(void *buffer, size_t frames, uint32_t bytes_per_sample)
+{
+    // Walk backwards so we never overwrite a mono sample before it's been copied
+    if (bytes_per_sample == sizeof(int16_t))
+    {
+        int16_t *samples = (int16_t *)buffer;
+
+        for (size_t i = frames; i-- > 0;)
+        {
+            samples[2 * i + 1] = samples[i];
+            samples[2 * i] = samples[i];
+        }
+    }
+    else if (bytes_per_sample == sizeof(int32_t))
+    {
+        int32_t *samples = (int32_t *)buffer;
+
+        for (size_t i = frames; i-- > 0;)
+        {
+            samples[2 * i + 1] = samples[i];
+            samples[2 * i] = samples[i];
+        }
+    }
+}
@@ -0,0 +1,663 @@
+/*
+ * player.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#include "player.h"
+#include "cycles.h"
+#include "depth.h"
+#include "meter.h"
+#include "pcm.h"
+#include "wav.h"
+
+#define DITHER_SEED 0x2545F491
+
+static fs_driver_t *player_fs;
+static const codec_t *player_codec;
+static const audio_driver_t *player_audio;
+static ring_t *player_ring;
+static uint8_t *player_ring_buffer;
+static uint32_t player_ring_capacity;
+
+// TODO: only WAV for now, so the metadata is a wav_metadata_t
+static struct
+{
+    uint8_t open;
+    file_t file;
+    wav_metadata_t metadata;
+    format_plan_t plan;
+    int32_t rate_error_ppm;
+    uint64_t bytes_left;        // PCM still to be read from the file
+    uint64_t data_bytes;        // all of it, whole frames
+    uint32_t data_offset;       // where it starts in the file
+    uint32_t fill_bytes;        // don't read until at least this much of the ring is free
+    uint8_t filling;            // in the middle of a Fill, i.e., of a file read
+
+    // Adaptive depth (see depth.h)
+    uint32_t depth_b;           // what the ring should be: Fill stops there, so a smaller one can take over
+    uint32_t readahead_b;       // last passed to SetReadAhead
+    uint8_t sampled;            // read (and timed) something since the last Adapt
+} track;
+
+static pcm_dither_t dither;
+
+// Word-aligned so the conversion kernels can read 16/32-bit samples directly
+static uint32_t scratch[PLAYER_SCRATCH_BYTES / sizeof(uint32_t)];
+
+static inline uint32_t Min(uint32_t a, uint32_t b)
+{
+    return (a < b) ? a : b;
+}
+
+// Whole frames still to be read, capped so that many frames of any format still fit in 32 bits (RF64 files don't)
+static inline uint32_t FramesLeft(uint32_t source_frame)
+{
+    uint64_t frames = track.bytes_left / source_frame;
+
+    return (frames < UINT32_MAX / 8) ? (uint32_t)frames : UINT32_MAX / 8;
+}
+
+player_ret_t Player_Init(fs_driver_t *fs, const codec_t *codec, const audio_driver_t *audio, ring_t *ring)
+{
+    if (fs == NULL || codec == NULL || audio == NULL || ring == NULL)
+    {
+        return PLAYER_ERROR_NULL_PARAMETER;
+    }
+
+    player_fs = fs;
+    player_codec = codec;
+    player_audio = audio;
+    player_ring = ring;
+    player_ring_buffer = ring->buffer;
+    player_ring_capacity = ring->size;
+    track.open = 0;
+
+    // For timing reads (see Read)
+    Cycles_Init();
+
+    PCM_DitherInit(&dither, DITHER_SEED, PCM_SHAPING_SECOND_ORDER);
+
+    return PLAYER_SUCCESS;
+}
+
+// Pick a format and clock the sink for it. Falls back to a fixed rate if the sink can't hit the track's.
+static player_ret_t Negotiate(const audio_format_t *source)
+{
+    const audio_format_t *formats;
+    size_t count;
+
+    if (player_audio->GetFormats(&formats, &count) != AUDIO_SUCCESS)
+    {
+        return PLAYER_ERROR_UNABLE_TO_CONFIGURE;
+    }
+
+    if (Format_Negotiate(source, formats, count, AUDIO_RATE_ANY, &track.plan) != FORMAT_SUCCESS)
+    {
+        return PLAYER_ERROR_FORMAT_UNSUPPORTED;
+    }
+
+    audio_ret_t res = player_audio->Configure(&track.plan.sink, &track.rate_error_ppm);
+
+    if (res == AUDIO_ERROR_RATE_UNSUPPORTED)
+    {
+        if (Format_Negotiate(source, formats, count, PLAYER_FALLBACK_RATE, &track.plan) != FORMAT_SUCCESS)
+        {
+            return PLAYER_ERROR_FORMAT_UNSUPPORTED;
+        }
+
+        res = player_audio->Configure(&track.plan.sink, &track.rate_error_ppm);
+    }
+
+    if (res != AUDIO_SUCCESS)
+    {
+        return PLAYER_ERROR_UNABLE_TO_CONFIGURE;
+    }
+
+    // TODO: resampler. Until then a track that needs one can't be played.
+    if (track.plan.stages & FORMAT_STAGE_RESAMPLE)
+    {
+        return PLAYER_ERROR_FORMAT_UNSUPPORTED;
+    }
+
+    return PLAYER_SUCCESS;
+}
+
+static inline uint32_t BytesPerSecond(void)
+{
+    return track.plan.sink.sample_rate * Audio_BytesPerFrame(&track.plan.sink);
+}
+
+// Every file read is timed: the histogram of these is what the ring's depth is sized by (see depth.h)
+static fs_ret_t Read(void *buffer, size_t length)
+{
+    uint32_t start = Cycles_Now();
+    fs_ret_t res = player_fs->ops->ReadFile(&track.file, buffer, length);
+
+    Depth_Sample((Cycles_Now() - start) / (SystemCoreClock / 1000000));
+    track.sampled = 1;
+
+    return res;
+}
+
+// Free space Fill may use: up to the depth, not the ring's size, so the ring drains down to a smaller depth
+static uint32_t Room(void)
+{
+    uint32_t used = Ring_Used(player_ring);
+
+    return (track.depth_b > used) ? Min(track.depth_b - used, Ring_Free(player_ring)) : 0;
+}
+
+// Reading in the card's preferred size, but never so much that the ring runs half empty waiting for room
+static inline void SetFillBytes(void)
+{
+    track.fill_bytes = Min(player_fs->read_size_b, player_ring->size / 2);
+}
+
+/*
+ * Take on whatever Depth decided. The read-ahead changes straight away. Growing the ring does too, but shrinking
+ * has to wait until what's queued fits, which is what Room is for. Only ever between Fills: Ring_Resize moves the
+ * queued audio around, and nothing may be reading from or writing into the ring meanwhile.
+ */
+static void Adapt(void)
+{
+    if (track.sampled)
+    {
+        uint32_t readahead_b = track.readahead_b;
+
+        track.sampled = 0;
+        Depth_Update(BytesPerSecond(), player_fs->read_size_b, &track.depth_b, &readahead_b);
+        track.depth_b = Min(track.depth_b, player_ring_capacity);
+
+        if (readahead_b != track.readahead_b && player_fs->ops->SetReadAhead != NULL)
+        {
+            player_fs->ops->SetReadAhead(readahead_b);
+            track.readahead_b = readahead_b;
+        }
+    }
+
+    if (track.depth_b != player_ring->size && Ring_Resize(player_ring, track.depth_b) == RING_SUCCESS)
+    {
+        SetFillBytes();
+    }
+}
+
+player_ret_t Player_PrepareTrack(char *filename, player_track_t *prepared)
+{
+    if (player_fs == NULL || prepared == NULL)
+    {
+        return PLAYER_ERROR_NULL_PARAMETER;
+    }
+
+    prepared->ready = 0;
+
+    if (player_fs->ops->OpenFile(&prepared->file, filename) != FS_SUCCESS)
+    {
+        return PLAYER_ERROR_UNABLE_TO_OPEN_TRACK;
+    }
+
+    // The header goes in scratch, which Fill only needs within a call. It's read as far as the codec asks:
+    // there can be other chunks (tags, padding, album art) before the audio, and the codec has the ones it doesn't
+    // need seeked over. Marked as filling meanwhile, so that Stream, from the yield hook while the card is busy,
+    // keeps its hands off scratch too.
+    uint8_t *header = (uint8_t *)scratch;
+    uint64_t header_offset = 0;
+    uint64_t offset = 0;
+    size_t header_read = 0;
+    size_t header_len = WAV_HEADER_LEN;
+    codec_ret_t parsed = CODEC_NEED_MORE;
+    player_ret_t res = PLAYER_ERROR_INVALID_TRACK;
+    uint8_t filling = track.filling;
+
+    track.filling = 1;
+
+    while (parsed == CODEC_NEED_MORE && header_len <= sizeof(scratch))
+    {
+        // Further on in the file: from there, into the start of scratch
+        if (offset != header_offset)
+        {
+            if (player_fs->ops->SeekFile == NULL || player_fs->ops->SeekFile(&prepared->file, offset) != FS_SUCCESS)
+            {
+                res = PLAYER_ERROR_UNABLE_TO_READ;
+                break;
+            }
+
+            header_offset = offset;
+            header_read = 0;
+        }
+
+        if (header_len <= header_read)
+        {
+            break;
+        }
+
+        if (player_fs->ops->ReadFile(&prepared->file, header + header_read, header_len - header_read)
+                != FS_SUCCESS)
+        {
+            res = PLAYER_ERROR_UNABLE_TO_READ;
+            break;
+        }
+
+        header_read = header_len;
+        parsed = player_codec->ValidateHeader(header, &prepared->metadata, &offset, &header_len);
+    }
+
+    track.filling = filling;
+
+    if (parsed == CODEC_SUCCESS && player_codec->GetFormat(&prepared->metadata, &prepared->source) == CODEC_SUCCESS)
+    {
+        res = PLAYER_SUCCESS;
+    }
+
+    if (res != PLAYER_SUCCESS)
+    {
+        player_fs->ops->CloseFile(&prepared->file);
+        return res;
+    }
+
+    prepared->data_offset = (uint32_t)offset;
+    prepared->ready = 1;
+
+    return PLAYER_SUCCESS;
+}
+
+player_ret_t Player_DiscardPrepared(player_track_t *prepared)
+{
+    if (player_fs == NULL || prepared == NULL)
+    {
+        return PLAYER_ERROR_NULL_PARAMETER;
+    }
+
+    if (!prepared->ready)
+    {
+        return PLAYER_ERROR_NO_TRACK;
+    }
+
+    prepared->ready = 0;
+
+    if (player_fs->ops->CloseFile(&prepared->file) != FS_SUCCESS)
+    {
+        return PLAYER_ERROR_GENERIC;
+    }
+
+    return PLAYER_SUCCESS;
+}
+
+player_ret_t Player_OpenTrack(char *filename)
+{
+    player_track_t prepared;
+    player_ret_t res = Player_PrepareTrack(filename, &prepared);
+
+    if (res != PLAYER_SUCCESS)
+    {
+        return res;
+    }
+
+    return Player_OpenPrepared(&prepared);
+}
+
+player_ret_t Player_OpenPrepared(player_track_t *prepared)
+{
+    if (player_fs == NULL || prepared == NULL)
+    {
+        return PLAYER_ERROR_NULL_PARAMETER;
+    }
+
+    if (!prepared->ready)
+    {
+        return PLAYER_ERROR_NO_TRACK;
+    }
+
+    if (track.open)
+    {
+        Player_CloseTrack();
+    }
+
+    // The file is the track's now, whatever happens next
+    track.file = prepared->file;
+    track.metadata = prepared->metadata;
+    prepared->ready = 0;
+
+    player_ret_t res = Negotiate(&prepared->source);
+
+    if (res != PLAYER_SUCCESS)
+    {
+        player_fs->ops->CloseFile(&track.file);
+        return res;
+    }
+
+    // Only whole frames, in case the data chunk has a stray byte at the end
+    uint64_t frame_bytes = Audio_BytesPerFrame(&track.plan.source);
+    track.data_bytes = track.metadata.data_size - (track.metadata.data_size % frame_bytes);
+    track.data_offset = prepared->data_offset;
+    track.bytes_left = track.data_bytes;
+    track.open = 1;
+
+    // As deep as the reads so far say this card needs at this rate (or the profile, or everything, before
+    // there are any). Without Depth_Init, that's everything.
+    track.depth_b = player_ring_capacity;
+    track.readahead_b = 0;
+    track.sampled = 0;
+
+    Depth_Update(BytesPerSecond(), player_fs->read_size_b, &track.depth_b, &track.readahead_b);
+    track.depth_b = Min(track.depth_b, player_ring_capacity);
+
+    if (track.readahead_b > 0 && player_fs->ops->SetReadAhead != NULL)
+    {
+        player_fs->ops->SetReadAhead(track.readahead_b);
+    }
+
+    if (Ring_Init(player_ring, player_ring_buffer, track.depth_b) != RING_SUCCESS)
+    {
+        player_fs->ops->CloseFile(&track.file);
+        track.open = 0;
+        return PLAYER_ERROR_GENERIC;
+    }
+
+    SetFillBytes();
+
+    PCM_DitherReset(&dither);
+
+    // The meter sees the ring, so it has to be told what the sink format looks like.
+    // It's only a tap, so a failure here is not a reason to stop playback.
+    Meter_Init(player_ring, track.plan.sink.channels, Audio_BytesPerSample(track.plan.sink.packing),
+            track.plan.sink.sample_rate);
+
+    return PLAYER_SUCCESS;
+}
+
+player_ret_t Player_CloseTrack(void)
+{
+    if (!track.open)
+    {
+        return PLAYER_ERROR_NO_TRACK;
+    }
+
+    track.open = 0;
+
+    // No stream to make room for any more
+    if (player_fs->ops->SetIOClass != NULL)
+    {
+        player_fs->ops->SetIOClass(FS_IO_REALTIME, 0);
+    }
+
+    if (player_fs->ops->CloseFile(&track.file) != FS_SUCCESS)
+    {
+        return PLAYER_ERROR_GENERIC;
+    }
+
+    return PLAYER_SUCCESS;
+}
+
+/*
+ * Packed 24-bit frames (3 or 6 bytes) don't divide the ring size, so once per lap a frame straddles the wrap.
+ * That one frame goes through a small buffer and Ring_Write(), which splits it for us.
+ */
+static player_ret_t FillStraddle(uint32_t source_frame, uint32_t sink_frame)
+{
+    uint32_t source[2];
+    uint32_t sink[2];
+
+    if (Read(source, source_frame) != FS_SUCCESS)
+    {
+        return PLAYER_ERROR_UNABLE_TO_READ;
+    }
+
+    if (Format_Convert(&track.plan, &dither, sink, source, 1) != FORMAT_SUCCESS)
+    {
+        return PLAYER_ERROR_FORMAT_UNSUPPORTED;
+    }
+
+    Ring_Write(player_ring, sink, sink_frame);
+    track.bytes_left -= source_frame;
+
+    return PLAYER_SUCCESS;
+}
+
+// Our reads are real-time, and due by the time the ring runs dry. Kept up to date even when we don't read,
+// since that's what background work is held back by.
+static void PublishDeadline(uint32_t sink_frame)
+{
+    if (player_fs->ops->SetIOClass == NULL)
+    {
+        return;
+    }
+
+    uint32_t bytes_per_s = track.plan.sink.sample_rate * sink_frame;
+    uint32_t budget_ms = (bytes_per_s > 0) ? (uint32_t)(((uint64_t)Ring_Used(player_ring) * 1000) / bytes_per_s) : 0;
+
+    // 0 would mean the stream has stopped
+    player_fs->ops->SetIOClass(FS_IO_REALTIME, (budget_ms > 0) ? budget_ms : 1);
+}
+
+// Top up the ring from the file
+static player_ret_t Fill(void)
+{
+    uint32_t source_frame = Audio_BytesPerFrame(&track.plan.source);
+    uint32_t sink_frame = Audio_BytesPerFrame(&track.plan.sink);
+
+    PublishDeadline(sink_frame);
+
+    if (track.bytes_left < source_frame || Room() < sink_frame)
+    {
+        return PLAYER_SUCCESS;
+    }
+
+    // Wait until a worthwhile read fits (or whatever's left of the track does)
+    uint32_t remaining = FramesLeft(source_frame) * sink_frame;
+
+    if (Room() < Min(track.fill_bytes, remaining))
+    {
+        return PLAYER_SUCCESS;
+    }
+
+    uint8_t *region;
+    uint32_t frames = Min(Ring_PeekWrite(player_ring, &region), Room()) / sink_frame;
+    frames = Min(frames, FramesLeft(source_frame));
+
+    if (frames == 0)
+    {
+        return FillStraddle(source_frame, sink_frame);
+    }
+
+    if (track.plan.stages == FORMAT_STAGE_NONE)
+    {
+        // Passthrough: straight from the file into the ring
+        if (Read(region, frames * source_frame) != FS_SUCCESS)
+        {
+            return PLAYER_ERROR_UNABLE_TO_READ;
+        }
+    }
+    else
+    {
+        frames = Min(frames, sizeof(scratch) / source_frame);
+
+        if (Read(scratch, frames * source_frame) != FS_SUCCESS)
+        {
+            return PLAYER_ERROR_UNABLE_TO_READ;
+        }
+
+        if (Format_Convert(&track.plan, &dither, region, scratch, frames) != FORMAT_SUCCESS)
+        {
+            return PLAYER_ERROR_FORMAT_UNSUPPORTED;
+        }
+    }
+
+    Ring_Commit(player_ring, frames * sink_frame);
+    track.bytes_left -= frames * source_frame;
+
+    // Further out now, which is what lets background work back in
+    PublishDeadline(sink_frame);
+
+    return PLAYER_SUCCESS;
+}
+
+// One block from the ring to the sink. Only touches what Fill has already committed, so it can run in the middle
+// of a Fill (from the yield hook), apart from the straddling frame, which needs the scratch buffer.
+static player_ret_t Stream(void)
+{
+    const uint8_t *region;
+    uint32_t sink_frame = Audio_BytesPerFrame(&track.plan.sink);
+    uint32_t length = Min(Ring_PeekRead(player_ring, &region), PLAYER_STREAM_BYTES);
+    length -= length % sink_frame;
+
+    // A packed 24-bit frame straddling the wrap (see FillStraddle). Copy it out, along with whatever follows.
+    if (length == 0)
+    {
+        if (track.filling || Ring_Used(player_ring) < sink_frame)
+        {
+            return PLAYER_SUCCESS;
+        }
+
+        length = Min(Ring_Used(player_ring), PLAYER_STREAM_BYTES);
+        length -= length % sink_frame;
+
+        Ring_Read(player_ring, scratch, length);
+
+        if (player_audio->Stream(scratch, length) != AUDIO_SUCCESS)
+        {
+            return PLAYER_ERROR_UNABLE_TO_STREAM;
+        }
+
+        return PLAYER_SUCCESS;
+    }
+
+    // Stream() is synchronous for now, so the block can be released as soon as it returns
+    if (player_audio->Stream((void *)region, length) != AUDIO_SUCCESS)
+    {
+        return PLAYER_ERROR_UNABLE_TO_STREAM;
+    }
+
+    Ring_Consume(player_ring, length);
+
+    return PLAYER_SUCCESS;
+}
+
+player_ret_t Player_Service(void)
+{
+    if (!track.open)
+    {
+        return PLAYER_ERROR_NO_TRACK;
+    }
+
+    track.filling = 1;
+    player_ret_t res = Fill();
+    track.filling = 0;
+
+    if (res != PLAYER_SUCCESS)
+    {
+        Player_CloseTrack();
+        return res;
+    }
+
+    Adapt();
+
+    // Nothing queued and nothing left to read: the track is done
+    if (Ring_Used(player_ring) < Audio_BytesPerFrame(&track.plan.sink))
+    {
+        if (track.bytes_left == 0)
+        {
+            Player_CloseTrack();
+        }
+
+        return PLAYER_SUCCESS;
+    }
+
+    return Stream();
+}
+
+player_ret_t Player_Pump(void)
+{
+    if (!track.open)
+    {
+        return PLAYER_ERROR_NO_TRACK;
+    }
+
+    return Stream();
+}
+
+uint8_t Player_IsPlaying(void)
+{
+    return track.open;
+}
+
+player_ret_t Player_Seek(uint64_t frame)
+{
+    if (!track.open)
+    {
+        return PLAYER_ERROR_NO_TRACK;
+    }
+
+    if (player_fs->ops->SeekFile == NULL)
+    {
+        return PLAYER_ERROR_UNABLE_TO_SEEK;
+    }
+
+    uint64_t frame_bytes = Audio_BytesPerFrame(&track.plan.source);
+
+    if (frame > track.data_bytes / frame_bytes)
+    {
+        return PLAYER_ERROR_UNABLE_TO_SEEK;
+    }
+
+    // Emptied first: if the card's busy with the seek, Stream (from the yield hook) finds nothing to hand on.
+    // Neither side is running here, Stream only ever runs from our own calls.
+    Ring_Reset(player_ring);
+
+    if (player_fs->ops->SeekFile(&track.file, track.data_offset + frame * frame_bytes) != FS_SUCCESS)
+    {
+        return PLAYER_ERROR_UNABLE_TO_SEEK;
+    }
+
+    track.bytes_left = track.data_bytes - frame * frame_bytes;
+
+    // What's next has nothing to do with what the dither and the meter saw last
+    PCM_DitherReset(&dither);
+    Meter_Init(player_ring, track.plan.sink.channels, Audio_BytesPerSample(track.plan.sink.packing),
+            track.plan.sink.sample_rate);
+
+    return PLAYER_SUCCESS;
+}
+
+player_ret_t Player_GetPosition(uint64_t *frame)
+{
+    if (frame == NULL)
+    {
+        return PLAYER_ERROR_NULL_PARAMETER;
+    }
+
+    if (!track.open)
+    {
+        return PLAYER_ERROR_NO_TRACK;
+    }
+
+    uint64_t read = (track.data_bytes - track.bytes_left) / Audio_BytesPerFrame(&track.plan.source);
+    uint64_t queued = Ring_Used(player_ring) / Audio_BytesPerFrame(&track.plan.sink);
+
+    *frame = (read > queued) ? read - queued : 0;
+
+    return PLAYER_SUCCESS;
+}
+
+player_ret_t Player_GetPlan(format_plan_t *plan, int32_t *rate_error_ppm)
+{
+    if (plan == NULL)
+    {
+        return PLAYER_ERROR_NULL_PARAMETER;
+    }
+
+    if (!track.open)
+    {
+        return PLAYER_ERROR_NO_TRACK;
+    }
+
+    *plan = track.plan;
+
+    if (rate_error_ppm != NULL)
+    {
+        *rate_error_ppm = track.rate_error_ppm;
+    }
+
+    return PLAYER_SUCCESS;
+}
@@ -0,0 +1,897 @@
+/*
+ * playlist.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#include "playlist.h"
+
+#include <string.h>
+
+// What the window is read in multiples of, and lined up with
+#define SECTOR_B 512
+
+// No entry handed over yet
+#define NO_ENTRY UINT32_MAX
+
+typedef enum
+{
+    LINE_OTHER = 0,                         // blank, a comment, or something we don't need
+    LINE_PATH,                              // an entry: M3U's path, PLS's FileN=
+    LINE_TITLE                              // #EXTINF or TitleN=
+} line_kind_t;
+
+static fs_driver_t *playlist_fs;
+
+static struct
+{
+    uint8_t open;
+    file_t file;
+    char name[PLAYLIST_MAX_PATH];           // the playlist's own path: file.filename points at it
+    uint32_t folder_length;                 // of name's folder, its slash included
+    uint32_t size;
+    uint32_t first;                         // the first line, after any byte order mark
+    playlist_kind_t kind;
+
+    // Bytes window_start to window_start + window_length of the file
+    uint8_t window[PLAYLIST_WINDOW];
+    uint32_t window_start;
+    uint32_t window_length;
+    char line[PLAYLIST_MAX_LINE];
+
+    // The entry handed over last (NO_ENTRY before the first), and where the one after it starts
+    uint32_t current;
+    uint32_t after;
+    uint32_t after_number;
+
+    // Where to look for the entry after the last one got ready
+    uint32_t scan;
+    uint32_t scan_number;
+    uint8_t at_end;
+
+    // The tracks got ready, oldest first, and where the entry after each starts
+    playlist_entry_t queue[PLAYLIST_PREFETCH];
+    uint32_t ends[PLAYLIST_PREFETCH];
+    uint32_t head;
+    uint32_t queued;
+
+    playlist_stats_t stats;
+} playlist;
+
+static inline uint32_t Min(uint32_t a, uint32_t b)
+{
+    return (a < b) ? a : b;
+}
+
+static inline char Fold(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+}
+
+static inline uint8_t IsBlank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+// Whether text starts with prefix (lowercase), ignoring case
+static uint8_t StartsWith(const char *text, const char *prefix)
+{
+    for (; *prefix != '\0'; text++, prefix++)
+    {
+        if (Fold(*text) != *prefix)
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static void CopyString(char *dst, const char *src, size_t size)
+{
+    strncpy(dst, src, size - 1);
+    dst[size - 1] = '\0';
+}
+
+// Playing a playlist isn't in a hurry, but shouldn't wait behind background work either
+static void SetIOClass(fs_io_class_t io_class)
+{
+    if (playlist_fs->ops->SetIOClass != NULL)
+    {
+        playlist_fs->ops->SetIOClass(io_class, 0);
+    }
+}
+
+playlist_ret_t Playlist_Init(fs_driver_t *fs)
+{
+    if (fs == NULL)
+    {
+        return PLAYLIST_ERROR_NULL_PARAMETER;
+    }
+
+    playlist_fs = fs;
+    playlist.open = 0;
+
+    return PLAYLIST_SUCCESS;
+}
+
+/*
+ * Reading
+ */
+
+// The window, from the sector offset is in (going forwards) or the one before (going backwards): either way, at
+// least a sector of what's next is in it
+static playlist_ret_t Load(uint32_t offset, uint8_t backwards)
+{
+    uint32_t start = offset - offset % SECTOR_B;
+
+    if (backwards)
+    {
+        start = (start >= PLAYLIST_WINDOW - SECTOR_B) ? start - (PLAYLIST_WINDOW - SECTOR_B) : 0;
+    }
+
+    uint32_t length = Min(PLAYLIST_WINDOW, playlist.size - start);
+
+    if (playlist_fs->ops->ReadFileFrom(&playlist.file, start, playlist.window, length) != FS_SUCCESS)
+    {
+        return PLAYLIST_ERROR_UNABLE_TO_READ;
+    }
+
+    playlist.window_start = start;
+    playlist.window_length = length;
+    playlist.stats.window_reads++;
+
+    return PLAYLIST_SUCCESS;
+}
+
+// The byte at offset (before the end), from the window, which is read there if it isn't in it
+static inline playlist_ret_t ByteAt(uint32_t offset, uint8_t backwards, uint8_t *byte)
+{
+    if (offset - playlist.window_start >= playlist.window_length)
+    {
+        playlist_ret_t res = Load(offset, backwards);
+
+        if (res != PLAYLIST_SUCCESS)
+        {
+            return res;
+        }
+    }
+
+    *byte = playlist.window[offset - playlist.window_start];
+
+    return PLAYLIST_SUCCESS;
+}
+
+// The line at *offset, without its end and the blanks around it, into *text (in playlist.line), and *offset on to
+// the next one. *too_long if it doesn't fit: it's gone past all the same. PLAYLIST_END at the end of the file.
+static playlist_ret_t ReadLine(uint32_t *offset, char **text, uint8_t *too_long)
+{
+    char *line = playlist.line;
+    uint32_t length = 0;
+    uint8_t byte;
+
+    *too_long = 0;
+
+    if (*offset >= playlist.size)
+    {
+        return PLAYLIST_END;
+    }
+
+    while (*offset < playlist.size)
+    {
+        playlist_ret_t res = ByteAt(*offset, 0, &byte);
+
+        if (res != PLAYLIST_SUCCESS)
+        {
+            return res;
+        }
+
+        (*offset)++;
+
+        if (byte == '\n')
+        {
+            break;
+        }
+
+        if (length < PLAYLIST_MAX_LINE - 1)
+        {
+            line[length++] = (char)byte;
+        }
+        else
+        {
+            *too_long = 1;
+        }
+    }
+
+    while (length > 0 && IsBlank(line[length - 1]))
+    {
+        length--;
+    }
+
+    line[length] = '\0';
+
+    while (IsBlank(*line))
+    {
+        line++;
+    }
+
+    *text = line;
+
+    return PLAYLIST_SUCCESS;
+}
+
+// The start of the line before the one at line (which isn't the first)
+static playlist_ret_t LineBefore(uint32_t *line)
+{
+    uint32_t at = *line - 1;                // the line before's end
+    uint8_t byte;
+
+    while (at > playlist.first)
+    {
+        playlist_ret_t res = ByteAt(at - 1, 1, &byte);
+
+        if (res != PLAYLIST_SUCCESS)
+        {
+            return res;
+        }
+
+        if (byte == '\n')
+        {
+            break;
+        }
+
+        at--;
+    }
+
+    *line = at;
+
+    return PLAYLIST_SUCCESS;
+}
+
+/*
+ * Parsing
+ */
+
+// What a line is, and *value, what comes with it: the path or the title
+static line_kind_t Classify(char *text, char **value)
+{
+    if (playlist.kind == PLAYLIST_M3U)
+    {
+        if (text[0] == '\0')
+        {
+            return LINE_OTHER;
+        }
+
+        if (text[0] != '#')
+        {
+            *value = text;
+            return LINE_PATH;
+        }
+
+        if (!StartsWith(text, "#extinf:"))
+        {
+            return LINE_OTHER;
+        }
+
+        // #EXTINF:seconds,title (there can be attributes before the comma, too)
+        char *comma = strchr(text, ',');
+        *value = (comma != NULL) ? comma + 1 : text + strlen(text);
+    }
+    else
+    {
+        uint32_t key = StartsWith(text, "file") ? 4 : StartsWith(text, "title") ? 5 : 0;
+        char *at = text + key;
+
+        if (key == 0 || *at < '0' || *at > '9')
+        {
+            return LINE_OTHER;
+        }
+
+        while (*at >= '0' && *at <= '9')
+        {
+            at++;
+        }
+
+        while (IsBlank(*at))
+        {
+            at++;
+        }
+
+        if (*at != '=')
+        {
+            return LINE_OTHER;
+        }
+
+        *value = at + 1;
+
+        if (key == 4)
+        {
+            while (IsBlank(**value))
+            {
+                (*value)++;
+            }
+
+            return LINE_PATH;
+        }
+    }
+
+    while (IsBlank(**value))
+    {
+        (*value)++;
+    }
+
+    return LINE_TITLE;
+}
+
+/*
+ * Where an entry is on the card, into path, relative to the root: 0 if it isn't on the card.
+ * Relative to the playlist's folder, unless it starts at the root (a slash, and maybe a drive letter before it, which
+ * can only be this card). Taken apart at the slashes, either way round: "." goes, ".." takes the folder before.
+ */
+static uint8_t Resolve(const char *raw, char *path)
+{
+    uint32_t length = 0;
+
+    // URLs, file:// ones included: those are some other machine's paths
+    if (strstr(raw, "://") != NULL)
+    {
+        return 0;
+    }
+
+    if (((raw[0] >= 'A' && raw[0] <= 'Z') || (raw[0] >= 'a' && raw[0] <= 'z')) && raw[1] == ':')
+    {
+        raw += 2;
+    }
+
+    if (raw[0] != '/' && raw[0] != '\\')
+    {
+        memcpy(path, playlist.name, playlist.folder_length);
+        length = playlist.folder_length;
+    }
+
+    // Each folder in path with its slash after it, so the last one's is where the terminator goes
+    while (*raw != '\0')
+    {
+        const char *end = raw;
+
+        while (*end != '\0' && *end != '/' && *end != '\\')
+        {
+            end++;
+        }
+
+        uint32_t part = (uint32_t)(end - raw);
+
+        if (part == 2 && raw[0] == '.' && raw[1] == '.')
+        {
+            // Above the root
+            if (length == 0)
+            {
+                return 0;
+            }
+
+            length--;
+
+            while (length > 0 && path[length - 1] != '/')
+            {
+                length--;
+            }
+        }
+        else if (part > 0 && !(part == 1 && raw[0] == '.'))
+        {
+            if (length + part + 1 > PLAYLIST_MAX_PATH)
+            {
+                return 0;
+            }
+
+            memcpy(path + length, raw, part);
+            length += part;
+            path[length++] = '/';
+        }
+
+        raw = (*end != '\0') ? end + 1 : end;
+    }
+
+    if (length == 0)
+    {
+        return 0;
+    }
+
+    path[length - 1] = '\0';
+
+    return 1;
+}
+
+// The entry that starts at or after *offset, resolved (path empty if it can't be), and *offset on past it.
+// It starts at M3U's #EXTINF, if there's one before its path, and takes in PLS's lines after its FileN=.
+static playlist_ret_t ParseEntry(uint32_t *offset, playlist_entry_t *entry)
+{
+    char *text;
+    char *value;
+    uint8_t too_long;
+    playlist_ret_t res;
+
+    entry->title[0] = '\0';
+    entry->offset = NO_ENTRY;
+
+    for (;;)
+    {
+        uint32_t start = *offset;
+
+        if ((res = ReadLine(offset, &text, &too_long)) != PLAYLIST_SUCCESS)
+        {
+            return res;
+        }
+
+        line_kind_t kind = too_long ? LINE_OTHER : Classify(text, &value);
+
+        if (kind == LINE_TITLE && playlist.kind == PLAYLIST_M3U)
+        {
+            CopyString(entry->title, value, sizeof(entry->title));
+            entry->offset = start;
+        }
+        else if (kind == LINE_PATH)
+        {
+            if (entry->offset == NO_ENTRY)
+            {
+                entry->offset = start;
+            }
+
+            if (!Resolve(value, entry->path))
+            {
+                entry->path[0] = '\0';
+            }
+
+            break;
+        }
+    }
+
+    // PLS: up to the next FileN=, for this one's TitleN=
+    while (playlist.kind == PLAYLIST_PLS)
+    {
+        uint32_t start = *offset;
+
+        if ((res = ReadLine(offset, &text, &too_long)) == PLAYLIST_END)
+        {
+            break;
+        }
+
+        if (res != PLAYLIST_SUCCESS)
+        {
+            return res;
+        }
+
+        line_kind_t kind = too_long ? LINE_OTHER : Classify(text, &value);
+
+        if (kind == LINE_PATH)
+        {
+            *offset = start;
+            break;
+        }
+
+        if (kind == LINE_TITLE)
+        {
+            CopyString(entry->title, value, sizeof(entry->title));
+        }
+    }
+
+    return PLAYLIST_SUCCESS;
+}
+
+// The start of the entry before the one that starts at *at: back a line at a time to the path before, then, for
+// M3U, its #EXTINF, if that's the line before it
+static playlist_ret_t FindPrevious(uint32_t *at)
+{
+    uint32_t line = *at;
+    char *text;
+    char *value;
+    uint8_t too_long;
+    playlist_ret_t res;
+
+    while (line > playlist.first)
+    {
+        uint32_t offset;
+
+        if ((res = LineBefore(&line)) != PLAYLIST_SUCCESS)
+        {
+            return res;
+        }
+
+        offset = line;
+
+        if ((res = ReadLine(&offset, &text, &too_long)) != PLAYLIST_SUCCESS)
+        {
+            return res;
+        }
+
+        if (too_long || Classify(text, &value) != LINE_PATH)
+        {
+            continue;
+        }
+
+        if (playlist.kind == PLAYLIST_M3U && line > playlist.first)
+        {
+            uint32_t title = line;
+
+            if ((res = LineBefore(&title)) != PLAYLIST_SUCCESS)
+            {
+                return res;
+            }
+
+            offset = title;
+
+            if ((res = ReadLine(&offset, &text, &too_long)) != PLAYLIST_SUCCESS)
+            {
+                return res;
+            }
+
+            if (!too_long && Classify(text, &value) == LINE_TITLE)
+            {
+                line = title;
+            }
+        }
+
+        *at = line;
+
+        return PLAYLIST_SUCCESS;
+    }
+
+    return PLAYLIST_END;
+}
+
+/*
+ * The queue
+ */
+
+// Look at the scan's next entry, and if it can be played, get it ready at the back of the queue (which has room).
+// PLAYLIST_END once there are no more.
+static playlist_ret_t Step(void)
+{
+    if (playlist.at_end)
+    {
+        return PLAYLIST_END;
+    }
+
+    uint32_t slot = (playlist.head + playlist.queued) % PLAYLIST_PREFETCH;
+    playlist_entry_t *entry = &playlist.queue[slot];
+    playlist_ret_t res = ParseEntry(&playlist.scan, entry);
+
+    if (res == PLAYLIST_END)
+    {
+        playlist.at_end = 1;
+    }
+
+    if (res != PLAYLIST_SUCCESS)
+    {
+        return res;
+    }
+
+    entry->number = playlist.scan_number++;
+    playlist.stats.entries++;
+
+    if (entry->path[0] == '\0' || Player_PrepareTrack(entry->path, &entry->track) != PLAYER_SUCCESS)
+    {
+        playlist.stats.skipped++;
+        return PLAYLIST_SUCCESS;
+    }
+
+    playlist.ends[slot] = playlist.scan;
+    playlist.queued++;
+
+    return PLAYLIST_SUCCESS;
+}
+
+// The front of the queue, handed over: it's the current entry now
+static void Pop(playlist_entry_t *entry)
+{
+    *entry = playlist.queue[playlist.head];
+    entry->track.file.filename = entry->path;
+
+    playlist.current = entry->offset;
+    playlist.after = playlist.ends[playlist.head];
+    playlist.after_number = entry->number + 1;
+
+    playlist.head = (playlist.head + 1) % PLAYLIST_PREFETCH;
+    playlist.queued--;
+}
+
+// Close what's been got ready, and look again from after the current entry
+static void Discard(void)
+{
+    while (playlist.queued > 0)
+    {
+        Player_DiscardPrepared(&playlist.queue[playlist.head].track);
+        playlist.head = (playlist.head + 1) % PLAYLIST_PREFETCH;
+        playlist.queued--;
+    }
+
+    playlist.head = 0;
+    playlist.scan = playlist.after;
+    playlist.scan_number = playlist.after_number;
+    playlist.at_end = 0;
+}
+
+/*
+ * Playing
+ */
+
+playlist_ret_t Playlist_Open(const char *filename)
+{
+    if (playlist_fs == NULL)
+    {
+        return PLAYLIST_ERROR_NOT_INITIALIZED;
+    }
+
+    if (filename == NULL)
+    {
+        return PLAYLIST_ERROR_NULL_PARAMETER;
+    }
+
+    const struct fs_operations *ops = playlist_fs->ops;
+
+    if (ops->ReadFileFrom == NULL || ops->FindFirst == NULL)
+    {
+        return PLAYLIST_ERROR_UNSUPPORTED;
+    }
+
+    if (playlist.open)
+    {
+        Playlist_Close();
+    }
+
+    size_t length = strlen(filename);
+
+    if (length >= PLAYLIST_MAX_PATH)
+    {
+        return PLAYLIST_ERROR_UNABLE_TO_OPEN;
+    }
+
+    memcpy(playlist.name, filename, length + 1);
+
+    const char *slash = strrchr(playlist.name, '/');
+    playlist.folder_length = (slash != NULL) ? (uint32_t)(slash - playlist.name) + 1 : 0;
+
+    SetIOClass(FS_IO_NORMAL);
+
+    // Its size, from its folder's listing: what it's read up to
+    char folder[PLAYLIST_MAX_PATH];
+    fs_dir_t dir;
+    fs_entry_t found;
+
+    memcpy(folder, playlist.name, playlist.folder_length);
+    folder[(playlist.folder_length > 0) ? playlist.folder_length - 1 : 0] = '\0';
+
+    fs_ret_t listed = ops->FindFirst(&dir, &found, folder, playlist.name + playlist.folder_length);
+    ops->CloseDir(&dir);
+
+    if (listed != FS_SUCCESS || found.name[0] == '\0' || found.is_dir)
+    {
+        return PLAYLIST_ERROR_UNABLE_TO_OPEN;
+    }
+
+    if (ops->OpenFile(&playlist.file, playlist.name) != FS_SUCCESS)
+    {
+        return PLAYLIST_ERROR_UNABLE_TO_OPEN;
+    }
+
+    playlist.open = 1;
+    playlist.size = (found.size < UINT32_MAX) ? (uint32_t)found.size : UINT32_MAX;
+    playlist.first = 0;
+    playlist.window_start = 0;
+    playlist.window_length = 0;
+    playlist.head = 0;
+    playlist.queued = 0;
+    memset(&playlist.stats, 0, sizeof(playlist.stats));
+
+    length = strlen(playlist.name);
+    playlist.kind = (length >= 4 && StartsWith(playlist.name + length - 4, ".pls")) ? PLAYLIST_PLS : PLAYLIST_M3U;
+
+    // The first window: a byte order mark, and [playlist] if it's a PLS, whatever it's called
+    if (playlist.size > 0)
+    {
+        uint32_t offset;
+        char *text;
+        uint8_t too_long;
+
+        if (Load(0, 0) != PLAYLIST_SUCCESS)
+        {
+            Playlist_Close();
+            return PLAYLIST_ERROR_UNABLE_TO_READ;
+        }
+
+        if (playlist.window_length >= 3 && memcmp(playlist.window, "\xEF\xBB\xBF", 3) == 0)
+        {
+            playlist.first = 3;
+        }
+
+        offset = playlist.first;
+
+        if (ReadLine(&offset, &text, &too_long) == PLAYLIST_SUCCESS && !too_long && StartsWith(text, "[playlist]"))
+        {
+            playlist.kind = PLAYLIST_PLS;
+        }
+    }
+
+    return Playlist_Rewind();
+}
+
+playlist_ret_t Playlist_Close(void)
+{
+    if (!playlist.open)
+    {
+        return PLAYLIST_ERROR_NOT_OPEN;
+    }
+
+    Discard();
+    playlist.open = 0;
+
+    if (playlist_fs->ops->CloseFile(&playlist.file) != FS_SUCCESS)
+    {
+        return PLAYLIST_ERROR_GENERIC;
+    }
+
+    return PLAYLIST_SUCCESS;
+}
+
+playlist_ret_t Playlist_Rewind(void)
+{
+    if (!playlist.open)
+    {
+        return PLAYLIST_ERROR_NOT_OPEN;
+    }
+
+    playlist.current = NO_ENTRY;
+    playlist.after = playlist.first;
+    playlist.after_number = 0;
+    Discard();
+
+    return PLAYLIST_SUCCESS;
+}
+
+playlist_ret_t Playlist_Service(void)
+{
+    if (!playlist.open)
+    {
+        return PLAYLIST_ERROR_NOT_OPEN;
+    }
+
+    if (playlist.queued == PLAYLIST_PREFETCH || playlist.at_end)
+    {
+        return PLAYLIST_READY;
+    }
+
+    // Background work: playback goes first
+    if (playlist_fs->ops->MayIssue != NULL && !playlist_fs->ops->MayIssue(FS_IO_IDLE))
+    {
+        return PLAYLIST_SUCCESS;
+    }
+
+    SetIOClass(FS_IO_IDLE);
+
+    uint32_t queued = playlist.queued;
+    playlist_ret_t res = Step();
+
+    if (res == PLAYLIST_END)
+    {
+        return PLAYLIST_READY;
+    }
+
+    if (playlist.queued > queued)
+    {
+        playlist.stats.prefetched++;
+    }
+
+    return res;
+}
+
+playlist_ret_t Playlist_Next(playlist_entry_t *entry)
+{
+    if (entry == NULL)
+    {
+        return PLAYLIST_ERROR_NULL_PARAMETER;
+    }
+
+    if (!playlist.open)
+    {
+        return PLAYLIST_ERROR_NOT_OPEN;
+    }
+
+    if (playlist.queued > 0)
+    {
+        playlist.stats.ready++;
+        Pop(entry);
+
+        return PLAYLIST_SUCCESS;
+    }
+
+    // Nothing ready: get it ready now, past however many can't be played
+    SetIOClass(FS_IO_NORMAL);
+
+    while (playlist.queued == 0)
+    {
+        playlist_ret_t res = Step();
+
+        if (res != PLAYLIST_SUCCESS)
+        {
+            return res;
+        }
+    }
+
+    playlist.stats.waited++;
+    Pop(entry);
+
+    return PLAYLIST_SUCCESS;
+}
+
+playlist_ret_t Playlist_Previous(playlist_entry_t *entry)
+{
+    if (entry == NULL)
+    {
+        return PLAYLIST_ERROR_NULL_PARAMETER;
+    }
+
+    if (!playlist.open)
+    {
+        return PLAYLIST_ERROR_NOT_OPEN;
+    }
+
+    if (playlist.current == NO_ENTRY)
+    {
+        return PLAYLIST_END;
+    }
+
+    // What's ready is for going forwards
+    Discard();
+    SetIOClass(FS_IO_NORMAL);
+
+    uint32_t at = playlist.current;
+    uint32_t number = playlist.after_number - 1;
+    playlist_entry_t *slot = &playlist.queue[0];
+    playlist_ret_t res;
+
+    while ((res = FindPrevious(&at)) == PLAYLIST_SUCCESS)
+    {
+        uint32_t end = at;
+
+        if ((res = ParseEntry(&end, slot)) != PLAYLIST_SUCCESS)
+        {
+            return res;
+        }
+
+        slot->number = --number;
+        playlist.stats.entries++;
+
+        if (slot->path[0] == '\0' || Player_PrepareTrack(slot->path, &slot->track) != PLAYER_SUCCESS)
+        {
+            playlist.stats.skipped++;
+            continue;
+        }
+
+        // Going forwards again from here
+        playlist.ends[0] = end;
+        playlist.queued = 1;
+        Pop(entry);
+        Discard();
+
+        return PLAYLIST_SUCCESS;
+    }
+
+    return res;
+}
+
+playlist_kind_t Playlist_Kind(void)
+{
+    return playlist.kind;
+}
+
+playlist_ret_t Playlist_GetStats(playlist_stats_t *stats)
+{
+    if (stats == NULL)
+    {
+        return PLAYLIST_ERROR_NULL_PARAMETER;
+    }
+
+    *stats = playlist.stats;
+
+    return PLAYLIST_SUCCESS;
+}
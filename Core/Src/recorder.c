@@ -0,0 +1,353 @@
+/*
+ * recorder.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#include "recorder.h"
+#include "cycles.h"
+
+#include <string.h>
+
+static fs_driver_t *recorder_fs;
+static const codec_t *recorder_codec;
+static ring_t *recorder_ring;
+
+static struct
+{
+    volatile uint8_t recording;     // read by Recorder_Capture, which may be an interrupt
+    file_t file;
+    audio_format_t format;
+    uint32_t frame_bytes;
+    uint32_t bytes_per_s;
+    uint64_t bytes;                 // audio written so far
+} session;
+
+static struct
+{
+    uint64_t reserved_b;
+    uint32_t writes;
+    uint32_t max_write_us;
+    uint64_t total_write_us;
+    uint32_t write_errors;
+
+    // Updated by Recorder_Capture
+    volatile uint32_t max_used_b;
+    volatile uint32_t overruns;
+    volatile uint64_t dropped_b;
+} stats;
+
+// Word-aligned like the ring, so it can go to the card without a bounce (see blk.h)
+static uint32_t header[RECORDER_HEADER_BYTES / sizeof(uint32_t)];
+
+static inline uint32_t Min(uint32_t a, uint32_t b)
+{
+    return (a < b) ? a : b;
+}
+
+recorder_ret_t Recorder_Init(fs_driver_t *fs, const codec_t *codec, ring_t *ring)
+{
+    if (fs == NULL || codec == NULL || ring == NULL)
+    {
+        return RECORDER_ERROR_NULL_PARAMETER;
+    }
+
+    // Whole writes straight out of the ring need the ring's wrap to fall on a write boundary, and a second write's
+    // worth of room for capture to go on into while the first one's on its way
+    if (ring->size < 2 * RECORDER_WRITE_BYTES || (ring->size % RECORDER_WRITE_BYTES) != 0)
+    {
+        return RECORDER_ERROR_RING_TOO_SMALL;
+    }
+
+    recorder_fs = fs;
+    recorder_codec = codec;
+    recorder_ring = ring;
+    session.recording = 0;
+
+    // For timing writes
+    Cycles_Init();
+
+    return RECORDER_SUCCESS;
+}
+
+// Our writes are real-time, due by the time capture would fill the ring
+static void PublishDeadline(void)
+{
+    if (recorder_fs->ops->SetIOClass == NULL)
+    {
+        return;
+    }
+
+    uint32_t budget_ms = (uint32_t)(((uint64_t)Ring_Free(recorder_ring) * 1000) / session.bytes_per_s);
+
+    // 0 would mean the stream has stopped
+    recorder_fs->ops->SetIOClass(FS_IO_REALTIME, (budget_ms > 0) ? budget_ms : 1);
+}
+
+// Every write is timed, for the stats: that's what the ring has to cover
+static recorder_ret_t Write(const uint8_t *data, uint32_t length)
+{
+    // In place: the codec's output is never longer than its input
+    if (recorder_codec->Encode != NULL
+            && recorder_codec->Encode((uint8_t *)data, data, length) != CODEC_SUCCESS)
+    {
+        return RECORDER_ERROR_FORMAT_UNSUPPORTED;
+    }
+
+    uint32_t start = Cycles_Now();
+    fs_ret_t res = recorder_fs->ops->WriteFile(&session.file, data, length);
+    uint32_t write_us = (Cycles_Now() - start) / (SystemCoreClock / 1000000);
+
+    stats.writes++;
+    stats.total_write_us += write_us;
+
+    if (write_us > stats.max_write_us)
+    {
+        stats.max_write_us = write_us;
+    }
+
+    if (res != FS_SUCCESS)
+    {
+        stats.write_errors++;
+        return RECORDER_ERROR_UNABLE_TO_WRITE;
+    }
+
+    session.bytes += length;
+
+    return RECORDER_SUCCESS;
+}
+
+recorder_ret_t Recorder_Start(char *filename, const audio_format_t *format, uint32_t reserve_s)
+{
+    if (filename == NULL || format == NULL)
+    {
+        return RECORDER_ERROR_NULL_PARAMETER;
+    }
+
+    if (recorder_fs == NULL)
+    {
+        return RECORDER_ERROR_NOT_INITIALIZED;
+    }
+
+    if (session.recording)
+    {
+        return RECORDER_ERROR_ALREADY_RECORDING;
+    }
+
+    const struct fs_operations *ops = recorder_fs->ops;
+
+    if (ops->CreateFile == NULL || ops->WriteFile == NULL || ops->WriteFileAt == NULL
+            || recorder_codec->EncodeHeader == NULL)
+    {
+        return RECORDER_ERROR_GENERIC;
+    }
+
+    // The header as it'll be at the end, just without the sizes. Also tells us whether the codec takes this format.
+    size_t header_len = sizeof(header);
+
+    if (recorder_codec->EncodeHeader(format, 0, header, &header_len) != CODEC_SUCCESS)
+    {
+        return RECORDER_ERROR_FORMAT_UNSUPPORTED;
+    }
+
+    session.format = *format;
+    session.frame_bytes = Audio_BytesPerFrame(format);
+    session.bytes_per_s = format->sample_rate * session.frame_bytes;
+    session.bytes = 0;
+
+    memset(&stats, 0, sizeof(stats));
+
+    if (ops->CreateFile(&session.file, filename) != FS_SUCCESS)
+    {
+        return RECORDER_ERROR_UNABLE_TO_CREATE;
+    }
+
+    // No contiguous run that big (or a storage that can't) isn't the end of the recording, just of the guarantees
+    if (reserve_s > 0 && ops->ReserveFile != NULL)
+    {
+        uint64_t reserve_b = header_len + (uint64_t)reserve_s * session.bytes_per_s;
+
+        if (ops->ReserveFile(&session.file, reserve_b) == FS_SUCCESS)
+        {
+            stats.reserved_b = reserve_b;
+        }
+    }
+
+    if (ops->WriteFile(&session.file, header, header_len) != FS_SUCCESS)
+    {
+        ops->CloseFile(&session.file);
+        return RECORDER_ERROR_UNABLE_TO_WRITE;
+    }
+
+    // Empty, and lined up with the file: a byte's position in the ring is its offset in the file, modulo the ring's
+    // size. So the first write fills up the rest of the header's block, and every one after that is a whole block
+    // at a multiple of RECORDER_WRITE_BYTES in the file, which never straddles a cluster of that size or more.
+    Ring_ResetTo(recorder_ring, (uint32_t)header_len);
+
+    // Last: from here on Recorder_Capture takes samples
+    session.recording = 1;
+
+    return RECORDER_SUCCESS;
+}
+
+uint32_t Recorder_Capture(const void *samples, uint32_t length)
+{
+    if (!session.recording || samples == NULL)
+    {
+        return 0;
+    }
+
+    // Whatever fits, in whole frames
+    uint32_t free = Ring_Free(recorder_ring);
+    uint32_t taken = Min(length, free - (free % session.frame_bytes));
+
+    Ring_Write(recorder_ring, samples, taken);
+
+    if (taken < length)
+    {
+        stats.overruns++;
+        stats.dropped_b += length - taken;
+    }
+
+    uint32_t used = Ring_Used(recorder_ring);
+
+    if (used > stats.max_used_b)
+    {
+        stats.max_used_b = used;
+    }
+
+    return taken;
+}
+
+recorder_ret_t Recorder_Service(void)
+{
+    if (!session.recording)
+    {
+        return RECORDER_ERROR_NOT_RECORDING;
+    }
+
+    PublishDeadline();
+
+    // The blocks that are there now: capture goes on while we write (and so would this loop, if the card were slow)
+    uint32_t used = Ring_Used(recorder_ring);
+
+    for (;;)
+    {
+        // Up to the next block boundary, which is the end of the header's block the first time and a whole block
+        // after that. Always one piece: the ring is a whole number of blocks.
+        uint32_t length = RECORDER_WRITE_BYTES - (recorder_ring->tail % RECORDER_WRITE_BYTES);
+        const uint8_t *region;
+
+        if (used < length)
+        {
+            break;
+        }
+
+        Ring_PeekRead(recorder_ring, &region);
+
+        recorder_ret_t res = Write(region, length);
+
+        if (res != RECORDER_SUCCESS)
+        {
+            return res;
+        }
+
+        Ring_Consume(recorder_ring, length);
+        used -= length;
+        PublishDeadline();
+    }
+
+    return RECORDER_SUCCESS;
+}
+
+recorder_ret_t Recorder_Stop(void)
+{
+    if (!session.recording)
+    {
+        return RECORDER_ERROR_NOT_RECORDING;
+    }
+
+    // Nothing more goes in the ring. The capture source should be stopped first, so it isn't in the middle of
+    // a Recorder_Capture either.
+    session.recording = 0;
+
+    recorder_ret_t res = RECORDER_SUCCESS;
+    const uint8_t *region;
+    uint32_t length;
+
+    // The rest, in at most two pieces (the end of the buffer, then its start), and less than a whole sector at
+    // the very end: the one write that isn't sector-sized
+    while (res == RECORDER_SUCCESS && (length = Ring_PeekRead(recorder_ring, &region)) > 0)
+    {
+        res = Write(region, length);
+        Ring_Consume(recorder_ring, length);
+    }
+
+    // RIFF chunks are an even length: a pad byte after an odd-sized data chunk (e.g., 24-bit mono),
+    // which isn't counted in its size
+    if (res == RECORDER_SUCCESS && (session.bytes & 1))
+    {
+        static const uint8_t pad = 0;
+
+        if (recorder_fs->ops->WriteFile(&session.file, &pad, sizeof(pad)) != FS_SUCCESS)
+        {
+            res = RECORDER_ERROR_UNABLE_TO_WRITE;
+        }
+    }
+
+    // The sizes, now that we know them. Even after a failed write: what's there should still be playable.
+    size_t header_len = sizeof(header);
+
+    if (recorder_codec->EncodeHeader(&session.format, session.bytes, header, &header_len) != CODEC_SUCCESS
+            || recorder_fs->ops->WriteFileAt(&session.file, 0, header, header_len) != FS_SUCCESS)
+    {
+        res = RECORDER_ERROR_UNABLE_TO_WRITE;
+    }
+
+    // Gives back the rest of the reservation
+    if (recorder_fs->ops->CloseFile(&session.file) != FS_SUCCESS)
+    {
+        res = RECORDER_ERROR_UNABLE_TO_WRITE;
+    }
+
+    // No stream to make room for any more
+    if (recorder_fs->ops->SetIOClass != NULL)
+    {
+        recorder_fs->ops->SetIOClass(FS_IO_REALTIME, 0);
+    }
+
+    return res;
+}
+
+uint8_t Recorder_IsRecording(void)
+{
+    return session.recording;
+}
+
+recorder_ret_t Recorder_GetStats(recorder_stats_t *out)
+{
+    if (out == NULL)
+    {
+        return RECORDER_ERROR_NULL_PARAMETER;
+    }
+
+    if (recorder_ring == NULL)
+    {
+        return RECORDER_ERROR_NOT_INITIALIZED;
+    }
+
+    out->bytes = session.bytes;
+    out->reserved_b = stats.reserved_b;
+    out->writes = stats.writes;
+    out->max_write_us = stats.max_write_us;
+    out->avg_write_us = (stats.writes > 0) ? (uint32_t)(stats.total_write_us / stats.writes) : 0;
+    out->write_errors = stats.write_errors;
+
+    out->max_used_b = stats.max_used_b;
+    out->ring_b = recorder_ring->size;
+    out->overruns = stats.overruns;
+    out->dropped_b = stats.dropped_b;
+
+    return RECORDER_SUCCESS;
+}
@@ -0,0 +1,206 @@
+/*
+ * ring.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#include "ring.h"
+
+#include <string.h>
+
+// The Cortex-M4 is single-core and in-order, so we don't need a hardware barrier (DMB) here.
+// We DO need to stop the compiler from moving the buffer copy after the index update,
+// otherwise the other side could see the new index before the data is actually there.
+// The GCC builtin works both on target and in a host build.
+#define RING_BARRIER() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+#define IS_POWER_OF_TWO(x) ((x) != 0 && (((x) & ((x) - 1)) == 0))
+
+ring_ret_t Ring_Init(ring_t *ring, uint8_t *buffer, uint32_t size)
+{
+    if (ring == NULL || buffer == NULL)
+    {
+        return RING_ERROR_NULL_BUFFER;
+    }
+
+    if (!IS_POWER_OF_TWO(size))
+    {
+        return RING_ERROR_INVALID_SIZE;
+    }
+
+    ring->buffer = buffer;
+    ring->size = size;
+    ring->head = 0;
+    ring->tail = 0;
+
+    return RING_SUCCESS;
+}
+
+// NOTE: only safe when neither side is running (e.g., between tracks)
+void Ring_Reset(ring_t *ring)
+{
+    ring->head = 0;
+    ring->tail = 0;
+}
+
+void Ring_ResetTo(ring_t *ring, uint32_t position)
+{
+    ring->head = position;
+    ring->tail = position;
+}
+
+/*
+ * Every queued byte moves from (counter & (old size - 1)) to (counter & (size - 1)).
+ * This works in place, in any order, because no byte lands where another queued byte still is:
+ * growing, the bytes that move all go to the part of the buffer the old size never used, and shrinking,
+ * the queued counters are fewer than the new size, so no two of them share a position under either mask.
+ */
+ring_ret_t Ring_Resize(ring_t *ring, uint32_t size)
+{
+    if (ring == NULL || ring->buffer == NULL)
+    {
+        return RING_ERROR_NULL_BUFFER;
+    }
+
+    if (!IS_POWER_OF_TWO(size) || Ring_Used(ring) > size)
+    {
+        return RING_ERROR_INVALID_SIZE;
+    }
+
+    uint32_t old_mask = ring->size - 1;
+    uint32_t new_mask = size - 1;
+    uint32_t counter = ring->tail;
+
+    // A piece at a time, up to wherever either position wraps
+    while (counter != ring->head)
+    {
+        uint32_t from = counter & old_mask;
+        uint32_t to = counter & new_mask;
+        uint32_t chunk = ring->head - counter;
+
+        if (chunk > old_mask + 1 - from)
+        {
+            chunk = old_mask + 1 - from;
+        }
+
+        if (chunk > new_mask + 1 - to)
+        {
+            chunk = new_mask + 1 - to;
+        }
+
+        if (from != to)
+        {
+            memmove(&ring->buffer[to], &ring->buffer[from], chunk);
+        }
+
+        counter += chunk;
+    }
+
+    RING_BARRIER();
+    ring->size = size;
+
+    return RING_SUCCESS;
+}
+
+uint32_t Ring_Used(const ring_t *ring)
+{
+    // Unsigned subtraction handles the counters overflowing
+    return ring->head - ring->tail;
+}
+
+uint32_t Ring_Free(const ring_t *ring)
+{
+    return ring->size - Ring_Used(ring);
+}
+
+uint32_t Ring_PeekWrite(const ring_t *ring, uint8_t **region)
+{
+    uint32_t offset = ring->head & (ring->size - 1);
+    uint32_t contiguous = ring->size - offset;
+    uint32_t free = Ring_Free(ring);
+
+    *region = &ring->buffer[offset];
+
+    return (free < contiguous) ? free : contiguous;
+}
+
+void Ring_Commit(ring_t *ring, uint32_t length)
+{
+    RING_BARRIER();
+    ring->head += length;
+}
+
+uint32_t Ring_PeekRead(const ring_t *ring, const uint8_t **region)
+{
+    uint32_t offset = ring->tail & (ring->size - 1);
+    uint32_t contiguous = ring->size - offset;
+    uint32_t used = Ring_Used(ring);
+
+    *region = &ring->buffer[offset];
+
+    return (used < contiguous) ? used : contiguous;
+}
+
+void Ring_Consume(ring_t *ring, uint32_t length)
+{
+    RING_BARRIER();
+    ring->tail += length;
+}
+
+uint32_t Ring_Write(ring_t *ring, const void *data, uint32_t length)
+{
+    const uint8_t *src = (const uint8_t *)data;
+    uint32_t written = 0;
+
+    // At most two iterations: up to the end of the buffer, then from the start
+    while (written < length)
+    {
+        uint8_t *region;
+        uint32_t chunk = Ring_PeekWrite(ring, &region);
+
+        if (chunk == 0)
+        {
+            break;
+        }
+
+        if (chunk > length - written)
+        {
+            chunk = length - written;
+        }
+
+        memcpy(region, &src[written], chunk);
+        Ring_Commit(ring, chunk);
+        written += chunk;
+    }
+
+    return written;
+}
+
+uint32_t Ring_Read(ring_t *ring, void *data, uint32_t length)
+{
+    uint8_t *dst = (uint8_t *)data;
+    uint32_t read = 0;
+
+    while (read < length)
+    {
+        const uint8_t *region;
+        uint32_t chunk = Ring_PeekRead(ring, &region);
+
+        if (chunk == 0)
+        {
+            break;
+        }
+
+        if (chunk > length - read)
+        {
+            chunk = length - read;
+        }
+
+        memcpy(&dst[read], region, chunk);
+        Ring_Consume(ring, chunk);
+        read += chunk;
+    }
+
+    return read;
+}
@@ -0,0 +1,204 @@
+/*
+ * sd_bench.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#include "sd_bench.h"
+#include "bsp_driver_sd.h"
+#include "sd_bus.h"
+#include "cycles.h"
+#include "xorshift.h"
+
+#include <string.h>
+
+static const uint16_t REQUEST_BLOCKS[SD_PROFILE_NUM_SIZES] = SD_PROFILE_SIZES;
+
+// Single-block random read latencies, sorted afterwards for the percentiles
+static uint32_t latencies[SD_BENCH_RANDOM_READS];
+
+static uint32_t rng;
+static uint32_t max_us;
+
+static inline uint32_t CyclesToUs(uint32_t cycles)
+{
+    return cycles / (SystemCoreClock / 1000000);
+}
+
+// One read command, timed from issue until the card is back in the transfer state (the same wait sd_diskio does)
+static sd_bench_ret_t TimedRead(uint32_t *buffer, uint32_t block, uint32_t count, uint32_t *us)
+{
+    uint32_t start = Cycles_Now();
+
+    // Straight to the card: the block layer's read-ahead would hide exactly what we're trying to measure
+    if (Blk_DeviceTransfer(&sd_bus_device, BLK_READ, buffer, block, count) != BLK_SUCCESS)
+    {
+        return SD_BENCH_ERROR_UNABLE_TO_READ;
+    }
+
+    uint32_t tick = HAL_GetTick();
+
+    while (BSP_SD_GetCardState() != SD_TRANSFER_OK)
+    {
+        if (HAL_GetTick() - tick > SD_BENCH_TIMEOUT_MS)
+        {
+            return SD_BENCH_ERROR_UNABLE_TO_READ;
+        }
+    }
+
+    *us = CyclesToUs(Cycles_Now() - start);
+
+    if (*us > max_us)
+    {
+        max_us = *us;
+    }
+
+    return SD_BENCH_SUCCESS;
+}
+
+static uint32_t KiBPerSecond(uint64_t bytes, uint64_t us)
+{
+    return (us > 0) ? (uint32_t)((bytes * 1000000) / (us * 1024)) : 0;
+}
+
+static sd_bench_ret_t Sequential(uint32_t *buffer, uint32_t first_block, uint32_t count, uint32_t *kbps)
+{
+    uint32_t requests = SD_BENCH_SEQUENTIAL_BYTES / (count * SD_PROFILE_BLOCK_SIZE);
+    uint64_t total_us = 0;
+
+    for (uint32_t i = 0; i < requests; i++)
+    {
+        uint32_t us;
+        sd_bench_ret_t res = TimedRead(buffer, first_block + i * count, count, &us);
+
+        if (res != SD_BENCH_SUCCESS)
+        {
+            return res;
+        }
+
+        total_us += us;
+    }
+
+    *kbps = KiBPerSecond((uint64_t)requests * count * SD_PROFILE_BLOCK_SIZE, total_us);
+
+    return SD_BENCH_SUCCESS;
+}
+
+static sd_bench_ret_t Random(uint32_t *buffer, uint32_t num_blocks, uint32_t count, uint32_t *kbps)
+{
+    uint64_t total_us = 0;
+
+    for (uint32_t i = 0; i < SD_BENCH_RANDOM_READS; i++)
+    {
+        // Aligned to the request size, like FatFs clusters are
+        uint32_t block = (XorShift_Next(&rng) % (num_blocks - count)) & ~(count - 1);
+        uint32_t us;
+        sd_bench_ret_t res = TimedRead(buffer, block, count, &us);
+
+        if (res != SD_BENCH_SUCCESS)
+        {
+            return res;
+        }
+
+        if (count == 1)
+        {
+            latencies[i] = us;
+        }
+
+        total_us += us;
+    }
+
+    *kbps = KiBPerSecond((uint64_t)SD_BENCH_RANDOM_READS * count * SD_PROFILE_BLOCK_SIZE, total_us);
+
+    return SD_BENCH_SUCCESS;
+}
+
+// Only 64 values, insertion sort is fine
+static void Sort(uint32_t *values, size_t length)
+{
+    for (size_t i = 1; i < length; i++)
+    {
+        uint32_t value = values[i];
+        size_t j = i;
+
+        while (j > 0 && values[j - 1] > value)
+        {
+            values[j] = values[j - 1];
+            j--;
+        }
+
+        values[j] = value;
+    }
+}
+
+static uint32_t Percentile(const uint32_t *sorted, size_t length, uint32_t percent)
+{
+    size_t index = (length * percent) / 100;
+
+    return sorted[(index < length) ? index : length - 1];
+}
+
+sd_bench_ret_t SDBench_Run(uint32_t num_blocks, const uint32_t cid[4], void *work, size_t work_size,
+        sd_profile_t *profile)
+{
+    if (cid == NULL || work == NULL || profile == NULL)
+    {
+        return SD_BENCH_ERROR_NULL_PARAMETER;
+    }
+
+    uint32_t largest = REQUEST_BLOCKS[SD_PROFILE_NUM_SIZES - 1];
+
+    if (work_size < largest * SD_PROFILE_BLOCK_SIZE)
+    {
+        return SD_BENCH_ERROR_BUFFER_TOO_SMALL;
+    }
+
+    // Sequential runs start in the middle of the card, random reads cover all of it
+    uint32_t sequential_blocks = SD_BENCH_SEQUENTIAL_BYTES / SD_PROFILE_BLOCK_SIZE;
+
+    if (num_blocks < 2 * sequential_blocks)
+    {
+        return SD_BENCH_ERROR_CARD_TOO_SMALL;
+    }
+
+    memset(profile, 0, sizeof(*profile));
+    memcpy(profile->cid, cid, sizeof(profile->cid));
+
+    Cycles_Init();
+    rng = Cycles_Now() | 1;
+    max_us = 0;
+
+    uint32_t *buffer = (uint32_t *)work;
+    uint32_t first_block = (num_blocks / 2) & ~(largest - 1);
+
+    for (size_t i = 0; i < SD_PROFILE_NUM_SIZES; i++)
+    {
+        uint32_t count = REQUEST_BLOCKS[i];
+        sd_bench_ret_t res;
+
+        profile->request_blocks[i] = (uint16_t)count;
+
+        res = Sequential(buffer, first_block, count, &profile->sequential_kbps[i]);
+        if (res != SD_BENCH_SUCCESS)
+        {
+            return res;
+        }
+
+        res = Random(buffer, num_blocks, count, &profile->random_kbps[i]);
+        if (res != SD_BENCH_SUCCESS)
+        {
+            return res;
+        }
+    }
+
+    Sort(latencies, SD_BENCH_RANDOM_READS);
+    profile->p50_us = Percentile(latencies, SD_BENCH_RANDOM_READS, 50);
+    profile->p95_us = Percentile(latencies, SD_BENCH_RANDOM_READS, 95);
+    profile->p99_us = Percentile(latencies, SD_BENCH_RANDOM_READS, 99);
+    profile->max_us = max_us;
+
+    SDProfile_Recommend(profile);
+
+    return SD_BENCH_SUCCESS;
+}
@@ -0,0 +1,621 @@
+/*
+ * sd_bus.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#include "sd_bus.h"
+#include "bsp_driver_sd.h"
+#include "crc32.h"
+#include "cycles.h"
+
+#if SD_BUS_USE_LL
+#include "sd_ll.h"
+#endif
+
+#include <string.h>
+
+// Defined in main.c, like in microsd.c
+extern SD_HandleTypeDef hsd;
+
+#define BLOCK_SIZE 512
+
+// CMD6 argument: mode (bit 31), then one nibble per function group, 0xF = "leave as is".
+// We only touch group 1 (access mode), where function 1 is high speed.
+#define SWITCH_CHECK 0x00FFFFF1
+#define SWITCH_SET 0x80FFFFF1
+#define SWITCH_STATUS_BYTES 64
+
+// Switch function (CMD6) is command class 10
+#define CCC_SWITCH (1 << 10)
+
+#define DEFAULT_SPEED_MAX_HZ 25000000
+#define HIGH_SPEED_MAX_HZ 50000000
+
+#define HAL_LINK_ERRORS (HAL_SD_ERROR_CMD_CRC_FAIL | HAL_SD_ERROR_DATA_CRC_FAIL | HAL_SD_ERROR_CMD_RSP_TIMEOUT \
+        | HAL_SD_ERROR_DATA_TIMEOUT | HAL_SD_ERROR_TX_UNDERRUN | HAL_SD_ERROR_RX_OVERRUN)
+
+typedef struct
+{
+    uint8_t bypass;
+    uint8_t clock_div;
+} clock_level_t;
+
+// Fastest first. With a 48 MHz kernel clock: 48, 24, 16, 12, 8, 4, 1 MHz.
+// The last one is the safe clock the reference data is read at.
+static const clock_level_t LEVELS[] =
+{
+{ 1, 0 },
+{ 0, 0 },
+{ 0, 1 },
+{ 0, 2 },
+{ 0, 4 },
+{ 0, 10 },
+{ 0, 46 } };
+
+#define LEN(arr) (sizeof(arr) / sizeof(arr[0]))
+#define SLOWEST (LEN(LEVELS) - 1)
+
+static fs_bus_t *state;
+static size_t level;
+static uint32_t consecutive_errors;
+static uint8_t negotiated;
+
+#if SD_BUS_USE_LL
+static sd_ll_t ll;
+static uint8_t ll_ready;
+#endif
+
+// Test reads go here, word aligned for the FIFO
+static uint32_t test_buffer[SD_BUS_TEST_BLOCKS * BLOCK_SIZE / sizeof(uint32_t)];
+static uint32_t reference[SD_BUS_TEST_ROUNDS];
+
+// PLL48CK = VCO / PLLQ, and the VCO runs off HSI or HSE depending on PLLSRC
+static uint32_t KernelClockHz(void)
+{
+    uint32_t pllcfgr = RCC->PLLCFGR;
+    uint32_t input_hz = (pllcfgr & RCC_PLLCFGR_PLLSRC) ? HSE_VALUE : HSI_VALUE;
+    uint32_t m = (pllcfgr & RCC_PLLCFGR_PLLM) >> RCC_PLLCFGR_PLLM_Pos;
+    uint32_t n = (pllcfgr & RCC_PLLCFGR_PLLN) >> RCC_PLLCFGR_PLLN_Pos;
+    uint32_t q = (pllcfgr & RCC_PLLCFGR_PLLQ) >> RCC_PLLCFGR_PLLQ_Pos;
+
+    if (m == 0 || q == 0)
+    {
+        return 0;
+    }
+
+    return (uint32_t)(((uint64_t)input_hz * n / m) / q);
+}
+
+static uint32_t LevelHz(size_t i)
+{
+    uint32_t kernel_hz = KernelClockHz();
+
+    return LEVELS[i].bypass ? kernel_hz : kernel_hz / (LEVELS[i].clock_div + 2);
+}
+
+static void ApplyLevel(size_t i)
+{
+    hsd.Init.ClockBypass = LEVELS[i].bypass ? SDIO_CLOCK_BYPASS_ENABLE : SDIO_CLOCK_BYPASS_DISABLE;
+    hsd.Init.ClockDiv = LEVELS[i].clock_div;
+
+    // HAL_SD_ConfigWideBusOperation re-inits the peripheral from hsd.Init too, so it has to stay in sync
+    SDIO_Init(hsd.Instance, hsd.Init);
+
+    level = i;
+
+    if (state != NULL)
+    {
+        state->clock_hz = LevelHz(i);
+    }
+}
+
+static uint8_t WaitForTransferState(void)
+{
+    uint32_t tick = HAL_GetTick();
+
+    while (BSP_SD_GetCardState() != SD_TRANSFER_OK)
+    {
+        if (HAL_GetTick() - tick > SD_BUS_TIMEOUT_MS)
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/*
+ * CMD6 returns a 512-bit status block on the data lines, which the HAL has no call for.
+ * Same steps as the HAL's own SCR read (SD_FindSCR): set the block length, arm the data path, send the command,
+ * then drain the FIFO.
+ */
+static uint8_t SwitchFunction(uint32_t argument, uint8_t status[SWITCH_STATUS_BYTES])
+{
+    SDIO_DataInitTypeDef config;
+    uint32_t words[SWITCH_STATUS_BYTES / sizeof(uint32_t)];
+    size_t count = 0;
+
+    if (SDMMC_CmdBlockLength(hsd.Instance, SWITCH_STATUS_BYTES) != HAL_SD_ERROR_NONE)
+    {
+        return 0;
+    }
+
+    config.DataTimeOut = SDMMC_DATATIMEOUT;
+    config.DataLength = SWITCH_STATUS_BYTES;
+    config.DataBlockSize = SDIO_DATABLOCK_SIZE_64B;
+    config.TransferDir = SDIO_TRANSFER_DIR_TO_SDIO;
+    config.TransferMode = SDIO_TRANSFER_MODE_BLOCK;
+    config.DPSM = SDIO_DPSM_ENABLE;
+    SDIO_ConfigData(hsd.Instance, &config);
+
+    uint8_t ok = (SDMMC_CmdSwitch(hsd.Instance, argument) == HAL_SD_ERROR_NONE);
+    uint32_t tick = HAL_GetTick();
+
+    while (ok && !__SDIO_GET_FLAG(hsd.Instance,
+            SDIO_FLAG_RXOVERR | SDIO_FLAG_DCRCFAIL | SDIO_FLAG_DTIMEOUT | SDIO_FLAG_DBCKEND))
+    {
+        if (__SDIO_GET_FLAG(hsd.Instance, SDIO_FLAG_RXDAVL) && count < LEN(words))
+        {
+            words[count++] = SDIO_ReadFIFO(hsd.Instance);
+        }
+
+        if (HAL_GetTick() - tick > SD_BUS_TIMEOUT_MS)
+        {
+            ok = 0;
+        }
+    }
+
+    // The last few words can still be in the FIFO when the block end flag goes up
+    while (ok && __SDIO_GET_FLAG(hsd.Instance, SDIO_FLAG_RXDAVL) && count < LEN(words))
+    {
+        words[count++] = SDIO_ReadFIFO(hsd.Instance);
+    }
+
+    if (__SDIO_GET_FLAG(hsd.Instance, SDIO_FLAG_RXOVERR | SDIO_FLAG_DCRCFAIL | SDIO_FLAG_DTIMEOUT))
+    {
+        ok = 0;
+    }
+
+    __SDIO_CLEAR_FLAG(hsd.Instance, SDIO_STATIC_FLAGS);
+
+    // Back to normal blocks, whatever happened
+    if (SDMMC_CmdBlockLength(hsd.Instance, BLOCK_SIZE) != HAL_SD_ERROR_NONE || count < LEN(words))
+    {
+        return 0;
+    }
+
+    // The FIFO hands the bytes over in the order they came off the bus (MSB of the status first)
+    memcpy(status, words, SWITCH_STATUS_BYTES);
+
+    return ok;
+}
+
+static uint8_t SwitchToHighSpeed(void)
+{
+    uint8_t status[SWITCH_STATUS_BYTES];
+
+    if (!(hsd.SdCard.Class & CCC_SWITCH))
+    {
+        return 0;
+    }
+
+    // Bits 415:400 are group 1's supported functions, so bit 401 (byte 13, bit 1) is high speed
+    if (!SwitchFunction(SWITCH_CHECK, status) || !(status[13] & 0x02))
+    {
+        return 0;
+    }
+
+    // Bits 379:376 are the function group 1 actually switched to
+    if (!SwitchFunction(SWITCH_SET, status) || (status[16] & 0x0F) != 1)
+    {
+        return 0;
+    }
+
+    // The card may take up to 8 clocks to switch timing, the next command is way further out than that
+    return 1;
+}
+
+// Test blocks, spread evenly over the card (the first ones alone might all be in the FAT, or all zeros)
+static inline uint32_t TestBlock(uint32_t round)
+{
+    return (uint32_t)(((uint64_t)(hsd.SdCard.BlockNbr - SD_BUS_TEST_BLOCKS) * round) / SD_BUS_TEST_ROUNDS);
+}
+
+static uint8_t ReadTest(uint32_t crcs[SD_BUS_TEST_ROUNDS], uint32_t *us)
+{
+    uint32_t start = Cycles_Now();
+
+    for (uint32_t round = 0; round < SD_BUS_TEST_ROUNDS; round++)
+    {
+        if (HAL_SD_ReadBlocks(&hsd, (uint8_t *)test_buffer, TestBlock(round), SD_BUS_TEST_BLOCKS,
+                SD_BUS_TIMEOUT_MS) != HAL_OK)
+        {
+            return 0;
+        }
+
+        if (!WaitForTransferState())
+        {
+            return 0;
+        }
+
+        crcs[round] = CRC32_Update(CRC32_INIT, test_buffer, sizeof(test_buffer));
+    }
+
+    *us = (Cycles_Now() - start) / (SystemCoreClock / 1000000);
+
+    return 1;
+}
+
+sd_bus_ret_t SDBus_Negotiate(fs_bus_t *bus)
+{
+    if (bus == NULL)
+    {
+        return SD_BUS_ERROR_NULL_PARAMETER;
+    }
+
+    if (hsd.State != HAL_SD_STATE_READY)
+    {
+        return SD_BUS_ERROR_NOT_INITIALIZED;
+    }
+
+    memset(bus, 0, sizeof(*bus));
+    bus->width = 1;
+
+    state = NULL;
+    negotiated = 0;
+    consecutive_errors = 0;
+
+#if SD_BUS_USE_LL
+    ll_ready = 0;
+#endif
+
+    // Everything below is optional: if a step fails, we just stay on what we had
+    if (hsd.SdCard.CardType != CARD_SECURED
+            && HAL_SD_ConfigWideBusOperation(&hsd, SDIO_BUS_WIDE_4B) == HAL_OK)
+    {
+        bus->width = 4;
+    }
+    else
+    {
+        // A failed switch leaves the peripheral in an unknown width, put it back
+        HAL_SD_ConfigWideBusOperation(&hsd, SDIO_BUS_WIDE_1B);
+    }
+
+    bus->high_speed = SwitchToHighSpeed();
+
+    // Reference data, read slowly
+    uint32_t us;
+
+    ApplyLevel(SLOWEST);
+
+    if (!ReadTest(reference, &us))
+    {
+        return SD_BUS_ERROR_NO_WORKING_CLOCK;
+    }
+
+    uint32_t crcs[SD_BUS_TEST_ROUNDS];
+    uint32_t max_hz = bus->high_speed ? HIGH_SPEED_MAX_HZ : DEFAULT_SPEED_MAX_HZ;
+
+    // Fastest level that reads the same data without errors. The slowest one always passes: it just did.
+    for (size_t i = 0; i < LEN(LEVELS); i++)
+    {
+        if (LevelHz(i) > max_hz)
+        {
+            continue;
+        }
+
+        ApplyLevel(i);
+
+        if (ReadTest(crcs, &us) && memcmp(crcs, reference, sizeof(reference)) == 0)
+        {
+            break;
+        }
+
+        // A failed read can leave the card mid-transfer
+        SDMMC_CmdStopTransfer(hsd.Instance);
+        WaitForTransferState();
+    }
+
+    bus->clock_hz = LevelHz(level);
+
+    if (us > 0)
+    {
+        bus->throughput_kbps = (uint32_t)(((uint64_t)sizeof(test_buffer) * SD_BUS_TEST_ROUNDS * 1000000)
+                / ((uint64_t)us * 1024));
+    }
+
+    state = bus;
+    negotiated = 1;
+
+#if SD_BUS_USE_LL
+    // From here on, the LL driver does the data transfers, on DMA2 stream 3 (channel 4 = SDIO).
+    // If it can't even read the SCR, we just stay on the HAL.
+    sd_ll_config_t config =
+    { .sdio = hsd.Instance, .dma = DMA2, .stream = DMA2_Stream3, .stream_index = 3,
+            .rca = hsd.SdCard.RelCardAdd, .high_capacity = (hsd.SdCard.CardType == CARD_SDHC_SDXC) };
+
+    __HAL_RCC_DMA2_CLK_ENABLE();
+    ll_ready = (SDLL_Init(&ll, &config) == SD_LL_SUCCESS);
+#endif
+
+    return SD_BUS_SUCCESS;
+}
+
+// Called after every failed transfer that the link is to blame for, decides whether to slow it down
+static void ReportError(void)
+{
+    if (state != NULL)
+    {
+        state->errors++;
+    }
+
+    if (!negotiated || ++consecutive_errors < SD_BUS_ERRORS_TO_STEP_DOWN)
+    {
+        return;
+    }
+
+    consecutive_errors = 0;
+
+    if (level < SLOWEST)
+    {
+        ApplyLevel(level + 1);
+    }
+    else if (hsd.Init.BusWide != SDIO_BUS_WIDE_1B
+            && HAL_SD_ConfigWideBusOperation(&hsd, SDIO_BUS_WIDE_1B) == HAL_OK && state != NULL)
+    {
+        // Already as slow as it goes: last resort is one data line
+        state->width = 1;
+    }
+
+    if (state != NULL)
+    {
+        state->step_downs++;
+    }
+}
+
+/*
+ * The block device is a small state machine, so nothing waits on the card: the block layer starts a transfer and
+ * polls it. Busy is the LL driver's own DMA transfer. Settling is waiting for the card to get back to the transfer
+ * state, either before a retry or, on the HAL path (which moves the data itself, blocking, with its own timeout),
+ * while the card is still programming after a write. Done holds a result that was known straight away.
+ */
+typedef enum
+{
+    XFER_IDLE = 0,
+    XFER_BUSY,
+    XFER_SETTLING,
+    XFER_DONE
+} xfer_stage_t;
+
+static struct
+{
+    xfer_stage_t stage;
+    uint32_t *data;
+    uint32_t block;
+    uint32_t count;
+    uint8_t write;
+    uint32_t attempt;
+    uint8_t retry;      // settling before another attempt, rather than before reporting success
+    uint32_t tick;
+    blk_ret_t result;
+} xfer;
+
+static inline void Finish(blk_ret_t result)
+{
+    if (result == BLK_SUCCESS)
+    {
+        consecutive_errors = 0;
+    }
+
+    xfer.result = result;
+    xfer.stage = XFER_DONE;
+}
+
+static inline void Settle(uint8_t retry)
+{
+    xfer.retry = retry;
+    xfer.tick = HAL_GetTick();
+    xfer.stage = XFER_SETTLING;
+}
+
+// An attempt failed. Anything but the link's fault (bad address, card locked, ...) won't go away by trying again.
+static void Failed(uint8_t link, blk_ret_t error)
+{
+    if (!link || xfer.attempt >= SD_BUS_RETRIES)
+    {
+        Finish(error);
+        return;
+    }
+
+    ReportError();
+    Settle(1);
+}
+
+static void StartAttempt(void)
+{
+#if SD_BUS_USE_LL
+    if (ll_ready)
+    {
+        sd_ll_ret_t res;
+
+        if (((uintptr_t)xfer.data & 3) == 0)
+        {
+            res = xfer.write ? SDLL_StartWrite(&ll, xfer.data, xfer.block, xfer.count)
+                    : SDLL_StartRead(&ll, xfer.data, xfer.block, xfer.count);
+
+            if (res == SD_LL_SUCCESS)
+            {
+                xfer.stage = XFER_BUSY;
+                return;
+            }
+        }
+        else
+        {
+            // No DMA into an unaligned buffer: the blocking bounce path, a block at a time. Only reached through
+            // Blk_DeviceTransfer: the block layer bounces anything unaligned through its staging buffer first.
+            res = xfer.write ? SDLL_WriteBlocks(&ll, xfer.data, xfer.block, xfer.count, SD_BUS_TIMEOUT_MS)
+                    : SDLL_ReadBlocks(&ll, xfer.data, xfer.block, xfer.count, SD_BUS_TIMEOUT_MS);
+
+            if (res == SD_LL_SUCCESS)
+            {
+                Finish(BLK_SUCCESS);
+                return;
+            }
+        }
+
+        // SDLL_* already stop the card on errors
+        Failed(SDLL_IsLinkError(res), (res == SD_LL_ERROR_TIMEOUT) ? BLK_ERROR_TIMEOUT : BLK_ERROR_DEVICE);
+        return;
+    }
+#endif
+
+    HAL_StatusTypeDef res = xfer.write ? HAL_SD_WriteBlocks(&hsd, (uint8_t *)xfer.data, xfer.block, xfer.count,
+            SD_BUS_TIMEOUT_MS) : HAL_SD_ReadBlocks(&hsd, (uint8_t *)xfer.data, xfer.block, xfer.count,
+            SD_BUS_TIMEOUT_MS);
+
+    if (res == HAL_OK)
+    {
+        Settle(0);
+        return;
+    }
+
+    // A failed multi-block transfer can leave the card mid-transfer
+    if (xfer.count > 1)
+    {
+        SDMMC_CmdStopTransfer(hsd.Instance);
+    }
+
+    Failed((hsd.ErrorCode & HAL_LINK_ERRORS) != 0,
+            (hsd.ErrorCode & HAL_SD_ERROR_TIMEOUT) ? BLK_ERROR_TIMEOUT : BLK_ERROR_DEVICE);
+}
+
+static blk_ret_t DeviceStart(blk_dir_t dir, void *buffer, uint32_t lba, uint32_t count)
+{
+    if (xfer.stage != XFER_IDLE)
+    {
+        return BLK_ERROR_GENERIC;
+    }
+
+    xfer.data = buffer;
+    xfer.block = lba;
+    xfer.count = count;
+    xfer.write = (dir == BLK_WRITE);
+    xfer.attempt = 0;
+
+    StartAttempt();
+
+    return BLK_SUCCESS;
+}
+
+static blk_ret_t DevicePoll(void)
+{
+    switch (xfer.stage)
+    {
+#if SD_BUS_USE_LL
+    case XFER_BUSY:
+    {
+        sd_ll_ret_t res = SDLL_Poll(&ll);
+
+        if (res == SD_LL_PENDING)
+        {
+            return BLK_PENDING;
+        }
+
+        if (res == SD_LL_SUCCESS)
+        {
+            Finish(BLK_SUCCESS);
+        }
+        else
+        {
+            Failed(SDLL_IsLinkError(res), (res == SD_LL_ERROR_TIMEOUT) ? BLK_ERROR_TIMEOUT : BLK_ERROR_DEVICE);
+        }
+
+        return BLK_PENDING;
+    }
+#endif
+
+    case XFER_SETTLING:
+        if (BSP_SD_GetCardState() == SD_TRANSFER_OK)
+        {
+            if (!xfer.retry)
+            {
+                Finish(BLK_SUCCESS);
+                return BLK_PENDING;
+            }
+
+            xfer.attempt++;
+            StartAttempt();
+        }
+        else if (HAL_GetTick() - xfer.tick > SD_BUS_TIMEOUT_MS)
+        {
+            Finish(BLK_ERROR_TIMEOUT);
+        }
+
+        return BLK_PENDING;
+
+    case XFER_DONE:
+        xfer.stage = XFER_IDLE;
+        return xfer.result;
+
+    default:
+        return BLK_ERROR_GENERIC;
+    }
+}
+
+#if SD_BUS_USE_LL
+static uint32_t DeviceCommands(void)
+{
+    return ll.stats.commands;
+}
+#endif
+
+static uint32_t DeviceNow(void)
+{
+    return HAL_GetTick();
+}
+
+const blk_device_t sd_bus_device =
+{ .Start = DeviceStart, .Poll = DevicePoll,
+#if SD_BUS_USE_LL
+        .Commands = DeviceCommands, .alignment = 4,     // DMA moves words
+#else
+        .Commands = NULL, .alignment = 0,               // the HAL's polled transfers take bytes
+#endif
+        .Now = DeviceNow };
+
+/*
+ * Overrides of the weak versions in bsp_driver_sd.c, which is what sd_diskio.c calls.
+ * Through the block layer, which merges and reads ahead. Timeouts are per transfer (SD_BUS_TIMEOUT_MS),
+ * since one request here may not be one transfer on the bus. When these return, the card is back in the
+ * transfer state, so there's no need to poll its state afterwards.
+ */
+uint8_t BSP_SD_ReadBlocks(uint32_t *pData, uint32_t ReadAddr, uint32_t NumOfBlocks, uint32_t Timeout)
+{
+    (void)Timeout;
+
+    return (Blk_Read(pData, ReadAddr, NumOfBlocks) == BLK_SUCCESS) ? MSD_OK : MSD_ERROR;
+}
+
+uint8_t BSP_SD_WriteBlocks(uint32_t *pData, uint32_t WriteAddr, uint32_t NumOfBlocks, uint32_t Timeout)
+{
+    (void)Timeout;
+
+    return (Blk_Write(pData, WriteAddr, NumOfBlocks) == BLK_SUCCESS) ? MSD_OK : MSD_ERROR;
+}
+
+#if SD_BUS_USE_LL
+// Polled while settling after every write, so it's worth the cheaper CMD13 too
+uint8_t BSP_SD_GetCardState(void)
+{
+    if (!ll_ready)
+    {
+        return (HAL_SD_GetCardState(&hsd) == HAL_SD_CARD_TRANSFER) ? SD_TRANSFER_OK : SD_TRANSFER_BUSY;
+    }
+
+    uint8_t ready;
+
+    return (SDLL_IsReady(&ll, &ready) == SD_LL_SUCCESS && ready) ? SD_TRANSFER_OK : SD_TRANSFER_BUSY;
+}
+#endif
@@ -0,0 +1,583 @@
+/*
+ * sd_ll.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#include "sd_ll.h"
+
+#include <string.h>
+
+// On the board, the DMA takes plain bus addresses and register reads are just reads.
+// On a PC, pointers don't fit in a 32-bit register, and the mock has to get a look in whenever we check a flag.
+#ifdef HOST_BUILD
+#define BUS_ADDRESS(ptr) SDIOMock_BusAddress((const volatile void *)(ptr))
+#define SYNC(ll) SDIOMock_Service((ll)->config.sdio)
+#else
+#define BUS_ADDRESS(ptr) ((uint32_t)(ptr))
+#define SYNC(ll)
+#endif
+
+// Card status (R1) current state, bits 12:9
+#define R1_STATE(r1) (((r1) >> 9) & 0x0F)
+#define R1_STATE_TRANSFER 4
+
+// SCR bit 33: CMD23 supported
+#define SCR_BYTES 8
+#define SCR_CMD23_BYTE 3
+#define SCR_CMD23_BIT 0x02
+
+#define DATA_ERRORS (SDIO_STA_DCRCFAIL | SDIO_STA_DTIMEOUT | SDIO_STA_RXOVERR | SDIO_STA_TXUNDERR | SDIO_STA_STBITERR)
+
+// Each stream's flags sit at one of these offsets in LISR (streams 0-3) or HISR (streams 4-7)
+static const uint8_t DMA_FLAG_SHIFT[4] = { 0, 6, 16, 22 };
+
+#define DMA_FLAG_FE (1 << 0)
+#define DMA_FLAG_DME (1 << 2)
+#define DMA_FLAG_TE (1 << 3)
+#define DMA_FLAG_TC (1 << 5)
+#define DMA_FLAGS_ALL 0x3D
+
+// Channel 4 (SDIO), 4-beat bursts of words on both sides, very high priority, SDIO is the flow controller
+#define DMA_CR (DMA_SxCR_CHSEL_2 | DMA_SxCR_MBURST_0 | DMA_SxCR_PBURST_0 | DMA_SxCR_PL | DMA_SxCR_MSIZE_1 \
+        | DMA_SxCR_PSIZE_1 | DMA_SxCR_MINC | DMA_SxCR_PFCTRL)
+
+// FIFO mode (direct mode can't do bursts), threshold full
+#define DMA_FCR (DMA_SxFCR_DMDIS | DMA_SxFCR_FTH)
+
+// For when the caller's buffer isn't word aligned
+static uint32_t bounce[SD_LL_BLOCK_SIZE / sizeof(uint32_t)];
+
+static inline uint32_t Status(sd_ll_t *ll)
+{
+    SYNC(ll);
+
+    return ll->config.sdio->STA;
+}
+
+static inline uint32_t DmaFlags(sd_ll_t *ll)
+{
+    SYNC(ll);
+
+    uint8_t index = ll->config.stream_index;
+    uint32_t isr = (index < 4) ? ll->config.dma->LISR : ll->config.dma->HISR;
+
+    return (isr >> DMA_FLAG_SHIFT[index & 3]) & DMA_FLAGS_ALL;
+}
+
+static inline void ClearDmaFlags(sd_ll_t *ll)
+{
+    uint8_t index = ll->config.stream_index;
+    uint32_t mask = (uint32_t)DMA_FLAGS_ALL << DMA_FLAG_SHIFT[index & 3];
+
+    if (index < 4)
+    {
+        ll->config.dma->LIFCR = mask;
+    }
+    else
+    {
+        ll->config.dma->HIFCR = mask;
+    }
+}
+
+static void StopDma(sd_ll_t *ll)
+{
+    ll->config.stream->CR &= ~DMA_SxCR_EN;
+
+    // The stream only lets go once the current burst is done
+    while (ll->config.stream->CR & DMA_SxCR_EN)
+    {
+        SYNC(ll);
+    }
+
+    ClearDmaFlags(ll);
+}
+
+static void StartDma(sd_ll_t *ll, const volatile void *buffer, uint32_t bytes, uint8_t to_card)
+{
+    DMA_Stream_TypeDef *stream = ll->config.stream;
+
+    StopDma(ll);
+
+    stream->PAR = BUS_ADDRESS(&ll->config.sdio->FIFO);
+    stream->M0AR = BUS_ADDRESS(buffer);
+    stream->NDTR = bytes / sizeof(uint32_t);    // ignored with the SDIO as flow controller, but keep it honest
+    stream->FCR = DMA_FCR;
+    stream->CR = DMA_CR | (to_card ? DMA_SxCR_DIR_0 : 0);
+    stream->CR |= DMA_SxCR_EN;
+}
+
+static inline void ConfigureData(sd_ll_t *ll, uint32_t bytes, uint32_t block_size, uint8_t to_host)
+{
+    SDIO_TypeDef *sdio = ll->config.sdio;
+
+    sdio->DTIMER = SDMMC_DATATIMEOUT;
+    sdio->DLEN = bytes;
+    sdio->DCTRL = block_size | SDIO_DCTRL_DMAEN | SDIO_DCTRL_DTEN | (to_host ? SDIO_DCTRL_DTDIR : 0);
+}
+
+// Every command we send has a short R1 response
+static sd_ll_ret_t Command(sd_ll_t *ll, uint32_t index, uint32_t argument, uint32_t *r1)
+{
+    SDIO_TypeDef *sdio = ll->config.sdio;
+
+    sdio->ICR = SDIO_STATIC_CMD_FLAGS;
+    sdio->ARG = argument;
+    sdio->CMD = index | SDIO_RESPONSE_SHORT | SDIO_WAIT_NO | SDIO_CPSM_ENABLE;
+
+    ll->stats.commands++;
+
+    uint32_t tick = HAL_GetTick();
+    uint32_t sta;
+
+    while (!((sta = Status(ll)) & (SDIO_STA_CMDREND | SDIO_STA_CCRCFAIL | SDIO_STA_CTIMEOUT)))
+    {
+        if (HAL_GetTick() - tick > SD_LL_CMD_TIMEOUT_MS)
+        {
+            return SD_LL_ERROR_CMD_TIMEOUT;
+        }
+    }
+
+    sdio->ICR = SDIO_STATIC_CMD_FLAGS;
+
+    if (sta & SDIO_STA_CTIMEOUT)
+    {
+        ll->last_status = sta;
+        return SD_LL_ERROR_CMD_TIMEOUT;
+    }
+
+    if ((sta & SDIO_STA_CCRCFAIL) || sdio->RESPCMD != index)
+    {
+        ll->last_status = sta;
+        return SD_LL_ERROR_CMD_CRC;
+    }
+
+    uint32_t status = sdio->RESP1;
+
+    if (r1 != NULL)
+    {
+        *r1 = status;
+    }
+
+    return (status & SDMMC_OCR_ERRORBITS) ? SD_LL_ERROR_CARD : SD_LL_SUCCESS;
+}
+
+static inline uint32_t Address(sd_ll_t *ll, uint32_t block)
+{
+    return ll->config.high_capacity ? block : block * SD_LL_BLOCK_SIZE;
+}
+
+static sd_ll_ret_t DataError(sd_ll_t *ll, uint32_t sta)
+{
+    ll->last_status = sta;
+    ll->stats.errors++;
+
+    SDLL_Abort(ll);
+
+    if (sta & SDIO_STA_DCRCFAIL)
+    {
+        return SD_LL_ERROR_DATA_CRC;
+    }
+
+    if (sta & SDIO_STA_DTIMEOUT)
+    {
+        return SD_LL_ERROR_DATA_TIMEOUT;
+    }
+
+    if (sta & (SDIO_STA_RXOVERR | SDIO_STA_TXUNDERR))
+    {
+        return SD_LL_ERROR_OVERRUN;
+    }
+
+    return SD_LL_ERROR_DMA;
+}
+
+sd_ll_ret_t SDLL_Init(sd_ll_t *ll, const sd_ll_config_t *config)
+{
+    if (ll == NULL || config == NULL || config->sdio == NULL || config->dma == NULL || config->stream == NULL)
+    {
+        return SD_LL_ERROR_NULL_PARAMETER;
+    }
+
+    memset(ll, 0, sizeof(*ll));
+    ll->config = *config;
+    ll->state = SD_LL_STATE_IDLE;
+
+    if (ll->config.timeout_ms == 0)
+    {
+        ll->config.timeout_ms = SD_LL_TRANSFER_TIMEOUT_MS;
+    }
+
+    // SCR: 8 bytes over the data lines (ACMD51). Borrow the bounce buffer for it.
+    uint32_t argument = ll->config.rca << 16;
+    sd_ll_ret_t res;
+
+    if ((res = Command(ll, SDMMC_CMD_SET_BLOCKLEN, SCR_BYTES, NULL)) != SD_LL_SUCCESS)
+    {
+        return res;
+    }
+
+    StartDma(ll, bounce, SCR_BYTES, 0);
+    ConfigureData(ll, SCR_BYTES, SDIO_DATABLOCK_SIZE_8B, 1);
+
+    if ((res = Command(ll, SDMMC_CMD_APP_CMD, argument, NULL)) == SD_LL_SUCCESS)
+    {
+        res = Command(ll, SDMMC_CMD_SD_APP_SEND_SCR, 0, NULL);
+    }
+
+    uint32_t tick = HAL_GetTick();
+
+    while (res == SD_LL_SUCCESS && !(Status(ll) & (SDIO_STA_DATAEND | DATA_ERRORS)))
+    {
+        if (HAL_GetTick() - tick > SD_LL_CMD_TIMEOUT_MS)
+        {
+            res = SD_LL_ERROR_DATA_TIMEOUT;
+        }
+    }
+
+    while (res == SD_LL_SUCCESS && !(DmaFlags(ll) & (DMA_FLAG_TC | DMA_FLAG_TE)))
+    {
+        if (HAL_GetTick() - tick > SD_LL_CMD_TIMEOUT_MS)
+        {
+            res = SD_LL_ERROR_DMA;
+        }
+    }
+
+    if (res == SD_LL_SUCCESS && (Status(ll) & DATA_ERRORS))
+    {
+        res = SD_LL_ERROR_DATA_CRC;
+    }
+
+    ll->config.sdio->DCTRL = 0;
+    ll->config.sdio->ICR = SDIO_STATIC_FLAGS;
+    StopDma(ll);
+
+    // Back to normal blocks, even if the SCR read failed
+    sd_ll_ret_t restore = Command(ll, SDMMC_CMD_SET_BLOCKLEN, SD_LL_BLOCK_SIZE, NULL);
+
+    if (res != SD_LL_SUCCESS)
+    {
+        return res;
+    }
+
+    ll->cmd23 = (((const uint8_t *)bounce)[SCR_CMD23_BYTE] & SCR_CMD23_BIT) != 0;
+
+    return restore;
+}
+
+static sd_ll_ret_t Start(sd_ll_t *ll, const volatile void *buffer, uint32_t block, uint32_t count, uint8_t write)
+{
+    if (ll == NULL || buffer == NULL)
+    {
+        return SD_LL_ERROR_NULL_PARAMETER;
+    }
+
+    if (ll->state != SD_LL_STATE_IDLE)
+    {
+        return SD_LL_ERROR_BUSY;
+    }
+
+    if (((uintptr_t)buffer & 3) != 0)
+    {
+        return SD_LL_ERROR_ALIGNMENT;
+    }
+
+    if (count == 0)
+    {
+        return SD_LL_SUCCESS;
+    }
+
+    sd_ll_ret_t res;
+    uint32_t bytes = count * SD_LL_BLOCK_SIZE;
+
+    ll->writing = write;
+    ll->count = count;
+    ll->start_tick = HAL_GetTick();
+    ll->open_ended = (count > 1 && !ll->cmd23);
+
+    // Tell the card how many blocks are coming, so it can stop by itself (and, for writes, pre-erase)
+    if (count > 1 && ll->cmd23)
+    {
+        if ((res = Command(ll, SDMMC_CMD_SET_BLOCK_COUNT, count, NULL)) != SD_LL_SUCCESS)
+        {
+            return res;
+        }
+    }
+
+    ll->config.sdio->ICR = SDIO_STATIC_DATA_FLAGS;
+
+    // Reads: the data path has to be armed before the command, the card starts sending right after the response.
+    // Writes: the other way around, like the HAL does: the card only takes data once it's answered the command.
+    if (write)
+    {
+        res = Command(ll, (count > 1) ? SDMMC_CMD_WRITE_MULT_BLOCK : SDMMC_CMD_WRITE_SINGLE_BLOCK,
+                Address(ll, block), NULL);
+
+        if (res != SD_LL_SUCCESS)
+        {
+            return res;
+        }
+
+        StartDma(ll, buffer, bytes, 1);
+        ConfigureData(ll, bytes, SDIO_DATABLOCK_SIZE_512B, 0);
+    }
+    else
+    {
+        StartDma(ll, buffer, bytes, 0);
+        ConfigureData(ll, bytes, SDIO_DATABLOCK_SIZE_512B, 1);
+
+        res = Command(ll, (count > 1) ? SDMMC_CMD_READ_MULT_BLOCK : SDMMC_CMD_READ_SINGLE_BLOCK,
+                Address(ll, block), NULL);
+
+        if (res != SD_LL_SUCCESS)
+        {
+            ll->config.sdio->DCTRL = 0;
+            StopDma(ll);
+            return res;
+        }
+    }
+
+    ll->state = SD_LL_STATE_DATA;
+    ll->stats.transfers++;
+
+    return SD_LL_SUCCESS;
+}
+
+sd_ll_ret_t SDLL_StartRead(sd_ll_t *ll, void *buffer, uint32_t block, uint32_t count)
+{
+    return Start(ll, buffer, block, count, 0);
+}
+
+sd_ll_ret_t SDLL_StartWrite(sd_ll_t *ll, const void *buffer, uint32_t block, uint32_t count)
+{
+    return Start(ll, buffer, block, count, 1);
+}
+
+sd_ll_ret_t SDLL_Poll(sd_ll_t *ll)
+{
+    if (ll == NULL)
+    {
+        return SD_LL_ERROR_NULL_PARAMETER;
+    }
+
+    sd_ll_ret_t res;
+
+    // A card that stops responding mid-transfer (or never finishes programming) would otherwise be polled forever
+    if (ll->state != SD_LL_STATE_IDLE && HAL_GetTick() - ll->start_tick > ll->config.timeout_ms)
+    {
+        ll->stats.errors++;
+        SDLL_Abort(ll);
+        return SD_LL_ERROR_TIMEOUT;
+    }
+
+    switch (ll->state)
+    {
+    case SD_LL_STATE_IDLE:
+        return SD_LL_SUCCESS;
+
+    case SD_LL_STATE_DATA:
+    {
+        uint32_t sta = Status(ll);
+
+        if (sta & DATA_ERRORS)
+        {
+            return DataError(ll, sta);
+        }
+
+        if (DmaFlags(ll) & (DMA_FLAG_TE | DMA_FLAG_DME))
+        {
+            return DataError(ll, sta);
+        }
+
+        // On reads, the last words can still be in the DMA's FIFO when the SDIO says it's done
+        if (!(sta & SDIO_STA_DATAEND) || (!ll->writing && !(DmaFlags(ll) & DMA_FLAG_TC)))
+        {
+            return SD_LL_PENDING;
+        }
+
+        ll->config.sdio->ICR = SDIO_STATIC_DATA_FLAGS;
+        ll->config.sdio->DCTRL = 0;
+        StopDma(ll);
+
+        ll->stats.blocks += ll->count;
+
+        if (ll->open_ended)
+        {
+            ll->stats.stops++;
+
+            if ((res = Command(ll, SDMMC_CMD_STOP_TRANSMISSION, 0, NULL)) != SD_LL_SUCCESS)
+            {
+                ll->state = SD_LL_STATE_IDLE;
+                ll->stats.errors++;
+                return res;
+            }
+        }
+
+        if (!ll->writing)
+        {
+            ll->state = SD_LL_STATE_IDLE;
+            return SD_LL_SUCCESS;
+        }
+
+        ll->state = SD_LL_STATE_PROGRAMMING;
+
+        return SD_LL_PENDING;
+    }
+
+    case SD_LL_STATE_PROGRAMMING:
+    {
+        uint8_t ready;
+
+        if ((res = SDLL_IsReady(ll, &ready)) != SD_LL_SUCCESS)
+        {
+            ll->state = SD_LL_STATE_IDLE;
+            ll->stats.errors++;
+            return res;
+        }
+
+        if (!ready)
+        {
+            return SD_LL_PENDING;
+        }
+
+        ll->state = SD_LL_STATE_IDLE;
+
+        return SD_LL_SUCCESS;
+    }
+
+    default:
+        return SD_LL_ERROR_GENERIC;
+    }
+}
+
+void SDLL_Abort(sd_ll_t *ll)
+{
+    if (ll == NULL || ll->state == SD_LL_STATE_IDLE)
+    {
+        return;
+    }
+
+    ll->config.sdio->DCTRL = 0;
+    ll->config.sdio->ICR = SDIO_STATIC_FLAGS;
+    StopDma(ll);
+
+    // After an error mid-transfer, the card can still be sending/receiving, even if it knew the count (CMD23)
+    if (ll->state == SD_LL_STATE_DATA && ll->count > 1)
+    {
+        ll->stats.stops++;
+        Command(ll, SDMMC_CMD_STOP_TRANSMISSION, 0, NULL);
+    }
+
+    ll->state = SD_LL_STATE_IDLE;
+}
+
+static sd_ll_ret_t Wait(sd_ll_t *ll, uint32_t timeout_ms)
+{
+    uint32_t tick = HAL_GetTick();
+    sd_ll_ret_t res;
+
+    while ((res = SDLL_Poll(ll)) == SD_LL_PENDING)
+    {
+        if (HAL_GetTick() - tick > timeout_ms)
+        {
+            ll->stats.errors++;
+            SDLL_Abort(ll);
+            return SD_LL_ERROR_TIMEOUT;
+        }
+    }
+
+    return res;
+}
+
+sd_ll_ret_t SDLL_ReadBlocks(sd_ll_t *ll, void *buffer, uint32_t block, uint32_t count, uint32_t timeout_ms)
+{
+    if (ll == NULL || buffer == NULL)
+    {
+        return SD_LL_ERROR_NULL_PARAMETER;
+    }
+
+    sd_ll_ret_t res;
+
+    if (((uintptr_t)buffer & 3) == 0)
+    {
+        if ((res = SDLL_StartRead(ll, buffer, block, count)) != SD_LL_SUCCESS)
+        {
+            return res;
+        }
+
+        return Wait(ll, timeout_ms);
+    }
+
+    uint8_t *dst = buffer;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if ((res = SDLL_StartRead(ll, bounce, block + i, 1)) != SD_LL_SUCCESS
+                || (res = Wait(ll, timeout_ms)) != SD_LL_SUCCESS)
+        {
+            return res;
+        }
+
+        memcpy(dst + i * SD_LL_BLOCK_SIZE, bounce, SD_LL_BLOCK_SIZE);
+        ll->stats.bounced++;
+    }
+
+    return SD_LL_SUCCESS;
+}
+
+sd_ll_ret_t SDLL_WriteBlocks(sd_ll_t *ll, const void *buffer, uint32_t block, uint32_t count, uint32_t timeout_ms)
+{
+    if (ll == NULL || buffer == NULL)
+    {
+        return SD_LL_ERROR_NULL_PARAMETER;
+    }
+
+    sd_ll_ret_t res;
+
+    if (((uintptr_t)buffer & 3) == 0)
+    {
+        if ((res = SDLL_StartWrite(ll, buffer, block, count)) != SD_LL_SUCCESS)
+        {
+            return res;
+        }
+
+        return Wait(ll, timeout_ms);
+    }
+
+    const uint8_t *src = buffer;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        memcpy(bounce, src + i * SD_LL_BLOCK_SIZE, SD_LL_BLOCK_SIZE);
+        ll->stats.bounced++;
+
+        if ((res = SDLL_StartWrite(ll, bounce, block + i, 1)) != SD_LL_SUCCESS
+                || (res = Wait(ll, timeout_ms)) != SD_LL_SUCCESS)
+        {
+            return res;
+        }
+    }
+
+    return SD_LL_SUCCESS;
+}
+
+sd_ll_ret_t SDLL_IsReady(sd_ll_t *ll, uint8_t *ready)
+{
+    if (ll == NULL || ready == NULL)
+    {
+        return SD_LL_ERROR_NULL_PARAMETER;
+    }
+
+    uint32_t r1;
+    sd_ll_ret_t res = Command(ll, SDMMC_CMD_SEND_STATUS, ll->config.rca << 16, &r1);
+
+    if (res != SD_LL_SUCCESS)
+    {
+        return res;
+    }
+
+    *ready = (R1_STATE(r1) == R1_STATE_TRANSFER);
+
+    return SD_LL_SUCCESS;
+}
@@ -0,0 +1,114 @@
+/*
+ * sd_profile.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#include "sd_profile.h"
+#include "crc32.h"
+#include "ff.h"
+
+#include <string.h>
+
+#define CRC_LENGTH offsetof(sd_profile_t, crc)
+
+void SDProfile_Recommend(sd_profile_t *profile)
+{
+    if (profile == NULL)
+    {
+        return;
+    }
+
+    uint32_t best_kbps = 0;
+
+    for (size_t i = 0; i < SD_PROFILE_NUM_SIZES; i++)
+    {
+        if (profile->sequential_kbps[i] > best_kbps)
+        {
+            best_kbps = profile->sequential_kbps[i];
+        }
+    }
+
+    // Bigger requests cost RAM and latency, so take the smallest one that's nearly as fast as the best
+    profile->read_size_b = (uint32_t)profile->request_blocks[SD_PROFILE_NUM_SIZES - 1] * SD_PROFILE_BLOCK_SIZE;
+
+    for (size_t i = 0; i < SD_PROFILE_NUM_SIZES; i++)
+    {
+        if ((uint64_t)profile->sequential_kbps[i] * 100 >= (uint64_t)best_kbps * SD_PROFILE_GOOD_ENOUGH_PERCENT)
+        {
+            profile->read_size_b = (uint32_t)profile->request_blocks[i] * SD_PROFILE_BLOCK_SIZE;
+            break;
+        }
+    }
+
+    profile->stall_us = profile->max_us;
+}
+
+sd_profile_ret_t SDProfile_Load(const uint32_t cid[4], sd_profile_t *profile)
+{
+    if (cid == NULL || profile == NULL)
+    {
+        return SD_PROFILE_ERROR_NULL_PARAMETER;
+    }
+
+    FIL file;
+    UINT bytes_read;
+
+    if (f_open(&file, SD_PROFILE_PATH, FA_OPEN_EXISTING | FA_READ) != FR_OK)
+    {
+        return SD_PROFILE_ERROR_NOT_FOUND;
+    }
+
+    FRESULT res = f_read(&file, profile, sizeof(*profile), &bytes_read);
+    f_close(&file);
+
+    if (res != FR_OK || bytes_read != sizeof(*profile))
+    {
+        return SD_PROFILE_ERROR_CORRUPT;
+    }
+
+    if (profile->magic != SD_PROFILE_MAGIC || profile->version != SD_PROFILE_VERSION
+            || profile->size != sizeof(*profile) || profile->crc != CRC32_Update(CRC32_INIT, profile, CRC_LENGTH))
+    {
+        return SD_PROFILE_ERROR_CORRUPT;
+    }
+
+    if (memcmp(profile->cid, cid, sizeof(profile->cid)) != 0)
+    {
+        return SD_PROFILE_ERROR_WRONG_CARD;
+    }
+
+    return SD_PROFILE_SUCCESS;
+}
+
+sd_profile_ret_t SDProfile_Save(sd_profile_t *profile)
+{
+    if (profile == NULL)
+    {
+        return SD_PROFILE_ERROR_NULL_PARAMETER;
+    }
+
+    profile->magic = SD_PROFILE_MAGIC;
+    profile->version = SD_PROFILE_VERSION;
+    profile->size = sizeof(*profile);
+    profile->crc = CRC32_Update(CRC32_INIT, profile, CRC_LENGTH);
+
+    FIL file;
+    UINT bytes_written;
+
+    if (f_open(&file, SD_PROFILE_PATH, FA_CREATE_ALWAYS | FA_WRITE) != FR_OK)
+    {
+        return SD_PROFILE_ERROR_UNABLE_TO_WRITE;
+    }
+
+    FRESULT res = f_write(&file, profile, sizeof(*profile), &bytes_written);
+
+    // f_close flushes, so it has to succeed too
+    if (f_close(&file) != FR_OK || res != FR_OK || bytes_written != sizeof(*profile))
+    {
+        return SD_PROFILE_ERROR_UNABLE_TO_WRITE;
+    }
+
+    return SD_PROFILE_SUCCESS;
+}
@@ -0,0 +1,642 @@
+/*
+ * settings.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#include "settings.h"
+
+#include <string.h>
+
+#include "crc32.h"
+
+// A sector starts with its state, then its sequence number, then the log. The sequence is programmed first and the
+// state last, so a sector is only ever active once everything in it is there.
+#define STATE_OFFSET 0
+#define SEQUENCE_OFFSET 4
+#define LOG_START 8
+
+#define ERASED_WORD 0xFFFFFFFFUL
+
+// "SETT". Anything else that isn't erased (a state cut short, say) is a sector to be erased.
+#define STATE_ACTIVE 0x54544553UL
+
+// What an old active sector is marked before it's erased: an erase cut short can leave anything behind, but not its
+// state back the way it was, with a sequence number that might now look newer than the active one's
+#define STATE_RETIRED 0x00000000UL
+
+// Header word, the value in words, CRC word
+#define VALUE_BYTES(length) (((length) == SETTINGS_DELETED) ? 0 : (length))
+#define RECORD_WORDS(length) (2 + (VALUE_BYTES(length) + 3) / 4)
+#define MAX_RECORD_WORDS RECORD_WORDS(SETTINGS_MAX_VALUE)
+
+// Not where any record is
+#define NO_OFFSET UINT32_MAX
+
+typedef enum
+{
+    SPARE_UNKNOWN = 0,                      // says it's erased, but may have been cut short being erased or written
+    SPARE_ERASED,
+    SPARE_DIRTY                             // has to be erased before it's copied to
+} spare_t;
+
+typedef struct
+{
+    uint16_t key;
+    uint32_t offset;                        // of its latest record, in the active sector (maybe a deletion)
+} entry_t;
+
+static const settings_flash_t *flash;
+
+static struct
+{
+    uint8_t ready;
+    uint32_t active;                        // sector 0 or 1
+    uint32_t sequence;
+    uint32_t end;                           // where the next record goes
+    spare_t spare;                          // the other sector
+    entry_t entries[SETTINGS_MAX_KEYS];
+    uint32_t count;
+    uint32_t record[MAX_RECORD_WORDS];      // being written, or copied
+    settings_stats_t stats;
+} settings;
+
+static inline uint32_t Word(uint32_t sector, uint32_t offset)
+{
+    uint32_t word;
+
+    memcpy(&word, flash->Sector(sector) + offset, sizeof(word));
+
+    return word;
+}
+
+static uint8_t Blank(uint32_t sector, uint32_t offset, uint32_t words)
+{
+    for (uint32_t i = 0; i < words; i++)
+    {
+        if (Word(sector, offset + i * 4) != ERASED_WORD)
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+// Whether sequence a came after b, the counter having gone round or not
+static inline uint8_t IsNewer(uint32_t a, uint32_t b)
+{
+    return (int32_t)(a - b) > 0;
+}
+
+/*
+ * Records
+ */
+
+static inline uint32_t Check(uint32_t key, uint32_t length)
+{
+    return ~(key ^ (key >> 8) ^ length ^ 0x5A) & 0xFF;
+}
+
+static inline uint32_t Header(uint16_t key, uint32_t length)
+{
+    return key | (length << 16) | (Check(key, length) << 24);
+}
+
+static inline uint16_t KeyOf(uint32_t header)
+{
+    return (uint16_t)(header & 0xFFFF);
+}
+
+static inline uint32_t LengthOf(uint32_t header)
+{
+    return (header >> 16) & 0xFF;
+}
+
+static inline uint8_t IsHeader(uint32_t header)
+{
+    uint32_t length = LengthOf(header);
+
+    return KeyOf(header) != SETTINGS_KEY_NONE && (length <= SETTINGS_MAX_VALUE || length == SETTINGS_DELETED)
+            && (header >> 24) == Check(KeyOf(header), length);
+}
+
+// The CRC at the end of the record at offset, against the header and value before it
+static uint8_t IsIntact(uint32_t sector, uint32_t offset)
+{
+    uint32_t length = LengthOf(Word(sector, offset));
+    uint32_t crc = Word(sector, offset + (RECORD_WORDS(length) - 1) * 4);
+
+    return crc == CRC32_Update(CRC32_INIT, flash->Sector(sector) + offset, 4 + VALUE_BYTES(length));
+}
+
+// Into settings.record, 0xFF after the value like erased flash, so the padding programs nothing
+static uint32_t Build(uint16_t key, const void *value, uint32_t length)
+{
+    uint32_t words = RECORD_WORDS(length);
+
+    memset(settings.record, 0xFF, sizeof(settings.record));
+    settings.record[0] = Header(key, length);
+
+    if (VALUE_BYTES(length) > 0)
+    {
+        memcpy(&settings.record[1], value, length);
+    }
+
+    settings.record[words - 1] = CRC32_Update(CRC32_INIT, settings.record, 4 + VALUE_BYTES(length));
+
+    return words;
+}
+
+/*
+ * The index: each key's latest record
+ */
+
+static entry_t *Find(uint16_t key)
+{
+    for (uint32_t i = 0; i < settings.count; i++)
+    {
+        if (settings.entries[i].key == key)
+        {
+            return &settings.entries[i];
+        }
+    }
+
+    return NULL;
+}
+
+static inline uint8_t IsDeleted(const entry_t *entry)
+{
+    return LengthOf(Word(settings.active, entry->offset)) == SETTINGS_DELETED;
+}
+
+static void Remember(uint16_t key, uint32_t offset)
+{
+    entry_t *entry = Find(key);
+
+    if (entry == NULL && settings.count < SETTINGS_MAX_KEYS)
+    {
+        entry = &settings.entries[settings.count++];
+        entry->key = key;
+    }
+
+    if (entry != NULL)
+    {
+        entry->offset = offset;
+    }
+}
+
+static void Forget(uint32_t i)
+{
+    settings.entries[i] = settings.entries[--settings.count];
+}
+
+// The last intact record for key before offset, NO_OFFSET if there isn't one
+static uint32_t FindPrevious(uint16_t key, uint32_t before)
+{
+    uint32_t found = NO_OFFSET;
+
+    for (uint32_t offset = LOG_START; offset < before;)
+    {
+        uint32_t header = Word(settings.active, offset);
+
+        if (KeyOf(header) == key && IsIntact(settings.active, offset))
+        {
+            found = offset;
+        }
+
+        offset += RECORD_WORDS(LengthOf(header)) * 4;
+    }
+
+    return found;
+}
+
+/*
+ * Only the headers on the way through, to find each key's latest record and the end of the log. Then only those
+ * records' CRCs: one that doesn't check out (cut short when the power went) means the one before it is the value,
+ * found by going through the log again for that key. That only happens after a power cut, and for the one key.
+ */
+static void Scan(void)
+{
+    uint32_t offset = LOG_START;
+
+    settings.count = 0;
+
+    while (offset + 4 <= flash->sector_size)
+    {
+        uint32_t header = Word(settings.active, offset);
+
+        if (header == ERASED_WORD)
+        {
+            break;
+        }
+
+        settings.stats.headers_read++;
+
+        // A header cut short: where the next record starts can't be trusted, so nothing more goes in this sector.
+        // The next Settings_Set compacts.
+        if (!IsHeader(header) || offset + RECORD_WORDS(LengthOf(header)) * 4 > flash->sector_size)
+        {
+            settings.stats.torn++;
+            offset = flash->sector_size;
+            break;
+        }
+
+        Remember(KeyOf(header), offset);
+        offset += RECORD_WORDS(LengthOf(header)) * 4;
+    }
+
+    settings.end = offset;
+
+    for (uint32_t i = 0; i < settings.count;)
+    {
+        entry_t *entry = &settings.entries[i];
+
+        if (IsIntact(settings.active, entry->offset))
+        {
+            i++;
+            continue;
+        }
+
+        settings.stats.torn++;
+        entry->offset = FindPrevious(entry->key, entry->offset);
+
+        if (entry->offset == NO_OFFSET)
+        {
+            Forget(i);
+        }
+        else
+        {
+            i++;
+        }
+    }
+}
+
+/*
+ * Sectors
+ */
+
+static settings_ret_t EraseSpare(void)
+{
+    uint32_t spare = settings.active ^ 1;
+    uint32_t retired = STATE_RETIRED;
+
+    settings.spare = SPARE_DIRTY;
+    settings.stats.erases++;
+
+    if (Word(spare, STATE_OFFSET) == STATE_ACTIVE && flash->Program(spare, STATE_OFFSET, &retired, 1)
+            != SETTINGS_SUCCESS)
+    {
+        return SETTINGS_ERROR_FLASH;
+    }
+
+    if (flash->Erase(spare) != SETTINGS_SUCCESS)
+    {
+        return SETTINGS_ERROR_FLASH;
+    }
+
+    settings.spare = SPARE_ERASED;
+
+    return SETTINGS_SUCCESS;
+}
+
+// Neither sector active: erase what isn't already, and start sector 0 off empty
+static settings_ret_t Format(void)
+{
+    uint32_t sequence = 1;
+    uint32_t state = STATE_ACTIVE;
+    uint32_t words = flash->sector_size / 4;
+
+    settings.stats.formatted = 1;
+
+    for (uint32_t sector = 0; sector < 2; sector++)
+    {
+        if (!Blank(sector, 0, words))
+        {
+            settings.stats.erases++;
+
+            if (flash->Erase(sector) != SETTINGS_SUCCESS)
+            {
+                return SETTINGS_ERROR_FLASH;
+            }
+        }
+    }
+
+    if (flash->Program(0, SEQUENCE_OFFSET, &sequence, 1) != SETTINGS_SUCCESS
+            || flash->Program(0, STATE_OFFSET, &state, 1) != SETTINGS_SUCCESS)
+    {
+        return SETTINGS_ERROR_FLASH;
+    }
+
+    settings.active = 0;
+    settings.spare = SPARE_ERASED;
+
+    return SETTINGS_SUCCESS;
+}
+
+/*
+ * Copy what's live to the spare sector, and make it the active one. Deletions are left behind. The spare is
+ * numbered first and marked active last: until then the old sector is still the active one, whatever happens.
+ */
+static settings_ret_t Compact(void)
+{
+    uint32_t spare = settings.active ^ 1;
+    uint32_t sequence = settings.sequence + 1;
+    uint32_t state = STATE_ACTIVE;
+    uint32_t moved[SETTINGS_MAX_KEYS];
+    uint32_t offset = LOG_START;
+
+    if (settings.spare == SPARE_UNKNOWN && Blank(spare, 0, flash->sector_size / 4))
+    {
+        settings.spare = SPARE_ERASED;
+    }
+
+    // Settings_Service hasn't got round to it
+    if (settings.spare != SPARE_ERASED)
+    {
+        settings.stats.inline_erases++;
+
+        if (EraseSpare() != SETTINGS_SUCCESS)
+        {
+            return SETTINGS_ERROR_FLASH;
+        }
+    }
+
+    settings.spare = SPARE_DIRTY;
+
+    if (flash->Program(spare, SEQUENCE_OFFSET, &sequence, 1) != SETTINGS_SUCCESS)
+    {
+        return SETTINGS_ERROR_FLASH;
+    }
+
+    for (uint32_t i = 0; i < settings.count; i++)
+    {
+        const entry_t *entry = &settings.entries[i];
+        uint32_t words = RECORD_WORDS(LengthOf(Word(settings.active, entry->offset)));
+
+        moved[i] = NO_OFFSET;
+
+        if (IsDeleted(entry))
+        {
+            continue;
+        }
+
+        // Through RAM: the flash can't be read while it's being programmed
+        memcpy(settings.record, flash->Sector(settings.active) + entry->offset, words * 4);
+
+        if (offset + words * 4 > flash->sector_size
+                || flash->Program(spare, offset, settings.record, words) != SETTINGS_SUCCESS)
+        {
+            return (offset + words * 4 > flash->sector_size) ? SETTINGS_ERROR_FULL : SETTINGS_ERROR_FLASH;
+        }
+
+        moved[i] = offset;
+        offset += words * 4;
+    }
+
+    if (flash->Program(spare, STATE_OFFSET, &state, 1) != SETTINGS_SUCCESS)
+    {
+        return SETTINGS_ERROR_FLASH;
+    }
+
+    // It's the active sector now. The old one is left as it is (active, but numbered lower) until it's erased.
+    settings.active = spare;
+    settings.sequence = sequence;
+    settings.end = offset;
+    settings.stats.compactions++;
+
+    for (uint32_t i = settings.count; i-- > 0;)
+    {
+        settings.entries[i].offset = moved[i];
+
+        if (moved[i] == NO_OFFSET)
+        {
+            Forget(i);
+        }
+    }
+
+    return SETTINGS_SUCCESS;
+}
+
+static inline uint8_t Fits(uint32_t words)
+{
+    return settings.end + words * 4 <= flash->sector_size && Blank(settings.active, settings.end, words);
+}
+
+static settings_ret_t Append(uint16_t key, const void *value, uint32_t length)
+{
+    uint32_t words = RECORD_WORDS(length);
+    uint8_t known = Find(key) != NULL;
+
+    // Out of room, or of keys (deletions only go at a compaction)
+    if (!Fits(words) || (!known && settings.count == SETTINGS_MAX_KEYS))
+    {
+        settings_ret_t res = Compact();
+
+        if (res != SETTINGS_SUCCESS)
+        {
+            return res;
+        }
+
+        known = Find(key) != NULL;
+
+        if (!Fits(words) || (!known && settings.count == SETTINGS_MAX_KEYS))
+        {
+            return SETTINGS_ERROR_FULL;
+        }
+    }
+
+    Build(key, value, length);
+
+    // Its room is taken whether it all gets there or not: a record cut short is still where it is
+    uint32_t offset = settings.end;
+    settings.end += words * 4;
+
+    if (flash->Program(settings.active, offset, settings.record, words) != SETTINGS_SUCCESS)
+    {
+        return SETTINGS_ERROR_FLASH;
+    }
+
+    Remember(key, offset);
+    settings.stats.writes++;
+
+    return SETTINGS_SUCCESS;
+}
+
+settings_ret_t Settings_Init(const settings_flash_t *new_flash)
+{
+    if (new_flash == NULL || new_flash->Sector == NULL || new_flash->Program == NULL || new_flash->Erase == NULL)
+    {
+        return SETTINGS_ERROR_NULL_PARAMETER;
+    }
+
+    if (new_flash->sector_size % 4 != 0 || new_flash->sector_size < LOG_START + MAX_RECORD_WORDS * 4)
+    {
+        return SETTINGS_ERROR_INVALID;
+    }
+
+    flash = new_flash;
+    settings.ready = 0;
+    memset(&settings.stats, 0, sizeof(settings.stats));
+
+    uint32_t states[2] = { Word(0, STATE_OFFSET), Word(1, STATE_OFFSET) };
+    uint8_t active[2] = { states[0] == STATE_ACTIVE, states[1] == STATE_ACTIVE };
+
+    if (active[0] && active[1])
+    {
+        // A compaction that got as far as marking the new one but not erasing the old one
+        settings.active = IsNewer(Word(1, SEQUENCE_OFFSET), Word(0, SEQUENCE_OFFSET)) ? 1 : 0;
+        settings.spare = SPARE_DIRTY;
+    }
+    else if (active[0] || active[1])
+    {
+        settings.active = active[1] ? 1 : 0;
+        settings.spare = (states[settings.active ^ 1] == ERASED_WORD) ? SPARE_UNKNOWN : SPARE_DIRTY;
+    }
+    else if (Format() != SETTINGS_SUCCESS)
+    {
+        return SETTINGS_ERROR_FLASH;
+    }
+
+    settings.sequence = Word(settings.active, SEQUENCE_OFFSET);
+    Scan();
+    settings.ready = 1;
+
+    return SETTINGS_SUCCESS;
+}
+
+settings_ret_t Settings_Get(uint16_t key, void *value, uint32_t size, uint32_t *length)
+{
+    if (value == NULL && size > 0)
+    {
+        return SETTINGS_ERROR_NULL_PARAMETER;
+    }
+
+    if (!settings.ready)
+    {
+        return SETTINGS_ERROR_NOT_INITIALIZED;
+    }
+
+    const entry_t *entry = Find(key);
+
+    if (entry == NULL || IsDeleted(entry))
+    {
+        return SETTINGS_ERROR_NOT_FOUND;
+    }
+
+    uint32_t stored = LengthOf(Word(settings.active, entry->offset));
+
+    if (length != NULL)
+    {
+        *length = stored;
+    }
+
+    if (stored > size)
+    {
+        return SETTINGS_ERROR_TOO_SMALL;
+    }
+
+    memcpy(value, flash->Sector(settings.active) + entry->offset + 4, stored);
+
+    return SETTINGS_SUCCESS;
+}
+
+settings_ret_t Settings_Set(uint16_t key, const void *value, uint32_t length)
+{
+    if (value == NULL && length > 0)
+    {
+        return SETTINGS_ERROR_NULL_PARAMETER;
+    }
+
+    if (!settings.ready)
+    {
+        return SETTINGS_ERROR_NOT_INITIALIZED;
+    }
+
+    if (key == SETTINGS_KEY_NONE || length > SETTINGS_MAX_VALUE)
+    {
+        return SETTINGS_ERROR_INVALID;
+    }
+
+    // Flash wears: the same value again isn't written
+    const entry_t *entry = Find(key);
+
+    if (entry != NULL && LengthOf(Word(settings.active, entry->offset)) == length
+            && (length == 0 || memcmp(flash->Sector(settings.active) + entry->offset + 4, value, length) == 0))
+    {
+        settings.stats.unchanged++;
+        return SETTINGS_UNCHANGED;
+    }
+
+    return Append(key, value, length);
+}
+
+settings_ret_t Settings_Delete(uint16_t key)
+{
+    if (!settings.ready)
+    {
+        return SETTINGS_ERROR_NOT_INITIALIZED;
+    }
+
+    const entry_t *entry = Find(key);
+
+    if (entry == NULL || IsDeleted(entry))
+    {
+        return SETTINGS_ERROR_NOT_FOUND;
+    }
+
+    return Append(key, NULL, SETTINGS_DELETED);
+}
+
+settings_ret_t Settings_Service(void)
+{
+    if (!settings.ready)
+    {
+        return SETTINGS_ERROR_NOT_INITIALIZED;
+    }
+
+    // Said to be erased, but maybe cut short being erased or being copied to: read it through once to be sure
+    if (settings.spare == SPARE_UNKNOWN && Blank(settings.active ^ 1, 0, flash->sector_size / 4))
+    {
+        settings.spare = SPARE_ERASED;
+    }
+
+    if (settings.spare == SPARE_ERASED)
+    {
+        return SETTINGS_READY;
+    }
+
+    return EraseSpare();
+}
+
+settings_ret_t Settings_GetStats(settings_stats_t *stats)
+{
+    if (stats == NULL)
+    {
+        return SETTINGS_ERROR_NULL_PARAMETER;
+    }
+
+    if (!settings.ready)
+    {
+        return SETTINGS_ERROR_NOT_INITIALIZED;
+    }
+
+    settings.stats.keys = 0;
+    settings.stats.live_b = LOG_START;
+
+    for (uint32_t i = 0; i < settings.count; i++)
+    {
+        if (!IsDeleted(&settings.entries[i]))
+        {
+            settings.stats.keys++;
+            settings.stats.live_b += RECORD_WORDS(LengthOf(Word(settings.active, settings.entries[i].offset))) * 4;
+        }
+    }
+
+    settings.stats.used_b = settings.end;
+    settings.stats.sequence = settings.sequence;
+    *stats = settings.stats;
+
+    return SETTINGS_SUCCESS;
+}
@@ -0,0 +1,190 @@
+/*
+ * shuffle.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#include "shuffle.h"
+
+#include <string.h>
+
+static inline uint32_t Mask(uint32_t bits)
+{
+    return (bits >= 32) ? 0xFFFFFFFF : ((uint32_t)1 << bits) - 1;
+}
+
+// Integer hash (lowbias32): every bit of the input reaches every bit of the output
+static inline uint32_t Mix(uint32_t x)
+{
+    x ^= x >> 16;
+    x *= 0x7FEB352D;
+    x ^= x >> 15;
+    x *= 0x846CA68B;
+    x ^= x >> 16;
+
+    return x;
+}
+
+static void SetKeys(shuffle_t *shuffle)
+{
+    for (uint32_t i = 0; i < SHUFFLE_ROUNDS; i++)
+    {
+        shuffle->keys[i] = Mix(shuffle->seed ^ Mix(shuffle->pass * SHUFFLE_ROUNDS + i + 1));
+    }
+}
+
+shuffle_ret_t Shuffle_Init(shuffle_t *shuffle, uint32_t count, uint32_t seed)
+{
+    if (shuffle == NULL)
+    {
+        return SHUFFLE_ERROR_NULL_PARAMETER;
+    }
+
+    if (count == 0)
+    {
+        return SHUFFLE_ERROR_EMPTY;
+    }
+
+    memset(shuffle, 0, sizeof(*shuffle));
+    shuffle->count = count;
+    shuffle->seed = seed;
+
+    uint32_t bits = 0;
+
+    while (bits < 32 && (count - 1) >> bits != 0)
+    {
+        bits++;
+    }
+
+    shuffle->low_bits = (uint8_t)(bits / 2);
+    shuffle->high_bits = (uint8_t)(bits - bits / 2);
+
+    SetKeys(shuffle);
+
+    return SHUFFLE_SUCCESS;
+}
+
+// Over [0, 2^bits): each round, the half that's kept as it is keys what the other's xored with, and they swap
+static uint32_t Permute(const shuffle_t *shuffle, uint32_t x)
+{
+    uint32_t a = x >> shuffle->low_bits;
+    uint32_t b = x & Mask(shuffle->low_bits);
+    uint32_t a_bits = shuffle->high_bits;
+    uint32_t b_bits = shuffle->low_bits;
+
+    for (uint32_t i = 0; i < SHUFFLE_ROUNDS; i++)
+    {
+        uint32_t mixed = (a ^ Mix(b ^ shuffle->keys[i])) & Mask(a_bits);
+        uint32_t bits = a_bits;
+
+        a = b;
+        b = mixed;
+        a_bits = b_bits;
+        b_bits = bits;
+    }
+
+    return (a << shuffle->low_bits) | b;
+}
+
+// The rounds backwards
+static uint32_t Unpermute(const shuffle_t *shuffle, uint32_t x)
+{
+    uint32_t a = x >> shuffle->low_bits;
+    uint32_t b = x & Mask(shuffle->low_bits);
+    uint32_t a_bits = shuffle->high_bits;
+    uint32_t b_bits = shuffle->low_bits;
+
+    for (uint32_t i = SHUFFLE_ROUNDS; i > 0; i--)
+    {
+        uint32_t mixed = (b ^ Mix(a ^ shuffle->keys[i - 1])) & Mask(b_bits);
+        uint32_t bits = b_bits;
+
+        b = a;
+        a = mixed;
+        b_bits = a_bits;
+        a_bits = bits;
+    }
+
+    return (a << shuffle->low_bits) | b;
+}
+
+uint32_t Shuffle_Track(const shuffle_t *shuffle, uint32_t position)
+{
+    if (position >= shuffle->count)
+    {
+        return shuffle->count;
+    }
+
+    // Past the end is no track: on to wherever that goes, which comes back round to one, at worst through all of
+    // the ones past the end
+    do
+    {
+        position = Permute(shuffle, position);
+    } while (position >= shuffle->count);
+
+    return position;
+}
+
+uint32_t Shuffle_Position(const shuffle_t *shuffle, uint32_t track)
+{
+    if (track >= shuffle->count)
+    {
+        return shuffle->count;
+    }
+
+    do
+    {
+        track = Unpermute(shuffle, track);
+    } while (track >= shuffle->count);
+
+    return track;
+}
+
+uint32_t Shuffle_Current(const shuffle_t *shuffle)
+{
+    return Shuffle_Track(shuffle, shuffle->position);
+}
+
+uint32_t Shuffle_Next(shuffle_t *shuffle)
+{
+    if (++shuffle->position == shuffle->count)
+    {
+        shuffle->position = 0;
+        shuffle->pass++;
+        SetKeys(shuffle);
+    }
+
+    return Shuffle_Current(shuffle);
+}
+
+uint32_t Shuffle_Previous(shuffle_t *shuffle)
+{
+    if (shuffle->position == 0)
+    {
+        shuffle->position = shuffle->count;
+        shuffle->pass--;
+        SetKeys(shuffle);
+    }
+
+    shuffle->position--;
+
+    return Shuffle_Current(shuffle);
+}
+
+shuffle_ret_t Shuffle_Seek(shuffle_t *shuffle, uint32_t track)
+{
+    if (shuffle == NULL)
+    {
+        return SHUFFLE_ERROR_NULL_PARAMETER;
+    }
+
+    if (track >= shuffle->count)
+    {
+        return SHUFFLE_ERROR_OUT_OF_RANGE;
+    }
+
+    shuffle->position = Shuffle_Position(shuffle, track);
+
+    return SHUFFLE_SUCCESS;
+}
@@ -37,6 +37,36 @@ static const uint16_t WAV_HEADER_AUDIOFORMAT_PCM = 1;
 // Identifier « data »
 static const uint8_t WAV_HEADER_DATABLOCID[] = { 0x64, 0x61, 0x74, 0x61 };
 
+// RF64 (EBU Tech 3306) is RIFF for files of 4 GB and up: « RF64 » instead of « RIFF », the 32-bit sizes all set to
+// 0xFFFFFFFF, and the real ones in a « ds64 » chunk, which has to be the first one after « WAVE »
+static const uint8_t WAV_HEADER_RF64[] = { 0x52, 0x46, 0x36, 0x34 };
+static const uint8_t WAV_HEADER_DS64[] = { 0x64, 0x73, 0x36, 0x34 };
+static const uint32_t WAV_SIZE_IN_DS64 = 0xFFFFFFFF;
+
+// riffSize, dataSize and sampleCount (64-bit), then tableLength (32-bit), and no table
+#define WAV_DS64_SIZE 28
+
+// Identifier « JUNK »: a chunk that's only there to take up space, and everyone skips
+static const uint8_t WAV_HEADER_JUNK[] = { 0x4A, 0x55, 0x4E, 0x4B };
+
+// Identifier « LIST » with list type « INFO »: tags, as sub-chunks of text (RIFF Multimedia Programming Interface)
+static const uint8_t WAV_HEADER_LIST[] = { 0x4C, 0x49, 0x53, 0x54 };
+static const uint8_t WAV_HEADER_INFO[] = { 0x49, 0x4E, 0x46, 0x4F };
+
+// The INFO sub-chunks we read: « INAM » title, « IART » artist, « IPRD » album (product), « ITRK » track number,
+// and « IPRT » (part), which some taggers use for the track number instead
+static const uint8_t WAV_INFO_TITLE[] = { 0x49, 0x4E, 0x41, 0x4D };
+static const uint8_t WAV_INFO_ARTIST[] = { 0x49, 0x41, 0x52, 0x54 };
+static const uint8_t WAV_INFO_ALBUM[] = { 0x49, 0x50, 0x52, 0x44 };
+static const uint8_t WAV_INFO_TRACK[] = { 0x49, 0x54, 0x52, 0x4B };
+static const uint8_t WAV_INFO_PART[] = { 0x49, 0x50, 0x52, 0x54 };
+
+// Identifier + size
+#define WAV_CHUNK_HEADER_LEN 8
+
+// « RIFF », the size and « WAVE », before the first chunk
+#define WAV_RIFF_HEADER_LEN 12
+
 /*
  * Macros are really interesting!
  *
@@ -115,42 +145,84 @@ static inline codec_ret_t STORE_METADATA_FIELD_16(uint16_t *field, const uint8_t
     return CODEC_SUCCESS;
 }
 
-codec_ret_t WAV_Open(void)
+static inline codec_ret_t STORE_METADATA_FIELD_64(uint64_t *field, const uint8_t **buffer)
 {
-    // TODO
+    memcpy(field, *buffer, sizeof(uint64_t));
+
+    *buffer += sizeof(uint64_t);
 
     return CODEC_SUCCESS;
 }
 
-codec_ret_t WAV_Close(void)
+// The same thing the other way around, for the encoder
+static inline void WRITE_IDENTIFIER(const uint8_t *identifier, uint8_t **buffer, size_t length)
 {
-    // TODO
+    memcpy(*buffer, identifier, length);
 
-    return CODEC_SUCCESS;
+    *buffer += length;
 }
 
-codec_ret_t WAV_ValidateHeader(const void *buffer, void *metadata, size_t *bytes_read)
+static inline void WRITE_FIELD_32(uint32_t field, uint8_t **buffer)
 {
-    wav_metadata_t *wav_metadata = (wav_metadata_t *)metadata;
-    const uint8_t *curr_buffer = (const uint8_t *)buffer;
+    memcpy(*buffer, &field, sizeof(uint32_t));
 
-    // Read the RIFF identifier
-    WAV_ERR(VALIDATE_IDENTIFIER(WAV_HEADER_RIFF, &curr_buffer, LEN(WAV_HEADER_RIFF)));
+    *buffer += sizeof(uint32_t);
+}
 
-    // Read the file size
-    WAV_ERR(STORE_METADATA_FIELD_32(&wav_metadata->file_size, &curr_buffer));
+static inline void WRITE_FIELD_16(uint16_t field, uint8_t **buffer)
+{
+    memcpy(*buffer, &field, sizeof(uint16_t));
 
-    // Read the file format identifier
-    WAV_ERR(VALIDATE_IDENTIFIER(WAV_HEADER_FILEFORMATID, &curr_buffer, LEN(WAV_HEADER_FILEFORMATID)));
+    *buffer += sizeof(uint16_t);
+}
 
-    // Read the fmt identifier
-    WAV_ERR(VALIDATE_IDENTIFIER(WAV_HEADER_FMT, &curr_buffer, LEN(WAV_HEADER_FMT)));
+static inline void WRITE_FIELD_64(uint64_t field, uint8_t **buffer)
+{
+    memcpy(*buffer, &field, sizeof(uint64_t));
+
+    *buffer += sizeof(uint64_t);
+}
+
+// The header is only valid up to length: asks for more when the next step needs it. Where that would take the buffer
+// past WAV_MAX_HEADER_LEN, the buffer moves up to start at the chunk being read instead: what's before it is done with.
+#define WAV_NEED(needed, chunk, length, offset, bytes_read) \
+    do { \
+        if ((needed) > (length)) \
+        { \
+            if ((needed) - (chunk) > WAV_MAX_HEADER_LEN) \
+            { \
+                return CODEC_ERROR_INVALID_FILE_FORMAT; \
+            } \
+            if ((needed) > WAV_MAX_HEADER_LEN) \
+            { \
+                *(offset) += (chunk); \
+                *(bytes_read) = (size_t)((needed) - (chunk)); \
+            } \
+            else \
+            { \
+                *(bytes_read) = (size_t)(needed); \
+            } \
+            return CODEC_NEED_MORE; \
+        } \
+    } while (0)
+
+codec_ret_t WAV_Open(void)
+{
+    // TODO
 
-    // Read BlocSize
-    // Cast the uint32_t value to a uint8_t pointer
-    // This is fine because everything is still tied to the length parameter
-    WAV_ERR(VALIDATE_IDENTIFIER((const uint8_t *)&WAV_HEADER_BLOCSIZE, &curr_buffer, sizeof(WAV_HEADER_BLOCSIZE)));
+    return CODEC_SUCCESS;
+}
+
+codec_ret_t WAV_Close(void)
+{
+    // TODO
+
+    return CODEC_SUCCESS;
+}
 
+// The fmt chunk's payload, from AudioFormat on
+static codec_ret_t ReadFormat(wav_metadata_t *wav_metadata, const uint8_t *curr_buffer)
+{
     // Read AudioFormat
     // Only support PCM for now
     // TODO: add IEEE. Would change this call to instead store the metadata field
@@ -171,14 +243,352 @@ codec_ret_t WAV_ValidateHeader(const void *buffer, void *metadata, size_t *bytes
     // Read the number of bits per sample
     WAV_ERR(STORE_METADATA_FIELD_16(&wav_metadata->bits_per_sample, &curr_buffer));
 
-    // Read DataBlocID
-    WAV_ERR(VALIDATE_IDENTIFIER(WAV_HEADER_DATABLOCID, &curr_buffer, LEN(WAV_HEADER_DATABLOCID)));
+    return CODEC_SUCCESS;
+}
+
+/*
+ * Most files are the canonical 44 bytes: RIFF, fmt, data. But anything may come between the chunks we need
+ * (LIST tags, JUNK padding: our own recordings have both, see WAV_EncodeHeader; album art, ID3 tags), so the
+ * chunks are walked until « data », skipping whatever isn't fmt or ds64. When the buffer runs out first, we ask
+ * for more: right on from it while the header's short, otherwise only the next chunk's header, from wherever in the
+ * file that is. So a chunk of any size costs an 8-byte read at most, and the caller's buffer never has to hold more
+ * than WAV_MAX_HEADER_LEN. Where the walk has got to (RF64 or not, the fmt chunk seen) is kept in the metadata.
+ */
+codec_ret_t WAV_ValidateHeader(const void *buffer, void *metadata, uint64_t *offset, size_t *bytes_read)
+{
+    wav_metadata_t *wav_metadata = (wav_metadata_t *)metadata;
+    const uint8_t *start = (const uint8_t *)buffer;
+    const uint8_t *curr_buffer = start;
+
+    if (buffer == NULL || metadata == NULL || offset == NULL || bytes_read == NULL)
+    {
+        return CODEC_ERROR_GENERIC;
+    }
+
+    size_t length = *bytes_read;
+    uint64_t chunk = 0;
+
+    // The start of the file: RIFF's header, then its first chunk. Anywhere else, the buffer starts at a chunk.
+    if (*offset == 0)
+    {
+        uint32_t size_32;
+
+        WAV_NEED(WAV_RIFF_HEADER_LEN, 0, length, offset, bytes_read);
+
+        wav_metadata->rf64 = 0;
+        wav_metadata->found_format = 0;
+        wav_metadata->data_size = 0;
+
+        // Read the RIFF (or RF64) identifier
+        if (VALIDATE_IDENTIFIER(WAV_HEADER_RF64, &curr_buffer, LEN(WAV_HEADER_RF64)) == CODEC_SUCCESS)
+        {
+            wav_metadata->rf64 = 1;
+        }
+        else
+        {
+            WAV_ERR(VALIDATE_IDENTIFIER(WAV_HEADER_RIFF, &curr_buffer, LEN(WAV_HEADER_RIFF)));
+        }
+
+        // Read the file size
+        WAV_ERR(STORE_METADATA_FIELD_32(&size_32, &curr_buffer));
+        wav_metadata->file_size = size_32;
+
+        // Read the file format identifier
+        WAV_ERR(VALIDATE_IDENTIFIER(WAV_HEADER_FILEFORMATID, &curr_buffer, LEN(WAV_HEADER_FILEFORMATID)));
+
+        chunk = WAV_RIFF_HEADER_LEN;
+    }
+
+    for (;;)
+    {
+        WAV_NEED(chunk + WAV_CHUNK_HEADER_LEN, chunk, length, offset, bytes_read);
+
+        curr_buffer = start + chunk;
+
+        const uint8_t *identifier = curr_buffer;
+        curr_buffer += LEN(WAV_HEADER_FMT);
+
+        uint32_t chunk_size;
+        WAV_ERR(STORE_METADATA_FIELD_32(&chunk_size, &curr_buffer));
+
+        if (memcmp(identifier, WAV_HEADER_DATABLOCID, LEN(WAV_HEADER_DATABLOCID)) == BUFFERS_MATCH)
+        {
+            // The audio starts right after. Without a fmt chunk first, we wouldn't know what it is.
+            if (!wav_metadata->found_format)
+            {
+                return CODEC_ERROR_INVALID_FILE_FORMAT;
+            }
+
+            // ds64's size, if it said to look there
+            if (!wav_metadata->rf64 || chunk_size != WAV_SIZE_IN_DS64)
+            {
+                wav_metadata->data_size = chunk_size;
+            }
+
+            // Where the audio starts
+            *offset += chunk + WAV_CHUNK_HEADER_LEN;
+
+            return CODEC_SUCCESS;
+        }
+
+        if (memcmp(identifier, WAV_HEADER_FMT, LEN(WAV_HEADER_FMT)) == BUFFERS_MATCH)
+        {
+            // BlocSize is 16 for plain PCM. More is an extension we don't need.
+            if (chunk_size < WAV_HEADER_BLOCSIZE)
+            {
+                return CODEC_ERROR_INVALID_FILE_FORMAT;
+            }
+
+            WAV_NEED(chunk + WAV_CHUNK_HEADER_LEN + WAV_HEADER_BLOCSIZE, chunk, length, offset, bytes_read);
+            WAV_ERR(ReadFormat(wav_metadata, curr_buffer));
+            wav_metadata->found_format = 1;
+        }
+        else if (wav_metadata->rf64 && memcmp(identifier, WAV_HEADER_DS64, LEN(WAV_HEADER_DS64)) == BUFFERS_MATCH)
+        {
+            if (chunk_size < WAV_DS64_SIZE)
+            {
+                return CODEC_ERROR_INVALID_FILE_FORMAT;
+            }
+
+            WAV_NEED(chunk + WAV_CHUNK_HEADER_LEN + WAV_DS64_SIZE, chunk, length, offset, bytes_read);
+            WAV_ERR(STORE_METADATA_FIELD_64(&wav_metadata->file_size, &curr_buffer));
+            WAV_ERR(STORE_METADATA_FIELD_64(&wav_metadata->data_size, &curr_buffer));
+        }
+
+        // On to the next chunk. Chunks are padded to an even length.
+        chunk += WAV_CHUNK_HEADER_LEN + (uint64_t)chunk_size + (chunk_size & 1);
+    }
+}
+
+/*
+ * Our own header is always WAV_ENCODED_HEADER_LEN long:
+ *
+ *    0  « RIFF » size « WAVE »
+ *   12  « JUNK » 28 bytes: holds ds64's place. If the file ends up 4 GB or more, this becomes « ds64 » and
+ *       « RIFF » becomes « RF64 », without anything else having to move.
+ *   48  « fmt  » 16 bytes: PCM
+ *   72  « JUNK » padding up to ...
+ *  504  « data » size
+ *  512  the audio
+ *
+ * so it can be written before the recording with a size of 0, and again with the real size once it's over.
+ */
+codec_ret_t WAV_EncodeHeader(const audio_format_t *format, uint64_t data_size, void *buffer, size_t *length)
+{
+    if (format == NULL || buffer == NULL || length == NULL)
+    {
+        return CODEC_ERROR_GENERIC;
+    }
+
+    if (*length < WAV_ENCODED_HEADER_LEN)
+    {
+        return CODEC_ERROR_UNABLE_TO_ENCODE;
+    }
+
+    // Samples are stored as they come, in their whole container: 24 bits in 32 are simply 32-bit PCM
+    // with the bottom byte 0 (the sample's in the top 24 bits)
+    uint16_t bits_per_sample;
+
+    switch (format->packing)
+    {
+    case AUDIO_PACKING_S16:
+        bits_per_sample = 16;
+        break;
+    case AUDIO_PACKING_S24_PACKED:
+        bits_per_sample = 24;
+        break;
+    case AUDIO_PACKING_S24_IN_32:
+    case AUDIO_PACKING_S32:
+        bits_per_sample = 32;
+        break;
+    default:
+        return CODEC_ERROR_UNABLE_TO_ENCODE;
+    }
+
+    if (format->channels == 0 || format->sample_rate == 0)
+    {
+        return CODEC_ERROR_UNABLE_TO_ENCODE;
+    }
+
+    uint16_t bytes_per_bloc = format->channels * (bits_per_sample / 8);
+    uint64_t file_size = WAV_ENCODED_HEADER_LEN - WAV_CHUNK_HEADER_LEN + data_size + (data_size & 1);
+
+    // 0xFFFFFFFF itself means "see ds64", so that's already too big for RIFF
+    uint8_t rf64 = (file_size >= WAV_SIZE_IN_DS64);
+
+    uint8_t *curr_buffer = (uint8_t *)buffer;
+    memset(buffer, 0, WAV_ENCODED_HEADER_LEN);
+
+    WRITE_IDENTIFIER(rf64 ? WAV_HEADER_RF64 : WAV_HEADER_RIFF, &curr_buffer, LEN(WAV_HEADER_RIFF));
+    WRITE_FIELD_32(rf64 ? WAV_SIZE_IN_DS64 : (uint32_t)file_size, &curr_buffer);
+    WRITE_IDENTIFIER(WAV_HEADER_FILEFORMATID, &curr_buffer, LEN(WAV_HEADER_FILEFORMATID));
+
+    // ds64, or the JUNK that keeps its place (left as zeros)
+    WRITE_IDENTIFIER(rf64 ? WAV_HEADER_DS64 : WAV_HEADER_JUNK, &curr_buffer, LEN(WAV_HEADER_DS64));
+    WRITE_FIELD_32(WAV_DS64_SIZE, &curr_buffer);
+
+    if (rf64)
+    {
+        WRITE_FIELD_64(file_size, &curr_buffer);
+        WRITE_FIELD_64(data_size, &curr_buffer);
+        WRITE_FIELD_64(data_size / bytes_per_bloc, &curr_buffer);
+        WRITE_FIELD_32(0, &curr_buffer);
+    }
+    else
+    {
+        curr_buffer += WAV_DS64_SIZE;
+    }
+
+    WRITE_IDENTIFIER(WAV_HEADER_FMT, &curr_buffer, LEN(WAV_HEADER_FMT));
+    WRITE_FIELD_32(WAV_HEADER_BLOCSIZE, &curr_buffer);
+    WRITE_FIELD_16(WAV_HEADER_AUDIOFORMAT_PCM, &curr_buffer);
+    WRITE_FIELD_16(format->channels, &curr_buffer);
+    WRITE_FIELD_32(format->sample_rate, &curr_buffer);
+    WRITE_FIELD_32(format->sample_rate * bytes_per_bloc, &curr_buffer);
+    WRITE_FIELD_16(bytes_per_bloc, &curr_buffer);
+    WRITE_FIELD_16(bits_per_sample, &curr_buffer);
+
+    // Pad so the audio starts on a sector boundary
+    size_t padding = WAV_ENCODED_HEADER_LEN - (size_t)(curr_buffer - (uint8_t *)buffer) - 2 * WAV_CHUNK_HEADER_LEN;
+
+    WRITE_IDENTIFIER(WAV_HEADER_JUNK, &curr_buffer, LEN(WAV_HEADER_JUNK));
+    WRITE_FIELD_32((uint32_t)padding, &curr_buffer);
+    curr_buffer += padding;
+
+    WRITE_IDENTIFIER(WAV_HEADER_DATABLOCID, &curr_buffer, LEN(WAV_HEADER_DATABLOCID));
+    WRITE_FIELD_32(rf64 ? WAV_SIZE_IN_DS64 : (uint32_t)data_size, &curr_buffer);
+
+    *length = WAV_ENCODED_HEADER_LEN;
+
+    return CODEC_SUCCESS;
+}
+
+codec_ret_t WAV_Encode(uint8_t *dst, const uint8_t *src, size_t length)
+{
+    if (dst == NULL || src == NULL)
+    {
+        return CODEC_ERROR_GENERIC;
+    }
+
+    // WAV is the PCM itself, so there's nothing to do unless it has to be moved
+    if (dst != src)
+    {
+        memmove(dst, src, length);
+    }
+
+    return CODEC_SUCCESS;
+}
+
+// A text sub-chunk into a tag: NUL-terminated in the file, mostly, but not always, and cut down to fit
+static void CopyTag(char *tag, const uint8_t *text, uint32_t size)
+{
+    uint32_t length = 0;
+
+    while (length < size && length < CODEC_MAX_TAG - 1 && text[length] != '\0')
+    {
+        tag[length] = (char)text[length];
+        length++;
+    }
+
+    tag[length] = '\0';
+}
+
+// "7" or "7/12"
+static uint16_t ParseTrackNumber(const uint8_t *text, uint32_t size)
+{
+    uint32_t number = 0;
+
+    for (uint32_t i = 0; i < size && text[i] >= '0' && text[i] <= '9' && number < UINT16_MAX / 10; i++)
+    {
+        number = number * 10 + (text[i] - '0');
+    }
+
+    return (uint16_t)number;
+}
+
+static void ReadInfo(const uint8_t *list, uint32_t size, codec_tags_t *tags)
+{
+    uint32_t offset = LEN(WAV_HEADER_INFO);
+
+    while (offset + WAV_CHUNK_HEADER_LEN <= size)
+    {
+        const uint8_t *identifier = list + offset;
+        const uint8_t *curr_buffer = identifier + LEN(WAV_HEADER_LIST);
+        uint32_t chunk_size;
+
+        STORE_METADATA_FIELD_32(&chunk_size, &curr_buffer);
+
+        if (chunk_size > size - offset - WAV_CHUNK_HEADER_LEN)
+        {
+            return;
+        }
+
+        if (memcmp(identifier, WAV_INFO_TITLE, LEN(WAV_INFO_TITLE)) == BUFFERS_MATCH)
+        {
+            CopyTag(tags->title, curr_buffer, chunk_size);
+        }
+        else if (memcmp(identifier, WAV_INFO_ARTIST, LEN(WAV_INFO_ARTIST)) == BUFFERS_MATCH)
+        {
+            CopyTag(tags->artist, curr_buffer, chunk_size);
+        }
+        else if (memcmp(identifier, WAV_INFO_ALBUM, LEN(WAV_INFO_ALBUM)) == BUFFERS_MATCH)
+        {
+            CopyTag(tags->album, curr_buffer, chunk_size);
+        }
+        else if (memcmp(identifier, WAV_INFO_TRACK, LEN(WAV_INFO_TRACK)) == BUFFERS_MATCH
+                || memcmp(identifier, WAV_INFO_PART, LEN(WAV_INFO_PART)) == BUFFERS_MATCH)
+        {
+            tags->track_number = ParseTrackNumber(curr_buffer, chunk_size);
+        }
+
+        offset += WAV_CHUNK_HEADER_LEN + chunk_size + (chunk_size & 1);
+    }
+}
 
-    // Read DataSize
-    WAV_ERR(STORE_METADATA_FIELD_32(&wav_metadata->data_size, &curr_buffer));
+/*
+ * Tags are in a « LIST » chunk of type « INFO ». Walks the chunks the same way ValidateHeader does, but only
+ * as far as the buffer goes: a LIST after the audio (some tools put it there) is too far in for us.
+ */
+codec_ret_t WAV_ReadTags(const void *buffer, size_t length, codec_tags_t *tags)
+{
+    const uint8_t *start = (const uint8_t *)buffer;
 
-    // Store the amount of data read
-    *bytes_read = WAV_HEADER_LEN;
+    if (buffer == NULL || tags == NULL)
+    {
+        return CODEC_ERROR_GENERIC;
+    }
+
+    if (length < WAV_RIFF_HEADER_LEN)
+    {
+        return CODEC_ERROR_INVALID_FILE_FORMAT;
+    }
+
+    size_t offset = WAV_RIFF_HEADER_LEN;
+
+    while (offset + WAV_CHUNK_HEADER_LEN <= length)
+    {
+        const uint8_t *identifier = start + offset;
+        const uint8_t *curr_buffer = identifier + LEN(WAV_HEADER_LIST);
+        uint32_t chunk_size;
+
+        STORE_METADATA_FIELD_32(&chunk_size, &curr_buffer);
+
+        // The audio, or a chunk that goes on past the buffer: nothing after it that we can get at
+        if (memcmp(identifier, WAV_HEADER_DATABLOCID, LEN(WAV_HEADER_DATABLOCID)) == BUFFERS_MATCH
+                || chunk_size > length - offset - WAV_CHUNK_HEADER_LEN)
+        {
+            break;
+        }
+
+        if (memcmp(identifier, WAV_HEADER_LIST, LEN(WAV_HEADER_LIST)) == BUFFERS_MATCH
+                && chunk_size >= LEN(WAV_HEADER_INFO)
+                && memcmp(curr_buffer, WAV_HEADER_INFO, LEN(WAV_HEADER_INFO)) == BUFFERS_MATCH)
+        {
+            ReadInfo(curr_buffer, chunk_size, tags);
+        }
+
+        offset += WAV_CHUNK_HEADER_LEN + (size_t)chunk_size + (chunk_size & 1);
+    }
 
     return CODEC_SUCCESS;
 }
@@ -204,5 +614,39 @@ codec_ret_t WAV_DecodeFrom(void *buffer, size_t start, size_t length)
     return CODEC_SUCCESS;
 }
 
+codec_ret_t WAV_GetFormat(const void *metadata, audio_format_t *format)
+{
+    const wav_metadata_t *wav_metadata = (const wav_metadata_t *)metadata;
+
+    if (wav_metadata == NULL || format == NULL)
+    {
+        return CODEC_ERROR_GENERIC;
+    }
+
+    format->sample_rate = wav_metadata->frequency;
+    format->bits_per_sample = wav_metadata->bits_per_sample;
+    format->channels = wav_metadata->nbr_channels;
+
+    // WAV samples are packed back to back, so the container size is simply the sample size
+    switch (wav_metadata->bits_per_sample)
+    {
+    case 16:
+        format->packing = AUDIO_PACKING_S16;
+        break;
+    case 24:
+        format->packing = AUDIO_PACKING_S24_PACKED;
+        break;
+    case 32:
+        format->packing = AUDIO_PACKING_S32;
+        break;
+    default:
+        // TODO: 8-bit WAV is unsigned, so it needs its own conversion
+        return CODEC_ERROR_INVALID_FILE_FORMAT;
+    }
+
+    return CODEC_SUCCESS;
+}
+
 const codec_t wav_codec =
-{ .Open = WAV_Open, .Close = WAV_Close, .ValidateHeader = WAV_ValidateHeader, .Decode = WAV_Decode, .DecodeFrom = WAV_DecodeFrom };
+{ .Open = WAV_Open, .Close = WAV_Close, .ValidateHeader = WAV_ValidateHeader, .GetFormat = WAV_GetFormat, .Decode = WAV_Decode, .DecodeFrom = WAV_DecodeFrom,
+        .EncodeHeader = WAV_EncodeHeader, .Encode = WAV_Encode, .ReadTags = WAV_ReadTags };
@@ -63,6 +63,21 @@
 #define _USE_FASTSEEK        1
 /* This option switches fast seek feature. (0:Disable or 1:Enable) */
 
+#define _FS_CONTIG           1
+/* This option switches contiguous file detection. (0:Disable or 1:Enable)
+/  When enabled, f_open() in read mode finds how far the file is contiguous on the
+/  volume (from the exFAT NoFatChain flag, or by following the cluster chain once),
+/  and f_read()/f_lseek() compute the clusters in that run instead of following the FAT.
+/  Multiple sector reads also go on across cluster boundaries within the run. */
+
+#define _FS_DIRCACHE         2048
+/* This option sets the size of the directory lookup cache in objects, 6 bytes each (0:Disable).
+/  When enabled, the first name looked up in a directory has every object in it hashed into the cache,
+/  so that later lookups there read the entry block of the matching object only, instead of scanning
+/  the directory from the top. Adding or removing an object drops the directory from the cache.
+/  Up to 8 directories are cached, the least recently used making room for a new one. A directory
+/  with more objects than 3/4 of them has its top part cached and the rest scanned. Needs _USE_LFN. */
+
 #define	_USE_EXPAND		1
 /* This option switches f_expand function. (0:Disable or 1:Enable) */
 
@@ -227,7 +242,7 @@
 /  _NORTC_MDAY and _NORTC_YEAR have no effect.
 /  These options have no effect at read-only configuration (_FS_READONLY = 1). */
 
-#define _FS_LOCK    2     /* 0:Disable or >=1:Enable */
+#define _FS_LOCK    16    /* 0:Disable or >=1:Enable */
 /* The option _FS_LOCK switches file lock function to control duplicated file open
 /  and illegal operation to open objects. This option must be 0 when _FS_READONLY
 /  is 1.
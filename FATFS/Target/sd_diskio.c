@@ -134,6 +134,36 @@ DSTATUS SD_status(BYTE lun)
 
 /* USER CODE BEGIN beforeReadSection */
 /* can be used to modify previous code / undefine following code / add new code */
+
+/*
+ * The generated SD_read/SD_write spin on BSP_SD_GetCardState after every transfer, with no timeout: a card that
+ * stops answering hangs the whole firmware there. They're compiled out below in favour of these.
+ * BSP_SD_ReadBlocks/WriteBlocks (sd_bus.c) go through the block layer, which only returns once the transfer is
+ * over and the card is back in the transfer state, or with an error once SD_BUS_TIMEOUT_MS is up. While it waits,
+ * it runs the yield hook (Blk_SetYield), so there's nothing left to wait for here.
+ *
+ * buff is whatever FatFs was given: for whole sectors, f_read/f_write pass the caller's buffer straight down,
+ * at any alignment. The uint32_t* is only the BSP's prototype, nothing reads through it as words. The block layer
+ * checks the alignment against what the DMA needs (blk_device_t alignment) and bounces anything else through its
+ * aligned staging buffer, as one transfer rather than a block at a time (stats: bounced, aligned).
+ */
+DRESULT SD_read(BYTE lun, BYTE *buff, DWORD sector, UINT count)
+{
+  (void)lun;
+
+  return (BSP_SD_ReadBlocks((uint32_t*)buff, (uint32_t)sector, count, SD_TIMEOUT) == MSD_OK) ? RES_OK : RES_ERROR;
+}
+
+#if _USE_WRITE == 1
+DRESULT SD_write(BYTE lun, const BYTE *buff, DWORD sector, UINT count)
+{
+  (void)lun;
+
+  return (BSP_SD_WriteBlocks((uint32_t*)buff, (uint32_t)sector, count, SD_TIMEOUT) == MSD_OK) ? RES_OK : RES_ERROR;
+}
+#endif /* _USE_WRITE == 1 */
+
+#if 0
 /* USER CODE END beforeReadSection */
 /**
   * @brief  Reads Sector(s)
@@ -196,6 +226,7 @@ DRESULT SD_write(BYTE lun, const BYTE *buff, DWORD sector, UINT count)
 
 /* USER CODE BEGIN beforeIoctlSection */
 /* can be used to modify previous code / undefine following code / add new code */
+#endif /* generated SD_read/SD_write */
 /* USER CODE END beforeIoctlSection */
 /**
   * @brief  I/O control operation
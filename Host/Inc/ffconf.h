@@ -0,0 +1,26 @@
+/*
+ * ffconf.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#ifndef INC_HOST_FFCONF_H_
+#define INC_HOST_FFCONF_H_
+
+/*
+ * Host builds use the exact same FatFs configuration as the board, so the host behaves like the card does.
+ *
+ * The target ffconf.h pulls in main.h, the HAL and the SD BSP, none of which build on a PC and none of which
+ * the configuration itself needs. Defining their include guards first turns those includes into no-ops
+ * (the files still have to be found, so the HAL's Inc directory stays on the include path).
+ * Host/Inc must come before FATFS/Target on the include path for this file to be picked up.
+ */
+
+#define __MAIN_H
+#define __STM32F4xx_HAL_H
+#define __STM32F4_SD_H
+
+#include "../../FATFS/Target/ffconf.h"
+
+#endif /* INC_HOST_FFCONF_H_ */
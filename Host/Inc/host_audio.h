@@ -0,0 +1,62 @@
+/*
+ * host_audio.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#ifndef INC_HOST_AUDIO_H_
+#define INC_HOST_AUDIO_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "audio.h"
+
+/*
+ * Audio sink for host builds: instead of an I2S DAC, everything streamed is written to a WAV file.
+ *
+ * The file holds exactly the bytes the pipeline produced, so two runs can be compared byte for byte
+ * (bit-exact regression testing of decode + conversion + dither).
+ *
+ * It also pretends to be a real sample clock. The "device" has a small FIFO (HOST_AUDIO_FIFO_FRAMES,
+ * about what the I2S DMA double buffer holds) that drains at the configured sample rate:
+ *  - Stream() blocks until the FIFO has room for the block, just like waiting on a DMA half-transfer
+ *  - if the FIFO has already run dry when Stream() is called, that's an underrun: on the board you'd hear a click.
+ *    It is logged with a timestamp and how long the DAC was starved for.
+ *
+ * In benchmark mode there's no waiting at all, so the pipeline runs as fast as the PC can go
+ * and the stats say how many times faster than real time that was.
+ */
+
+#define HOST_AUDIO_FIFO_FRAMES 1024
+
+typedef enum
+{
+    HOST_AUDIO_MODE_REALTIME = 0,
+    HOST_AUDIO_MODE_BENCHMARK
+} host_audio_mode_t;
+
+typedef struct
+{
+    uint64_t frames;                // frames written to the file
+    uint32_t blocks;                // Stream() calls
+    uint32_t underruns;
+    uint64_t underrun_us;           // total time the DAC would have been starved
+    uint64_t max_underrun_us;
+    uint64_t elapsed_us;            // wall time from the first Stream() to the last
+} host_audio_stats_t;
+
+// Must be called before Open(). log may be NULL for silence, stderr is a good default.
+audio_ret_t HostAudio_Setup(const char *path, host_audio_mode_t mode, FILE *log);
+
+// Restrict what the sink advertises, e.g., to exactly what the I2S driver takes, so the host
+// negotiates the same plan as the board. By default every packing is accepted at any rate, mono or stereo.
+audio_ret_t HostAudio_SetFormats(const audio_format_t *formats, size_t count);
+
+audio_ret_t HostAudio_GetStats(host_audio_stats_t *stats);
+
+extern const audio_driver_t host_audio_driver;
+
+#endif /* INC_HOST_AUDIO_H_ */
@@ -0,0 +1,32 @@
+/*
+ * host_bookmark.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#ifndef INC_HOST_BOOKMARK_H_
+#define INC_HOST_BOOKMARK_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "fs.h"
+#include "sd_model.h"
+
+/*
+ * Bookmarks (bookmark.h) against a disk image: what a save writes, next to rewriting a small file every time, how
+ * long a boot takes to find the latest, and that a save torn by the power going falls back to the one before.
+ */
+
+// Saves made, and checked
+#define HOST_BOOKMARK_SAVES 1000
+
+// Saves the naive way, a file made over each time, to compare
+#define HOST_BOOKMARK_NAIVE 100
+
+// Whatever was on the image stays, apart from the bookmark file (and the naive one), which are made over.
+// model may be NULL; with one, the card's time is reported too.
+int HostBookmark_Benchmark(fs_driver_t *fs, const sd_model_t *model, FILE *out);
+
+#endif /* INC_HOST_BOOKMARK_H_ */
@@ -0,0 +1,47 @@
+/*
+ * host_cortex.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#ifndef INC_HOST_CORTEX_H_
+#define INC_HOST_CORTEX_H_
+
+#include <stdint.h>
+
+/*
+ * Host stand-in for the few Cortex-M bits the portable modules use (only cycles.h, so far).
+ *
+ * Building with -DHOST_BUILD swaps this in for main.h, so player, format, pcm, ring, meter, wav, ...
+ * build unchanged on a PC. Anything that really touches hardware (i2s.c, microsd.c, the HAL) is simply not
+ * part of a host build.
+ */
+
+// The DWT cycle counter doesn't exist on a PC. The registers are there to be written to, but Cycles_Now() reads
+// HostCortex_Cycles() instead: the PC's monotonic clock in SystemCoreClock cycles. Good for timing reads and the like;
+// cycle counts of DSP code (meter snapshots) are the PC's, not the board's.
+typedef struct
+{
+    uint32_t DEMCR;
+} host_core_debug_t;
+
+typedef struct
+{
+    uint32_t CTRL;
+    uint32_t CYCCNT;
+} host_dwt_t;
+
+extern host_core_debug_t host_core_debug;
+extern host_dwt_t host_dwt;
+
+#define CoreDebug (&host_core_debug)
+#define DWT (&host_dwt)
+#define CoreDebug_DEMCR_TRCENA_Msk (1UL << 24)
+#define DWT_CTRL_CYCCNTENA_Msk (1UL << 0)
+
+extern uint32_t SystemCoreClock;
+
+uint32_t HostCortex_Cycles(void);
+
+#endif /* INC_HOST_CORTEX_H_ */
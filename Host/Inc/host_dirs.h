@@ -0,0 +1,29 @@
+/*
+ * host_dirs.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#ifndef INC_HOST_DIRS_H_
+#define INC_HOST_DIRS_H_
+
+#include <stdio.h>
+
+#include "fs.h"
+#include "sd_model.h"
+
+/*
+ * Opening a file by path in folders of more and more files: what a lookup in a big folder costs, with FatFs's
+ * directory lookup cache (_FS_DIRCACHE in ffconf.h) or without.
+ */
+
+// Files opened in each folder once the first open has cached it, spread across the folder
+#define HOST_DIRS_OPENS 32
+
+// Format the image (HostDisk_Setup first), fill folders of 16 up to 4096 (empty) files with long names, then time
+// opening them: the first open in a folder, the ones after, and a name that isn't there. model may be NULL; with
+// one, the card's time is reported too.
+int HostDirs_Benchmark(fs_driver_t *fs, const sd_model_t *model, FILE *out);
+
+#endif /* INC_HOST_DIRS_H_ */
@@ -0,0 +1,73 @@
+/*
+ * host_disk.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#ifndef INC_HOST_DISK_H_
+#define INC_HOST_DISK_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "ff_gen_drv.h"
+#include "sd_model.h"
+
+/*
+ * FatFs disk driver backed by a disk image file, the host counterpart of sd_diskio.c.
+ * Link it with FATFS_LinkDriver(&HostDisk_Driver, path) and FatFs runs against the image exactly like against the card.
+ *
+ * With a model attached, every read/write takes as long as the card would (see sd_model.h):
+ * each transfer stays pending for the modelled latency, and the block layer polls it (running its yield hook,
+ * see Blk_SetYield) until it's done, like on the board. So a stall holds up FatFs, but not whatever the hook runs.
+ * Without one, the image answers instantly.
+ *
+ * Like sd_diskio.c on the board, requests go through the block layer (blk.h) first.
+ *
+ * With SDIO on, sectors don't come straight from the image but through the real low-level driver (sd_ll.c)
+ * talking to a register mock of the peripheral and card (sdio_mock.h). The data is the same; what's being
+ * exercised is the driver's command sequences, DMA setup and bounce path.
+ */
+
+#define HOST_DISK_SECTOR_SIZE 512
+
+// Erase block size reported to f_mkfs, in sectors (4 MiB, typical for SDHC allocation units)
+#define HOST_DISK_ERASE_BLOCK 8192
+
+// What FatFs asked of the disk: each call, however many sectors
+typedef struct
+{
+    uint32_t reads;
+    uint32_t read_sectors;
+    uint32_t writes;
+    uint32_t write_sectors;
+} host_disk_io_t;
+
+typedef enum
+{
+    HOST_DISK_SUCCESS = 0,
+    HOST_DISK_ERROR_NULL_PARAMETER = -1,
+    HOST_DISK_ERROR_UNABLE_TO_OPEN = -2,
+    HOST_DISK_ERROR_GENERIC = -128
+} host_disk_ret_t;
+
+// Must be called before f_mount. model may be NULL; sleep = 0 only accounts the time in the model's stats.
+host_disk_ret_t HostDisk_Setup(const char *image_path, sd_model_t *model, uint8_t sleep);
+
+// Call after HostDisk_Setup. cmd23 = 0 makes the mock card behave like one without SET_BLOCK_COUNT.
+// Protocol violations the mock notices go to log.
+host_disk_ret_t HostDisk_UseSDIO(uint8_t cmd23, FILE *log);
+
+// Block layer counters, and the driver's and mock's if SDIO is on
+void HostDisk_PrintStats(FILE *out);
+
+// Since HostDisk_Setup, e.g., to take two apart to see what something wrote
+void HostDisk_GetIO(host_disk_io_t *io);
+
+// Create (or truncate) an empty image of the given size, e.g., to f_mkfs onto
+host_disk_ret_t HostDisk_CreateImage(const char *image_path, uint64_t size_bytes);
+
+extern const Diskio_drvTypeDef HostDisk_Driver;
+
+#endif /* INC_HOST_DISK_H_ */
@@ -0,0 +1,34 @@
+/*
+ * host_dither.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#ifndef INC_HOST_DITHER_H_
+#define INC_HOST_DITHER_H_
+
+#include <stdio.h>
+
+/*
+ * Dither and noise shaping (pcm.h): PCM_Convert24To16 and PCM_Convert32To16 on a quiet sine and on silence, with
+ * each pcm_shaping_t (and without dither, to compare). The error the conversion adds is split into bands, which
+ * shows where the shaping has moved the noise to, and each kernel is timed.
+ */
+
+// Frames converted for each spectrum, at HOST_DITHER_RATE
+#define HOST_DITHER_FRAMES 65536
+#define HOST_DITHER_RATE 48000
+
+// The quiet sine, in dBFS: a fade-out's tail, where the rounding error is heard
+#define HOST_DITHER_SINE_DBFS (-60)
+#define HOST_DITHER_SINE_HZ 997
+
+// Samples converted for the timing, in all
+#define HOST_DITHER_TIMED 20000000
+
+// Prints the bands and timings to out. Returns 1 if the kernels disagree, or a shaping's noise isn't the power or
+// the tilt it should be.
+int HostDither_Benchmark(FILE *out);
+
+#endif /* INC_HOST_DITHER_H_ */
@@ -0,0 +1,35 @@
+/*
+ * host_fatfs.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#ifndef INC_HOST_FATFS_H_
+#define INC_HOST_FATFS_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "fs.h"
+
+/*
+ * fs_driver_t on FatFs over a disk image (host_disk.h), i.e., microsd.c without the SDIO peripheral.
+ * Same FatFs, same configuration, so file system behaviour (cluster chains, FAT lookups, ...) matches the board.
+ * Call HostDisk_Setup() before Open().
+ */
+
+extern fs_driver_t host_fatfs_driver;
+
+// Make a new, empty volume on the whole image (FAT32, or exFAT), e.g., to generate a card onto. Open() after.
+fs_ret_t HostFatFS_Format(uint8_t exfat, uint32_t cluster_b);
+
+// For the last file that was read: how much of it was contiguous, and the FAT sector reads that saved
+// (see _FS_CONTIG in ffconf.h)
+void HostFatFS_PrintStats(FILE *out);
+
+// Since the start: directories FatFs scanned into its lookup cache, and entry blocks it read to check a name found
+// there (see _FS_DIRCACHE in ffconf.h). Both 0 without the cache.
+void HostFatFS_GetDirCacheStats(uint32_t *built, uint32_t *checked);
+
+#endif /* INC_HOST_FATFS_H_ */
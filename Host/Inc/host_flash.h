@@ -0,0 +1,65 @@
+/*
+ * host_flash.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#ifndef INC_HOST_FLASH_H_
+#define INC_HOST_FLASH_H_
+
+#include <stdint.h>
+
+#include "settings.h"
+
+/*
+ * A pair of flash sectors in RAM, for running the settings store (settings.h) on a PC. It behaves like the
+ * internal flash (internal_flash.h) where the store could tell the difference: programming only ever clears bits
+ * (asking for a 0 to go back to 1 is counted, and doesn't happen), and erasing sets a whole sector back to 0xFF.
+ *
+ * The power can be made to go partway through any program or erase (HostFlash_CutAfter): the word being programmed
+ * gets only some of its bits, the sector being erased is left some old, some erased and some in between. Or just
+ * after one (HostFlash_CutBetween), which leaves it done: a record's last word, say, so the record made it. After
+ * that every operation fails until HostFlash_PowerOn, and what's in the flash is what a reboot would find.
+ *
+ * Time is only added up, from the F401's datasheet figures (word programming at x32, typical sector erase).
+ */
+
+#define HOST_FLASH_PROGRAM_US 16
+#define HOST_FLASH_ERASE_US_PER_KIB 8000
+
+typedef enum
+{
+    HOST_FLASH_SUCCESS = 0,
+    HOST_FLASH_ERROR_INVALID = -1,
+    HOST_FLASH_ERROR_GENERIC = -128
+} host_flash_ret_t;
+
+typedef struct
+{
+    uint64_t words_programmed;
+    uint32_t erases[2];
+    uint32_t violations;        // a bit asked to go from 0 back to 1 without an erase
+    uint32_t cuts;
+    uint64_t busy_us;
+} host_flash_stats_t;
+
+// Both sectors erased, sector_size bytes each (a multiple of 4). seed is for where the cuts leave bits.
+host_flash_ret_t HostFlash_Setup(uint32_t sector_size, uint32_t seed);
+
+// The power goes during the operations-th word programmed or sector erased from now on. 0: it doesn't.
+void HostFlash_CutAfter(uint32_t operations);
+
+// The same, but once the operations-th is done, before the next one
+void HostFlash_CutBetween(uint32_t operations);
+uint8_t HostFlash_IsCut(void);
+
+// Back on after a cut, the flash as it was left
+void HostFlash_PowerOn(void);
+
+void HostFlash_GetStats(host_flash_stats_t *stats);
+
+// sector_size is set by HostFlash_Setup
+extern settings_flash_t host_flash_settings;
+
+#endif /* INC_HOST_FLASH_H_ */
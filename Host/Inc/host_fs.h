@@ -0,0 +1,24 @@
+/*
+ * host_fs.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#ifndef INC_HOST_FS_H_
+#define INC_HOST_FS_H_
+
+#include "fs.h"
+
+/*
+ * fs_driver_t on top of the PC's own file system (stdio), for host builds.
+ * Filenames are relative to the root passed to HostFS_SetRoot(), like paths on the card are relative to its root.
+ */
+
+#define HOST_FS_MAX_PATH 512
+
+fs_ret_t HostFS_SetRoot(const char *root);
+
+extern fs_driver_t host_fs_driver;
+
+#endif /* INC_HOST_FS_H_ */
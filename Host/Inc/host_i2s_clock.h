@@ -0,0 +1,29 @@
+/*
+ * host_i2s_clock.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#ifndef INC_HOST_I2S_CLOCK_H_
+#define INC_HOST_I2S_CLOCK_H_
+
+#include <stdio.h>
+
+/*
+ * I2S clock planning (i2s_clock.h) from the board's PLL input: every standard rate, for both frame sizes, with and
+ * without MCLK, either within I2S_MAX_RATE_ERROR_PPM (i2s.c) or reported as needing resampling. The plans are
+ * worked back to a rate from their N/R/DIV/ODD, and I2SClock_Lookup has to give what I2SClock_Compute does.
+ */
+
+// Like SystemClock_Config in main.c: HSI (16 MHz) over PLLM = 16
+#define HOST_I2S_CLOCK_INPUT_HZ 1000000
+
+// Table builds timed, what I2S_Open costs at boot
+#define HOST_I2S_CLOCK_BUILDS 100
+
+// Runs on the i2s_clock.c table alone, building it over (so after this it's the one without MCLK). Returns 1 if a rate
+// has no plan, a plan doesn't give its rate, or a lookup isn't what was computed.
+int HostI2SClock_Benchmark(FILE *out);
+
+#endif /* INC_HOST_I2S_CLOCK_H_ */
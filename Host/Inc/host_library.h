@@ -0,0 +1,42 @@
+/*
+ * host_library.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#ifndef INC_HOST_LIBRARY_H_
+#define INC_HOST_LIBRARY_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "fs.h"
+#include "sd_model.h"
+
+/*
+ * The media library (library.h) against a disk image: a generated card full of tracks, and how long indexing it
+ * takes, then how long it takes a boot with the index already there to get to something to browse.
+ */
+
+// Tracks per album, albums per artist on a generated card
+#define HOST_LIBRARY_ALBUM_TRACKS 10
+#define HOST_LIBRARY_ARTIST_ALBUMS 10
+
+// Tracks listed after the boot, like the first screen of the artist view
+#define HOST_LIBRARY_SCREEN 8
+
+// Titles searched for, from all over the library, each a letter, three letters and whole (as it is, and lowercase)
+#define HOST_LIBRARY_QUERIES 16
+
+// Format the image (HostDisk_Setup first) and fill it with tracks tagged tracks, as Artist/Album/NN Title.wav:
+// each a few ms of silence, with LIST INFO tags. Names are made up, the same ones every time for the same count.
+int HostLibrary_MakeCard(fs_driver_t *fs, uint32_t tracks, FILE *out);
+
+// Build the index on the (open) card with work_b of work buffer, then time a boot: mount, Library_Open, and the
+// first screen of the artist view. Then searches for titles, a screen of results each (with 100 000 tracks, -work
+// has to be 4096 KiB for the views). Then re-index (Library_Update) with nothing changed, and again after changing
+// one album. model may be NULL; with one, the card's time is reported too.
+int HostLibrary_Benchmark(fs_driver_t *fs, const sd_model_t *model, uint32_t work_b, FILE *out);
+
+#endif /* INC_HOST_LIBRARY_H_ */
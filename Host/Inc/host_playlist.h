@@ -0,0 +1,38 @@
+/*
+ * host_playlist.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#ifndef INC_HOST_PLAYLIST_H_
+#define INC_HOST_PLAYLIST_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "fs.h"
+#include "sd_model.h"
+
+/*
+ * Playlists (playlist.h) against a disk image with a library on it (host_library.h): every track in the library
+ * in an M3U and a PLS, and how long they take to open, and to go on from one track to the next, with and without
+ * the next ones got ready in the background.
+ */
+
+// Entries in the short playlist, to compare opening it with opening the long ones
+#define HOST_PLAYLIST_SHORT 10
+
+// Every this many entries, a URL and a comment, which are skipped
+#define HOST_PLAYLIST_URL_EVERY 97
+
+// Steps back from the end of the playlist, checked and timed
+#define HOST_PLAYLIST_BACK 100
+
+// Index the (open) card's library, if it isn't already, with work_b of work buffer. Then write its tracks, in
+// title order, to an M3U in the root, a PLS in the first artist's folder (relative paths with ..) and a short M3U,
+// and play through each, checking every entry comes out as it should. model may be NULL; with one, the card's time
+// is reported too.
+int HostPlaylist_Benchmark(fs_driver_t *fs, const sd_model_t *model, uint32_t work_b, FILE *out);
+
+#endif /* INC_HOST_PLAYLIST_H_ */
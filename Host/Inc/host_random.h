@@ -0,0 +1,20 @@
+/*
+ * host_random.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#ifndef INC_HOST_RANDOM_H_
+#define INC_HOST_RANDOM_H_
+
+#include "xorshift.h"
+
+// The firmware's xorshift32 (xorshift.h), for the host models and benchmarks: the same seed gives the same run every
+// time. Each keeps its own state.
+static inline uint32_t HostRandom_Next(uint32_t *state)
+{
+    return XorShift_Next(state);
+}
+
+#endif /* INC_HOST_RANDOM_H_ */
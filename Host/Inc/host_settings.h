@@ -0,0 +1,35 @@
+/*
+ * host_settings.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#ifndef INC_HOST_SETTINGS_H_
+#define INC_HOST_SETTINGS_H_
+
+#include <stdio.h>
+
+/*
+ * The settings store (settings.h) on the RAM-backed flash (host_flash.h): a long run of changes on sectors the
+ * board's size, checked against a copy kept in RAM, with what it costs in flash time and wear and how long a boot
+ * and a read take. Then the power cut at random points over and over, on small sectors so that compactions and
+ * erases get cut too, checking after every reboot that nothing but the change in flight was lost.
+ */
+
+// Changes made on the board-sized sectors
+#define HOST_SETTINGS_CHANGES 200000
+
+// Power cuts, and the sector size they're made on
+#define HOST_SETTINGS_CUTS 20000
+#define HOST_SETTINGS_CUT_SECTOR 2048
+
+// Words programmed or sectors erased before a cut, at most. More than a compaction copies: a torn header leaves the
+// sector looking full, so the first change after that reboot compacts, and the cuts have to get past it too.
+#define HOST_SETTINGS_CUT_WITHIN 400
+
+// Sets up its own flash (HostFlash_Setup) for each run. Returns 1 if a change fails with the power on, a boot after a
+// cut fails or formats, a key comes back wrong, a bit is programmed back to 1, or no change ever survived a cut.
+int HostSettings_Benchmark(FILE *out);
+
+#endif /* INC_HOST_SETTINGS_H_ */
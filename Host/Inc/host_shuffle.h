@@ -0,0 +1,24 @@
+/*
+ * host_shuffle.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#ifndef INC_HOST_SHUFFLE_H_
+#define INC_HOST_SHUFFLE_H_
+
+#include <stdio.h>
+
+/*
+ * Shuffle play (shuffle.h): that every pass is a permutation, for library sizes either side of the network's
+ * sizes, that going back retraces going forward across passes, and what a step costs.
+ */
+
+// Steps timed per library size
+#define HOST_SHUFFLE_STEPS 10000000
+
+// Returns 1 at the first pass that repeats a track, a step back that doesn't retrace, or a seek that loses its place.
+int HostShuffle_Benchmark(FILE *out);
+
+#endif /* INC_HOST_SHUFFLE_H_ */
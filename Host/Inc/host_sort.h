@@ -0,0 +1,29 @@
+/*
+ * host_sort.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#ifndef INC_HOST_SORT_H_
+#define INC_HOST_SORT_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "fs.h"
+#include "sd_model.h"
+
+/*
+ * The external sort (extsort.h) against a disk image: library views' worth of sort entries (32 bytes each, random
+ * keys), sorted with the board's work buffer and with a bigger one, for libraries of more and more tracks.
+ */
+
+// The board's: its output ring, see main.c
+#define HOST_SORT_BOARD_WORK (32 * 1024)
+
+// Format the image (HostDisk_Setup first), then sort 1000 up to 100 000 records with HOST_SORT_BOARD_WORK and with
+// work_b of work buffer, checking what comes out. model may be NULL; with one, the card's time is reported too.
+int HostSort_Benchmark(fs_driver_t *fs, const sd_model_t *model, uint32_t work_b, FILE *out);
+
+#endif /* INC_HOST_SORT_H_ */
@@ -0,0 +1,121 @@
+/*
+ * sd_model.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#ifndef INC_SD_MODEL_H_
+#define INC_SD_MODEL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Latency model of an SD card behind the SDIO peripheral, for the host disk driver.
+ *
+ * A disk image on a PC answers instantly, which hides the one thing that actually causes dropouts:
+ * real cards occasionally go away for 50-250 ms to do internal housekeeping (wear levelling, garbage collection,
+ * erasing a block before reusing it). The model adds, per command:
+ *
+ *  - a fixed overhead: sending the command, waiting for the response, and the card's access time (NAC)
+ *    before the first data block comes out
+ *  - the transfer itself, clocked at the SDIO clock over a 1- or 4-bit bus.
+ *    Each 512-byte block is 4096 / width clocks of data, plus a start bit, 16 CRC clocks and an end bit per line.
+ *  - after a write, a busy period while the card programs the flash
+ *  - with a small probability, a long-tail stall somewhere in [stall_min_us, stall_max_us]
+ *
+ * Alternatively, a trace captured on a real card can be replayed: one command per line,
+ *
+ *   R 8 1234
+ *   W 1 250300
+ *
+ * i.e., direction, number of blocks and the measured latency in microseconds. Blank lines and lines starting
+ * with # are ignored. Each command takes the latency of the next trace entry in the same direction,
+ * corrected by the bus time for the difference in block count (so a recorded stall stays a stall),
+ * and the trace wraps around when it runs out.
+ */
+
+#define SD_MODEL_BLOCK_SIZE 512
+
+// A reasonable mid-range card: 24 MHz (48 MHz / (ClockDiv + 2) with ClockDiv = 0), 4-bit bus
+#define SD_MODEL_DEFAULT_CLOCK_HZ 24000000
+#define SD_MODEL_DEFAULT_BUS_WIDTH 4
+#define SD_MODEL_DEFAULT_COMMAND_US 100
+#define SD_MODEL_DEFAULT_WRITE_BUSY_US 400
+#define SD_MODEL_DEFAULT_STALL_PPM 2000
+#define SD_MODEL_DEFAULT_STALL_MIN_US 50000
+#define SD_MODEL_DEFAULT_STALL_MAX_US 250000
+
+#define SD_MODEL_MAX_TRACE 4096
+
+typedef enum
+{
+    SD_MODEL_SUCCESS = 0,
+    SD_MODEL_ERROR_NULL_PARAMETER = -1,
+    SD_MODEL_ERROR_INVALID_CONFIG = -2,
+    SD_MODEL_ERROR_UNABLE_TO_OPEN_TRACE = -3,
+    SD_MODEL_ERROR_INVALID_TRACE = -4,
+    SD_MODEL_ERROR_GENERIC = -128
+} sd_model_ret_t;
+
+typedef enum
+{
+    SD_MODEL_READ = 0,
+    SD_MODEL_WRITE
+} sd_model_op_t;
+
+typedef struct
+{
+    uint32_t clock_hz;
+    uint8_t bus_width;              // 1 or 4
+    uint32_t command_us;            // per-command overhead (CMD + response + access time)
+    uint32_t write_busy_us;         // programming time after a write command
+    uint32_t stall_ppm;             // chance per command of a housekeeping stall, parts per million
+    uint32_t stall_min_us;
+    uint32_t stall_max_us;
+    uint32_t seed;
+} sd_model_config_t;
+
+typedef struct
+{
+    uint8_t op;
+    uint32_t blocks;
+    uint32_t latency_us;
+} sd_model_trace_entry_t;
+
+typedef struct
+{
+    uint64_t commands;
+    uint64_t blocks;
+    uint64_t busy_us;               // total modelled time
+    uint64_t max_us;
+    uint32_t stalls;
+} sd_model_stats_t;
+
+typedef struct
+{
+    sd_model_config_t config;
+    uint32_t rng;
+
+    sd_model_trace_entry_t *trace;  // NULL: analytic model
+    size_t trace_length;
+    size_t trace_next[2];           // next entry to look at, per direction
+
+    sd_model_stats_t stats;
+} sd_model_t;
+
+void SDModel_DefaultConfig(sd_model_config_t *config);
+sd_model_ret_t SDModel_Init(sd_model_t *model, const sd_model_config_t *config);
+void SDModel_Deinit(sd_model_t *model);
+
+// Switch from the analytic model to replaying a captured trace
+sd_model_ret_t SDModel_LoadTrace(sd_model_t *model, const char *path);
+
+// Microseconds the card would take to complete one command of this many blocks. Updates the stats.
+uint32_t SDModel_CommandUs(sd_model_t *model, sd_model_op_t op, uint32_t blocks);
+
+// Just the bus time for this many blocks, no overhead or stalls (useful for sizing)
+uint32_t SDModel_TransferUs(const sd_model_config_t *config, uint32_t blocks);
+
+#endif /* INC_SD_MODEL_H_ */
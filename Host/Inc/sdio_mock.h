@@ -0,0 +1,77 @@
+/*
+ * sdio_mock.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#ifndef INC_SDIO_MOCK_H_
+#define INC_SDIO_MOCK_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "stm32f4xx.h"
+#include "stm32f4xx_ll_sdmmc.h"
+
+/*
+ * Register-level mock of the SDIO peripheral, DMA2 stream 3 and an SD card behind them, for running sd_ll.c on a PC.
+ *
+ * The registers are plain structs in RAM. Whenever the driver looks at a flag it calls SDIOMock_Service first
+ * (see SYNC in sd_ll.c), which is where the "hardware" reacts: write-1-to-clear registers are applied, a command
+ * written to CMD is answered, and once both the command and the data path are set up, the data is copied between
+ * the disk image and the DMA's memory address in one go.
+ *
+ * The card checks the command sequence the way a real one would and counts (and logs) anything that would
+ * hang or confuse it: reading without the data path armed, a CMD12 with no open-ended transfer to stop,
+ * a new command while a transfer is still open, a CMD23 count that doesn't match the data length, and so on.
+ * Together with the per-command counts, that's what to look at when changing the driver.
+ */
+
+#define SDIO_MOCK_DMA_STREAM 3
+#define SDIO_MOCK_ADDRESSES 8
+
+typedef enum
+{
+    SDIO_MOCK_SUCCESS = 0,
+    SDIO_MOCK_ERROR_NULL_PARAMETER = -1,
+    SDIO_MOCK_ERROR_GENERIC = -128
+} sdio_mock_ret_t;
+
+typedef struct
+{
+    uint8_t cmd23;              // advertise CMD23 in the SCR
+    uint8_t high_capacity;      // block addressing (SDHC/SDXC)
+    uint32_t program_polls;     // CMD13s that still see the card programming after a write
+    uint32_t rca;
+} sdio_mock_config_t;
+
+typedef struct
+{
+    uint32_t commands[64];      // per command index (ACMDs under their own index)
+    uint64_t blocks_read;
+    uint64_t blocks_written;
+    uint32_t violations;
+} sdio_mock_stats_t;
+
+// The "hardware": point sd_ll_config_t at these
+extern SDIO_TypeDef sdio_mock;
+extern DMA_TypeDef sdio_mock_dma;
+extern DMA_Stream_TypeDef sdio_mock_stream;
+
+void SDIOMock_DefaultConfig(sdio_mock_config_t *config);
+
+// The card's contents are the image behind fd. Protocol violations are logged to log (may be NULL).
+sdio_mock_ret_t SDIOMock_Init(const sdio_mock_config_t *config, int fd, uint32_t num_blocks, FILE *log);
+
+void SDIOMock_Service(SDIO_TypeDef *sdio);
+
+// Stands in for a 32-bit bus address in the DMA registers, see BUS_ADDRESS in sd_ll.c
+uint32_t SDIOMock_BusAddress(const volatile void *address);
+
+void SDIOMock_GetStats(sdio_mock_stats_t *stats);
+
+// Host millisecond tick, for the driver's timeouts
+uint32_t HAL_GetTick(void);
+
+#endif /* INC_SDIO_MOCK_H_ */
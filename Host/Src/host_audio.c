@@ -0,0 +1,385 @@
+/*
+ * host_audio.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "host_audio.h"
+
+#include <string.h>
+#include <time.h>
+
+#define WAV_HEADER_BYTES 44
+#define NS_PER_SEC 1000000000ULL
+#define NS_PER_US 1000ULL
+
+#define LEN(arr) (sizeof(arr) / sizeof(arr[0]))
+
+// Accept anything by default: the point is to see what the pipeline produces, not to constrain it
+static const audio_format_t DEFAULT_FORMATS[] =
+{
+    { .sample_rate = AUDIO_RATE_ANY, .bits_per_sample = 16, .channels = 2, .packing = AUDIO_PACKING_S16 },
+    { .sample_rate = AUDIO_RATE_ANY, .bits_per_sample = 24, .channels = 2, .packing = AUDIO_PACKING_S24_PACKED },
+    { .sample_rate = AUDIO_RATE_ANY, .bits_per_sample = 24, .channels = 2, .packing = AUDIO_PACKING_S24_IN_32 },
+    { .sample_rate = AUDIO_RATE_ANY, .bits_per_sample = 32, .channels = 2, .packing = AUDIO_PACKING_S32 },
+    { .sample_rate = AUDIO_RATE_ANY, .bits_per_sample = 16, .channels = 1, .packing = AUDIO_PACKING_S16 },
+    { .sample_rate = AUDIO_RATE_ANY, .bits_per_sample = 24, .channels = 1, .packing = AUDIO_PACKING_S24_PACKED },
+    { .sample_rate = AUDIO_RATE_ANY, .bits_per_sample = 24, .channels = 1, .packing = AUDIO_PACKING_S24_IN_32 },
+    { .sample_rate = AUDIO_RATE_ANY, .bits_per_sample = 32, .channels = 1, .packing = AUDIO_PACKING_S32 },
+};
+
+static const audio_format_t *sink_formats = DEFAULT_FORMATS;
+static size_t sink_format_count = LEN(DEFAULT_FORMATS);
+
+static const char *sink_path;
+static host_audio_mode_t sink_mode;
+static FILE *sink_log;
+
+static FILE *wav_file;
+static audio_format_t sink_format;
+static uint8_t configured;
+
+// Simulated DAC: the time at which it will have played everything it has been given so far
+static uint8_t started;
+static uint64_t start_ns;
+static uint64_t drained_at_ns;
+
+static host_audio_stats_t stats;
+
+static uint64_t NowNs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * NS_PER_SEC + (uint64_t)now.tv_nsec;
+}
+
+static void SleepUntilNs(uint64_t deadline_ns)
+{
+    struct timespec deadline =
+    { .tv_sec = (time_t)(deadline_ns / NS_PER_SEC), .tv_nsec = (long)(deadline_ns % NS_PER_SEC) };
+
+    // Absolute deadline, so an interrupted sleep just resumes and errors don't accumulate
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) != 0)
+    {
+    }
+}
+
+static uint64_t FramesToNs(uint64_t frames)
+{
+    return frames * NS_PER_SEC / sink_format.sample_rate;
+}
+
+static void Put16(uint8_t *dst, uint16_t value)
+{
+    dst[0] = (uint8_t)value;
+    dst[1] = (uint8_t)(value >> 8);
+}
+
+static void Put32(uint8_t *dst, uint32_t value)
+{
+    Put16(dst, (uint16_t)value);
+    Put16(dst + 2, (uint16_t)(value >> 16));
+}
+
+/*
+ * Canonical 44-byte header, same layout wav.c parses.
+ * The file stores the container size, so S24_IN_32 is written as 32-bit PCM:
+ * a 24-bit sample left-justified in 32 bits is a valid 32-bit sample, and the bytes stay exactly what was streamed.
+ */
+static int WriteHeader(uint32_t data_bytes)
+{
+    uint8_t header[WAV_HEADER_BYTES];
+    uint16_t block_align = (uint16_t)Audio_BytesPerFrame(&sink_format);
+    uint16_t container_bits = (uint16_t)(Audio_BytesPerSample(sink_format.packing) * 8);
+
+    memcpy(&header[0], "RIFF", 4);
+    Put32(&header[4], WAV_HEADER_BYTES - 8 + data_bytes);
+    memcpy(&header[8], "WAVE", 4);
+    memcpy(&header[12], "fmt ", 4);
+    Put32(&header[16], 16);
+    Put16(&header[20], 1);  // PCM
+    Put16(&header[22], sink_format.channels);
+    Put32(&header[24], sink_format.sample_rate);
+    Put32(&header[28], sink_format.sample_rate * block_align);
+    Put16(&header[32], block_align);
+    Put16(&header[34], container_bits);
+    memcpy(&header[36], "data", 4);
+    Put32(&header[40], data_bytes);
+
+    if (fseek(wav_file, 0, SEEK_SET) != 0)
+    {
+        return -1;
+    }
+
+    return (fwrite(header, 1, sizeof(header), wav_file) == sizeof(header)) ? 0 : -1;
+}
+
+audio_ret_t HostAudio_Setup(const char *path, host_audio_mode_t mode, FILE *log)
+{
+    if (path == NULL)
+    {
+        return AUDIO_ERROR_NULL_BUFFER;
+    }
+
+    sink_path = path;
+    sink_mode = mode;
+    sink_log = log;
+
+    return AUDIO_SUCCESS;
+}
+
+audio_ret_t HostAudio_SetFormats(const audio_format_t *formats, size_t count)
+{
+    if (formats == NULL || count == 0)
+    {
+        return AUDIO_ERROR_NULL_BUFFER;
+    }
+
+    sink_formats = formats;
+    sink_format_count = count;
+
+    return AUDIO_SUCCESS;
+}
+
+audio_ret_t HostAudio_GetStats(host_audio_stats_t *out)
+{
+    if (out == NULL)
+    {
+        return AUDIO_ERROR_NULL_BUFFER;
+    }
+
+    *out = stats;
+
+    return AUDIO_SUCCESS;
+}
+
+audio_ret_t HostAudio_Open(void)
+{
+    if (sink_path == NULL)
+    {
+        return AUDIO_ERROR_UNABLE_TO_CONFIGURE;
+    }
+
+    wav_file = fopen(sink_path, "wb");
+
+    if (wav_file == NULL)
+    {
+        return AUDIO_ERROR_UNABLE_TO_CONFIGURE;
+    }
+
+    configured = 0;
+    started = 0;
+    memset(&stats, 0, sizeof(stats));
+
+    return AUDIO_SUCCESS;
+}
+
+audio_ret_t HostAudio_Close(void)
+{
+    if (wav_file == NULL)
+    {
+        return AUDIO_ERROR_GENERIC;
+    }
+
+    audio_ret_t res = AUDIO_SUCCESS;
+
+    // The sizes weren't known until now
+    if (configured)
+    {
+        uint64_t data_bytes = stats.frames * Audio_BytesPerFrame(&sink_format);
+
+        if (WriteHeader((uint32_t)data_bytes) != 0)
+        {
+            res = AUDIO_ERROR_GENERIC;
+        }
+    }
+
+    if (sink_log != NULL && started)
+    {
+        fprintf(sink_log, "[host_audio] %llu frames in %u blocks, %u underruns (%llu us total, %llu us worst)",
+                (unsigned long long)stats.frames, stats.blocks, stats.underruns,
+                (unsigned long long)stats.underrun_us, (unsigned long long)stats.max_underrun_us);
+
+        if (stats.elapsed_us > 0)
+        {
+            double audio_us = (double)stats.frames * 1e6 / sink_format.sample_rate;
+            fprintf(sink_log, ", %.1fx real time", audio_us / (double)stats.elapsed_us);
+        }
+
+        fprintf(sink_log, "\n");
+    }
+
+    fclose(wav_file);
+    wav_file = NULL;
+
+    return res;
+}
+
+audio_ret_t HostAudio_GetFormats(const audio_format_t **formats, size_t *count)
+{
+    if (formats == NULL || count == NULL)
+    {
+        return AUDIO_ERROR_NULL_BUFFER;
+    }
+
+    *formats = sink_formats;
+    *count = sink_format_count;
+
+    return AUDIO_SUCCESS;
+}
+
+// A file can be "clocked" at any rate exactly, so the only question is whether the format was advertised
+audio_ret_t HostAudio_Configure(const audio_format_t *format, int32_t *error_ppm)
+{
+    if (format == NULL)
+    {
+        return AUDIO_ERROR_NULL_BUFFER;
+    }
+
+    if (wav_file == NULL)
+    {
+        return AUDIO_ERROR_UNABLE_TO_CONFIGURE;
+    }
+
+    uint8_t supported = 0;
+
+    for (size_t i = 0; i < sink_format_count; i++)
+    {
+        const audio_format_t *candidate = &sink_formats[i];
+
+        if (candidate->bits_per_sample == format->bits_per_sample && candidate->channels == format->channels
+                && candidate->packing == format->packing
+                && (candidate->sample_rate == AUDIO_RATE_ANY || candidate->sample_rate == format->sample_rate))
+        {
+            supported = 1;
+            break;
+        }
+    }
+
+    if (!supported)
+    {
+        return AUDIO_ERROR_FORMAT_UNSUPPORTED;
+    }
+
+    if (format->sample_rate == 0)
+    {
+        return AUDIO_ERROR_RATE_UNSUPPORTED;
+    }
+
+    // One file per Open(): a second track with a different format would make the file unreadable
+    if (configured && memcmp(format, &sink_format, sizeof(sink_format)) != 0)
+    {
+        return AUDIO_ERROR_FORMAT_UNSUPPORTED;
+    }
+
+    if (error_ppm != NULL)
+    {
+        *error_ppm = 0;
+    }
+
+    if (!configured)
+    {
+        sink_format = *format;
+        configured = 1;
+
+        // Placeholder, patched with the real sizes on Close()
+        if (WriteHeader(0) != 0)
+        {
+            return AUDIO_ERROR_UNABLE_TO_CONFIGURE;
+        }
+    }
+
+    return AUDIO_SUCCESS;
+}
+
+/*
+ * Wait (in real time mode) until the simulated FIFO has room for the block, then append it to the file.
+ *
+ * drained_at_ns is when the DAC will run out of samples if nothing else arrives.
+ * If that's already in the past when a block shows up, the DAC sat there with nothing to play: underrun.
+ */
+audio_ret_t HostAudio_Stream(void *buffer, size_t length)
+{
+    if (buffer == NULL)
+    {
+        return AUDIO_ERROR_NULL_BUFFER;
+    }
+
+    if (wav_file == NULL || !configured)
+    {
+        return AUDIO_ERROR_UNABLE_TO_STREAM_BUFFER;
+    }
+
+    uint32_t frame_bytes = Audio_BytesPerFrame(&sink_format);
+
+    if (length % frame_bytes != 0)
+    {
+        return AUDIO_ERROR_UNABLE_TO_STREAM_BUFFER;
+    }
+
+    uint64_t frames = length / frame_bytes;
+    uint64_t now = NowNs();
+
+    if (!started)
+    {
+        started = 1;
+        start_ns = now;
+        drained_at_ns = now;
+    }
+    else if (sink_mode == HOST_AUDIO_MODE_REALTIME && now > drained_at_ns)
+    {
+        uint64_t starved_us = (now - drained_at_ns) / NS_PER_US;
+
+        stats.underruns++;
+        stats.underrun_us += starved_us;
+
+        if (starved_us > stats.max_underrun_us)
+        {
+            stats.max_underrun_us = starved_us;
+        }
+
+        if (sink_log != NULL)
+        {
+            fprintf(sink_log, "[host_audio] %10.3f ms: underrun at frame %llu, starved for %llu us\n",
+                    (double)(now - start_ns) / 1e6, (unsigned long long)stats.frames,
+                    (unsigned long long)starved_us);
+        }
+
+        // The DAC restarts from silence
+        drained_at_ns = now;
+    }
+
+    if (sink_mode == HOST_AUDIO_MODE_REALTIME)
+    {
+        uint64_t block_ns = FramesToNs(frames);
+        uint64_t fifo_ns = FramesToNs(HOST_AUDIO_FIFO_FRAMES);
+
+        // Room for this block once the queue (including the block) fits in the FIFO again
+        if (drained_at_ns + block_ns > now + fifo_ns)
+        {
+            SleepUntilNs(drained_at_ns + block_ns - fifo_ns);
+        }
+
+        drained_at_ns += block_ns;
+    }
+
+    if (fwrite(buffer, 1, length, wav_file) != length)
+    {
+        return AUDIO_ERROR_UNABLE_TO_STREAM_BUFFER;
+    }
+
+    stats.frames += frames;
+    stats.blocks++;
+
+    stats.elapsed_us = (NowNs() - start_ns) / NS_PER_US;
+
+    return AUDIO_SUCCESS;
+}
+
+const audio_driver_t host_audio_driver =
+{ .Open = HostAudio_Open, .Close = HostAudio_Close, .GetFormats = HostAudio_GetFormats,
+        .Configure = HostAudio_Configure, .Stream = HostAudio_Stream };
@@ -0,0 +1,272 @@
+/*
+ * host_bookmark.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#include "host_bookmark.h"
+#include "bookmark.h"
+#include "host_disk.h"
+
+#include <string.h>
+#include <time.h>
+
+#define NAIVE_NAME "NAIVE.BMK"
+
+// What a step cost: FatFs's calls to the disk, and time, on the card and in all
+typedef struct
+{
+    host_disk_io_t io;
+    uint64_t busy_us;
+    struct timespec start;
+} mark_t;
+
+typedef struct
+{
+    uint32_t count;
+    uint32_t writes;
+    uint32_t write_sectors;
+    uint32_t reads;
+    uint32_t max_writes;
+    double total_ms;
+    double max_ms;
+} cost_t;
+
+static const sd_model_t *card;
+
+static void Mark(mark_t *mark)
+{
+    HostDisk_GetIO(&mark->io);
+    mark->busy_us = (card != NULL) ? card->stats.busy_us : 0;
+    clock_gettime(CLOCK_MONOTONIC, &mark->start);
+}
+
+// Since the mark, in ms (the card's time with a model, the host's without), added to cost
+static double Add(cost_t *cost, const mark_t *mark)
+{
+    host_disk_io_t io;
+    struct timespec end;
+    double ms;
+
+    HostDisk_GetIO(&io);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if (card != NULL)
+    {
+        ms = (double)(card->stats.busy_us - mark->busy_us) / 1e3;
+    }
+    else
+    {
+        ms = (double)(end.tv_sec - mark->start.tv_sec) * 1e3 + (double)(end.tv_nsec - mark->start.tv_nsec) / 1e6;
+    }
+
+    uint32_t writes = io.writes - mark->io.writes;
+
+    cost->count++;
+    cost->writes += writes;
+    cost->write_sectors += io.write_sectors - mark->io.write_sectors;
+    cost->reads += io.reads - mark->io.reads;
+    cost->max_writes = (writes > cost->max_writes) ? writes : cost->max_writes;
+    cost->total_ms += ms;
+    cost->max_ms = (ms > cost->max_ms) ? ms : cost->max_ms;
+
+    return ms;
+}
+
+static void PrintCost(FILE *out, const char *what, const cost_t *cost)
+{
+    double n = cost->count ? cost->count : 1;
+
+    fprintf(out, "[bookmark] %s: %.2f writes (%.2f sectors, %u at most), %.2f reads, %.3f ms on average, "
+            "%.3f ms at most (%u)\n", what, cost->writes / n, cost->write_sectors / n, cost->max_writes,
+            cost->reads / n, cost->total_ms / n, cost->max_ms, cost->count);
+}
+
+// Save i: a different track every so often, and a different place in it every time
+static void Make(bookmark_t *bookmark, uint32_t i)
+{
+    memset(bookmark, 0, sizeof(*bookmark));
+    snprintf(bookmark->path, sizeof(bookmark->path), "Artist %u/Album/%02u Track.wav", i / 50, i % 50);
+    bookmark->frame = (uint64_t)i * 44100 * 5 + i;
+    bookmark->user[0] = i;
+    bookmark->user[BOOKMARK_USER_WORDS - 1] = ~i;
+}
+
+static uint8_t Same(const bookmark_t *a, const bookmark_t *b)
+{
+    return strcmp(a->path, b->path) == 0 && a->frame == b->frame && memcmp(a->user, b->user, sizeof(a->user)) == 0;
+}
+
+static int Boot(const bookmark_t *expected, const char *what, FILE *out)
+{
+    cost_t cost = { 0 };
+    bookmark_stats_t stats;
+    bookmark_t loaded;
+    mark_t mark;
+
+    Bookmark_Close();
+
+    Mark(&mark);
+    bookmark_ret_t res = Bookmark_Open();
+
+    if (res == BOOKMARK_SUCCESS)
+    {
+        res = Bookmark_Load(&loaded);
+    }
+
+    Add(&cost, &mark);
+    Bookmark_GetStats(&stats);
+
+    if (res != BOOKMARK_SUCCESS || !Same(&loaded, expected))
+    {
+        fprintf(out, "[bookmark] %s: didn't get the bookmark back (%d)\n", what, res);
+        return 1;
+    }
+
+    PrintCost(out, what, &cost);
+    fprintf(out, "[bookmark]   %u valid records, %u not, the latest sequence %u\n", stats.valid, stats.invalid,
+            stats.sequence);
+
+    return 0;
+}
+
+int HostBookmark_Benchmark(fs_driver_t *fs, const sd_model_t *model, FILE *out)
+{
+    const struct fs_operations *ops = fs->ops;
+    cost_t made = { 0 };
+    cost_t saves = { 0 };
+    cost_t unchanged = { 0 };
+    cost_t naive = { 0 };
+    bookmark_t bookmark;
+    bookmark_t previous;
+    mark_t mark;
+
+    card = model;
+
+    if (ops->RemoveFile != NULL)
+    {
+        ops->RemoveFile(BOOKMARK_FILE);
+        ops->RemoveFile(NAIVE_NAME);
+    }
+
+    if (Bookmark_Init(fs) != BOOKMARK_SUCCESS)
+    {
+        return 1;
+    }
+
+    // A new card: the file's made
+    Mark(&mark);
+    bookmark_ret_t res = Bookmark_Open();
+    Add(&made, &mark);
+
+    if (res != BOOKMARK_SUCCESS || Bookmark_Load(&bookmark) != BOOKMARK_ERROR_NONE_SAVED)
+    {
+        fprintf(out, "[bookmark] Unable to make %s (%d)\n", BOOKMARK_FILE, res);
+        return 1;
+    }
+
+    PrintCost(out, "making the file", &made);
+
+    // Every tenth save is the same again, which should write nothing
+    for (uint32_t i = 0; i < HOST_BOOKMARK_SAVES; i++)
+    {
+        previous = bookmark;
+        Make(&bookmark, i);
+
+        Mark(&mark);
+        res = Bookmark_Save(&bookmark);
+        Add(&saves, &mark);
+
+        if (res == BOOKMARK_SUCCESS && i % 10 == 9)
+        {
+            Mark(&mark);
+            res = (Bookmark_Save(&bookmark) == BOOKMARK_UNCHANGED) ? BOOKMARK_SUCCESS : BOOKMARK_ERROR_GENERIC;
+            Add(&unchanged, &mark);
+        }
+
+        if (res != BOOKMARK_SUCCESS)
+        {
+            fprintf(out, "[bookmark] save %u failed (%d)\n", i, res);
+            return 1;
+        }
+    }
+
+    PrintCost(out, "save", &saves);
+    PrintCost(out, "save of the same again", &unchanged);
+
+    // The same saves as a little file made over each time: the directory and FAT are written too
+    for (uint32_t i = 0; i < HOST_BOOKMARK_NAIVE; i++)
+    {
+        bookmark_t scratch;
+        file_t file;
+
+        Make(&scratch, i);
+        Mark(&mark);
+
+        if (ops->CreateFile(&file, NAIVE_NAME) != FS_SUCCESS)
+        {
+            fprintf(out, "[bookmark] Unable to create %s\n", NAIVE_NAME);
+            return 1;
+        }
+
+        res = (ops->WriteFile(&file, &scratch, sizeof(scratch)) == FS_SUCCESS) ? BOOKMARK_SUCCESS
+                : BOOKMARK_ERROR_UNABLE_TO_WRITE;
+
+        if (ops->CloseFile(&file) != FS_SUCCESS || res != BOOKMARK_SUCCESS)
+        {
+            fprintf(out, "[bookmark] Unable to write %s\n", NAIVE_NAME);
+            return 1;
+        }
+
+        Add(&naive, &mark);
+    }
+
+    PrintCost(out, "save as a file made over", &naive);
+
+    if (Boot(&bookmark, "boot", out) != 0)
+    {
+        return 1;
+    }
+
+    // The power goes halfway through the last save: the back half of its sector is whatever was there before
+    Bookmark_Close();
+
+    file_t file;
+    uint8_t sector[BOOKMARK_RECORD_SIZE];
+    uint64_t last = (uint64_t)((HOST_BOOKMARK_SAVES - 1) % BOOKMARK_SLOTS) * BOOKMARK_RECORD_SIZE;
+
+    if (ops->OpenFileForUpdate(&file, BOOKMARK_FILE) != FS_SUCCESS
+            || ops->ReadFileFrom(&file, last, sector, sizeof(sector)) != FS_SUCCESS)
+    {
+        fprintf(out, "[bookmark] Unable to open %s to tear it\n", BOOKMARK_FILE);
+        return 1;
+    }
+
+    memset(sector + sizeof(sector) / 2, 0xA5, sizeof(sector) / 2);
+
+    if (ops->WriteFileAt(&file, last, sector, sizeof(sector)) != FS_SUCCESS || ops->CloseFile(&file) != FS_SUCCESS)
+    {
+        fprintf(out, "[bookmark] Unable to tear %s\n", BOOKMARK_FILE);
+        return 1;
+    }
+
+    if (Boot(&previous, "boot after a torn save", out) != 0)
+    {
+        return 1;
+    }
+
+    // And on from there: the next save goes over the torn one
+    Mark(&mark);
+    res = Bookmark_Save(&bookmark);
+    Add(&saves, &mark);
+
+    if (res != BOOKMARK_SUCCESS || Boot(&bookmark, "boot after saving over it", out) != 0)
+    {
+        return 1;
+    }
+
+    Bookmark_Close();
+
+    return 0;
+}
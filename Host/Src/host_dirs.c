@@ -0,0 +1,167 @@
+/*
+ * host_dirs.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#include "host_dirs.h"
+#include "blk.h"
+#include "ff.h"
+#include "host_fatfs.h"
+
+// Same as a generated library card (host_library.c)
+#define CARD_CLUSTER_B 4096
+
+#define PATH_LEN 64
+
+static const uint32_t FOLDER_FILES[] = { 16, 128, 1024, 4096 };
+
+#define NUM_FOLDERS (sizeof(FOLDER_FILES) / sizeof(FOLDER_FILES[0]))
+
+// Long enough for three LFN entries a file, like most track names
+static void FilePath(char *path, size_t size, uint32_t files, uint32_t n)
+{
+    snprintf(path, size, "%u Files/%05u A Track With A Long Name.wav", files, n);
+}
+
+static int MakeFolder(fs_driver_t *fs, uint32_t files)
+{
+    char path[PATH_LEN];
+    file_t file;
+
+    snprintf(path, sizeof(path), "%u Files", files);
+
+    if (f_mkdir(path) != FR_OK)
+    {
+        return 1;
+    }
+
+    for (uint32_t n = 0; n < files; n++)
+    {
+        FilePath(path, sizeof(path), files, n);
+
+        if (fs->ops->CreateFile(&file, path) != FS_SUCCESS || fs->ops->CloseFile(&file) != FS_SUCCESS)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+typedef struct
+{
+    uint32_t requests;
+    uint64_t busy_us;
+} cost_t;
+
+// What opening path costs: the block layer's requests and the card's time. found: whether it's there.
+static cost_t Open(fs_driver_t *fs, const sd_model_t *model, char *path, uint8_t *found)
+{
+    blk_stats_t before;
+    blk_stats_t after;
+    uint64_t busy_before = (model != NULL) ? model->stats.busy_us : 0;
+    file_t file;
+    cost_t cost;
+
+    Blk_GetStats(&before);
+
+    *found = (fs->ops->OpenFile(&file, path) == FS_SUCCESS);
+
+    if (*found)
+    {
+        fs->ops->CloseFile(&file);
+    }
+
+    Blk_GetStats(&after);
+
+    cost.requests = after.requests - before.requests;
+    cost.busy_us = (model != NULL) ? model->stats.busy_us - busy_before : 0;
+
+    return cost;
+}
+
+static void PrintCost(FILE *out, const char *what, const cost_t *cost, uint32_t opens)
+{
+    fprintf(out, ", %s %.1f requests (%.2f ms card)", what, (double)cost->requests / opens,
+            (double)cost->busy_us / 1000.0 / opens);
+}
+
+int HostDirs_Benchmark(fs_driver_t *fs, const sd_model_t *model, FILE *out)
+{
+    char path[PATH_LEN];
+    uint32_t built;
+    uint32_t checked;
+    uint8_t found;
+
+    if (HostFatFS_Format(0, CARD_CLUSTER_B) != FS_SUCCESS || fs->ops->Open(fs) != FS_SUCCESS)
+    {
+        fprintf(out, "Unable to format the image\n");
+        return 1;
+    }
+
+    for (uint32_t i = 0; i < NUM_FOLDERS; i++)
+    {
+        if (MakeFolder(fs, FOLDER_FILES[i]) != 0)
+        {
+            fprintf(out, "Unable to fill the %u file folder\n", FOLDER_FILES[i]);
+            return 1;
+        }
+    }
+
+    // Mounted again, so nothing's cached yet
+    if (fs->ops->Close() != FS_SUCCESS || fs->ops->Open(fs) != FS_SUCCESS)
+    {
+        return 1;
+    }
+
+    HostFatFS_GetDirCacheStats(&built, &checked);
+    fprintf(out, "[dirs] directory lookup cache: %u objects (0: none)\n", (unsigned)_FS_DIRCACHE);
+
+    for (uint32_t i = 0; i < NUM_FOLDERS; i++)
+    {
+        uint32_t files = FOLDER_FILES[i];
+        cost_t first;
+        cost_t then = { 0, 0 };
+        cost_t missing;
+
+        // The middle of the folder first: without a cache, what an open costs on average
+        FilePath(path, sizeof(path), files, files / 2);
+        first = Open(fs, model, path, &found);
+
+        for (uint32_t n = 0; n < HOST_DIRS_OPENS && found; n++)
+        {
+            FilePath(path, sizeof(path), files, (uint32_t)((uint64_t)n * files / HOST_DIRS_OPENS));
+
+            cost_t cost = Open(fs, model, path, &found);
+
+            then.requests += cost.requests;
+            then.busy_us += cost.busy_us;
+        }
+
+        if (!found)
+        {
+            fprintf(out, "Unable to open %s\n", path);
+            return 1;
+        }
+
+        snprintf(path, sizeof(path), "%u Files/No Such Track.wav", files);
+        missing = Open(fs, model, path, &found);
+
+        fprintf(out, "[dirs] %4u files", files);
+        PrintCost(out, "first open", &first, 1);
+        PrintCost(out, "then", &then, HOST_DIRS_OPENS);
+        PrintCost(out, "not there", &missing, 1);
+        fprintf(out, "\n");
+    }
+
+    uint32_t built_after;
+    uint32_t checked_after;
+
+    HostFatFS_GetDirCacheStats(&built_after, &checked_after);
+    fprintf(out, "[dirs] %u directories cached, %u entry blocks read to check a hash\n", built_after - built,
+            checked_after - checked);
+
+    return 0;
+}
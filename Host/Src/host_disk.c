@@ -0,0 +1,367 @@
+/*
+ * host_disk.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "host_disk.h"
+#include "blk.h"
+#include "sd_ll.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+static const char *disk_path;
+static sd_model_t *disk_model;
+static uint8_t disk_sleep;
+
+static int disk_fd = -1;
+static DWORD disk_sectors;
+static volatile DSTATUS disk_stat = STA_NOINIT;
+
+static uint8_t disk_sdio;
+static host_disk_io_t disk_io;
+static sdio_mock_config_t sdio_config;
+static FILE *sdio_log;
+static sd_ll_t sdio_ll;
+
+#define SDIO_TIMEOUT_MS 1000
+
+static uint64_t NowUs(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000000 + (uint64_t)now.tv_nsec / 1000;
+}
+
+// Pretend to be the card: the transfer isn't done until as long as the model says it would take.
+// Nothing sleeps, the block layer polls (and yields) until then, like on the board.
+static uint64_t Delay(sd_model_op_t op, UINT count)
+{
+    if (disk_model == NULL)
+    {
+        return 0;
+    }
+
+    uint32_t latency_us = SDModel_CommandUs(disk_model, op, count);
+
+    return disk_sleep ? NowUs() + latency_us : 0;
+}
+
+host_disk_ret_t HostDisk_Setup(const char *image_path, sd_model_t *model, uint8_t sleep)
+{
+    if (image_path == NULL)
+    {
+        return HOST_DISK_ERROR_NULL_PARAMETER;
+    }
+
+    disk_path = image_path;
+    disk_model = model;
+    disk_sleep = sleep;
+
+    return HOST_DISK_SUCCESS;
+}
+
+host_disk_ret_t HostDisk_UseSDIO(uint8_t cmd23, FILE *log)
+{
+    SDIOMock_DefaultConfig(&sdio_config);
+    sdio_config.cmd23 = cmd23;
+    sdio_log = log;
+    disk_sdio = 1;
+
+    return HOST_DISK_SUCCESS;
+}
+
+void HostDisk_GetIO(host_disk_io_t *io)
+{
+    if (io != NULL)
+    {
+        *io = disk_io;
+    }
+}
+
+void HostDisk_PrintStats(FILE *out)
+{
+    if (out == NULL)
+    {
+        return;
+    }
+
+    blk_stats_t blk;
+    Blk_GetStats(&blk);
+
+    fprintf(out, "[blk] %u requests, %u merged, %u read-ahead hits, %u transfers, avg %u B, %u commands/MB\n",
+            blk.requests, blk.merged, blk.readahead_hits, blk.transfers, blk.avg_transfer_b, blk.commands_per_mb);
+    fprintf(out, "[blk] %u transfers straight to the caller's buffer, %u bounced for alignment (%u blocks)\n",
+            blk.aligned, blk.bounced, blk.bounced_blocks);
+    fprintf(out, "[blk] real-time %u (max wait %u ms, %u missed), normal %u (%u ms), idle %u (%u ms), "
+            "%u promoted, %u deferred, %u forced\n", blk.class_requests[BLK_CLASS_REALTIME],
+            blk.class_max_wait_ms[BLK_CLASS_REALTIME], blk.deadline_misses, blk.class_requests[BLK_CLASS_NORMAL],
+            blk.class_max_wait_ms[BLK_CLASS_NORMAL], blk.class_requests[BLK_CLASS_IDLE],
+            blk.class_max_wait_ms[BLK_CLASS_IDLE], blk.promotions, blk.deferrals, blk.forced);
+
+    if (!disk_sdio)
+    {
+        return;
+    }
+
+    sdio_mock_stats_t mock;
+    SDIOMock_GetStats(&mock);
+
+    fprintf(out, "[sd_ll] %u transfers, %u blocks, %u commands, %u stops, %u bounced, %u errors\n",
+            sdio_ll.stats.transfers, sdio_ll.stats.blocks, sdio_ll.stats.commands, sdio_ll.stats.stops,
+            sdio_ll.stats.bounced, sdio_ll.stats.errors);
+    fprintf(out, "[sdio_mock] CMD17 %u, CMD18 %u, CMD23 %u, CMD12 %u, CMD13 %u, CMD24 %u, CMD25 %u, "
+            "%u protocol violations\n", mock.commands[17], mock.commands[18], mock.commands[23], mock.commands[12],
+            mock.commands[13], mock.commands[24], mock.commands[25], mock.violations);
+}
+
+host_disk_ret_t HostDisk_CreateImage(const char *image_path, uint64_t size_bytes)
+{
+    if (image_path == NULL)
+    {
+        return HOST_DISK_ERROR_NULL_PARAMETER;
+    }
+
+    int fd = open(image_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+    if (fd < 0)
+    {
+        return HOST_DISK_ERROR_UNABLE_TO_OPEN;
+    }
+
+    int res = ftruncate(fd, (off_t)size_bytes);
+    close(fd);
+
+    return (res == 0) ? HOST_DISK_SUCCESS : HOST_DISK_ERROR_GENERIC;
+}
+
+// The image (or the mock card) as a block device, under the block layer like the card on the board.
+// The image is read/written in Start and the result handed over on the next Poll; the mock card runs
+// the LL driver's DMA state machine, like on the board, as long as the buffer is aligned.
+static blk_ret_t device_result;
+static uint8_t device_in_flight;
+static uint32_t device_count;
+static sd_model_op_t device_op;
+static uint8_t device_modelled;
+static uint64_t device_done_us;
+
+static blk_ret_t DeviceStart(blk_dir_t dir, void *buffer, uint32_t lba, uint32_t count)
+{
+    size_t length = (size_t)count * HOST_DISK_SECTOR_SIZE;
+    uint8_t write = (dir == BLK_WRITE);
+    sd_ll_ret_t res;
+
+    device_result = BLK_SUCCESS;
+    device_in_flight = 0;
+    device_modelled = 0;
+    device_count = count;
+    device_op = write ? SD_MODEL_WRITE : SD_MODEL_READ;
+
+    if (disk_sdio && ((uintptr_t)buffer & 3) == 0)
+    {
+        res = write ? SDLL_StartWrite(&sdio_ll, buffer, lba, count) : SDLL_StartRead(&sdio_ll, buffer, lba, count);
+        device_in_flight = (res == SD_LL_SUCCESS);
+        device_result = (res == SD_LL_SUCCESS) ? BLK_SUCCESS : BLK_ERROR_DEVICE;
+    }
+    else if (disk_sdio)
+    {
+        res = write ? SDLL_WriteBlocks(&sdio_ll, buffer, lba, count, SDIO_TIMEOUT_MS)
+                : SDLL_ReadBlocks(&sdio_ll, buffer, lba, count, SDIO_TIMEOUT_MS);
+        device_result = (res == SD_LL_SUCCESS) ? BLK_SUCCESS : BLK_ERROR_DEVICE;
+    }
+    else
+    {
+        off_t offset = (off_t)lba * HOST_DISK_SECTOR_SIZE;
+        ssize_t done = write ? pwrite(disk_fd, buffer, length, offset) : pread(disk_fd, buffer, length, offset);
+        device_result = (done == (ssize_t)length) ? BLK_SUCCESS : BLK_ERROR_DEVICE;
+    }
+
+    return BLK_SUCCESS;
+}
+
+static blk_ret_t DevicePoll(void)
+{
+    if (device_in_flight)
+    {
+        sd_ll_ret_t res = SDLL_Poll(&sdio_ll);
+
+        if (res == SD_LL_PENDING)
+        {
+            return BLK_PENDING;
+        }
+
+        device_in_flight = 0;
+        device_result = (res == SD_LL_SUCCESS) ? BLK_SUCCESS : BLK_ERROR_DEVICE;
+    }
+
+    if (device_result != BLK_SUCCESS)
+    {
+        return device_result;
+    }
+
+    if (!device_modelled)
+    {
+        device_modelled = 1;
+        device_done_us = Delay(device_op, device_count);
+    }
+
+    return (NowUs() < device_done_us) ? BLK_PENDING : BLK_SUCCESS;
+}
+
+static uint32_t DeviceCommands(void)
+{
+    return sdio_ll.stats.commands;
+}
+
+// Wall clock (see sdio_mock.c): the model sleeps for real, so deadlines are real too
+static uint32_t DeviceNow(void)
+{
+    return HAL_GetTick();
+}
+
+static const blk_device_t image_device =
+{ .Start = DeviceStart, .Poll = DevicePoll, .Commands = NULL, .Now = DeviceNow };
+
+// Like on the board, the DMA needs words
+static const blk_device_t sdio_device =
+{ .Start = DeviceStart, .Poll = DevicePoll, .Commands = DeviceCommands, .Now = DeviceNow, .alignment = 4 };
+
+DSTATUS HostDisk_initialize(BYTE lun)
+{
+    (void)lun;
+
+    if (disk_path == NULL)
+    {
+        return STA_NOINIT;
+    }
+
+    if (disk_fd >= 0)
+    {
+        close(disk_fd);
+    }
+
+    disk_fd = open(disk_path, O_RDWR);
+
+    if (disk_fd < 0)
+    {
+        disk_stat = STA_NOINIT | STA_NODISK;
+        return disk_stat;
+    }
+
+    struct stat info;
+
+    if (fstat(disk_fd, &info) != 0)
+    {
+        disk_stat = STA_NOINIT;
+        return disk_stat;
+    }
+
+    disk_sectors = (DWORD)(info.st_size / HOST_DISK_SECTOR_SIZE);
+
+    if (disk_sdio)
+    {
+        // Same wiring as on the board: DMA2 stream 3
+        sd_ll_config_t config =
+        { .sdio = &sdio_mock, .dma = &sdio_mock_dma, .stream = &sdio_mock_stream,
+                .stream_index = SDIO_MOCK_DMA_STREAM, .rca = sdio_config.rca,
+                .high_capacity = sdio_config.high_capacity };
+
+        SDIOMock_Init(&sdio_config, disk_fd, (uint32_t)disk_sectors, sdio_log);
+
+        if (SDLL_Init(&sdio_ll, &config) != SD_LL_SUCCESS)
+        {
+            disk_stat = STA_NOINIT;
+            return disk_stat;
+        }
+    }
+
+    Blk_Init(disk_sdio ? &sdio_device : &image_device, (uint32_t)disk_sectors);
+    disk_stat = 0;
+
+    return disk_stat;
+}
+
+DSTATUS HostDisk_status(BYTE lun)
+{
+    (void)lun;
+
+    return disk_stat;
+}
+
+DRESULT HostDisk_read(BYTE lun, BYTE *buff, DWORD sector, UINT count)
+{
+    (void)lun;
+
+    if (disk_stat & STA_NOINIT)
+    {
+        return RES_NOTRDY;
+    }
+
+    if ((uint64_t)sector + count > disk_sectors)
+    {
+        return RES_PARERR;
+    }
+
+    disk_io.reads++;
+    disk_io.read_sectors += count;
+
+    return (Blk_Read(buff, (uint32_t)sector, count) == BLK_SUCCESS) ? RES_OK : RES_ERROR;
+}
+
+DRESULT HostDisk_write(BYTE lun, const BYTE *buff, DWORD sector, UINT count)
+{
+    (void)lun;
+
+    if (disk_stat & STA_NOINIT)
+    {
+        return RES_NOTRDY;
+    }
+
+    if ((uint64_t)sector + count > disk_sectors)
+    {
+        return RES_PARERR;
+    }
+
+    disk_io.writes++;
+    disk_io.write_sectors += count;
+
+    return (Blk_Write(buff, (uint32_t)sector, count) == BLK_SUCCESS) ? RES_OK : RES_ERROR;
+}
+
+DRESULT HostDisk_ioctl(BYTE lun, BYTE cmd, void *buff)
+{
+    (void)lun;
+
+    if (disk_stat & STA_NOINIT)
+    {
+        return RES_NOTRDY;
+    }
+
+    switch (cmd)
+    {
+    case CTRL_SYNC:
+        return (fsync(disk_fd) == 0) ? RES_OK : RES_ERROR;
+    case GET_SECTOR_COUNT:
+        *(DWORD *)buff = disk_sectors;
+        return RES_OK;
+    case GET_SECTOR_SIZE:
+        *(WORD *)buff = HOST_DISK_SECTOR_SIZE;
+        return RES_OK;
+    case GET_BLOCK_SIZE:
+        *(DWORD *)buff = HOST_DISK_ERASE_BLOCK;
+        return RES_OK;
+    default:
+        return RES_PARERR;
+    }
+}
+
+const Diskio_drvTypeDef HostDisk_Driver =
+{ HostDisk_initialize, HostDisk_status, HostDisk_read, HostDisk_write, HostDisk_ioctl };
@@ -0,0 +1,318 @@
+/*
+ * host_dither.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#include "host_dither.h"
+#include "cycles.h"
+#include "pcm.h"
+
+#include <math.h>
+#include <string.h>
+
+#define CHANNELS 2
+#define SAMPLES (HOST_DITHER_FRAMES * CHANNELS)
+
+// The error's spectrum is averaged over segments of this many frames, Hann windowed
+#define FFT_LEN 1024
+#define SEGMENTS (HOST_DITHER_FRAMES / FFT_LEN)
+
+#define SEED 0x6D75506F
+
+#define PI 3.14159265358979
+
+// Band edges in Hz, up to Nyquist
+static const uint32_t BAND_EDGES[] = { 0, 1500, 3000, 6000, 12000, 18000, HOST_DITHER_RATE / 2 };
+
+#define NUM_BANDS (sizeof(BAND_EDGES) / sizeof(BAND_EDGES[0]) - 1)
+
+// What the shaping should make of TPDF dither's 1/4 LSB^2 (1/12 rounding plus 1/6 dither): the noise transfer's
+// power gain, 1 + h1^2 + h2^2
+static const struct
+{
+    pcm_shaping_t shaping;
+    const char *name;
+    double gain;
+} SHAPINGS[] =
+{
+    { PCM_SHAPING_NONE, "TPDF", 1.0 },
+    { PCM_SHAPING_FIRST_ORDER, "1st order", 2.0 },
+    { PCM_SHAPING_SECOND_ORDER, "2nd order", 6.0 },
+};
+
+#define NUM_SHAPINGS (sizeof(SHAPINGS) / sizeof(SHAPINGS[0]))
+
+typedef enum
+{
+    SIGNAL_SINE = 0,
+    SIGNAL_SILENCE
+} signal_t;
+
+// The input, at 24 bits in an int32_t, and as each kernel takes it
+static int32_t input24[SAMPLES];
+static uint8_t packed24[SAMPLES * 3];
+static int32_t words32[SAMPLES];
+static int16_t output[SAMPLES];
+static int16_t output32[SAMPLES];
+
+static double fft_re[FFT_LEN];
+static double fft_im[FFT_LEN];
+
+static void MakeSignal(signal_t signal)
+{
+    double amplitude = (signal == SIGNAL_SINE) ? 8388607.0 * pow(10.0, HOST_DITHER_SINE_DBFS / 20.0) : 0.0;
+
+    for (uint32_t frame = 0; frame < HOST_DITHER_FRAMES; frame++)
+    {
+        int32_t sample = (int32_t)lrint(amplitude * sin(2.0 * PI * HOST_DITHER_SINE_HZ * frame / HOST_DITHER_RATE));
+
+        for (uint32_t ch = 0; ch < CHANNELS; ch++)
+        {
+            // The right channel inverted, so the channels' error histories are seen to be kept apart
+            uint32_t i = frame * CHANNELS + ch;
+            int32_t value = ch ? -sample : sample;
+
+            input24[i] = value;
+            words32[i] = (int32_t)((uint32_t)value << 8);
+            packed24[3 * i] = (uint8_t)value;
+            packed24[3 * i + 1] = (uint8_t)(value >> 8);
+            packed24[3 * i + 2] = (uint8_t)(value >> 16);
+        }
+    }
+}
+
+// In-place radix-2, decimation in time
+static void FFT(double *re, double *im, uint32_t n)
+{
+    for (uint32_t i = 1, j = 0; i < n; i++)
+    {
+        uint32_t bit = n >> 1;
+
+        for (; j & bit; bit >>= 1)
+        {
+            j ^= bit;
+        }
+
+        j ^= bit;
+
+        if (i < j)
+        {
+            double t = re[i];
+            re[i] = re[j];
+            re[j] = t;
+            t = im[i];
+            im[i] = im[j];
+            im[j] = t;
+        }
+    }
+
+    for (uint32_t length = 2; length <= n; length <<= 1)
+    {
+        double angle = -2.0 * PI / length;
+
+        for (uint32_t start = 0; start < n; start += length)
+        {
+            for (uint32_t k = 0; k < length / 2; k++)
+            {
+                double wr = cos(angle * k);
+                double wi = sin(angle * k);
+                uint32_t a = start + k;
+                uint32_t b = a + length / 2;
+                double xr = re[b] * wr - im[b] * wi;
+                double xi = re[b] * wi + im[b] * wr;
+
+                re[b] = re[a] - xr;
+                im[b] = im[a] - xi;
+                re[a] += xr;
+                im[a] += xi;
+            }
+        }
+    }
+}
+
+/*
+ * The error the conversion added to the left channel (output minus input, in 16-bit LSBs), as power per band in
+ * LSB^2: averaged periodograms, scaled so that the bands add up to the error's variance. Returns the total.
+ */
+static double ErrorBands(const int16_t *converted, double *bands)
+{
+    double window_power = 0.0;
+
+    memset(bands, 0, NUM_BANDS * sizeof(*bands));
+
+    for (uint32_t n = 0; n < FFT_LEN; n++)
+    {
+        double w = 0.5 - 0.5 * cos(2.0 * PI * n / FFT_LEN);
+        window_power += w * w;
+    }
+
+    for (uint32_t segment = 0; segment < SEGMENTS; segment++)
+    {
+        for (uint32_t n = 0; n < FFT_LEN; n++)
+        {
+            uint32_t i = (segment * FFT_LEN + n) * CHANNELS;
+            double w = 0.5 - 0.5 * cos(2.0 * PI * n / FFT_LEN);
+
+            fft_re[n] = w * ((double)converted[i] - input24[i] / 256.0);
+            fft_im[n] = 0.0;
+        }
+
+        FFT(fft_re, fft_im, FFT_LEN);
+
+        // Both halves of the spectrum, folded into the positive one
+        for (uint32_t k = 1; k < FFT_LEN / 2; k++)
+        {
+            double hz = (double)k * HOST_DITHER_RATE / FFT_LEN;
+            double power = 2.0 * (fft_re[k] * fft_re[k] + fft_im[k] * fft_im[k]) / (window_power * FFT_LEN);
+            uint32_t band = 0;
+
+            while (band < NUM_BANDS - 1 && hz >= BAND_EDGES[band + 1])
+            {
+                band++;
+            }
+
+            bands[band] += power / SEGMENTS;
+        }
+    }
+
+    double total = 0.0;
+
+    for (uint32_t band = 0; band < NUM_BANDS; band++)
+    {
+        total += bands[band];
+    }
+
+    return total;
+}
+
+static double Decibels(double power)
+{
+    return (power > 1e-12) ? 10.0 * log10(power) : -120.0;
+}
+
+// Per Hz, relative to the same power spread flat from 0 to Nyquist: 0 dB is white
+static double Tilt(const double *bands, double total, uint32_t band)
+{
+    double share = (double)(BAND_EDGES[band + 1] - BAND_EDGES[band]) / (HOST_DITHER_RATE / 2);
+
+    return Decibels(bands[band] / (total * share));
+}
+
+static void PrintBands(FILE *out, const char *what, const double *bands, double total)
+{
+    fprintf(out, "[dither]   %-9s %6.1f dB total |", what, Decibels(total));
+
+    for (uint32_t band = 0; band < NUM_BANDS; band++)
+    {
+        fprintf(out, " %6.1f", Decibels(bands[band]));
+    }
+
+    fprintf(out, "\n");
+}
+
+/*
+ * One signal through both kernels and every shaping: the error's bands, and the checks on them. The bands are the
+ * 24-bit kernel's, the 32-bit one having to match it to the bit. dither = NULL (rounding alone) first, to show what
+ * the dither is for.
+ */
+static int Spectra(signal_t signal, FILE *out)
+{
+    double bands[NUM_BANDS];
+    int failed = 0;
+
+    MakeSignal(signal);
+
+    fprintf(out, "[dither] %s, error in dB re 1 LSB^2, bands (kHz):", (signal == SIGNAL_SINE) ? "sine" : "silence");
+
+    for (uint32_t band = 0; band < NUM_BANDS; band++)
+    {
+        fprintf(out, " %g-%g", BAND_EDGES[band] / 1000.0, BAND_EDGES[band + 1] / 1000.0);
+    }
+
+    fprintf(out, "\n");
+
+    PCM_Convert24To16(NULL, output, packed24, SAMPLES, CHANNELS);
+    PrintBands(out, "rounded", bands, ErrorBands(output, bands));
+
+    for (uint32_t s = 0; s < NUM_SHAPINGS; s++)
+    {
+        pcm_dither_t dither;
+        pcm_dither_t dither32;
+
+        PCM_DitherInit(&dither, SEED, SHAPINGS[s].shaping);
+        PCM_DitherInit(&dither32, SEED, SHAPINGS[s].shaping);
+        PCM_Convert24To16(&dither, output, packed24, SAMPLES, CHANNELS);
+        PCM_Convert32To16(&dither32, output32, words32, SAMPLES, CHANNELS);
+
+        double total = ErrorBands(output, bands);
+
+        PrintBands(out, SHAPINGS[s].name, bands, total);
+
+        // The same samples and seed: the two kernels should be the same to the bit
+        if (memcmp(output, output32, sizeof(output)) != 0)
+        {
+            fprintf(out, "[dither]   %s: the 32-bit kernel's output isn't the 24-bit one's\n", SHAPINGS[s].name);
+            failed = 1;
+        }
+
+        // As much noise as the shaping's gain says, and pushed up: white without shaping, the top band well above
+        // the bottom one with it
+        double expected = 0.25 * SHAPINGS[s].gain;
+        double low = Tilt(bands, total, 0);
+        double high = Tilt(bands, total, NUM_BANDS - 1);
+        uint8_t tilted = (SHAPINGS[s].shaping == PCM_SHAPING_NONE) ? (fabs(high - low) < 1.0) : (high - low > 10.0);
+
+        if (fabs(Decibels(total / expected)) > 0.5 || !tilted)
+        {
+            fprintf(out, "[dither]   %s: %.3f LSB^2 (expected %.3f), %.1f dB from the bottom band to the top\n",
+                    SHAPINGS[s].name, total, expected, high - low);
+            failed = 1;
+        }
+    }
+
+    return failed;
+}
+
+// Cycles a sample for each kernel and shaping, at SystemCoreClock off the PC's clock (see host_cortex.h)
+static void Timing(FILE *out)
+{
+    const uint32_t rounds = HOST_DITHER_TIMED / SAMPLES;
+
+    MakeSignal(SIGNAL_SINE);
+
+    for (uint32_t s = 0; s < NUM_SHAPINGS + 1; s++)
+    {
+        pcm_dither_t dither;
+        pcm_dither_t *used = (s < NUM_SHAPINGS) ? &dither : NULL;
+        uint64_t cycles24 = 0;
+        uint64_t cycles32 = 0;
+
+        PCM_DitherInit(&dither, SEED, (s < NUM_SHAPINGS) ? SHAPINGS[s].shaping : PCM_SHAPING_NONE);
+
+        for (uint32_t round = 0; round < rounds; round++)
+        {
+            uint32_t start = Cycles_Now();
+            PCM_Convert24To16(used, output, packed24, SAMPLES, CHANNELS);
+            uint32_t middle = Cycles_Now();
+            PCM_Convert32To16(used, output32, words32, SAMPLES, CHANNELS);
+            cycles24 += middle - start;
+            cycles32 += Cycles_Now() - middle;
+        }
+
+        fprintf(out, "[dither] %-9s: %.2f cycles a sample from 24-bit, %.2f from 32-bit\n",
+                (s < NUM_SHAPINGS) ? SHAPINGS[s].name : "rounded", (double)cycles24 / ((uint64_t)rounds * SAMPLES),
+                (double)cycles32 / ((uint64_t)rounds * SAMPLES));
+    }
+}
+
+int HostDither_Benchmark(FILE *out)
+{
+    int failed = Spectra(SIGNAL_SINE, out);
+
+    failed |= Spectra(SIGNAL_SILENCE, out);
+    Timing(out);
+
+    return failed;
+}
@@ -0,0 +1,564 @@
+/*
+ * host_fatfs.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#include "host_fatfs.h"
+#include "blk.h"
+#include "host_disk.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define MEGABYTES_TO_BYTES (1024 * 1024)
+#define FORCED_MOUNT 1
+
+static char disk_root[4];
+static FATFS disk_fatfs;
+static uint8_t linked;
+
+// What contiguous-file detection (_FS_CONTIG in ffconf.h) did for the last file read, for HostFatFS_PrintStats
+static struct
+{
+    uint8_t valid;
+    uint32_t clusters;
+    uint32_t contiguous;        // from the start of the file
+    uint32_t skipped;           // cluster boundaries crossed without looking at the FAT
+    uint32_t fat_reads_open;    // FAT sectors read by f_open (the chain scan)
+    uint32_t fat_reads;         // and while reading
+    uint32_t fat_reads_saved;   // that following the chain at each of the skipped boundaries would have taken
+} track;
+
+static uint32_t fat_reads_mark;
+
+fs_ret_t HostFatFS_Open(fs_driver_t *fs)
+{
+    if (fs == NULL)
+    {
+        return FS_ERROR_UNABLE_TO_INIT;
+    }
+
+    if (!linked)
+    {
+        if (FATFS_LinkDriver(&HostDisk_Driver, disk_root) != 0)
+        {
+            return FS_ERROR_UNABLE_TO_INIT;
+        }
+
+        linked = 1;
+    }
+
+    if (f_mount(&disk_fatfs, (TCHAR const *)disk_root, FORCED_MOUNT) != FR_OK)
+    {
+        return FS_ERROR_UNABLE_TO_MOUNT;
+    }
+
+    DWORD sectors;
+
+    if (disk_ioctl(disk_fatfs.drv, GET_SECTOR_COUNT, &sectors) != RES_OK)
+    {
+        return FS_ERROR_UNABLE_TO_MOUNT;
+    }
+
+    fs->block_size_b = HOST_DISK_SECTOR_SIZE;
+    fs->num_blocks = (uint32_t)sectors;
+    fs->fs_size_mb = (uint32_t)(((uint64_t)sectors * HOST_DISK_SECTOR_SIZE) / MEGABYTES_TO_BYTES);
+
+    DWORD serial;
+
+    fs->volume_serial = (f_getlabel((TCHAR const *)disk_root, NULL, &serial) == FR_OK) ? serial : 0;
+
+    return FS_SUCCESS;
+}
+
+fs_ret_t HostFatFS_Close(void)
+{
+    if (!linked)
+    {
+        return FS_ERROR_UNINITIALIZED;
+    }
+
+    f_mount(NULL, (TCHAR const *)disk_root, 0);
+    FATFS_UnLinkDriver(disk_root);
+    linked = 0;
+
+    return FS_SUCCESS;
+}
+
+fs_ret_t HostFatFS_Format(uint8_t exfat, uint32_t cluster_b)
+{
+    // f_mkfs needs the drive, not a mounted volume
+    if (!linked)
+    {
+        if (FATFS_LinkDriver(&HostDisk_Driver, disk_root) != 0)
+        {
+            return FS_ERROR_UNABLE_TO_INIT;
+        }
+
+        linked = 1;
+    }
+
+    static BYTE work[32768];
+
+    if (f_mkfs((TCHAR const *)disk_root, exfat ? FM_EXFAT : FM_FAT32, cluster_b, work, sizeof(work)) != FR_OK)
+    {
+        return FS_ERROR_GENERIC;
+    }
+
+    return FS_SUCCESS;
+}
+
+fs_ret_t HostFatFS_OpenFile(file_t *file, char *filename)
+{
+    if (!linked)
+    {
+        return FS_ERROR_UNINITIALIZED;
+    }
+
+    if (file == NULL)
+    {
+        return FS_ERROR_UNABLE_TO_OPEN_FILE;
+    }
+
+    FIL *handle = malloc(sizeof(FIL));
+
+    if (handle == NULL)
+    {
+        return FS_ERROR_UNABLE_TO_OPEN_FILE;
+    }
+
+    uint32_t fat_reads = disk_fatfs.n_fatrd;
+
+    if (f_open(handle, filename, FA_OPEN_EXISTING | FA_READ) != FR_OK)
+    {
+        free(handle);
+        return FS_ERROR_UNABLE_TO_OPEN_FILE;
+    }
+
+    file->handle = handle;
+    file->filename = filename;
+
+    track.fat_reads_open = disk_fatfs.n_fatrd - fat_reads;
+    fat_reads_mark = disk_fatfs.n_fatrd;
+
+    return FS_SUCCESS;
+}
+
+// The FAT sector holding a cluster's entry, relative to the start of the FAT
+static uint32_t FatSector(const FATFS *fs, DWORD cluster)
+{
+    switch (fs->fs_type)
+    {
+    case FS_FAT12:
+        return (cluster + cluster / 2) / HOST_DISK_SECTOR_SIZE;
+    case FS_FAT16:
+        return (cluster * 2) / HOST_DISK_SECTOR_SIZE;
+    default:
+        return (uint32_t)(((uint64_t)cluster * 4) / HOST_DISK_SECTOR_SIZE);
+    }
+}
+
+static void RecordTrack(const FIL *handle)
+{
+    const FATFS *fs = handle->obj.fs;
+    uint64_t cluster_b = (uint64_t)fs->csize * HOST_DISK_SECTOR_SIZE;
+
+    track.valid = 1;
+    track.clusters = (uint32_t)((handle->obj.objsize + cluster_b - 1) / cluster_b);
+    track.contiguous = handle->ncont;
+    track.skipped = handle->nskip;
+    track.fat_reads = disk_fatfs.n_fatrd - fat_reads_mark;
+
+    // The skipped boundaries are all in the run from the first cluster, whose FAT entries are one after the other,
+    // so the walk would have read each FAT sector they're in once (the window keeps it in between). Nothing for an
+    // exFAT file without a FAT chain: FatFs never reads the FAT for those anyway.
+    track.fat_reads_saved = 0;
+
+    if (handle->nskip > 0 && !(fs->fs_type == FS_EXFAT && handle->obj.stat == 2))
+    {
+        DWORD first = handle->obj.sclust;
+        DWORD last = first + handle->nskip - 1;
+
+        track.fat_reads_saved = FatSector(fs, last) - FatSector(fs, first) + 1;
+    }
+}
+
+void HostFatFS_PrintStats(FILE *out)
+{
+    if (out == NULL || !track.valid)
+    {
+        return;
+    }
+
+    fprintf(out, "[fatfs] last track: %u clusters, %u contiguous from the start, "
+            "%u boundaries crossed without the FAT\n", track.clusters, track.contiguous, track.skipped);
+    fprintf(out, "[fatfs] FAT sector reads: %u at open, %u while reading, %u saved\n", track.fat_reads_open,
+            track.fat_reads, track.fat_reads_saved);
+}
+
+void HostFatFS_GetDirCacheStats(uint32_t *built, uint32_t *checked)
+{
+#if _FS_DIRCACHE
+    *built = disk_fatfs.n_dcbld;
+    *checked = disk_fatfs.n_dcchk;
+#else
+    *built = 0;
+    *checked = 0;
+#endif
+}
+
+fs_ret_t HostFatFS_CloseFile(file_t *file)
+{
+    if (file == NULL || file->handle == NULL)
+    {
+        return FS_ERROR_UNABLE_TO_CLOSE_FILE;
+    }
+
+    FIL *handle = (FIL *)file->handle;
+    fs_ret_t res = FS_SUCCESS;
+
+    if ((handle->flag & FA_READ) && !(handle->flag & FA_WRITE))
+    {
+        RecordTrack(handle);
+    }
+
+    // Same as MicroSD_CloseFile: a file being written gives back the rest of its reservation
+    if ((handle->flag & FA_WRITE) && f_truncate(handle) != FR_OK)
+    {
+        res = FS_ERROR_UNABLE_TO_CLOSE_FILE;
+    }
+
+    if (f_close(handle) != FR_OK)
+    {
+        res = FS_ERROR_UNABLE_TO_CLOSE_FILE;
+    }
+
+    free(file->handle);
+    file->handle = NULL;
+
+    return res;
+}
+
+fs_ret_t HostFatFS_ReadFile(file_t *file, void *buffer, size_t length)
+{
+    if (file == NULL || file->handle == NULL || buffer == NULL)
+    {
+        return FS_ERROR_UNABLE_TO_READ_FILE;
+    }
+
+    UINT bytes_read;
+
+    if (f_read((FIL *)file->handle, buffer, (UINT)length, &bytes_read) != FR_OK)
+    {
+        return FS_ERROR_UNABLE_TO_READ_FILE;
+    }
+
+    return FS_SUCCESS;
+}
+
+// Scheduled by the block layer, like on the board (see MicroSD_SetIOClass)
+static fs_ret_t HostFatFS_SetIOClass(fs_io_class_t io_class, uint32_t budget_ms)
+{
+    Blk_SetClass((blk_class_t)io_class, budget_ms);
+
+    return FS_SUCCESS;
+}
+
+static uint8_t HostFatFS_MayIssue(fs_io_class_t io_class)
+{
+    return Blk_Admit((blk_class_t)io_class);
+}
+
+static fs_ret_t HostFatFS_SetReadAhead(uint32_t bytes)
+{
+    Blk_SetReadAhead(bytes / BLK_BLOCK_SIZE);
+
+    return FS_SUCCESS;
+}
+
+// The writing side is the same as on the board too (see MicroSD_WriteFile and friends)
+static fs_ret_t HostFatFS_CreateFile(file_t *file, char *filename)
+{
+    if (!linked)
+    {
+        return FS_ERROR_UNINITIALIZED;
+    }
+
+    if (file == NULL)
+    {
+        return FS_ERROR_UNABLE_TO_OPEN_FILE;
+    }
+
+    FIL *handle = malloc(sizeof(FIL));
+
+    if (handle == NULL)
+    {
+        return FS_ERROR_UNABLE_TO_OPEN_FILE;
+    }
+
+    if (f_open(handle, filename, FA_CREATE_ALWAYS | FA_WRITE | FA_READ) != FR_OK)
+    {
+        free(handle);
+        return FS_ERROR_UNABLE_TO_OPEN_FILE;
+    }
+
+    file->handle = handle;
+    file->filename = filename;
+
+    return FS_SUCCESS;
+}
+
+static fs_ret_t HostFatFS_WriteFile(file_t *file, const void *buffer, size_t length)
+{
+    if (file == NULL || file->handle == NULL || buffer == NULL)
+    {
+        return FS_ERROR_UNABLE_TO_WRITE_FILE;
+    }
+
+    UINT bytes_written;
+
+    if (f_write((FIL *)file->handle, buffer, (UINT)length, &bytes_written) != FR_OK || bytes_written != length)
+    {
+        return FS_ERROR_UNABLE_TO_WRITE_FILE;
+    }
+
+    return FS_SUCCESS;
+}
+
+static fs_ret_t HostFatFS_WriteFileAt(file_t *file, uint64_t offset, const void *buffer, size_t length)
+{
+    if (file == NULL || file->handle == NULL || buffer == NULL)
+    {
+        return FS_ERROR_UNABLE_TO_WRITE_FILE;
+    }
+
+    FIL *handle = (FIL *)file->handle;
+    FSIZE_t end = f_tell(handle);
+    UINT bytes_written;
+
+    if (f_lseek(handle, offset) != FR_OK || f_write(handle, buffer, (UINT)length, &bytes_written) != FR_OK
+            || bytes_written != length)
+    {
+        f_lseek(handle, end);
+        return FS_ERROR_UNABLE_TO_WRITE_FILE;
+    }
+
+    if (f_lseek(handle, end) != FR_OK)
+    {
+        return FS_ERROR_UNABLE_TO_WRITE_FILE;
+    }
+
+    return FS_SUCCESS;
+}
+
+static fs_ret_t HostFatFS_ReserveFile(file_t *file, uint64_t bytes)
+{
+    if (file == NULL || file->handle == NULL)
+    {
+        return FS_ERROR_UNABLE_TO_RESERVE;
+    }
+
+    FIL *handle = (FIL *)file->handle;
+
+    if (f_expand(handle, (FSIZE_t)bytes, 1) != FR_OK || f_sync(handle) != FR_OK)
+    {
+        return FS_ERROR_UNABLE_TO_RESERVE;
+    }
+
+    return FS_SUCCESS;
+}
+
+// Like MicroSD_SeekFile and MicroSD_OpenFileForUpdate
+static fs_ret_t HostFatFS_SeekFile(file_t *file, uint64_t offset)
+{
+    if (file == NULL || file->handle == NULL)
+    {
+        return FS_ERROR_UNABLE_TO_SEEK;
+    }
+
+    FIL *handle = (FIL *)file->handle;
+
+    if (offset > f_size(handle) || f_lseek(handle, offset) != FR_OK)
+    {
+        return FS_ERROR_UNABLE_TO_SEEK;
+    }
+
+    return FS_SUCCESS;
+}
+
+static fs_ret_t HostFatFS_OpenFileForUpdate(file_t *file, char *filename)
+{
+    if (!linked)
+    {
+        return FS_ERROR_UNINITIALIZED;
+    }
+
+    if (file == NULL)
+    {
+        return FS_ERROR_UNABLE_TO_OPEN_FILE;
+    }
+
+    FIL *handle = malloc(sizeof(FIL));
+
+    if (handle == NULL)
+    {
+        return FS_ERROR_UNABLE_TO_OPEN_FILE;
+    }
+
+    if (f_open(handle, filename, FA_OPEN_EXISTING | FA_WRITE | FA_READ) != FR_OK)
+    {
+        free(handle);
+        return FS_ERROR_UNABLE_TO_OPEN_FILE;
+    }
+
+    if (f_lseek(handle, f_size(handle)) != FR_OK)
+    {
+        f_close(handle);
+        free(handle);
+        return FS_ERROR_UNABLE_TO_OPEN_FILE;
+    }
+
+    file->handle = handle;
+    file->filename = filename;
+
+    return FS_SUCCESS;
+}
+
+// Directories and the rest: MicroSD_ReadFileFrom and friends
+static fs_ret_t HostFatFS_ReadFileFrom(file_t *file, uint64_t offset, void *buffer, size_t length)
+{
+    if (file == NULL || file->handle == NULL || buffer == NULL)
+    {
+        return FS_ERROR_UNABLE_TO_READ_FILE;
+    }
+
+    FIL *handle = (FIL *)file->handle;
+    FSIZE_t position = f_tell(handle);
+    UINT bytes_read;
+    fs_ret_t res = FS_SUCCESS;
+
+    if (f_lseek(handle, offset) != FR_OK || f_read(handle, buffer, (UINT)length, &bytes_read) != FR_OK
+            || bytes_read != length)
+    {
+        res = FS_ERROR_UNABLE_TO_READ_FILE;
+    }
+
+    if (f_lseek(handle, position) != FR_OK)
+    {
+        res = FS_ERROR_UNABLE_TO_READ_FILE;
+    }
+
+    return res;
+}
+
+static void ToEntry(const FILINFO *info, fs_entry_t *entry)
+{
+    strncpy(entry->name, info->fname, FS_MAX_NAME - 1);
+    entry->name[FS_MAX_NAME - 1] = '\0';
+    entry->size = info->fsize;
+    entry->modified = ((uint32_t)info->fdate << 16) | info->ftime;
+    entry->is_dir = (info->fattrib & AM_DIR) != 0;
+    entry->hidden = (info->fattrib & (AM_HID | AM_SYS)) != 0;
+}
+
+static fs_ret_t HostFatFS_FindFirst(fs_dir_t *dir, fs_entry_t *entry, const char *path, const char *pattern)
+{
+    if (!linked)
+    {
+        return FS_ERROR_UNINITIALIZED;
+    }
+
+    if (dir == NULL || entry == NULL || path == NULL || pattern == NULL)
+    {
+        return FS_ERROR_UNABLE_TO_OPEN_DIR;
+    }
+
+    DIR *handle = malloc(sizeof(DIR));
+    FILINFO info;
+
+    dir->handle = handle;
+
+    if (handle == NULL)
+    {
+        return FS_ERROR_UNABLE_TO_OPEN_DIR;
+    }
+
+    if (f_findfirst(handle, &info, path, pattern) != FR_OK)
+    {
+        free(handle);
+        dir->handle = NULL;
+        return FS_ERROR_UNABLE_TO_OPEN_DIR;
+    }
+
+    ToEntry(&info, entry);
+
+    return FS_SUCCESS;
+}
+
+static fs_ret_t HostFatFS_FindNext(fs_dir_t *dir, fs_entry_t *entry)
+{
+    if (dir == NULL || dir->handle == NULL || entry == NULL)
+    {
+        return FS_ERROR_UNABLE_TO_READ_DIR;
+    }
+
+    FILINFO info;
+
+    if (f_findnext((DIR *)dir->handle, &info) != FR_OK)
+    {
+        return FS_ERROR_UNABLE_TO_READ_DIR;
+    }
+
+    ToEntry(&info, entry);
+
+    return FS_SUCCESS;
+}
+
+static fs_ret_t HostFatFS_CloseDir(fs_dir_t *dir)
+{
+    if (dir == NULL || dir->handle == NULL)
+    {
+        return FS_SUCCESS;
+    }
+
+    FRESULT res = f_closedir((DIR *)dir->handle);
+
+    free(dir->handle);
+    dir->handle = NULL;
+
+    return (res == FR_OK) ? FS_SUCCESS : FS_ERROR_GENERIC;
+}
+
+static fs_ret_t HostFatFS_RemoveFile(const char *filename)
+{
+    if (!linked)
+    {
+        return FS_ERROR_UNINITIALIZED;
+    }
+
+    return (filename != NULL && f_unlink(filename) == FR_OK) ? FS_SUCCESS : FS_ERROR_UNABLE_TO_REMOVE;
+}
+
+static fs_ret_t HostFatFS_RenameFile(const char *from, const char *to)
+{
+    if (!linked)
+    {
+        return FS_ERROR_UNINITIALIZED;
+    }
+
+    return (from != NULL && to != NULL && f_rename(from, to) == FR_OK) ? FS_SUCCESS : FS_ERROR_UNABLE_TO_RENAME;
+}
+
+static const struct fs_operations fs_ops =
+{ .Open = HostFatFS_Open, .Close = HostFatFS_Close, .OpenFile = HostFatFS_OpenFile,
+        .CloseFile = HostFatFS_CloseFile, .ReadFile = HostFatFS_ReadFile, .SetIOClass = HostFatFS_SetIOClass,
+        .MayIssue = HostFatFS_MayIssue, .SetReadAhead = HostFatFS_SetReadAhead, .CreateFile = HostFatFS_CreateFile,
+        .WriteFile = HostFatFS_WriteFile, .WriteFileAt = HostFatFS_WriteFileAt, .ReserveFile = HostFatFS_ReserveFile,
+        .ReadFileFrom = HostFatFS_ReadFileFrom, .FindFirst = HostFatFS_FindFirst, .FindNext = HostFatFS_FindNext,
+        .CloseDir = HostFatFS_CloseDir, .RemoveFile = HostFatFS_RemoveFile, .RenameFile = HostFatFS_RenameFile,
+        .SeekFile = HostFatFS_SeekFile, .OpenFileForUpdate = HostFatFS_OpenFileForUpdate };
+
+fs_driver_t host_fatfs_driver =
+{ .ops = &fs_ops };
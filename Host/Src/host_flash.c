@@ -0,0 +1,179 @@
+/*
+ * host_flash.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#include "host_flash.h"
+#include "host_random.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static uint32_t *sectors[2];
+static uint32_t sector_words;
+static uint32_t rng = 1;
+static uint32_t cut_after;
+static uint8_t cut_between;                 // the cut lets the operation finish
+static uint8_t cut;
+static host_flash_stats_t stats;
+
+// Whether the power goes during this operation
+static uint8_t Cut(void)
+{
+    if (cut_after == 0 || --cut_after > 0)
+    {
+        return 0;
+    }
+
+    cut = 1;
+    stats.cuts++;
+
+    return 1;
+}
+
+static const uint8_t *Sector(uint32_t sector)
+{
+    return (const uint8_t *)sectors[sector & 1];
+}
+
+static settings_ret_t Program(uint32_t sector, uint32_t offset, const uint32_t *words, uint32_t count)
+{
+    if (sector > 1 || offset % 4 != 0 || offset / 4 + count > sector_words)
+    {
+        return SETTINGS_ERROR_INVALID;
+    }
+
+    uint32_t *flash = sectors[sector] + offset / 4;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (cut)
+        {
+            return SETTINGS_ERROR_FLASH;
+        }
+
+        // Like internal_flash.c, which leaves erased words alone
+        if (words[i] == 0xFFFFFFFFUL)
+        {
+            continue;
+        }
+
+        if ((flash[i] & words[i]) != words[i])
+        {
+            stats.violations++;
+        }
+
+        // Only some of the bits that were to be cleared are. Or all of them, and the next word is the one that fails.
+        if (Cut() && !cut_between)
+        {
+            flash[i] &= words[i] | HostRandom_Next(&rng);
+            return SETTINGS_ERROR_FLASH;
+        }
+
+        flash[i] &= words[i];
+        stats.words_programmed++;
+        stats.busy_us += HOST_FLASH_PROGRAM_US;
+    }
+
+    return SETTINGS_SUCCESS;
+}
+
+static settings_ret_t Erase(uint32_t sector)
+{
+    if (sector > 1)
+    {
+        return SETTINGS_ERROR_INVALID;
+    }
+
+    if (cut)
+    {
+        return SETTINGS_ERROR_FLASH;
+    }
+
+    // Some words erased, some as they were, some with only some of their bits back
+    if (Cut() && !cut_between)
+    {
+        for (uint32_t i = 0; i < sector_words; i++)
+        {
+            uint32_t how = HostRandom_Next(&rng) % 3;
+            sectors[sector][i] = (how == 0) ? 0xFFFFFFFFUL : (how == 1) ? sectors[sector][i]
+                    : sectors[sector][i] | HostRandom_Next(&rng);
+        }
+
+        return SETTINGS_ERROR_FLASH;
+    }
+
+    memset(sectors[sector], 0xFF, (size_t)sector_words * 4);
+    stats.erases[sector]++;
+    stats.busy_us += (uint64_t)sector_words * 4 / 1024 * HOST_FLASH_ERASE_US_PER_KIB;
+
+    return SETTINGS_SUCCESS;
+}
+
+settings_flash_t host_flash_settings =
+{ .sector_size = 0, .Sector = Sector, .Program = Program, .Erase = Erase };
+
+host_flash_ret_t HostFlash_Setup(uint32_t sector_size, uint32_t seed)
+{
+    if (sector_size == 0 || sector_size % 4 != 0)
+    {
+        return HOST_FLASH_ERROR_INVALID;
+    }
+
+    for (uint32_t sector = 0; sector < 2; sector++)
+    {
+        free(sectors[sector]);
+        sectors[sector] = malloc(sector_size);
+
+        if (sectors[sector] == NULL)
+        {
+            return HOST_FLASH_ERROR_GENERIC;
+        }
+
+        memset(sectors[sector], 0xFF, sector_size);
+    }
+
+    sector_words = sector_size / 4;
+    host_flash_settings.sector_size = sector_size;
+    rng = (seed != 0) ? seed : 1;
+    cut_after = 0;
+    cut_between = 0;
+    cut = 0;
+    memset(&stats, 0, sizeof(stats));
+
+    return HOST_FLASH_SUCCESS;
+}
+
+void HostFlash_CutAfter(uint32_t operations)
+{
+    cut_after = operations;
+    cut_between = 0;
+}
+
+void HostFlash_CutBetween(uint32_t operations)
+{
+    cut_after = operations;
+    cut_between = 1;
+}
+
+uint8_t HostFlash_IsCut(void)
+{
+    return cut;
+}
+
+void HostFlash_PowerOn(void)
+{
+    cut = 0;
+    cut_after = 0;
+    cut_between = 0;
+}
+
+void HostFlash_GetStats(host_flash_stats_t *out)
+{
+    if (out != NULL)
+    {
+        *out = stats;
+    }
+}
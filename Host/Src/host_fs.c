@@ -0,0 +1,131 @@
+/*
+ * host_fs.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#include "host_fs.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static const char *fs_root = ".";
+static uint8_t fs_open;
+
+fs_ret_t HostFS_SetRoot(const char *root)
+{
+    if (root == NULL)
+    {
+        return FS_ERROR_UNABLE_TO_INIT;
+    }
+
+    fs_root = root;
+
+    return FS_SUCCESS;
+}
+
+fs_ret_t HostFS_Open(fs_driver_t *fs)
+{
+    if (fs == NULL)
+    {
+        return FS_ERROR_UNABLE_TO_INIT;
+    }
+
+    // There's no card, so report something plausible
+    fs->block_size_b = 512;
+    fs->num_blocks = 0;
+    fs->fs_size_mb = 0;
+    fs_open = 1;
+
+    return FS_SUCCESS;
+}
+
+fs_ret_t HostFS_Close(void)
+{
+    fs_open = 0;
+
+    return FS_SUCCESS;
+}
+
+fs_ret_t HostFS_OpenFile(file_t *file, char *filename)
+{
+    if (!fs_open)
+    {
+        return FS_ERROR_UNINITIALIZED;
+    }
+
+    if (file == NULL || filename == NULL)
+    {
+        return FS_ERROR_UNABLE_TO_OPEN_FILE;
+    }
+
+    char path[HOST_FS_MAX_PATH];
+    int written = snprintf(path, sizeof(path), "%s/%s", fs_root, filename);
+
+    if (written < 0 || (size_t)written >= sizeof(path))
+    {
+        return FS_ERROR_UNABLE_TO_OPEN_FILE;
+    }
+
+    FILE *handle = fopen(path, "rb");
+
+    if (handle == NULL)
+    {
+        return FS_ERROR_UNABLE_TO_OPEN_FILE;
+    }
+
+    file->handle = handle;
+    file->filename = filename;
+
+    return FS_SUCCESS;
+}
+
+fs_ret_t HostFS_CloseFile(file_t *file)
+{
+    if (file == NULL || file->handle == NULL)
+    {
+        return FS_ERROR_UNABLE_TO_CLOSE_FILE;
+    }
+
+    int res = fclose((FILE *)file->handle);
+    file->handle = NULL;
+
+    return (res == 0) ? FS_SUCCESS : FS_ERROR_UNABLE_TO_CLOSE_FILE;
+}
+
+// Same contract as MicroSD_ReadFile: a short read at the end of the file isn't an error
+fs_ret_t HostFS_ReadFile(file_t *file, void *buffer, size_t length)
+{
+    if (file == NULL || file->handle == NULL || buffer == NULL)
+    {
+        return FS_ERROR_UNABLE_TO_READ_FILE;
+    }
+
+    FILE *handle = (FILE *)file->handle;
+    fread(buffer, 1, length, handle);
+
+    if (ferror(handle))
+    {
+        return FS_ERROR_UNABLE_TO_READ_FILE;
+    }
+
+    return FS_SUCCESS;
+}
+
+static fs_ret_t HostFS_SeekFile(file_t *file, uint64_t offset)
+{
+    if (file == NULL || file->handle == NULL || offset > INT64_MAX)
+    {
+        return FS_ERROR_UNABLE_TO_SEEK;
+    }
+
+    return (fseeko((FILE *)file->handle, (off_t)offset, SEEK_SET) == 0) ? FS_SUCCESS : FS_ERROR_UNABLE_TO_SEEK;
+}
+
+static const struct fs_operations fs_ops =
+{ .Open = HostFS_Open, .Close = HostFS_Close, .OpenFile = HostFS_OpenFile,
+        .CloseFile = HostFS_CloseFile, .ReadFile = HostFS_ReadFile, .SeekFile = HostFS_SeekFile };
+
+fs_driver_t host_fs_driver =
+{ .ops = &fs_ops };
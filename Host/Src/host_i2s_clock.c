@@ -0,0 +1,131 @@
+/*
+ * host_i2s_clock.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#include "host_i2s_clock.h"
+#include "i2s_clock.h"
+
+#include <string.h>
+#include <time.h>
+
+// Same as I2S_MAX_RATE_ERROR_PPM in i2s.c: any further off and I2S_Configure asks for resampling instead
+#define MAX_RATE_ERROR_PPM 250
+
+// Same as STANDARD_RATES in i2s_clock.c, and one that isn't in the table, which Lookup has to search for
+static const uint32_t RATES[] = { 8000, 11025, 16000, 22050, 32000, 44100, 48000, 88200, 96000, 37800 };
+
+#define NUM_RATES (sizeof(RATES) / sizeof(RATES[0]))
+
+static const uint32_t FRAME_BITS[] = { I2S_CLOCK_FRAME_16, I2S_CLOCK_FRAME_32 };
+
+static inline uint32_t AbsPPM(int32_t ppm)
+{
+    return (ppm < 0) ? (uint32_t)(-ppm) : (uint32_t)ppm;
+}
+
+// Whether the plan is one the hardware takes, and gives the rate it says it does
+static uint8_t IsConsistent(const i2s_clock_t *clock, uint32_t frame_bits, uint8_t mclk_output)
+{
+    uint64_t vco_hz = (uint64_t)HOST_I2S_CLOCK_INPUT_HZ * clock->plli2s_n;
+    uint64_t i2sclk_hz = vco_hz / clock->plli2s_r;
+    uint64_t k = mclk_output ? 256 : frame_bits;
+    uint64_t divider = 2 * (uint64_t)clock->i2s_div + clock->i2s_odd;
+
+    if (clock->plli2s_n < I2S_CLOCK_PLLN_MIN || clock->plli2s_n > I2S_CLOCK_PLLN_MAX
+            || clock->plli2s_r < I2S_CLOCK_PLLR_MIN || clock->plli2s_r > I2S_CLOCK_PLLR_MAX
+            || clock->i2s_div < I2S_CLOCK_DIV_MIN || vco_hz < I2S_CLOCK_VCO_MIN_HZ || vco_hz > I2S_CLOCK_VCO_MAX_HZ
+            || i2sclk_hz > I2S_CLOCK_I2SCLK_MAX_HZ)
+    {
+        return 0;
+    }
+
+    uint64_t actual_mhz = (i2sclk_hz * 1000) / (k * divider);
+    int64_t error_ppm = (((int64_t)actual_mhz - (int64_t)clock->sample_rate * 1000) * 1000000)
+            / ((int64_t)clock->sample_rate * 1000);
+
+    return actual_mhz == clock->actual_rate_mhz && error_ppm == clock->error_ppm;
+}
+
+static int CheckTable(uint8_t mclk_output, FILE *out)
+{
+    int failed = 0;
+
+    if (I2SClock_BuildTable(HOST_I2S_CLOCK_INPUT_HZ, mclk_output) != I2S_CLOCK_SUCCESS)
+    {
+        fprintf(out, "[i2s_clock] no table for a %u Hz input%s\n", HOST_I2S_CLOCK_INPUT_HZ,
+                mclk_output ? " with MCLK" : "");
+        return 1;
+    }
+
+    for (uint32_t f = 0; f < sizeof(FRAME_BITS) / sizeof(FRAME_BITS[0]); f++)
+    {
+        fprintf(out, "[i2s_clock] %u-bit frames%s, ppm off:", FRAME_BITS[f], mclk_output ? " with MCLK" : "");
+
+        for (uint32_t i = 0; i < NUM_RATES; i++)
+        {
+            i2s_clock_t computed;
+            i2s_clock_t looked_up;
+            i2s_clock_ret_t res = I2SClock_Compute(HOST_I2S_CLOCK_INPUT_HZ, RATES[i], FRAME_BITS[f], mclk_output,
+                    &computed);
+
+            if (res != I2S_CLOCK_SUCCESS || I2SClock_Lookup(RATES[i], FRAME_BITS[f], &looked_up) != I2S_CLOCK_SUCCESS)
+            {
+                fprintf(out, "\n[i2s_clock] %u Hz: no plan (%d)\n", RATES[i], res);
+                failed = 1;
+                continue;
+            }
+
+            // Over the limit isn't wrong, it's a rate that gets resampled: only said so
+            fprintf(out, " %u Hz %+d%s", RATES[i], computed.error_ppm,
+                    (AbsPPM(computed.error_ppm) > MAX_RATE_ERROR_PPM) ? " (resampled)" : "");
+
+            if (memcmp(&computed, &looked_up, sizeof(computed)) != 0)
+            {
+                fprintf(out, "\n[i2s_clock] %u Hz: the table's plan isn't the one computed", RATES[i]);
+                failed = 1;
+            }
+
+            if (!IsConsistent(&computed, FRAME_BITS[f], mclk_output))
+            {
+                fprintf(out, "\n[i2s_clock] %u Hz: N %u, R %u, DIV %u, ODD %u isn't a clock that gives %d ppm",
+                        RATES[i], computed.plli2s_n, computed.plli2s_r, computed.i2s_div, computed.i2s_odd,
+                        computed.error_ppm);
+                failed = 1;
+            }
+        }
+
+        fprintf(out, "\n");
+    }
+
+    return failed;
+}
+
+int HostI2SClock_Benchmark(FILE *out)
+{
+    i2s_clock_t clock;
+    struct timespec start;
+    struct timespec end;
+
+    // Nothing to look up in before the table's built
+    int failed = (I2SClock_Lookup(44100, I2S_CLOCK_FRAME_16, &clock) != I2S_CLOCK_ERROR_TABLE_NOT_BUILT);
+
+    failed |= CheckTable(1, out);
+    failed |= CheckTable(0, out);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (uint32_t i = 0; i < HOST_I2S_CLOCK_BUILDS; i++)
+    {
+        I2SClock_BuildTable(HOST_I2S_CLOCK_INPUT_HZ, 0);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    fprintf(out, "[i2s_clock] building the table: %.1f us here\n", ((double)(end.tv_sec - start.tv_sec) * 1e6
+            + (double)(end.tv_nsec - start.tv_nsec) / 1e3) / HOST_I2S_CLOCK_BUILDS);
+
+    return failed;
+}
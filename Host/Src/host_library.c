@@ -0,0 +1,503 @@
+/*
+ * host_library.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#include "host_library.h"
+#include "blk.h"
+#include "ff.h"
+#include "host_fatfs.h"
+#include "host_random.h"
+#include "library.h"
+#include "wav.h"
+
+#include <ctype.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+// A generated card: FAT32, 4 KiB clusters (so a track is one cluster), like a small SDHC card
+#define CARD_CLUSTER_B 4096
+
+// Per track: 10 ms of 44.1 kHz 16-bit stereo
+#define TRACK_RATE 44100
+#define TRACK_CHANNELS 2
+#define TRACK_BITS 16
+#define TRACK_FRAMES 441
+
+static const char *const SYLLABLES[] =
+{
+    "ka", "lo", "mi", "ne", "ru", "sa", "to", "vi", "ba", "de", "fo", "gu", "ha", "ji", "ko", "la",
+    "me", "no", "pi", "qua", "re", "si", "tu", "ve", "wa", "xe", "yo", "zu", "bri", "cha", "dro", "sta"
+};
+
+// The same card for the same track count, every time
+static uint32_t seed;
+
+// words capitalized words of 1 to 3 syllables
+static void MakeName(char *name, uint32_t words)
+{
+    name[0] = '\0';
+
+    for (uint32_t w = 0; w < words; w++)
+    {
+        char *word = name + strlen(name);
+
+        if (w > 0)
+        {
+            *word++ = ' ';
+            *word = '\0';
+        }
+
+        for (uint32_t s = HostRandom_Next(&seed) % 3 + 1; s > 0; s--)
+        {
+            strcat(word, SYLLABLES[HostRandom_Next(&seed) % (sizeof(SYLLABLES) / sizeof(SYLLABLES[0]))]);
+        }
+
+        word[0] = (char)(word[0] - 'a' + 'A');
+    }
+}
+
+static uint8_t *Put32(uint8_t *p, uint32_t value)
+{
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+    p[2] = (uint8_t)(value >> 16);
+    p[3] = (uint8_t)(value >> 24);
+
+    return p + 4;
+}
+
+static uint8_t *Put16(uint8_t *p, uint16_t value)
+{
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+
+    return p + 2;
+}
+
+// An INFO sub-chunk: NUL-terminated, padded to even
+static uint8_t *PutInfo(uint8_t *p, const char *id, const char *text)
+{
+    uint32_t length = (uint32_t)strlen(text) + 1;
+
+    memcpy(p, id, 4);
+    p = Put32(p + 4, length);
+    memcpy(p, text, length);
+    p += length;
+
+    if (length & 1)
+    {
+        *p++ = 0;
+    }
+
+    return p;
+}
+
+// RIFF, fmt, LIST INFO, then data (silence): tags before the audio, where Library_Build looks for them
+static uint32_t MakeTrack(uint8_t *wav, const char *title, const char *artist, const char *album, uint32_t number)
+{
+    uint32_t data_b = TRACK_FRAMES * TRACK_CHANNELS * (TRACK_BITS / 8);
+    char track[8];
+    uint8_t *p = wav + 12;
+
+    snprintf(track, sizeof(track), "%u", number);
+
+    memcpy(p, "fmt ", 4);
+    p = Put32(p + 4, 16);
+    p = Put16(p, 1);
+    p = Put16(p, TRACK_CHANNELS);
+    p = Put32(p, TRACK_RATE);
+    p = Put32(p, TRACK_RATE * TRACK_CHANNELS * (TRACK_BITS / 8));
+    p = Put16(p, TRACK_CHANNELS * (TRACK_BITS / 8));
+    p = Put16(p, TRACK_BITS);
+
+    uint8_t *list = p;
+
+    memcpy(p, "LIST", 4);
+    memcpy(p + 8, "INFO", 4);
+    p = PutInfo(p + 12, "INAM", title);
+    p = PutInfo(p, "IART", artist);
+    p = PutInfo(p, "IPRD", album);
+    p = PutInfo(p, "ITRK", track);
+    Put32(list + 4, (uint32_t)(p - list - 8));
+
+    memcpy(p, "data", 4);
+    p = Put32(p + 4, data_b);
+    memset(p, 0, data_b);
+    p += data_b;
+
+    memcpy(wav, "RIFF", 4);
+    Put32(wav + 4, (uint32_t)(p - wav - 8));
+    memcpy(wav + 8, "WAVE", 4);
+
+    return (uint32_t)(p - wav);
+}
+
+static double Seconds(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (double)(now.tv_sec - start->tv_sec) + (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static int WriteTrack(fs_driver_t *fs, char *path, const char *title, const char *artist, const char *album,
+        uint32_t number)
+{
+    static uint8_t wav[4096];
+    uint32_t length = MakeTrack(wav, title, artist, album, number);
+    file_t file;
+
+    if (fs->ops->CreateFile(&file, path) != FS_SUCCESS)
+    {
+        return 1;
+    }
+
+    fs_ret_t written = fs->ops->WriteFile(&file, wav, length);
+
+    return (fs->ops->CloseFile(&file) != FS_SUCCESS || written != FS_SUCCESS) ? 1 : 0;
+}
+
+int HostLibrary_MakeCard(fs_driver_t *fs, uint32_t tracks, FILE *out)
+{
+    static char path[LIBRARY_MAX_PATH];
+    char artist[CODEC_MAX_TAG];
+    char album[CODEC_MAX_TAG];
+    char title[CODEC_MAX_TAG];
+    struct timespec start;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    if (HostFatFS_Format(0, CARD_CLUSTER_B) != FS_SUCCESS || fs->ops->Open(fs) != FS_SUCCESS)
+    {
+        fprintf(out, "Unable to format the image\n");
+        return 1;
+    }
+
+    seed = 2463534242u;
+
+    for (uint32_t i = 0; i < tracks; i++)
+    {
+        uint32_t number = i % HOST_LIBRARY_ALBUM_TRACKS + 1;
+
+        if (i % (HOST_LIBRARY_ALBUM_TRACKS * HOST_LIBRARY_ARTIST_ALBUMS) == 0)
+        {
+            // Artists made up twice would be one folder: number them
+            MakeName(artist, 2);
+            snprintf(artist + strlen(artist), sizeof(artist) - strlen(artist), " %u",
+                    i / (HOST_LIBRARY_ALBUM_TRACKS * HOST_LIBRARY_ARTIST_ALBUMS));
+            snprintf(path, sizeof(path), "%s", artist);
+            f_mkdir(path);
+        }
+
+        if (i % HOST_LIBRARY_ALBUM_TRACKS == 0)
+        {
+            MakeName(album, 2);
+            snprintf(album + strlen(album), sizeof(album) - strlen(album), " %u",
+                    (i / HOST_LIBRARY_ALBUM_TRACKS) % HOST_LIBRARY_ARTIST_ALBUMS + 1);
+            snprintf(path, sizeof(path), "%s/%s", artist, album);
+            f_mkdir(path);
+        }
+
+        MakeName(title, HostRandom_Next(&seed) % 3 + 1);
+        snprintf(path, sizeof(path), "%s/%s/%02u %s.wav", artist, album, number, title);
+
+        if (WriteTrack(fs, path, title, artist, album, number) != 0)
+        {
+            fprintf(out, "Unable to write %s\n", path);
+            return 1;
+        }
+    }
+
+    fprintf(out, "[library] made a card of %u tracks in %.1f s\n", tracks, Seconds(&start));
+
+    return 0;
+}
+
+static void PrintBlkDelta(FILE *out, const char *what, const blk_stats_t *before, const sd_model_t *model,
+        uint64_t busy_before, double wall_s)
+{
+    blk_stats_t after;
+    Blk_GetStats(&after);
+
+    fprintf(out, "[library] %s: %.3f s host, %u requests, %u transfers, %llu blocks", what, wall_s,
+            after.requests - before->requests, after.transfers - before->transfers,
+            (unsigned long long)(after.blocks - before->blocks));
+
+    if (model != NULL)
+    {
+        fprintf(out, ", %.3f s card", (double)(model->stats.busy_us - busy_before) / 1e6);
+    }
+
+    fprintf(out, "\n");
+}
+
+static int Update(const char *what, uint8_t *work, uint32_t work_b, const sd_model_t *model, FILE *out)
+{
+    library_stats_t stats;
+    blk_stats_t before;
+    uint64_t busy_before = (model != NULL) ? model->stats.busy_us : 0;
+    struct timespec start;
+
+    Blk_GetStats(&before);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    library_ret_t res = Library_Update(work, work_b, &stats);
+
+    PrintBlkDelta(out, what, &before, model, busy_before, Seconds(&start));
+
+    if (res != LIBRARY_SUCCESS)
+    {
+        fprintf(out, "Unable to update the library (%d)\n", res);
+        return 1;
+    }
+
+    fprintf(out, "[library] %u tracks in %u folders: %u folders changed, %u tracks kept, %u skipped\n",
+            stats.tracks, stats.dirs, stats.changed_dirs, stats.reused, stats.skipped);
+
+    return 0;
+}
+
+// Like a PC would: the album halfway through the library gets a track retagged (a longer title, so a different
+// size: without a clock, FatFs timestamps are all the same) and a track more
+static int ChangeAlbum(fs_driver_t *fs, FILE *out)
+{
+    static char path[LIBRARY_MAX_PATH];
+    library_track_t track;
+    uint32_t index = Library_Count() / 2;
+
+    if (Library_GetPath(index, path, sizeof(path)) != LIBRARY_SUCCESS
+            || Library_GetTrack(index, &track) != LIBRARY_SUCCESS)
+    {
+        return 1;
+    }
+
+    // Not while the index is open: the update replaces it
+    Library_Close();
+
+    char *name = strrchr(path, '/');
+
+    if (WriteTrack(fs, path, "Retagged, With A Longer Title", track.artist, track.album, track.track_number) != 0
+            || name == NULL)
+    {
+        return 1;
+    }
+
+    snprintf(name, sizeof(path) - (size_t)(name - path), "/99 Bonus Track.wav");
+
+    if (WriteTrack(fs, path, "Bonus Track", track.artist, track.album, 99) != 0)
+    {
+        return 1;
+    }
+
+    *name = '\0';
+    fprintf(out, "[library] changed %s\n", path);
+
+    return 0;
+}
+
+// Searches, as if typed: the sector reads and card time each took, and that what came back is right
+static int Search(const char *what, char (*prefixes)[CODEC_MAX_TAG], uint32_t count, uint8_t must_find,
+        const sd_model_t *model, FILE *out)
+{
+    uint32_t results[HOST_LIBRARY_SCREEN];
+    uint32_t requests = 0;
+    uint32_t max_requests = 0;
+    uint32_t found_total = 0;
+    uint64_t busy_us = 0;
+    double wall_s = 0;
+
+    for (uint32_t q = 0; q < count; q++)
+    {
+        const char *prefix = prefixes[q];
+        uint64_t busy_before = (model != NULL) ? model->stats.busy_us : 0;
+        blk_stats_t before, after;
+        struct timespec start;
+        uint32_t found;
+
+        Blk_GetStats(&before);
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        library_ret_t res = Library_Search(prefix, 0, results, HOST_LIBRARY_SCREEN, &found);
+
+        wall_s += Seconds(&start);
+        Blk_GetStats(&after);
+        busy_us += (model != NULL) ? model->stats.busy_us - busy_before : 0;
+        requests += after.requests - before.requests;
+        max_requests = (after.requests - before.requests > max_requests) ? after.requests - before.requests
+                : max_requests;
+        found_total += found;
+
+        if (res != LIBRARY_SUCCESS || (must_find && found == 0) || (!must_find && found != 0))
+        {
+            fprintf(out, "Search for \"%s\": %d, %u found\n", prefix, res, found);
+            return 1;
+        }
+
+        // In title order, and every one of them a match
+        char last[CODEC_MAX_TAG] = "";
+
+        for (uint32_t i = 0; i < found; i++)
+        {
+            library_track_t track;
+
+            if (Library_GetTrack(results[i], &track) != LIBRARY_SUCCESS
+                    || strncasecmp(track.title, prefix, strlen(prefix)) != 0 || strcasecmp(last, track.title) > 0)
+            {
+                fprintf(out, "Search for \"%s\": \"%s\" doesn't belong\n", prefix, track.title);
+                return 1;
+            }
+
+            snprintf(last, sizeof(last), "%s", track.title);
+        }
+    }
+
+    fprintf(out, "[library] search, %s: %u queries, %.1f requests avg (max %u), %.1f found avg, %.1f us host",
+            what, count, (double)requests / count, max_requests, (double)found_total / count, wall_s * 1e6 / count);
+
+    if (model != NULL)
+    {
+        fprintf(out, ", %.2f ms card", (double)busy_us / 1e3 / count);
+    }
+
+    fprintf(out, "\n");
+
+    return 0;
+}
+
+static int SearchTitles(const sd_model_t *model, FILE *out)
+{
+    static char prefixes[4][HOST_LIBRARY_QUERIES][CODEC_MAX_TAG];
+    static const char *const what[] = { "a letter", "three letters", "whole titles", "whole titles, lowercase" };
+    static const size_t sizes[] = { 1 + 1, 3 + 1, CODEC_MAX_TAG, CODEC_MAX_TAG };
+    library_track_t track;
+
+    for (uint32_t q = 0; q < HOST_LIBRARY_QUERIES; q++)
+    {
+        uint32_t index = (uint32_t)((uint64_t)Library_Count() * q / HOST_LIBRARY_QUERIES);
+
+        if (Library_GetTrack(index, &track) != LIBRARY_SUCCESS)
+        {
+            return 1;
+        }
+
+        for (uint32_t kind = 0; kind < 4; kind++)
+        {
+            snprintf(prefixes[kind][q], sizes[kind], "%s", track.title);
+        }
+
+        for (char *c = prefixes[3][q]; *c != '\0'; c++)
+        {
+            *c = (char)tolower((unsigned char)*c);
+        }
+    }
+
+    for (uint32_t kind = 0; kind < 4; kind++)
+    {
+        if (Search(what[kind], prefixes[kind], HOST_LIBRARY_QUERIES, 1, model, out) != 0)
+        {
+            return 1;
+        }
+    }
+
+    static char missing[1][CODEC_MAX_TAG] = { "Zzyzx" };
+
+    return Search("not there", missing, 1, 0, model, out);
+}
+
+int HostLibrary_Benchmark(fs_driver_t *fs, const sd_model_t *model, uint32_t work_b, FILE *out)
+{
+    static uint8_t work[16 * 1024 * 1024] __attribute__((aligned(4)));
+    library_stats_t stats;
+    blk_stats_t before;
+    uint64_t busy_before = (model != NULL) ? model->stats.busy_us : 0;
+    struct timespec start;
+
+    if (work_b > sizeof(work))
+    {
+        work_b = sizeof(work);
+    }
+
+    if (Library_Init(fs, &wav_codec) != LIBRARY_SUCCESS)
+    {
+        return 1;
+    }
+
+    // Indexing, as on a first boot
+    Blk_GetStats(&before);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    library_ret_t res = Library_Build(work, work_b, &stats);
+
+    PrintBlkDelta(out, "build", &before, model, busy_before, Seconds(&start));
+
+    if (res != LIBRARY_SUCCESS)
+    {
+        fprintf(out, "Unable to build the library (%d)\n", res);
+        return 1;
+    }
+
+    fprintf(out, "[library] %u tracks in %u folders, %u skipped, %u too deep, %u/%u views (%u runs sorted on the "
+            "card, %u merge passes)\n", stats.tracks, stats.dirs, stats.skipped, stats.too_deep, stats.views,
+            LIBRARY_NUM_VIEWS, stats.sort_runs, stats.sort_passes);
+    fprintf(out, "[library] index %u B: strings %u B, paths %u B (%.1f B a track), search %u B (%.1f B a track)\n",
+            stats.index_b, stats.strings_b, stats.paths_b, stats.tracks ? (double)stats.paths_b / stats.tracks : 0.0,
+            stats.search_b, stats.tracks ? (double)stats.search_b / stats.tracks : 0.0);
+
+    // A boot with the index there: mount, open it, list the first screen
+    Library_Close();
+    fs->ops->Close();
+
+    // The mount starts the block layer over, stats and all
+    busy_before = (model != NULL) ? model->stats.busy_us : 0;
+    memset(&before, 0, sizeof(before));
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    if (fs->ops->Open(fs) != FS_SUCCESS || Library_Open() != LIBRARY_SUCCESS)
+    {
+        fprintf(out, "Unable to open the library\n");
+        return 1;
+    }
+
+    library_track_t screen[HOST_LIBRARY_SCREEN];
+    uint32_t shown = 0;
+
+    for (; shown < HOST_LIBRARY_SCREEN && shown < Library_Count(); shown++)
+    {
+        uint32_t index = shown;
+
+        // Walk order if there's no view
+        Library_GetViewEntry(LIBRARY_VIEW_ARTIST, shown, &index);
+
+        if (Library_GetTrack(index, &screen[shown]) != LIBRARY_SUCCESS)
+        {
+            fprintf(out, "Unable to read track %u\n", index);
+            return 1;
+        }
+    }
+
+    PrintBlkDelta(out, "boot to browsable", &before, model, busy_before, Seconds(&start));
+
+    for (uint32_t i = 0; i < shown; i++)
+    {
+        fprintf(out, "[library]   %s - %s - %02u %s (%u.%03u s)\n", screen[i].artist, screen[i].album,
+                screen[i].track_number, screen[i].title, screen[i].duration_ms / 1000, screen[i].duration_ms % 1000);
+    }
+
+    if (stats.views == LIBRARY_NUM_VIEWS && SearchTitles(model, out) != 0)
+    {
+        return 1;
+    }
+
+    // Re-indexing: with nothing changed, then with one album changed
+    if (Update("re-index, nothing changed", work, work_b, model, out) != 0 || ChangeAlbum(fs, out) != 0
+            || Update("re-index, one album changed", work, work_b, model, out) != 0)
+    {
+        return 1;
+    }
+
+    return 0;
+}
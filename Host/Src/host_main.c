@@ -0,0 +1,913 @@
+/*
+ * host_main.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+/*
+ * Runs the playback pipeline on a PC: WAV file in, through the player (format negotiation, conversion, dither),
+ * and out to another WAV file through the host audio sink.
+ * Or, with -record, the record pipeline: a WAV file on the PC stands in for line-in, and goes through the recorder
+ * into a new file on a disk image.
+ *
+ * HOST_BUILD swaps the Cortex-M bits for host_cortex.h (see cycles.h),
+ * and Host/Inc has to come before FATFS/Target for the FatFs configuration (see Host/Inc/ffconf.h):
+ *
+ *   gcc -O2 -DHOST_BUILD -DSTM32F401xE -IHost/Inc -ICore/Inc -IFATFS/Target -IMiddlewares/Third_Party/FatFs/src \
+ *       -IDrivers/STM32F4xx_HAL_Driver/Inc -IDrivers/CMSIS/Device/ST/STM32F4xx/Include -IDrivers/CMSIS/Include \
+ *       Host/Src/host_*.c Host/Src/sd_model.c Host/Src/sdio_mock.c Core/Src/sd_ll.c Core/Src/blk.c \
+ *       Core/Src/player.c Core/Src/format.c Core/Src/pcm.c Core/Src/ring.c Core/Src/meter.c Core/Src/wav.c \
+ *       Core/Src/sd_profile.c Core/Src/crc32.c Core/Src/depth.c Core/Src/recorder.c Core/Src/library.c \
+ *       Core/Src/shuffle.c Core/Src/extsort.c Core/Src/playlist.c Core/Src/bookmark.c Core/Src/settings.c \
+ *       Core/Src/i2s_clock.c \
+ *       Middlewares/Third_Party/FatFs/src/ff.c Middlewares/Third_Party/FatFs/src/ff_gen_drv.c \
+ *       Middlewares/Third_Party/FatFs/src/diskio.c Middlewares/Third_Party/FatFs/src/option/ccsbcs.c \
+ *       -lm -o muPod-host
+ *
+ *   ./muPod-host [-b] [-i2s] [-img card.img [-sd] [-trace card.trace] [-stall ppm] [-sdio [-nocmd23]]
+ *                [-scan [-noadmit]] [-record [-reserve s]]] [-ring KiB] [-budget KiB] [-underrun ppm]
+ *                [-seek frame] input.wav output.wav
+ *   ./muPod-host -img card.img [-sd] [-sdio] [-mklib tracks] -index [-work KiB]
+ *   ./muPod-host -img card.img [-sd] [-sdio] -dirs
+ *   ./muPod-host -img card.img [-sd] [-sdio] -sort [-work KiB]
+ *   ./muPod-host -img card.img [-sd] [-sdio] [-mklib tracks] -playlist [-work KiB]
+ *   ./muPod-host -img card.img [-sd] [-sdio] -bookmark
+ *   ./muPod-host -shuffle
+ *   ./muPod-host -dither
+ *   ./muPod-host -i2sclock
+ *   ./muPod-host -settings
+ *
+ *   -b          benchmark: don't wait for the simulated sample clock (or the simulated card)
+ *   -i2s        only advertise what the I2S driver takes, to get the same plan as the board
+ *   -img        read input.wav from a FAT/exFAT disk image through FatFs instead of from the PC's file system
+ *   -sd         make the image as slow as an SD card, see sd_model.h
+ *   -trace      replay latencies captured on a real card instead of the model (implies -sd)
+ *   -stall      housekeeping stall probability per command, in ppm (implies -sd)
+ *   -sdio       go through the low-level SDIO driver and a register mock of the card, see sdio_mock.h
+ *   -nocmd23    make the mock card one without CMD23, so multi-block transfers need CMD12 (implies -sdio)
+ *   -scan       while playing, keep reading every file in the image's root in the background (idle I/O class),
+ *               a step per main loop pass, like a library scan would
+ *   -noadmit    don't ask the block layer before each scan step, to see what that costs the stream
+ *   -record     record input.wav (from the PC) into output.wav on the image, captured at the sample clock
+ *               (or as fast as the recorder takes it, with -b). Capture goes on while writes wait on the card,
+ *               like the DMA would, and every sample that doesn't fit in the ring is counted. To check the result,
+ *               play output.wav back from the image.
+ *   -reserve    seconds to allocate for the recording up front (default: as long as input.wav)
+ *   -ring       output ring size in KiB, a power of two (default 8), e.g., to make room for the model's stalls.
+ *               The most the player will use: how much it does use depends on the reads, see depth.h.
+ *               With -record, the capture ring (default 64)
+ *   -budget     RAM for the ring and the block layer's read-ahead together, in KiB (default: both in full)
+ *   -underrun   underruns per million reads to size the ring for (default DEPTH_DEFAULT_TARGET_PPM)
+ *   -seek       start playing this many frames into input.wav, the way a resumed bookmark does (Player_Seek).
+ *               output.wav is then input.wav from there on, to the sample.
+ *   -mklib      replace whatever's on the image with a generated card of this many tracks, see host_library.h
+ *   -index      index the image's library (library.h), then time a boot that opens the index and lists a screenful,
+ *               title searches, and re-indexing, before and after one album changes
+ *   -work       work buffer for the index or -sort, in KiB (default 1024; the board has its 32 KiB output ring)
+ *   -dirs       replace whatever's on the image with folders of more and more files, and time opening files
+ *               in them, see host_dirs.h
+ *   -sort       replace whatever's on the image with nothing, and time sorting more and more records on it, with the
+ *               board's work buffer and with -work, see host_sort.h
+ *   -playlist   write the image's library (indexed first, if it isn't) into long M3U and PLS playlists and a short
+ *               one, and time opening them and going from track to track, see host_playlist.h
+ *   -bookmark   save bookmarks over and over, and boot, with and without the last save torn, see host_bookmark.h
+ *   -shuffle    check shuffle play's passes over libraries of all sizes, and time its steps, see host_shuffle.h
+ *   -dither     dither and noise shaping on a quiet sine and on silence: where the error's noise goes, and what the
+ *               conversion costs, see host_dither.h
+ *   -i2sclock   plan the I2S clock for every standard rate from the board's PLL input, and check the plans, see
+ *               host_i2s_clock.h
+ *   -settings   run the settings store on RAM-backed flash, with and without the power cut, see host_settings.h
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "blk.h"
+#include "depth.h"
+#include "host_audio.h"
+#include "host_bookmark.h"
+#include "host_cortex.h"
+#include "host_dirs.h"
+#include "host_disk.h"
+#include "host_dither.h"
+#include "host_fatfs.h"
+#include "host_fs.h"
+#include "host_i2s_clock.h"
+#include "host_library.h"
+#include "host_playlist.h"
+#include "host_settings.h"
+#include "host_shuffle.h"
+#include "host_sort.h"
+#include "ff.h"
+#include "meter.h"
+#include "player.h"
+#include "recorder.h"
+#include "wav.h"
+
+#define OUTPUT_RING_SIZE 8192
+#define CAPTURE_RING_SIZE 65536
+#define MAX_RING_SIZE (1024 * 1024)
+#define SCAN_STEP_BYTES 4096
+#define LIBRARY_WORK_SIZE (1024 * 1024)
+
+// Capture arrives this many frames at a time, like half of a circular DMA buffer
+#define CAPTURE_DMA_FRAMES 256
+
+// Same as I2S_FORMATS in i2s.c
+static const audio_format_t I2S_FORMATS[] =
+{
+    { .sample_rate = AUDIO_RATE_ANY, .bits_per_sample = 16, .channels = 2, .packing = AUDIO_PACKING_S16 },
+    { .sample_rate = AUDIO_RATE_ANY, .bits_per_sample = 24, .channels = 2, .packing = AUDIO_PACKING_S24_IN_32 },
+    { .sample_rate = AUDIO_RATE_ANY, .bits_per_sample = 32, .channels = 2, .packing = AUDIO_PACKING_S32 },
+};
+
+host_core_debug_t host_core_debug;
+host_dwt_t host_dwt;
+uint32_t SystemCoreClock = 84000000;
+
+uint32_t HostCortex_Cycles(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    uint64_t ns = (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+
+    // Wraps like CYCCNT does, which is what Cycles_Now's users expect
+    return (uint32_t)((ns * (SystemCoreClock / 1000000)) / 1000);
+}
+
+static uint8_t output_ring_buffer[MAX_RING_SIZE] __attribute__((aligned(4)));
+static ring_t output_ring;
+
+// Background scan (-scan)
+static struct
+{
+    DIR dir;
+    FIL file;
+    uint8_t dir_open;
+    uint8_t file_open;
+    uint64_t bytes;
+    uint32_t steps;
+    uint32_t held_back;
+} scan;
+
+static uint8_t scan_buffer[SCAN_STEP_BYTES] __attribute__((aligned(4)));
+
+// Line-in (-record)
+static struct
+{
+    FILE *input;
+    uint64_t bytes_left;
+    uint32_t bytes_per_s;
+    uint32_t chunk;             // bytes per DMA interrupt
+    uint64_t delivered;
+    uint32_t max_late_us;       // longest an interrupt was late, i.e., capture was held up
+    uint8_t paced;
+    struct timespec start;
+} capture;
+
+static uint8_t capture_buffer[CAPTURE_DMA_FRAMES * 8];
+
+void Error_Handler(void)
+{
+    fprintf(stderr, "Error_Handler\n");
+    exit(1);
+}
+
+// One read of the scan: the next chunk of the current file, or on to the next file (from the top once done)
+static void ScanStep(fs_driver_t *fs, uint8_t admit)
+{
+    if (admit && !fs->ops->MayIssue(FS_IO_IDLE))
+    {
+        scan.held_back++;
+        return;
+    }
+
+    fs->ops->SetIOClass(FS_IO_IDLE, 0);
+    scan.steps++;
+
+    if (scan.file_open)
+    {
+        UINT read;
+
+        if (f_read(&scan.file, scan_buffer, SCAN_STEP_BYTES, &read) == FR_OK && read == SCAN_STEP_BYTES)
+        {
+            scan.bytes += read;
+            return;
+        }
+
+        scan.bytes += read;
+        f_close(&scan.file);
+        scan.file_open = 0;
+        return;
+    }
+
+    if (!scan.dir_open)
+    {
+        scan.dir_open = (f_opendir(&scan.dir, "") == FR_OK);
+        return;
+    }
+
+    FILINFO info;
+
+    if (f_readdir(&scan.dir, &info) != FR_OK || info.fname[0] == '\0')
+    {
+        f_closedir(&scan.dir);
+        scan.dir_open = 0;
+        return;
+    }
+
+    if (!(info.fattrib & AM_DIR))
+    {
+        scan.file_open = (f_open(&scan.file, info.fname, FA_READ) == FR_OK);
+    }
+}
+
+// Same as WhileCardBusy in main.c: keep the sink fed from the ring while a read waits on the card
+static void WhileCardBusy(void)
+{
+    Player_Pump();
+    Meter_Process();
+}
+
+static uint64_t ElapsedUs(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)(now.tv_sec - start->tv_sec) * 1000000 + (uint64_t)(now.tv_nsec / 1000)
+            - (uint64_t)(start->tv_nsec / 1000);
+}
+
+// The capture DMA's interrupts: every chunk that's due by the sample clock, handed to the recorder.
+// Without pacing (-b), as many as fit, so the recording's only as slow as the card.
+static void CaptureTick(void)
+{
+    uint64_t elapsed_us = capture.paced ? ElapsedUs(&capture.start) : 0;
+
+    while (capture.bytes_left > 0)
+    {
+        uint32_t length = (capture.bytes_left < capture.chunk) ? (uint32_t)capture.bytes_left : capture.chunk;
+
+        if (capture.paced)
+        {
+            // When this chunk was complete, at the sample clock
+            uint64_t due_us = ((capture.delivered + length) * 1000000) / capture.bytes_per_s;
+
+            if (due_us > elapsed_us)
+            {
+                return;
+            }
+
+            if (elapsed_us - due_us > capture.max_late_us)
+            {
+                capture.max_late_us = (uint32_t)(elapsed_us - due_us);
+            }
+        }
+        else if (Ring_Free(&output_ring) < length)
+        {
+            return;
+        }
+
+        if (fread(capture_buffer, 1, length, capture.input) != length)
+        {
+            capture.bytes_left = 0;
+            return;
+        }
+
+        // What doesn't fit is the recorder's to count
+        Recorder_Capture(capture_buffer, length);
+        capture.delivered += length;
+        capture.bytes_left -= length;
+    }
+}
+
+// Recording: what the DMA would do while a write waits on the card
+static void WhileRecording(void)
+{
+    CaptureTick();
+}
+
+// Record input (a WAV file on the PC) into output on the image, see -record
+static int Record(fs_driver_t *fs, const char *input, char *output, uint32_t reserve_s, uint8_t paced)
+{
+    static uint8_t header[WAV_MAX_HEADER_LEN];
+    wav_metadata_t metadata;
+    audio_format_t format;
+    uint64_t header_offset = 0;
+    uint64_t offset = 0;
+    size_t header_read = 0;
+    size_t header_len = WAV_HEADER_LEN;
+    codec_ret_t parsed = CODEC_NEED_MORE;
+
+    capture.input = fopen(input, "rb");
+
+    if (capture.input == NULL)
+    {
+        fprintf(stderr, "Unable to open %s\n", input);
+        return 1;
+    }
+
+    // Like Player_OpenTrack: as much of the header as the codec asks for
+    while (parsed == CODEC_NEED_MORE && header_len <= sizeof(header))
+    {
+        if (offset != header_offset)
+        {
+            if (fseeko(capture.input, (off_t)offset, SEEK_SET) != 0)
+            {
+                break;
+            }
+
+            header_offset = offset;
+            header_read = 0;
+        }
+
+        if (header_len <= header_read
+                || fread(header + header_read, 1, header_len - header_read, capture.input) != header_len - header_read)
+        {
+            break;
+        }
+
+        header_read = header_len;
+        parsed = wav_codec.ValidateHeader(header, &metadata, &offset, &header_len);
+    }
+
+    if (parsed != CODEC_SUCCESS || wav_codec.GetFormat(&metadata, &format) != CODEC_SUCCESS)
+    {
+        fprintf(stderr, "%s isn't a WAV file we can read\n", input);
+        fclose(capture.input);
+        return 1;
+    }
+
+    uint32_t frame_bytes = Audio_BytesPerFrame(&format);
+
+    capture.bytes_left = metadata.data_size - (metadata.data_size % frame_bytes);
+    capture.bytes_per_s = format.sample_rate * frame_bytes;
+    capture.chunk = CAPTURE_DMA_FRAMES * frame_bytes;
+    capture.delivered = 0;
+    capture.max_late_us = 0;
+    capture.paced = paced;
+
+    if (reserve_s == 0)
+    {
+        reserve_s = (uint32_t)(capture.bytes_left / capture.bytes_per_s) + 1;
+    }
+
+    if (Recorder_Init(fs, &wav_codec, &output_ring) != RECORDER_SUCCESS)
+    {
+        fprintf(stderr, "The capture ring has to be at least %u KiB\n", 2 * RECORDER_WRITE_BYTES / 1024);
+        fclose(capture.input);
+        return 1;
+    }
+
+    recorder_ret_t res = Recorder_Start(output, &format, reserve_s);
+
+    if (res != RECORDER_SUCCESS)
+    {
+        fprintf(stderr, "Unable to record to %s (%d)\n", output, res);
+        fclose(capture.input);
+        return 1;
+    }
+
+    fprintf(stderr, "Recording %u Hz, %u-bit x%u to %s\n", format.sample_rate, format.bits_per_sample,
+            format.channels, output);
+
+    Blk_SetYield(WhileRecording);
+    clock_gettime(CLOCK_MONOTONIC, &capture.start);
+
+    while (capture.bytes_left > 0 && res == RECORDER_SUCCESS)
+    {
+        CaptureTick();
+        res = Recorder_Service();
+    }
+
+    recorder_ret_t stopped = Recorder_Stop();
+    Blk_SetYield(NULL);
+    fclose(capture.input);
+
+    recorder_stats_t stats;
+    Recorder_GetStats(&stats);
+
+    fprintf(stderr, "[record] %llu B of audio in %u writes, avg %u us, max %u us, %u errors, %llu KiB reserved\n",
+            (unsigned long long)stats.bytes, stats.writes, stats.avg_write_us, stats.max_write_us,
+            stats.write_errors, (unsigned long long)(stats.reserved_b / 1024));
+    fprintf(stderr, "[record] ring %u KiB, at most %u B used, %u overruns (%llu B dropped), capture late %u us\n",
+            stats.ring_b / 1024, stats.max_used_b, stats.overruns, (unsigned long long)stats.dropped_b,
+            capture.max_late_us);
+
+    if (res != RECORDER_SUCCESS || stopped != RECORDER_SUCCESS)
+    {
+        fprintf(stderr, "Recording failed (%d, %d)\n", res, stopped);
+        return 1;
+    }
+
+    return (stats.overruns == 0) ? 0 : 2;
+}
+
+static void PrintSDModelStats(FILE *out, const sd_model_t *sd_model)
+{
+    fprintf(out, "[sd_model] %llu commands, %llu blocks, %llu us busy, %llu us worst, %u stalls\n",
+            (unsigned long long)sd_model->stats.commands, (unsigned long long)sd_model->stats.blocks,
+            (unsigned long long)sd_model->stats.busy_us, (unsigned long long)sd_model->stats.max_us,
+            sd_model->stats.stalls);
+}
+
+// What the board dumps over the UART (see PrintDepthStats in main.c), all at once
+static void PrintDepthStats(FILE *out)
+{
+    depth_stats_t stats;
+
+    if (Depth_GetStats(&stats) != DEPTH_SUCCESS)
+    {
+        return;
+    }
+
+    fprintf(out, "[depth] ring %u B (needs %u), read-ahead %u B, sized for %u us, risk %u ppm\n", stats.ring_b,
+            stats.needed_b, stats.readahead_b, stats.latency_us, stats.risk_ppm);
+    fprintf(out, "[depth] %u reads, max %u us, %u grows, %u shrinks, %u read-ahead changes, %u capped\n",
+            stats.samples, stats.max_us, stats.grows, stats.shrinks, stats.readahead_changes, stats.caps);
+    fprintf(out, "[depth] histogram (us: reads):");
+
+    for (uint32_t b = 0; b < DEPTH_BUCKETS; b++)
+    {
+        if (stats.histogram[b] > 0)
+        {
+            fprintf(out, " %u: %u", 1U << b, stats.histogram[b]);
+        }
+    }
+
+    fprintf(out, "\n");
+
+    for (uint32_t i = 0; i < stats.logged; i++)
+    {
+        const depth_log_entry_t *entry = &stats.log[i];
+
+        fprintf(out, "[depth] read %u: %s, ring %u B, read-ahead %u B (%u us)\n", entry->sample,
+                Depth_DecisionName(entry->decision), entry->ring_b, entry->readahead_b, entry->latency_us);
+    }
+}
+
+// The meter's share of the CPU (see Meter_GetSnapshot), in the host's cycles: SystemCoreClock off the PC's clock
+static void PrintMeterStats(FILE *out)
+{
+    meter_snapshot_t snapshot;
+
+    if (Meter_GetSnapshot(&snapshot) != METER_SUCCESS)
+    {
+        return;
+    }
+
+    fprintf(out, "[meter] %u blocks (%u dropped), %u cycles a block on average, %u at most, "
+            "%u.%u%% of the CPU on average, %u.%u%% at most\n", snapshot.blocks, snapshot.dropped,
+            snapshot.avg_cycles, snapshot.max_cycles, snapshot.avg_cpu_permille / 10, snapshot.avg_cpu_permille % 10,
+            snapshot.max_cpu_permille / 10, snapshot.max_cpu_permille % 10);
+}
+
+static void Usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-b] [-i2s] input.wav output.wav\n", name);
+    fprintf(stderr, "       %s -img card.img [-sd] [-mklib tracks] -index [-work KiB]\n", name);
+    fprintf(stderr, "       %s -img card.img [-sd] -dirs\n", name);
+    fprintf(stderr, "       %s -img card.img [-sd] -sort [-work KiB]\n", name);
+    fprintf(stderr, "       %s -img card.img [-sd] [-mklib tracks] -playlist [-work KiB]\n", name);
+    fprintf(stderr, "       %s -img card.img [-sd] -bookmark\n", name);
+    fprintf(stderr, "       %s -shuffle\n", name);
+    fprintf(stderr, "       %s -dither\n", name);
+    fprintf(stderr, "       %s -i2sclock\n", name);
+    fprintf(stderr, "       %s -settings\n", name);
+}
+
+int main(int argc, char **argv)
+{
+    host_audio_mode_t mode = HOST_AUDIO_MODE_REALTIME;
+    uint8_t i2s_formats = 0;
+    const char *image = NULL;
+    const char *trace = NULL;
+    uint8_t sd_timing = 0;
+    uint8_t sdio = 0;
+    uint8_t cmd23 = 1;
+    uint8_t background_scan = 0;
+    uint8_t admit = 1;
+    uint8_t record = 0;
+    uint32_t reserve_s = 0;
+    uint32_t ring_size = 0;
+    uint32_t budget = 0;
+    uint32_t underrun_ppm = DEPTH_DEFAULT_TARGET_PPM;
+    uint32_t make_tracks = 0;
+    uint8_t index = 0;
+    uint32_t work_size = LIBRARY_WORK_SIZE;
+    uint8_t dirs = 0;
+    uint8_t sort = 0;
+    uint8_t shuffle = 0;
+    uint8_t dither = 0;
+    uint8_t i2s_clock = 0;
+    uint8_t settings = 0;
+    uint8_t playlist = 0;
+    uint8_t bookmark = 0;
+    uint64_t seek = 0;
+    sd_model_config_t sd_config;
+    int arg = 1;
+
+    SDModel_DefaultConfig(&sd_config);
+
+    for (; arg < argc && argv[arg][0] == '-'; arg++)
+    {
+        if (strcmp(argv[arg], "-b") == 0)
+        {
+            mode = HOST_AUDIO_MODE_BENCHMARK;
+        }
+        else if (strcmp(argv[arg], "-i2s") == 0)
+        {
+            i2s_formats = 1;
+        }
+        else if (strcmp(argv[arg], "-img") == 0 && arg + 1 < argc)
+        {
+            image = argv[++arg];
+        }
+        else if (strcmp(argv[arg], "-sd") == 0)
+        {
+            sd_timing = 1;
+        }
+        else if (strcmp(argv[arg], "-trace") == 0 && arg + 1 < argc)
+        {
+            trace = argv[++arg];
+            sd_timing = 1;
+        }
+        else if (strcmp(argv[arg], "-stall") == 0 && arg + 1 < argc)
+        {
+            sd_config.stall_ppm = (uint32_t)strtoul(argv[++arg], NULL, 10);
+            sd_timing = 1;
+        }
+        else if (strcmp(argv[arg], "-sdio") == 0)
+        {
+            sdio = 1;
+        }
+        else if (strcmp(argv[arg], "-nocmd23") == 0)
+        {
+            sdio = 1;
+            cmd23 = 0;
+        }
+        else if (strcmp(argv[arg], "-scan") == 0)
+        {
+            background_scan = 1;
+        }
+        else if (strcmp(argv[arg], "-noadmit") == 0)
+        {
+            background_scan = 1;
+            admit = 0;
+        }
+        else if (strcmp(argv[arg], "-record") == 0)
+        {
+            record = 1;
+        }
+        else if (strcmp(argv[arg], "-reserve") == 0 && arg + 1 < argc)
+        {
+            reserve_s = (uint32_t)strtoul(argv[++arg], NULL, 10);
+        }
+        else if (strcmp(argv[arg], "-ring") == 0 && arg + 1 < argc)
+        {
+            ring_size = (uint32_t)strtoul(argv[++arg], NULL, 10) * 1024;
+        }
+        else if (strcmp(argv[arg], "-budget") == 0 && arg + 1 < argc)
+        {
+            budget = (uint32_t)strtoul(argv[++arg], NULL, 10) * 1024;
+        }
+        else if (strcmp(argv[arg], "-underrun") == 0 && arg + 1 < argc)
+        {
+            underrun_ppm = (uint32_t)strtoul(argv[++arg], NULL, 10);
+        }
+        else if (strcmp(argv[arg], "-mklib") == 0 && arg + 1 < argc)
+        {
+            make_tracks = (uint32_t)strtoul(argv[++arg], NULL, 10);
+        }
+        else if (strcmp(argv[arg], "-index") == 0)
+        {
+            index = 1;
+        }
+        else if (strcmp(argv[arg], "-work") == 0 && arg + 1 < argc)
+        {
+            work_size = (uint32_t)strtoul(argv[++arg], NULL, 10) * 1024;
+        }
+        else if (strcmp(argv[arg], "-dirs") == 0)
+        {
+            dirs = 1;
+        }
+        else if (strcmp(argv[arg], "-sort") == 0)
+        {
+            sort = 1;
+        }
+        else if (strcmp(argv[arg], "-playlist") == 0)
+        {
+            playlist = 1;
+        }
+        else if (strcmp(argv[arg], "-bookmark") == 0)
+        {
+            bookmark = 1;
+        }
+        else if (strcmp(argv[arg], "-seek") == 0 && arg + 1 < argc)
+        {
+            seek = strtoull(argv[++arg], NULL, 10);
+        }
+        else if (strcmp(argv[arg], "-shuffle") == 0)
+        {
+            shuffle = 1;
+        }
+        else if (strcmp(argv[arg], "-dither") == 0)
+        {
+            dither = 1;
+        }
+        else if (strcmp(argv[arg], "-i2sclock") == 0)
+        {
+            i2s_clock = 1;
+        }
+        else if (strcmp(argv[arg], "-settings") == 0)
+        {
+            settings = 1;
+        }
+        else
+        {
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+
+    // Nothing but arithmetic
+    if (shuffle)
+    {
+        return (arg == argc) ? HostShuffle_Benchmark(stderr) : (Usage(argv[0]), 1);
+    }
+
+    if (dither)
+    {
+        return (arg == argc) ? HostDither_Benchmark(stderr) : (Usage(argv[0]), 1);
+    }
+
+    if (i2s_clock)
+    {
+        return (arg == argc) ? HostI2SClock_Benchmark(stderr) : (Usage(argv[0]), 1);
+    }
+
+    if (settings)
+    {
+        return (arg == argc) ? HostSettings_Benchmark(stderr) : (Usage(argv[0]), 1);
+    }
+
+    // Benchmarks of the card alone
+    uint8_t card_only = index || dirs || sort || playlist || bookmark;
+
+    // Nothing to wait for in real time
+    if (card_only)
+    {
+        mode = HOST_AUDIO_MODE_BENCHMARK;
+    }
+
+    if (ring_size == 0)
+    {
+        ring_size = record ? CAPTURE_RING_SIZE : OUTPUT_RING_SIZE;
+    }
+
+    if (argc - arg != (card_only ? 0 : 2) || ((background_scan || record || card_only) && image == NULL)
+            || ring_size > MAX_RING_SIZE)
+    {
+        Usage(argv[0]);
+        return 1;
+    }
+
+    // Input paths are taken as-is, so without an image the "card" is the current directory
+    fs_driver_t *fs = &host_fs_driver;
+    sd_model_t sd_model;
+
+    if (image != NULL)
+    {
+        if (sd_timing)
+        {
+            if (SDModel_Init(&sd_model, &sd_config) != SD_MODEL_SUCCESS)
+            {
+                Error_Handler();
+            }
+
+            if (trace != NULL && SDModel_LoadTrace(&sd_model, trace) != SD_MODEL_SUCCESS)
+            {
+                fprintf(stderr, "Unable to load trace %s\n", trace);
+                return 1;
+            }
+        }
+
+        // A generated card needs room for a cluster per track, and then some
+        if ((make_tracks > 0 || dirs || sort)
+                && HostDisk_CreateImage(image, (512ULL << 20) + (uint64_t)make_tracks * 8192) != HOST_DISK_SUCCESS)
+        {
+            fprintf(stderr, "Unable to create %s\n", image);
+            return 1;
+        }
+
+        // In benchmark mode the card's time is only added up, not slept
+        HostDisk_Setup(image, sd_timing ? &sd_model : NULL, mode == HOST_AUDIO_MODE_REALTIME);
+
+        if (sdio)
+        {
+            HostDisk_UseSDIO(cmd23, stderr);
+        }
+
+        fs = &host_fatfs_driver;
+    }
+
+    // Nothing to play: the card itself is what's measured, as fast as it goes
+    if (card_only)
+    {
+        int status = dirs ? HostDirs_Benchmark(fs, sd_timing ? &sd_model : NULL, stderr)
+                : sort ? HostSort_Benchmark(fs, sd_timing ? &sd_model : NULL, work_size, stderr)
+                : (make_tracks > 0) ? HostLibrary_MakeCard(fs, make_tracks, stderr)
+                : (fs->ops->Open(fs) == FS_SUCCESS) ? 0 : 1;
+
+        if (status == 0 && index)
+        {
+            status = HostLibrary_Benchmark(fs, sd_timing ? &sd_model : NULL, work_size, stderr);
+        }
+
+        if (status == 0 && playlist)
+        {
+            status = HostPlaylist_Benchmark(fs, sd_timing ? &sd_model : NULL, work_size, stderr);
+        }
+
+        if (status == 0 && bookmark)
+        {
+            status = HostBookmark_Benchmark(fs, sd_timing ? &sd_model : NULL, stderr);
+        }
+
+        fs->ops->Close();
+        HostDisk_PrintStats(stderr);
+
+        if (sd_timing)
+        {
+            PrintSDModelStats(stderr, &sd_model);
+            SDModel_Deinit(&sd_model);
+        }
+
+        return status;
+    }
+
+    if (Ring_Init(&output_ring, output_ring_buffer, ring_size) != RING_SUCCESS)
+    {
+        Usage(argv[0]);
+        return 1;
+    }
+
+    if (record)
+    {
+        if (fs->ops->Open(fs) != FS_SUCCESS)
+        {
+            Error_Handler();
+        }
+
+        if (sd_timing)
+        {
+            Blk_SetWorstLatency(sd_config.stall_max_us / 1000);
+        }
+
+        int status = Record(fs, argv[arg], argv[arg + 1], reserve_s, mode == HOST_AUDIO_MODE_REALTIME);
+
+        fs->ops->Close();
+        HostDisk_PrintStats(stderr);
+
+        if (sd_timing)
+        {
+            PrintSDModelStats(stderr, &sd_model);
+            SDModel_Deinit(&sd_model);
+        }
+
+        return status;
+    }
+
+    const codec_t *codec = &wav_codec;
+    const audio_driver_t *audio = &host_audio_driver;
+
+    HostAudio_Setup(argv[arg + 1], mode, stderr);
+
+    if (i2s_formats)
+    {
+        HostAudio_SetFormats(I2S_FORMATS, sizeof(I2S_FORMATS) / sizeof(I2S_FORMATS[0]));
+    }
+
+    if (fs->ops->Open(fs) != FS_SUCCESS || codec->Open() != CODEC_SUCCESS || audio->Open() != AUDIO_SUCCESS)
+    {
+        Error_Handler();
+    }
+
+    // What the profile's stall_us does on the board (see MicroSD_Open)
+    if (image != NULL && sd_timing)
+    {
+        Blk_SetWorstLatency(sd_config.stall_max_us / 1000);
+    }
+
+    // Sized by the reads as they come, like on the board
+    depth_config_t depth_config;
+    Depth_DefaultConfig(&depth_config, ring_size, BLK_STAGING_BLOCKS * BLK_BLOCK_SIZE);
+    depth_config.target_ppm = underrun_ppm;
+    depth_config.seed_us = (image != NULL && sd_timing) ? sd_config.stall_max_us : fs->stall_us;
+
+    if (budget > 0)
+    {
+        depth_config.budget_b = budget;
+    }
+
+    if (Depth_Init(&depth_config) != DEPTH_SUCCESS)
+    {
+        fprintf(stderr, "Invalid ring/budget/underrun\n");
+        return 1;
+    }
+
+    if (Player_Init(fs, codec, audio, &output_ring) != PLAYER_SUCCESS)
+    {
+        Error_Handler();
+    }
+
+    Blk_SetYield(WhileCardBusy);
+
+    player_ret_t res = Player_OpenTrack(argv[arg]);
+
+    if (res != PLAYER_SUCCESS)
+    {
+        fprintf(stderr, "Unable to open %s (%d)\n", argv[arg], res);
+        audio->Close();
+        return 1;
+    }
+
+    if (seek > 0 && (res = Player_Seek(seek)) != PLAYER_SUCCESS)
+    {
+        fprintf(stderr, "Unable to seek to frame %llu (%d)\n", (unsigned long long)seek, res);
+        Player_CloseTrack();
+        audio->Close();
+        return 1;
+    }
+
+    uint64_t position = 0;
+
+    if (seek > 0 && Player_GetPosition(&position) == PLAYER_SUCCESS)
+    {
+        fprintf(stderr, "Resuming at frame %llu\n", (unsigned long long)position);
+    }
+
+    format_plan_t plan;
+    Player_GetPlan(&plan, NULL);
+    fprintf(stderr, "%u Hz, %u-bit x%u -> %u-bit x%u, stages 0x%x, cost %u\n", plan.sink.sample_rate,
+            plan.source.bits_per_sample, plan.source.channels, plan.sink.bits_per_sample, plan.sink.channels,
+            plan.stages, plan.cost);
+
+    while (Player_IsPlaying())
+    {
+        res = Player_Service();
+
+        if (res != PLAYER_SUCCESS && res != PLAYER_ERROR_NO_TRACK)
+        {
+            fprintf(stderr, "Playback stopped (%d)\n", res);
+            break;
+        }
+
+        Meter_Process();
+
+        if (background_scan)
+        {
+            ScanStep(fs, admit);
+        }
+    }
+
+    if (scan.file_open)
+    {
+        f_close(&scan.file);
+    }
+
+    if (scan.dir_open)
+    {
+        f_closedir(&scan.dir);
+    }
+
+    audio->Close();
+    fs->ops->Close();
+
+    if (image != NULL)
+    {
+        HostDisk_PrintStats(stderr);
+        HostFatFS_PrintStats(stderr);
+    }
+
+    PrintDepthStats(stderr);
+    PrintMeterStats(stderr);
+
+    if (background_scan)
+    {
+        fprintf(stderr, "[scan] %u steps, %llu KiB read, held back %u times\n", scan.steps,
+                (unsigned long long)(scan.bytes / 1024), scan.held_back);
+    }
+
+    if (image != NULL && sd_timing)
+    {
+        PrintSDModelStats(stderr, &sd_model);
+        SDModel_Deinit(&sd_model);
+    }
+
+    return (res == PLAYER_SUCCESS || res == PLAYER_ERROR_NO_TRACK) ? 0 : 1;
+}
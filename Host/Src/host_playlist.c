@@ -0,0 +1,388 @@
+/*
+ * host_playlist.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#include "host_playlist.h"
+#include "blk.h"
+#include "library.h"
+#include "player.h"
+#include "playlist.h"
+#include "host_audio.h"
+#include "ring.h"
+#include "wav.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define LONG_M3U "ALL.M3U"
+#define SHORT_M3U "SHORT.M3U"
+#define PLS_NAME "MIX.PLS"
+
+#define STREAM_URL "http://radio.example/stream.mp3"
+
+// What a time is spent on, on the card and in all
+typedef struct
+{
+    blk_stats_t blk;
+    uint64_t busy_us;
+    struct timespec start;
+} mark_t;
+
+typedef struct
+{
+    uint32_t count;
+    double total_ms;
+    double max_ms;
+} latency_t;
+
+static const sd_model_t *card;
+
+static void Mark(mark_t *mark)
+{
+    Blk_GetStats(&mark->blk);
+    mark->busy_us = (card != NULL) ? card->stats.busy_us : 0;
+    clock_gettime(CLOCK_MONOTONIC, &mark->start);
+}
+
+// Since the mark, in ms: the card's time with a model, the host's without
+static double Elapsed(const mark_t *mark, uint32_t *requests)
+{
+    blk_stats_t now;
+    struct timespec end;
+
+    Blk_GetStats(&now);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if (requests != NULL)
+    {
+        *requests = now.requests - mark->blk.requests;
+    }
+
+    if (card != NULL)
+    {
+        return (double)(card->stats.busy_us - mark->busy_us) / 1e3;
+    }
+
+    return (double)(end.tv_sec - mark->start.tv_sec) * 1e3 + (double)(end.tv_nsec - mark->start.tv_nsec) / 1e6;
+}
+
+static void Add(latency_t *latency, double ms)
+{
+    latency->count++;
+    latency->total_ms += ms;
+    latency->max_ms = (ms > latency->max_ms) ? ms : latency->max_ms;
+}
+
+static void PrintLatency(FILE *out, const char *what, const latency_t *latency)
+{
+    fprintf(out, "[playlist]   %s: %.3f ms on average, %.3f ms at most (%u)\n", what,
+            latency->count ? latency->total_ms / latency->count : 0.0, latency->max_ms, latency->count);
+}
+
+/*
+ * Writing the playlists
+ */
+
+static int Write(fs_driver_t *fs, file_t *file, const char *text)
+{
+    return (fs->ops->WriteFile(file, text, strlen(text)) == FS_SUCCESS) ? 0 : 1;
+}
+
+// The path the way a PC might have written it: as it is, or with "./", a leading slash or a drive letter, and
+// backslashes
+static void Disguise(char *line, size_t size, const char *path, uint32_t i)
+{
+    static const char *const PREFIXES[] = { "", ".\\", "/", "C:\\" };
+
+    snprintf(line, size, "%s%s", PREFIXES[i % 4], path);
+
+    for (char *c = line; i % 2 == 1 && *c != '\0'; c++)
+    {
+        *c = (*c == '/') ? '\\' : *c;
+    }
+}
+
+static int WritePlaylists(fs_driver_t *fs, char (*paths)[LIBRARY_MAX_PATH], uint32_t count, char *pls, FILE *out)
+{
+    file_t m3u;
+    file_t pls_file;
+    file_t short_m3u;
+    char line[3 * LIBRARY_MAX_PATH];
+    char path[LIBRARY_MAX_PATH];
+    library_track_t track;
+    int status = 0;
+
+    if (fs->ops->CreateFile(&m3u, LONG_M3U) != FS_SUCCESS)
+    {
+        fprintf(out, "Unable to create %s\n", LONG_M3U);
+        return 1;
+    }
+
+    if (fs->ops->CreateFile(&pls_file, pls) != FS_SUCCESS)
+    {
+        fprintf(out, "Unable to create %s\n", pls);
+        fs->ops->CloseFile(&m3u);
+        return 1;
+    }
+
+    if (fs->ops->CreateFile(&short_m3u, SHORT_M3U) != FS_SUCCESS)
+    {
+        fprintf(out, "Unable to create %s\n", SHORT_M3U);
+        fs->ops->CloseFile(&m3u);
+        fs->ops->CloseFile(&pls_file);
+        return 1;
+    }
+
+    // A byte order mark, and Windows line ends, like a player on a PC would write it
+    status |= Write(fs, &m3u, "\xEF\xBB\xBF#EXTM3U\r\n");
+    status |= Write(fs, &pls_file, "[playlist]\n");
+    status |= Write(fs, &short_m3u, "#EXTM3U\n");
+
+    for (uint32_t i = 0, n = 1; i < count && status == 0; i++)
+    {
+        uint32_t index;
+
+        if (i % HOST_PLAYLIST_URL_EVERY == HOST_PLAYLIST_URL_EVERY - 1)
+        {
+            status |= Write(fs, &m3u, "# the radio\r\n#EXTINF:-1,Radio\r\n" STREAM_URL "\r\n");
+            snprintf(line, sizeof(line), "File%u=" STREAM_URL "\nTitle%u=Radio\nLength%u=-1\n", n, n, n);
+            status |= Write(fs, &pls_file, line);
+            n++;
+        }
+
+        if (Library_GetViewEntry(LIBRARY_VIEW_TITLE, i, &index) != LIBRARY_SUCCESS
+                || Library_GetTrack(index, &track) != LIBRARY_SUCCESS)
+        {
+            fprintf(out, "Unable to read entry %u of the title view\n", i);
+            status = 1;
+            break;
+        }
+
+        Disguise(path, sizeof(path), paths[i], i);
+        snprintf(line, sizeof(line), "#EXTINF:%u,%s - %s\r\n%s\r\n", track.duration_ms / 1000, track.artist,
+                track.title, path);
+        status |= Write(fs, &m3u, line);
+
+        snprintf(line, sizeof(line), "File%u=..%s%s\nTitle%u=%s\nLength%u=%u\n", n, (i % 2) ? "\\" : "/", paths[i],
+                n, track.title, n, track.duration_ms / 1000);
+        status |= Write(fs, &pls_file, line);
+        n++;
+
+        if (i < HOST_PLAYLIST_SHORT)
+        {
+            snprintf(line, sizeof(line), "%s\n", paths[i]);
+            status |= Write(fs, &short_m3u, line);
+        }
+    }
+
+    snprintf(line, sizeof(line), "NumberOfEntries=%u\nVersion=2\n", count + count / HOST_PLAYLIST_URL_EVERY);
+    status |= Write(fs, &pls_file, line);
+
+    status |= (fs->ops->CloseFile(&m3u) != FS_SUCCESS);
+    status |= (fs->ops->CloseFile(&pls_file) != FS_SUCCESS);
+    status |= (fs->ops->CloseFile(&short_m3u) != FS_SUCCESS);
+
+    if (status != 0)
+    {
+        fprintf(out, "Unable to write the playlists\n");
+    }
+
+    return status;
+}
+
+/*
+ * Playing them
+ */
+
+static int Check(const playlist_entry_t *entry, char (*paths)[LIBRARY_MAX_PATH], uint32_t position, FILE *out)
+{
+    if (strcmp(entry->path, paths[position]) != 0)
+    {
+        fprintf(out, "[playlist] entry %u: %s, should be %s\n", position, entry->path, paths[position]);
+        return 1;
+    }
+
+    return 0;
+}
+
+// Open the playlist and go through it to the end, and with prefetch, back a way from there
+static int Play(const char *name, char (*paths)[LIBRARY_MAX_PATH], uint32_t count, uint8_t prefetch, FILE *out)
+{
+    playlist_entry_t entry;
+    playlist_stats_t stats;
+    latency_t next = { 0 };
+    latency_t background = { 0 };
+    latency_t back = { 0 };
+    uint32_t requests;
+    uint32_t seen = 0;
+    mark_t mark;
+    playlist_ret_t res;
+
+    Mark(&mark);
+
+    if ((res = Playlist_Open(name)) != PLAYLIST_SUCCESS)
+    {
+        fprintf(out, "Unable to open %s (%d)\n", name, res);
+        return 1;
+    }
+
+    double open_ms = Elapsed(&mark, &requests);
+
+    fprintf(out, "[playlist] %s (%s), %s: open %.3f ms, %u requests\n", name,
+            (Playlist_Kind() == PLAYLIST_PLS) ? "PLS" : "M3U", prefetch ? "prefetch" : "no prefetch", open_ms,
+            requests);
+
+    for (;;)
+    {
+        // Between tracks, while one would be playing
+        if (prefetch)
+        {
+            uint32_t steps = 0;
+
+            Mark(&mark);
+
+            while ((res = Playlist_Service()) == PLAYLIST_SUCCESS)
+            {
+                steps++;
+            }
+
+            if (steps > 0)
+            {
+                Add(&background, Elapsed(&mark, NULL));
+            }
+        }
+
+        Mark(&mark);
+
+        if ((res = Playlist_Next(&entry)) != PLAYLIST_SUCCESS)
+        {
+            break;
+        }
+
+        Add(&next, Elapsed(&mark, NULL));
+
+        if (seen >= count || Check(&entry, paths, seen, out) != 0)
+        {
+            Playlist_Close();
+            return 1;
+        }
+
+        Player_DiscardPrepared(&entry.track);
+        seen++;
+    }
+
+    if (res != PLAYLIST_END || seen != count)
+    {
+        fprintf(out, "[playlist] %s: %u of %u entries came out (%d)\n", name, seen, count, res);
+        Playlist_Close();
+        return 1;
+    }
+
+    for (uint32_t i = 1; prefetch && i <= HOST_PLAYLIST_BACK && i < count; i++)
+    {
+        Mark(&mark);
+
+        if ((res = Playlist_Previous(&entry)) != PLAYLIST_SUCCESS)
+        {
+            fprintf(out, "[playlist] %s: no entry %u back from the end (%d)\n", name, i, res);
+            Playlist_Close();
+            return 1;
+        }
+
+        Add(&back, Elapsed(&mark, NULL));
+
+        if (Check(&entry, paths, count - 1 - i, out) != 0)
+        {
+            Playlist_Close();
+            return 1;
+        }
+
+        Player_DiscardPrepared(&entry.track);
+    }
+
+    Playlist_GetStats(&stats);
+    Playlist_Close();
+
+    PrintLatency(out, "next", &next);
+
+    if (prefetch)
+    {
+        PrintLatency(out, "getting the next ready, in the background", &background);
+        PrintLatency(out, "previous", &back);
+    }
+
+    fprintf(out, "[playlist]   %u entries, %u skipped, %u ready ahead, %u waited for, %u window reads\n",
+            stats.entries, stats.skipped, stats.ready, stats.waited, stats.window_reads);
+
+    return 0;
+}
+
+int HostPlaylist_Benchmark(fs_driver_t *fs, const sd_model_t *model, uint32_t work_b, FILE *out)
+{
+    static uint8_t work[16 * 1024 * 1024] __attribute__((aligned(4)));
+    static uint8_t ring_buffer[8 * 1024];
+    char pls[LIBRARY_MAX_PATH];
+    ring_t ring;
+
+    card = model;
+
+    if (work_b > sizeof(work))
+    {
+        work_b = sizeof(work);
+    }
+
+    // The player opens the tracks; it never gets as far as the sink
+    if (Library_Init(fs, &wav_codec) != LIBRARY_SUCCESS || Ring_Init(&ring, ring_buffer, sizeof(ring_buffer))
+            != RING_SUCCESS || Player_Init(fs, &wav_codec, &host_audio_driver, &ring) != PLAYER_SUCCESS
+            || Playlist_Init(fs) != PLAYLIST_SUCCESS)
+    {
+        return 1;
+    }
+
+    if (Library_Update(work, work_b, NULL) != LIBRARY_SUCCESS || Library_Count() == 0)
+    {
+        fprintf(out, "No library to make playlists of: -mklib first\n");
+        return 1;
+    }
+
+    uint32_t count = Library_Count();
+    char (*paths)[LIBRARY_MAX_PATH] = malloc((size_t)count * LIBRARY_MAX_PATH);
+
+    if (paths == NULL)
+    {
+        return 1;
+    }
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t index;
+
+        if (Library_GetViewEntry(LIBRARY_VIEW_TITLE, i, &index) != LIBRARY_SUCCESS
+                || Library_GetPath(index, paths[i], LIBRARY_MAX_PATH) != LIBRARY_SUCCESS)
+        {
+            fprintf(out, "Unable to read entry %u of the title view\n", i);
+            free(paths);
+            return 1;
+        }
+    }
+
+    // The PLS goes in the first artist's folder, to be relative to that
+    char *slash = strchr(paths[0], '/');
+    snprintf(pls, sizeof(pls), "%.*s" PLS_NAME, (slash != NULL) ? (int)(slash - paths[0]) + 1 : 0, paths[0]);
+
+    int status = WritePlaylists(fs, paths, count, pls, out);
+    uint32_t shorter = (count < HOST_PLAYLIST_SHORT) ? count : HOST_PLAYLIST_SHORT;
+
+    Library_Close();
+
+    status = status || Play(SHORT_M3U, paths, shorter, 1, out) || Play(LONG_M3U, paths, count, 0, out)
+            || Play(LONG_M3U, paths, count, 1, out) || Play(pls, paths, count, 1, out);
+
+    free(paths);
+
+    return status;
+}
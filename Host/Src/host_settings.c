@@ -0,0 +1,371 @@
+/*
+ * host_settings.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#include "host_settings.h"
+#include "host_flash.h"
+#include "host_random.h"
+#include "settings.h"
+
+#include <string.h>
+#include <time.h>
+
+// Like the board's, sectors 6 and 7 (internal_flash.h)
+#define BOARD_SECTOR_SIZE (128 * 1024)
+
+// Reads timed
+#define GETS 1000000
+
+// The player's own, and some more of all lengths
+static const uint16_t KEYS[] =
+{ SETTINGS_KEY_VOLUME, SETTINGS_KEY_EQ, SETTINGS_KEY_PLAY_MODE, 100, 101, 102, 103, 104, 105, 106, 107, 108, 109,
+        110, 111, 112 };
+
+#define NUM_KEYS (sizeof(KEYS) / sizeof(KEYS[0]))
+
+typedef enum
+{
+    OP_SET = 0,
+    OP_DELETE,
+    OP_SERVICE
+} op_kind_t;
+
+// A change, and what the store should hold afterwards
+typedef struct
+{
+    op_kind_t kind;
+    uint32_t key;                           // index into KEYS
+    uint8_t length;
+    uint8_t value[SETTINGS_MAX_VALUE];
+} op_t;
+
+// What the store should hold
+typedef struct
+{
+    uint8_t present;
+    uint8_t length;
+    uint8_t value[SETTINGS_MAX_VALUE];
+} value_t;
+
+static value_t model[NUM_KEYS];
+static uint32_t rng = 1;
+
+static double ElapsedUs(const struct timespec *start)
+{
+    struct timespec end;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    return (double)(end.tv_sec - start->tv_sec) * 1e6 + (double)(end.tv_nsec - start->tv_nsec) / 1e3;
+}
+
+// Mostly new values, some the same again, a few deletions, and now and then an idle moment (service_percent)
+static void NextOp(op_t *op, uint32_t service_percent)
+{
+    uint32_t roll = HostRandom_Next(&rng) % 100;
+
+    op->key = HostRandom_Next(&rng) % NUM_KEYS;
+    op->kind = (roll < service_percent) ? OP_SERVICE : (roll < service_percent + 5) ? OP_DELETE : OP_SET;
+
+    if (op->kind != OP_SET)
+    {
+        return;
+    }
+
+    const value_t *current = &model[op->key];
+
+    if (current->present && HostRandom_Next(&rng) % 10 == 0)
+    {
+        op->length = current->length;
+        memcpy(op->value, current->value, current->length);
+        return;
+    }
+
+    op->length = (KEYS[op->key] == SETTINGS_KEY_EQ) ? 10 : (KEYS[op->key] < 100) ? 1
+            : (uint8_t)(HostRandom_Next(&rng) % (SETTINGS_MAX_VALUE + 1));
+
+    for (uint32_t i = 0; i < op->length; i++)
+    {
+        op->value[i] = (uint8_t)HostRandom_Next(&rng);
+    }
+}
+
+static settings_ret_t Do(const op_t *op)
+{
+    switch (op->kind)
+    {
+    case OP_SET:
+        return Settings_Set(KEYS[op->key], op->value, op->length);
+    case OP_DELETE:
+        return Settings_Delete(KEYS[op->key]);
+    default:
+        return Settings_Service();
+    }
+}
+
+static void Apply(const op_t *op)
+{
+    value_t *value = &model[op->key];
+
+    if (op->kind == OP_SET)
+    {
+        value->present = 1;
+        value->length = op->length;
+        memcpy(value->value, op->value, op->length);
+    }
+    else if (op->kind == OP_DELETE)
+    {
+        value->present = 0;
+    }
+}
+
+// Whether the store has what the model says for key i
+static uint8_t Matches(uint32_t i)
+{
+    uint8_t value[SETTINGS_MAX_VALUE];
+    uint32_t length = 0;
+    settings_ret_t res = Settings_Get(KEYS[i], value, sizeof(value), &length);
+
+    if (!model[i].present)
+    {
+        return res == SETTINGS_ERROR_NOT_FOUND;
+    }
+
+    return res == SETTINGS_SUCCESS && length == model[i].length && memcmp(value, model[i].value, length) == 0;
+}
+
+static uint32_t Mismatches(void)
+{
+    uint32_t mismatches = 0;
+
+    for (uint32_t i = 0; i < NUM_KEYS; i++)
+    {
+        mismatches += !Matches(i);
+    }
+
+    return mismatches;
+}
+
+/*
+ * The board's sector size: changes, wear, boot and reads
+ */
+static int LongRun(FILE *out)
+{
+    settings_stats_t stats;
+    host_flash_stats_t flash;
+    uint32_t mismatches = 0;
+    uint32_t deletes = 0;
+    struct timespec start;
+    op_t op;
+
+    memset(model, 0, sizeof(model));
+
+    if (HostFlash_Setup(BOARD_SECTOR_SIZE, 1) != HOST_FLASH_SUCCESS || Settings_Init(&host_flash_settings)
+            != SETTINGS_SUCCESS)
+    {
+        return 1;
+    }
+
+    for (uint32_t i = 0; i < HOST_SETTINGS_CHANGES; i++)
+    {
+        NextOp(&op, 0);
+
+        // Settings_Service between tracks, say
+        if (i % 1000 == 999)
+        {
+            Settings_Service();
+        }
+
+        settings_ret_t res = Do(&op);
+
+        if (res == SETTINGS_SUCCESS || res == SETTINGS_UNCHANGED)
+        {
+            Apply(&op);
+            deletes += (op.kind == OP_DELETE);
+        }
+        else if (!(res == SETTINGS_ERROR_NOT_FOUND && op.kind == OP_DELETE && !model[op.key].present))
+        {
+            fprintf(out, "[settings] change %u failed (%d)\n", i, res);
+            return 1;
+        }
+
+        mismatches += !Matches(op.key);
+    }
+
+    mismatches += Mismatches();
+    Settings_GetStats(&stats);
+    HostFlash_GetStats(&flash);
+
+    fprintf(out, "[settings] %u changes on %u KiB sectors: %u written, %u the same again, %u deletions, "
+            "%u wrong\n", HOST_SETTINGS_CHANGES, BOARD_SECTOR_SIZE / 1024, stats.writes, stats.unchanged, deletes,
+            mismatches);
+    fprintf(out, "[settings]   %u compactions (a write in %u), %u erases (sector 0: %u, sector 1: %u), %u had to be "
+            "waited for, %u bits asked back to 1\n", stats.compactions, stats.writes / (stats.compactions + 1),
+            stats.erases, flash.erases[0], flash.erases[1], stats.inline_erases, flash.violations);
+    fprintf(out, "[settings]   %.1f words programmed a write, %.0f us of flash time a write with the erases, "
+            "%u keys in %u B live\n", (double)flash.words_programmed / stats.writes,
+            (double)flash.busy_us / stats.writes, stats.keys, stats.live_b);
+
+    // A boot with the active sector as full as it gets: only the headers are read
+    uint8_t volume = 0;
+
+    while (stats.used_b + 12 <= BOARD_SECTOR_SIZE)
+    {
+        volume++;
+        Settings_Set(SETTINGS_KEY_VOLUME, &volume, 1);
+        Settings_GetStats(&stats);
+    }
+
+    model[0].present = 1;
+    model[0].length = 1;
+    model[0].value[0] = volume;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    settings_ret_t res = Settings_Init(&host_flash_settings);
+    double boot_us = ElapsedUs(&start);
+
+    Settings_GetStats(&stats);
+    mismatches = Mismatches();
+
+    fprintf(out, "[settings]   boot with the sector full (%u B): %u headers read, %.1f us here, %u wrong (%d)\n",
+            stats.used_b, stats.headers_read, boot_us, mismatches, res);
+
+    uint8_t value[SETTINGS_MAX_VALUE];
+    uint32_t length;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (uint32_t i = 0; i < GETS; i++)
+    {
+        Settings_Get(KEYS[i % NUM_KEYS], value, sizeof(value), &length);
+    }
+
+    fprintf(out, "[settings]   Settings_Get: %.0f ns here\n", ElapsedUs(&start) * 1e3 / GETS);
+
+    return (res != SETTINGS_SUCCESS || mismatches > 0 || flash.violations > 0) ? 1 : 0;
+}
+
+/*
+ * Small sectors, with the power going every few hundred words programmed
+ */
+static int PowerCuts(FILE *out)
+{
+    settings_stats_t stats;
+    host_flash_stats_t flash;
+    uint32_t mismatches = 0;
+    uint32_t kept[2] = { 0 };               // the change in flight, by where the cut was: during a word, or after
+    uint32_t lost[2] = { 0 };
+    uint32_t torn = 0;                      // found by the boots, the same one counted by each till it's compacted
+    uint32_t during_service = 0;
+    uint32_t formatted = 0;
+    op_t op;
+
+    memset(model, 0, sizeof(model));
+
+    if (HostFlash_Setup(HOST_SETTINGS_CUT_SECTOR, 2) != HOST_FLASH_SUCCESS || Settings_Init(&host_flash_settings)
+            != SETTINGS_SUCCESS)
+    {
+        return 1;
+    }
+
+    for (uint32_t cut = 0; cut < HOST_SETTINGS_CUTS; cut++)
+    {
+        // Half partway through a word or erase, half just after one: that can be the last word of a record, in which
+        // case the change made it
+        uint32_t between = cut & 1;
+
+        if (between)
+        {
+            HostFlash_CutBetween(1 + HostRandom_Next(&rng) % HOST_SETTINGS_CUT_WITHIN);
+        }
+        else
+        {
+            HostFlash_CutAfter(1 + HostRandom_Next(&rng) % HOST_SETTINGS_CUT_WITHIN);
+        }
+
+        // Until the power goes
+        for (;;)
+        {
+            NextOp(&op, 10);
+
+            settings_ret_t res = Do(&op);
+
+            if (HostFlash_IsCut())
+            {
+                break;
+            }
+
+            if (res == SETTINGS_SUCCESS || res == SETTINGS_UNCHANGED)
+            {
+                Apply(&op);
+            }
+            else if (res != SETTINGS_READY && res != SETTINGS_ERROR_NOT_FOUND)
+            {
+                fprintf(out, "[settings] failed with the power on (%d)\n", res);
+                return 1;
+            }
+        }
+
+        // Reboot: everything as it was, apart from the change in flight, which may or may not have made it
+        value_t before = model[op.key];
+
+        HostFlash_PowerOn();
+
+        if (Settings_Init(&host_flash_settings) != SETTINGS_SUCCESS)
+        {
+            fprintf(out, "[settings] no boot after cut %u\n", cut);
+            return 1;
+        }
+
+        Settings_GetStats(&stats);
+        torn += stats.torn;
+        formatted += stats.formatted;
+        during_service += (op.kind == OP_SERVICE);
+
+        if (op.kind != OP_SERVICE)
+        {
+            Apply(&op);
+
+            if (Matches(op.key))
+            {
+                kept[between]++;
+            }
+            else
+            {
+                model[op.key] = before;
+                lost[between]++;
+            }
+        }
+
+        uint32_t wrong = Mismatches();
+
+        if (wrong > 0 && mismatches == 0)
+        {
+            fprintf(out, "[settings] cut %u: %u keys wrong after the reboot\n", cut, wrong);
+        }
+
+        mismatches += wrong;
+    }
+
+    HostFlash_GetStats(&flash);
+
+    fprintf(out, "[settings] %u power cuts on %u B sectors (%u erases between them, %u during Settings_Service): "
+            "%u wrong after a reboot, %u formatted, %u bits asked back to 1\n", HOST_SETTINGS_CUTS,
+            HOST_SETTINGS_CUT_SECTOR, flash.erases[0] + flash.erases[1], during_service, mismatches, formatted,
+            flash.violations);
+    fprintf(out, "[settings]   the change in flight made it %u times and didn't %u times with the cut during a word, "
+            "%u and %u with it after one, %.1f torn records a boot\n", kept[0], lost[0], kept[1], lost[1],
+            (double)torn / HOST_SETTINGS_CUTS);
+
+    // A cut after a record's last word that didn't keep the record would be a wrong key above: this is that there
+    // were some
+    return (mismatches > 0 || formatted > 0 || flash.violations > 0 || kept[1] == 0) ? 1 : 0;
+}
+
+int HostSettings_Benchmark(FILE *out)
+{
+    return LongRun(out) || PowerCuts(out);
+}
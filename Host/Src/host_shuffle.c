@@ -0,0 +1,229 @@
+/*
+ * host_shuffle.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#include "host_shuffle.h"
+#include "shuffle.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define SEED 0x6D75506F
+
+// Odd and even bit counts, powers of two and one either side of them, and libraries of the sizes people have
+static const uint32_t CHECKED_COUNTS[] =
+{
+    1, 2, 3, 4, 5, 7, 8, 9, 255, 256, 257, 1000, 4095, 4096, 4097, 10000, 65535, 65536, 65537, 100000, 1048577
+};
+
+static const uint32_t TIMED_COUNTS[] = { 1000, 10000, 100000, 1048577 };
+
+#define NUM_CHECKED (sizeof(CHECKED_COUNTS) / sizeof(CHECKED_COUNTS[0]))
+#define NUM_TIMED (sizeof(TIMED_COUNTS) / sizeof(TIMED_COUNTS[0]))
+
+// Passes walked forward, then back, by CheckSteps
+#define STEPPED_PASSES 3
+
+static double Seconds(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (double)(now.tv_sec - start->tv_sec) + (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// Every position to a different track, and back to the same position. Also how many stay put, which for a random
+// permutation is 1 on average.
+static int CheckPass(uint32_t count, uint8_t *seen, uint32_t *fixed, FILE *out)
+{
+    shuffle_t shuffle;
+
+    if (Shuffle_Init(&shuffle, count, SEED) != SHUFFLE_SUCCESS)
+    {
+        fprintf(out, "Unable to shuffle %u tracks\n", count);
+        return 1;
+    }
+
+    memset(seen, 0, count);
+    *fixed = 0;
+
+    for (uint32_t position = 0; position < count; position++)
+    {
+        uint32_t track = Shuffle_Track(&shuffle, position);
+
+        if (track >= count || seen[track] || Shuffle_Position(&shuffle, track) != position)
+        {
+            fprintf(out, "[shuffle] %u tracks: position %u goes to %u, %s\n", count, position, track,
+                    (track >= count) ? "out of range" : seen[track] ? "already taken" : "which doesn't come back");
+            return 1;
+        }
+
+        seen[track] = 1;
+        *fixed += (track == position);
+    }
+
+    return 0;
+}
+
+// Forward through a few passes, each one a permutation and none the same as the one before, then back through them
+// all, getting the same tracks in reverse
+static int CheckSteps(uint32_t count, uint32_t *tracks, uint8_t *seen, FILE *out)
+{
+    shuffle_t shuffle;
+    uint32_t steps = STEPPED_PASSES * count;
+    uint32_t same = 0;
+
+    Shuffle_Init(&shuffle, count, SEED);
+    tracks[0] = Shuffle_Current(&shuffle);
+
+    for (uint32_t i = 1; i < steps; i++)
+    {
+        tracks[i] = Shuffle_Next(&shuffle);
+    }
+
+    for (uint32_t pass = 0; pass < STEPPED_PASSES; pass++)
+    {
+        memset(seen, 0, count);
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            uint32_t track = tracks[pass * count + i];
+
+            if (seen[track])
+            {
+                fprintf(out, "[shuffle] %u tracks: %u twice in pass %u\n", count, track, pass);
+                return 1;
+            }
+
+            seen[track] = 1;
+            same += (pass > 0 && track == tracks[(pass - 1) * count + i]);
+        }
+    }
+
+    for (uint32_t i = steps - 1; i > 0; i--)
+    {
+        if (Shuffle_Previous(&shuffle) != tracks[i - 1])
+        {
+            fprintf(out, "[shuffle] %u tracks: back from step %u isn't where it came from\n", count, i);
+            return 1;
+        }
+    }
+
+    // Before the first pass, and after: the pass before it is just another pass
+    if (shuffle.pass != 0 || shuffle.position != 0 || Shuffle_Previous(&shuffle) == count
+            || Shuffle_Next(&shuffle) != tracks[0])
+    {
+        fprintf(out, "[shuffle] %u tracks: not back at the start\n", count);
+        return 1;
+    }
+
+    // Carrying on from a track
+    if (Shuffle_Seek(&shuffle, tracks[count / 2]) != SHUFFLE_SUCCESS || Shuffle_Next(&shuffle) != tracks[count / 2 + 1])
+    {
+        fprintf(out, "[shuffle] %u tracks: seeking to a track doesn't carry on from it\n", count);
+        return 1;
+    }
+
+    if (count >= 1000 && same > 2 * (STEPPED_PASSES - 1) * 5)
+    {
+        fprintf(out, "[shuffle] %u tracks: %u positions with the same track as the pass before\n", count, same);
+        return 1;
+    }
+
+    return 0;
+}
+
+static void TimeSteps(uint32_t count, FILE *out)
+{
+    shuffle_t shuffle;
+    struct timespec start;
+    volatile uint32_t sink = 0;
+
+    Shuffle_Init(&shuffle, count, SEED);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (uint32_t i = 0; i < HOST_SHUFFLE_STEPS; i++)
+    {
+        sink += Shuffle_Next(&shuffle);
+    }
+
+    double next_s = Seconds(&start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (uint32_t i = 0; i < HOST_SHUFFLE_STEPS; i++)
+    {
+        sink += Shuffle_Previous(&shuffle);
+    }
+
+    double previous_s = Seconds(&start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (uint32_t i = 0; i < HOST_SHUFFLE_STEPS; i++)
+    {
+        sink += Shuffle_Position(&shuffle, i % count);
+    }
+
+    double position_s = Seconds(&start);
+
+    // What the network's over, against what's in it: how many goes a step takes, on average
+    uint32_t domain = 1u << (shuffle.low_bits + shuffle.high_bits);
+
+    fprintf(out, "[shuffle] %u tracks (over %u, %.2f goes a step): next %.1f ns, previous %.1f ns, "
+            "track to position %.1f ns, %u B of state\n", count, domain, (double)domain / count,
+            next_s * 1e9 / HOST_SHUFFLE_STEPS, previous_s * 1e9 / HOST_SHUFFLE_STEPS,
+            position_s * 1e9 / HOST_SHUFFLE_STEPS, (uint32_t)sizeof(shuffle_t));
+    (void)sink;
+}
+
+int HostShuffle_Benchmark(FILE *out)
+{
+    uint32_t largest = 0;
+
+    for (uint32_t i = 0; i < NUM_CHECKED; i++)
+    {
+        largest = (CHECKED_COUNTS[i] > largest) ? CHECKED_COUNTS[i] : largest;
+    }
+
+    uint8_t *seen = malloc(largest);
+    uint32_t *tracks = malloc((size_t)largest * STEPPED_PASSES * sizeof(uint32_t));
+    int status = (seen == NULL || tracks == NULL) ? 1 : 0;
+    uint64_t fixed_total = 0;
+    uint32_t fixed_counts = 0;
+
+    for (uint32_t i = 0; i < NUM_CHECKED && status == 0; i++)
+    {
+        uint32_t fixed;
+
+        status = CheckPass(CHECKED_COUNTS[i], seen, &fixed, out) || CheckSteps(CHECKED_COUNTS[i], tracks, seen, out);
+
+        if (CHECKED_COUNTS[i] >= 1000)
+        {
+            fixed_total += fixed;
+            fixed_counts++;
+        }
+    }
+
+    if (status == 0)
+    {
+        fprintf(out, "[shuffle] %u library sizes from 1 to %u: every pass a permutation, backwards the same as "
+                "forwards, %.1f tracks left where they were (a random shuffle: 1)\n", (uint32_t)NUM_CHECKED, largest,
+                fixed_counts ? (double)fixed_total / fixed_counts : 0.0);
+
+        for (uint32_t i = 0; i < NUM_TIMED; i++)
+        {
+            TimeSteps(TIMED_COUNTS[i], out);
+        }
+    }
+
+    free(seen);
+    free(tracks);
+
+    return status;
+}
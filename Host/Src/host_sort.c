@@ -0,0 +1,167 @@
+/*
+ * host_sort.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#include "host_sort.h"
+#include "blk.h"
+#include "extsort.h"
+#include "host_fatfs.h"
+#include "host_random.h"
+#include "library.h"
+
+#include <string.h>
+#include <time.h>
+
+// Same as a generated library card (host_library.c)
+#define CARD_CLUSTER_B 4096
+
+static const uint32_t RECORD_COUNTS[] = { 1000, 10000, 30000, 100000 };
+
+#define NUM_COUNTS (sizeof(RECORD_COUNTS) / sizeof(RECORD_COUNTS[0]))
+
+// Like the library's sort entries
+typedef struct
+{
+    uint8_t key[LIBRARY_KEY_LEN];
+    uint32_t index;
+} record_t;
+
+static uint32_t seed;
+
+static int CompareRecords(const void *a, const void *b)
+{
+    const record_t *x = (const record_t *)a;
+    const record_t *y = (const record_t *)b;
+    int order = memcmp(x->key, y->key, LIBRARY_KEY_LEN);
+
+    if (order != 0)
+    {
+        return order;
+    }
+
+    return (x->index > y->index) - (x->index < y->index);
+}
+
+// Lowercase words, like folded titles: plenty of keys with the same first few letters
+static void MakeRecord(record_t *record, uint32_t index)
+{
+    uint32_t length = 4 + HostRandom_Next(&seed) % (LIBRARY_KEY_LEN - 4);
+
+    memset(record, 0, sizeof(*record));
+
+    for (uint32_t i = 0; i < length; i++)
+    {
+        record->key[i] = (uint8_t)((HostRandom_Next(&seed) % 6 == 0) ? ' ' : 'a' + HostRandom_Next(&seed) % 26);
+    }
+
+    record->index = index;
+}
+
+static double Seconds(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (double)(now.tv_sec - start->tv_sec) + (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// Add, finish and read back every record, the way a view is built, and check they come out in order, all of them
+static int Sort(fs_driver_t *fs, const sd_model_t *model, uint8_t *work, uint32_t work_b, uint32_t count, FILE *out)
+{
+    extsort_t sort;
+    extsort_stats_t stats;
+    record_t record;
+    record_t last;
+    blk_stats_t before;
+    blk_stats_t after;
+    uint64_t busy_before = (model != NULL) ? model->stats.busy_us : 0;
+    uint64_t sum = 0;
+    uint32_t seen = 0;
+    struct timespec start;
+    extsort_ret_t res;
+
+    seed = 2463534242u;
+    Blk_GetStats(&before);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    res = ExtSort_Init(&sort, fs, LIBRARY_RUNS_TEMP, LIBRARY_MERGE_TEMP, sizeof(record_t), CompareRecords, work,
+            work_b);
+
+    for (uint32_t i = 0; i < count && res == EXTSORT_SUCCESS; i++)
+    {
+        MakeRecord(&record, i);
+        res = ExtSort_Add(&sort, &record);
+    }
+
+    if (res == EXTSORT_SUCCESS)
+    {
+        res = ExtSort_Finish(&sort);
+    }
+
+    while (res == EXTSORT_SUCCESS && (res = ExtSort_Next(&sort, &record)) == EXTSORT_SUCCESS)
+    {
+        if (seen > 0 && CompareRecords(&last, &record) >= 0)
+        {
+            fprintf(out, "[sort] %u records: out of order at %u\n", count, seen);
+            res = EXTSORT_ERROR_GENERIC;
+            break;
+        }
+
+        last = record;
+        sum += record.index;
+        seen++;
+    }
+
+    ExtSort_Close(&sort, &stats);
+
+    double wall_s = Seconds(&start);
+
+    if (res != EXTSORT_END || seen != count || sum != (uint64_t)count * (count - 1) / 2)
+    {
+        fprintf(out, "[sort] %u records with %u KiB: failed (%d), %u came out\n", count, work_b / 1024, res, seen);
+        return 1;
+    }
+
+    Blk_GetStats(&after);
+
+    fprintf(out, "[sort] %6u records, %4u KiB work: %3u runs, %u passes, %.2f MB written, %.2f MB read, "
+            "%.3f s host, %u requests", count, work_b / 1024, stats.runs, stats.passes, stats.written_b / 1e6,
+            stats.read_b / 1e6, wall_s, after.requests - before.requests);
+
+    if (model != NULL)
+    {
+        fprintf(out, ", %.3f s card", (double)(model->stats.busy_us - busy_before) / 1e6);
+    }
+
+    fprintf(out, "\n");
+
+    return 0;
+}
+
+int HostSort_Benchmark(fs_driver_t *fs, const sd_model_t *model, uint32_t work_b, FILE *out)
+{
+    static uint8_t work[16 * 1024 * 1024] __attribute__((aligned(4)));
+    const uint32_t works[] = { HOST_SORT_BOARD_WORK, (work_b < sizeof(work)) ? work_b : (uint32_t)sizeof(work) };
+
+    if (HostFatFS_Format(0, CARD_CLUSTER_B) != FS_SUCCESS || fs->ops->Open(fs) != FS_SUCCESS)
+    {
+        fprintf(out, "Unable to format the image\n");
+        return 1;
+    }
+
+    for (uint32_t w = 0; w < sizeof(works) / sizeof(works[0]); w++)
+    {
+        for (uint32_t i = 0; i < NUM_COUNTS; i++)
+        {
+            if (Sort(fs, model, work, works[w], RECORD_COUNTS[i], out) != 0)
+            {
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,238 @@
+/*
+ * sd_model.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#include "sd_model.h"
+#include "host_random.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Per line, per block: start bit + CRC16 + end bit
+#define BLOCK_FRAMING_CLOCKS (1 + 16 + 1)
+
+#define TRACE_LINE_LEN 128
+
+void SDModel_DefaultConfig(sd_model_config_t *config)
+{
+    if (config == NULL)
+    {
+        return;
+    }
+
+    config->clock_hz = SD_MODEL_DEFAULT_CLOCK_HZ;
+    config->bus_width = SD_MODEL_DEFAULT_BUS_WIDTH;
+    config->command_us = SD_MODEL_DEFAULT_COMMAND_US;
+    config->write_busy_us = SD_MODEL_DEFAULT_WRITE_BUSY_US;
+    config->stall_ppm = SD_MODEL_DEFAULT_STALL_PPM;
+    config->stall_min_us = SD_MODEL_DEFAULT_STALL_MIN_US;
+    config->stall_max_us = SD_MODEL_DEFAULT_STALL_MAX_US;
+    config->seed = 1;
+}
+
+sd_model_ret_t SDModel_Init(sd_model_t *model, const sd_model_config_t *config)
+{
+    if (model == NULL || config == NULL)
+    {
+        return SD_MODEL_ERROR_NULL_PARAMETER;
+    }
+
+    if (config->clock_hz == 0 || (config->bus_width != 1 && config->bus_width != 4)
+            || config->stall_min_us > config->stall_max_us || config->stall_ppm > 1000000)
+    {
+        return SD_MODEL_ERROR_INVALID_CONFIG;
+    }
+
+    memset(model, 0, sizeof(*model));
+    model->config = *config;
+
+    // xorshift gets stuck at 0
+    model->rng = (config->seed != 0) ? config->seed : 1;
+
+    return SD_MODEL_SUCCESS;
+}
+
+void SDModel_Deinit(sd_model_t *model)
+{
+    if (model == NULL)
+    {
+        return;
+    }
+
+    free(model->trace);
+    model->trace = NULL;
+    model->trace_length = 0;
+}
+
+sd_model_ret_t SDModel_LoadTrace(sd_model_t *model, const char *path)
+{
+    if (model == NULL || path == NULL)
+    {
+        return SD_MODEL_ERROR_NULL_PARAMETER;
+    }
+
+    FILE *file = fopen(path, "r");
+
+    if (file == NULL)
+    {
+        return SD_MODEL_ERROR_UNABLE_TO_OPEN_TRACE;
+    }
+
+    sd_model_trace_entry_t *trace = malloc(SD_MODEL_MAX_TRACE * sizeof(*trace));
+
+    if (trace == NULL)
+    {
+        fclose(file);
+        return SD_MODEL_ERROR_GENERIC;
+    }
+
+    char line[TRACE_LINE_LEN];
+    size_t length = 0;
+    sd_model_ret_t res = SD_MODEL_SUCCESS;
+
+    while (length < SD_MODEL_MAX_TRACE && fgets(line, sizeof(line), file) != NULL)
+    {
+        char op;
+        unsigned long blocks;
+        unsigned long latency_us;
+
+        if (line[0] == '#' || line[0] == '\n' || line[0] == '\r')
+        {
+            continue;
+        }
+
+        if (sscanf(line, " %c %lu %lu", &op, &blocks, &latency_us) != 3 || (op != 'R' && op != 'W') || blocks == 0)
+        {
+            res = SD_MODEL_ERROR_INVALID_TRACE;
+            break;
+        }
+
+        trace[length].op = (op == 'R') ? SD_MODEL_READ : SD_MODEL_WRITE;
+        trace[length].blocks = (uint32_t)blocks;
+        trace[length].latency_us = (uint32_t)latency_us;
+        length++;
+    }
+
+    fclose(file);
+
+    if (res == SD_MODEL_SUCCESS && length == 0)
+    {
+        res = SD_MODEL_ERROR_INVALID_TRACE;
+    }
+
+    if (res != SD_MODEL_SUCCESS)
+    {
+        free(trace);
+        return res;
+    }
+
+    free(model->trace);
+    model->trace = trace;
+    model->trace_length = length;
+    model->trace_next[SD_MODEL_READ] = 0;
+    model->trace_next[SD_MODEL_WRITE] = 0;
+
+    return SD_MODEL_SUCCESS;
+}
+
+uint32_t SDModel_TransferUs(const sd_model_config_t *config, uint32_t blocks)
+{
+    if (config == NULL || config->clock_hz == 0 || config->bus_width == 0)
+    {
+        return 0;
+    }
+
+    uint64_t clocks_per_block = (SD_MODEL_BLOCK_SIZE * 8) / config->bus_width + BLOCK_FRAMING_CLOCKS;
+    uint64_t clocks = clocks_per_block * blocks;
+
+    return (uint32_t)((clocks * 1000000 + config->clock_hz - 1) / config->clock_hz);
+}
+
+// Next entry in the same direction, or NULL if the trace has none
+static const sd_model_trace_entry_t *NextTraceEntry(sd_model_t *model, sd_model_op_t op)
+{
+    for (size_t tries = 0; tries < model->trace_length; tries++)
+    {
+        size_t i = model->trace_next[op];
+        model->trace_next[op] = (i + 1) % model->trace_length;
+
+        if (model->trace[i].op == op)
+        {
+            return &model->trace[i];
+        }
+    }
+
+    return NULL;
+}
+
+static uint32_t ReplayUs(sd_model_t *model, sd_model_op_t op, uint32_t blocks, uint8_t *stalled)
+{
+    const sd_model_trace_entry_t *entry = NextTraceEntry(model, op);
+
+    if (entry == NULL)
+    {
+        return 0;
+    }
+
+    int64_t latency = (int64_t)entry->latency_us + SDModel_TransferUs(&model->config, blocks)
+            - SDModel_TransferUs(&model->config, entry->blocks);
+
+    // Anything way above what the bus alone explains counts as a stall
+    *stalled = entry->latency_us >= model->config.stall_min_us;
+
+    return (latency > 0) ? (uint32_t)latency : 0;
+}
+
+static uint32_t ModelUs(sd_model_t *model, sd_model_op_t op, uint32_t blocks, uint8_t *stalled)
+{
+    const sd_model_config_t *config = &model->config;
+    uint32_t latency = config->command_us + SDModel_TransferUs(config, blocks);
+
+    if (op == SD_MODEL_WRITE)
+    {
+        latency += config->write_busy_us;
+    }
+
+    // Compare against a uniform number in [0, 1000000) to get the stall probability in ppm
+    if (config->stall_ppm > 0 && HostRandom_Next(&model->rng) % 1000000 < config->stall_ppm)
+    {
+        uint32_t range = config->stall_max_us - config->stall_min_us;
+
+        latency += config->stall_min_us + ((range > 0) ? HostRandom_Next(&model->rng) % (range + 1) : 0);
+        *stalled = 1;
+    }
+
+    return latency;
+}
+
+uint32_t SDModel_CommandUs(sd_model_t *model, sd_model_op_t op, uint32_t blocks)
+{
+    if (model == NULL || blocks == 0)
+    {
+        return 0;
+    }
+
+    uint8_t stalled = 0;
+    uint32_t latency = (model->trace != NULL) ? ReplayUs(model, op, blocks, &stalled)
+            : ModelUs(model, op, blocks, &stalled);
+
+    model->stats.commands++;
+    model->stats.blocks += blocks;
+    model->stats.busy_us += latency;
+
+    if (latency > model->stats.max_us)
+    {
+        model->stats.max_us = latency;
+    }
+
+    if (stalled)
+    {
+        model->stats.stalls++;
+    }
+
+    return latency;
+}
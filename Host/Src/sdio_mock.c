@@ -0,0 +1,472 @@
+/*
+ * sdio_mock.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: prestonmeek
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "sdio_mock.h"
+
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BLOCK_SIZE 512
+
+// Card states, as reported in bits 12:9 of R1
+#define STATE_TRANSFER 4
+#define STATE_DATA 5        // sending
+#define STATE_RECEIVE 6
+#define STATE_PROGRAMMING 7
+
+#define R1_OUT_OF_RANGE (1UL << 31)
+#define R1_ADDRESS_ERROR (1UL << 30)
+#define R1_READY_FOR_DATA (1UL << 8)
+#define R1_APP_CMD (1UL << 5)
+
+#define SCR_BYTES 8
+
+// Read-only to the driver, but the mock is the hardware that sets them
+#define HW(reg) (*(volatile uint32_t *)&(reg))
+
+SDIO_TypeDef sdio_mock;
+DMA_TypeDef sdio_mock_dma;
+DMA_Stream_TypeDef sdio_mock_stream;
+
+typedef struct
+{
+    uint8_t active;
+    uint8_t to_card;
+    uint8_t scr;
+    uint32_t block;
+    uint32_t blocks;        // 0 = open-ended, until CMD12
+} pending_t;
+
+static sdio_mock_config_t card;
+static int card_fd = -1;
+static uint32_t card_blocks;
+static FILE *card_log;
+
+static uint32_t state;
+static uint32_t block_length;
+static uint32_t block_count;    // from CMD23, for the next command only
+static uint32_t busy_left;
+static uint8_t app_cmd;
+static pending_t pending;
+
+static const volatile void *addresses[SDIO_MOCK_ADDRESSES];
+static uint32_t next_address;
+
+static sdio_mock_stats_t stats;
+
+static void Violation(const char *format, ...)
+{
+    stats.violations++;
+
+    if (card_log == NULL)
+    {
+        return;
+    }
+
+    va_list args;
+    va_start(args, format);
+    fprintf(card_log, "[sdio_mock] ");
+    vfprintf(card_log, format, args);
+    fprintf(card_log, "\n");
+    va_end(args);
+}
+
+void SDIOMock_DefaultConfig(sdio_mock_config_t *config)
+{
+    if (config == NULL)
+    {
+        return;
+    }
+
+    config->cmd23 = 1;
+    config->high_capacity = 1;
+    config->program_polls = 2;
+    config->rca = 0x1234;
+}
+
+sdio_mock_ret_t SDIOMock_Init(const sdio_mock_config_t *config, int fd, uint32_t num_blocks, FILE *log)
+{
+    if (config == NULL)
+    {
+        return SDIO_MOCK_ERROR_NULL_PARAMETER;
+    }
+
+    card = *config;
+    card_fd = fd;
+    card_blocks = num_blocks;
+    card_log = log;
+
+    memset(&sdio_mock, 0, sizeof(sdio_mock));
+    memset(&sdio_mock_dma, 0, sizeof(sdio_mock_dma));
+    memset(&sdio_mock_stream, 0, sizeof(sdio_mock_stream));
+    memset(&stats, 0, sizeof(stats));
+    memset(&pending, 0, sizeof(pending));
+
+    state = STATE_TRANSFER;
+    block_length = BLOCK_SIZE;
+    block_count = 0;
+    busy_left = 0;
+    app_cmd = 0;
+
+    return SDIO_MOCK_SUCCESS;
+}
+
+uint32_t SDIOMock_BusAddress(const volatile void *address)
+{
+    uint32_t slot = next_address++ % SDIO_MOCK_ADDRESSES;
+
+    addresses[slot] = address;
+
+    return slot;
+}
+
+void SDIOMock_GetStats(sdio_mock_stats_t *out)
+{
+    if (out != NULL)
+    {
+        *out = stats;
+    }
+}
+
+uint32_t HAL_GetTick(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint32_t)(now.tv_sec * 1000 + now.tv_nsec / 1000000);
+}
+
+static void Respond(uint32_t index, uint32_t r1)
+{
+    r1 |= state << 9;
+
+    if (state == STATE_TRANSFER)
+    {
+        r1 |= R1_READY_FOR_DATA;
+    }
+
+    HW(sdio_mock.RESPCMD) = index;
+    HW(sdio_mock.RESP1) = r1;
+    HW(sdio_mock.STA) |= SDIO_STA_CMDREND;
+}
+
+// A real card just doesn't answer a command it can't take in its current state
+static void NoResponse(void)
+{
+    HW(sdio_mock.STA) |= SDIO_STA_CTIMEOUT;
+}
+
+static void BlockCommand(uint32_t index, uint32_t argument)
+{
+    uint8_t to_card = (index == SDMMC_CMD_WRITE_SINGLE_BLOCK || index == SDMMC_CMD_WRITE_MULT_BLOCK);
+    uint8_t multi = (index == SDMMC_CMD_READ_MULT_BLOCK || index == SDMMC_CMD_WRITE_MULT_BLOCK);
+    uint32_t block = argument;
+
+    if (!card.high_capacity)
+    {
+        if (argument % BLOCK_SIZE != 0)
+        {
+            Respond(index, R1_ADDRESS_ERROR);
+            return;
+        }
+
+        block = argument / BLOCK_SIZE;
+    }
+
+    uint32_t blocks = multi ? block_count : 1;
+
+    if ((uint64_t)block + (blocks ? blocks : 1) > card_blocks)
+    {
+        Respond(index, R1_OUT_OF_RANGE);
+        return;
+    }
+
+    if (block_length != BLOCK_SIZE)
+    {
+        Violation("CMD%u with the block length still at %u", index, block_length);
+    }
+
+    // For reads the card starts sending right after the response, so the host must be listening already
+    if (!to_card && !(sdio_mock.DCTRL & SDIO_DCTRL_DTEN))
+    {
+        Violation("CMD%u before the data path was armed", index);
+    }
+
+    Respond(index, 0);
+
+    pending.active = 1;
+    pending.to_card = to_card;
+    pending.scr = 0;
+    pending.block = block;
+    pending.blocks = blocks;
+
+    state = to_card ? STATE_RECEIVE : STATE_DATA;
+}
+
+static void HandleCommand(void)
+{
+    uint32_t index = sdio_mock.CMD & SDIO_CMD_CMDINDEX;
+    uint32_t argument = sdio_mock.ARG;
+    uint8_t app = app_cmd;
+    uint32_t count = block_count;
+
+    sdio_mock.CMD &= ~SDIO_CMD_CPSMEN;
+    stats.commands[index]++;
+
+    app_cmd = 0;
+    block_count = 0;
+
+    if ((state == STATE_DATA || state == STATE_RECEIVE) && index != SDMMC_CMD_STOP_TRANSMISSION
+            && index != SDMMC_CMD_SEND_STATUS)
+    {
+        Violation("CMD%u while a transfer is still open", index);
+        NoResponse();
+        return;
+    }
+
+    switch (index)
+    {
+    case SDMMC_CMD_STOP_TRANSMISSION:
+        if (pending.active)
+        {
+            // Stopped before any data moved, e.g., after an error
+            pending.active = 0;
+            state = STATE_TRANSFER;
+        }
+        else if (state == STATE_DATA)
+        {
+            state = STATE_TRANSFER;
+        }
+        else if (state == STATE_RECEIVE)
+        {
+            state = STATE_PROGRAMMING;
+            busy_left = card.program_polls;
+        }
+        else
+        {
+            Violation("CMD12 with no transfer to stop");
+            NoResponse();
+            return;
+        }
+
+        Respond(index, 0);
+        break;
+
+    case SDMMC_CMD_SEND_STATUS:
+        if ((argument >> 16) != card.rca)
+        {
+            NoResponse();
+            return;
+        }
+
+        if (state == STATE_PROGRAMMING)
+        {
+            if (busy_left > 0)
+            {
+                busy_left--;
+            }
+            else
+            {
+                state = STATE_TRANSFER;
+            }
+        }
+
+        Respond(index, 0);
+        break;
+
+    case SDMMC_CMD_SET_BLOCKLEN:
+        block_length = argument;
+        Respond(index, 0);
+        break;
+
+    case SDMMC_CMD_SET_BLOCK_COUNT:
+        block_count = argument & 0xFFFF;
+        Respond(index, 0);
+        break;
+
+    case SDMMC_CMD_READ_SINGLE_BLOCK:
+    case SDMMC_CMD_READ_MULT_BLOCK:
+    case SDMMC_CMD_WRITE_SINGLE_BLOCK:
+    case SDMMC_CMD_WRITE_MULT_BLOCK:
+        block_count = count;
+        BlockCommand(index, argument);
+        block_count = 0;
+        break;
+
+    case SDMMC_CMD_SD_APP_SEND_SCR:
+        if (!app)
+        {
+            NoResponse();
+            return;
+        }
+
+        if (!(sdio_mock.DCTRL & SDIO_DCTRL_DTEN))
+        {
+            Violation("ACMD51 before the data path was armed");
+        }
+
+        Respond(index, R1_APP_CMD);
+
+        pending.active = 1;
+        pending.to_card = 0;
+        pending.scr = 1;
+        pending.blocks = 1;
+        state = STATE_DATA;
+        break;
+
+    case SDMMC_CMD_APP_CMD:
+        if ((argument >> 16) != card.rca)
+        {
+            NoResponse();
+            return;
+        }
+
+        app_cmd = 1;
+        Respond(index, R1_APP_CMD);
+        break;
+
+    default:
+        Respond(index, 0);
+        break;
+    }
+}
+
+static void Finish(uint32_t sta)
+{
+    HW(sdio_mock.STA) |= sta;
+    sdio_mock.DCTRL &= ~SDIO_DCTRL_DTEN;
+    sdio_mock_stream.CR &= ~DMA_SxCR_EN;
+    pending.active = 0;
+}
+
+// Moves the data once the command has been answered and the host has both the SDIO and DMA set up
+static void TryData(void)
+{
+    uint32_t dctrl = sdio_mock.DCTRL;
+
+    if (!(dctrl & SDIO_DCTRL_DTEN))
+    {
+        return;
+    }
+
+    if (!(dctrl & SDIO_DCTRL_DMAEN) || !(sdio_mock_stream.CR & DMA_SxCR_EN))
+    {
+        Violation("data path armed without the DMA running");
+        Finish(SDIO_STA_DTIMEOUT);
+        state = STATE_TRANSFER;
+        return;
+    }
+
+    uint8_t to_host = (dctrl & SDIO_DCTRL_DTDIR) != 0;
+    uint8_t dma_to_card = (sdio_mock_stream.CR & DMA_SxCR_DIR) == DMA_SxCR_DIR_0;
+
+    if (to_host == pending.to_card || dma_to_card != pending.to_card)
+    {
+        Violation("data path or DMA set up in the wrong direction");
+    }
+
+    if (!(sdio_mock_stream.CR & DMA_SxCR_PFCTRL))
+    {
+        Violation("DMA isn't using the SDIO as flow controller");
+    }
+
+    uint32_t length = sdio_mock.DLEN;
+    uint32_t block_size = 1UL << ((dctrl & SDIO_DCTRL_DBLOCKSIZE) >> SDIO_DCTRL_DBLOCKSIZE_Pos);
+    volatile void *memory = (volatile void *)addresses[sdio_mock_stream.M0AR % SDIO_MOCK_ADDRESSES];
+
+    if (pending.scr)
+    {
+        // SD 3.0, 1 and 4-bit bus, CMD23 if configured
+        uint8_t scr[SCR_BYTES] = { 0x02, 0x05, 0x80, (uint8_t)(card.cmd23 ? 0x02 : 0x00), 0, 0, 0, 0 };
+
+        if (length != SCR_BYTES || block_size != SCR_BYTES)
+        {
+            Violation("SCR read with %u bytes in blocks of %u", length, block_size);
+        }
+
+        memcpy((void *)memory, scr, SCR_BYTES);
+        Finish(SDIO_STA_DATAEND | SDIO_STA_DBCKEND);
+        HW(sdio_mock_dma.LISR) |= DMA_LISR_TCIF3;
+        state = STATE_TRANSFER;
+        return;
+    }
+
+    uint32_t blocks = length / BLOCK_SIZE;
+
+    if (block_size != BLOCK_SIZE || length % BLOCK_SIZE != 0 || blocks == 0)
+    {
+        Violation("data path set for %u bytes in blocks of %u", length, block_size);
+        Finish(SDIO_STA_DTIMEOUT);
+        return;
+    }
+
+    if (pending.blocks != 0 && blocks != pending.blocks)
+    {
+        Violation("card expects %u blocks, data path set for %u", pending.blocks, blocks);
+    }
+
+    if ((uint64_t)pending.block + blocks > card_blocks)
+    {
+        Finish(SDIO_STA_DTIMEOUT);
+        return;
+    }
+
+    off_t offset = (off_t)pending.block * BLOCK_SIZE;
+    ssize_t done;
+
+    if (pending.to_card)
+    {
+        done = pwrite(card_fd, (const void *)memory, length, offset);
+        stats.blocks_written += blocks;
+    }
+    else
+    {
+        done = pread(card_fd, (void *)memory, length, offset);
+        stats.blocks_read += blocks;
+    }
+
+    uint8_t open_ended = (pending.blocks == 0);
+    uint8_t to_card = pending.to_card;
+
+    Finish((done == (ssize_t)length) ? (SDIO_STA_DATAEND | SDIO_STA_DBCKEND) : SDIO_STA_DCRCFAIL);
+    HW(sdio_mock_dma.LISR) |= DMA_LISR_TCIF3;
+
+    // Open-ended transfers stay open until CMD12, counted ones end by themselves
+    if (!open_ended)
+    {
+        state = to_card ? STATE_PROGRAMMING : STATE_TRANSFER;
+        busy_left = card.program_polls;
+    }
+}
+
+void SDIOMock_Service(SDIO_TypeDef *sdio)
+{
+    (void)sdio;
+
+    // Write-1-to-clear
+    HW(sdio_mock.STA) &= ~sdio_mock.ICR;
+    sdio_mock.ICR = 0;
+    HW(sdio_mock_dma.LISR) &= ~sdio_mock_dma.LIFCR;
+    sdio_mock_dma.LIFCR = 0;
+    HW(sdio_mock_dma.HISR) &= ~sdio_mock_dma.HIFCR;
+    sdio_mock_dma.HIFCR = 0;
+
+    if (sdio_mock.CMD & SDIO_CMD_CPSMEN)
+    {
+        HandleCommand();
+    }
+
+    if (pending.active)
+    {
+        TryData();
+    }
+}
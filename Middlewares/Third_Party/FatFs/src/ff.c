@@ -926,6 +926,11 @@ FRESULT move_window (	/* Returns FR_OK or FR_DISK_ERROR */
 				sector = 0xFFFFFFFF;	/* Invalidate window if data is not reliable */
 				res = FR_DISK_ERR;
 			}
+#if _FS_CONTIG
+			else if (sector - fs->fatbase < fs->fsize * fs->n_fats) {
+				fs->n_fatrd++;			/* Count FAT sector reads */
+			}
+#endif
 			fs->winsect = sector;
 		}
 	}
@@ -1072,6 +1077,38 @@ DWORD get_fat (	/* 0xFFFFFFFF:Disk error, 1:Internal error, 2..0x7FFFFFFF:Cluste
 
 
 
+#if _FS_CONTIG
+/*-----------------------------------------------------------------------*/
+/* Get number of contiguous clusters from the top of an object           */
+/*-----------------------------------------------------------------------*/
+
+static
+DWORD contig_len (	/* Number of clusters in the first fragment (0:no cluster) */
+	_FDID* obj		/* Object to be checked */
+)
+{
+	DWORD clst, nxt, n, ncl, bcs;
+	FATFS *fs = obj->fs;
+
+
+	if (obj->sclust == 0) return 0;
+	bcs = (DWORD)fs->csize * SS(fs);				/* Cluster size (byte) */
+	ncl = (DWORD)((obj->objsize + bcs - 1) / bcs);	/* Number of clusters in use */
+#if _FS_EXFAT
+	if (obj->stat == 2) return ncl;				/* No FAT chain: contiguous as a whole */
+#endif
+	clst = obj->sclust;
+	for (n = 1; n < ncl; n++, clst = nxt) {		/* Follow the chain while it goes to the next cluster */
+		nxt = get_fat(obj, clst);
+		if (nxt != clst + 1) break;				/* Fragmented (or error): the run ends here */
+	}
+	return (ncl > 0) ? n : 0;
+}
+#endif
+
+
+
+
 #if !_FS_READONLY
 /*-----------------------------------------------------------------------*/
 /* FAT access - Change value of a FAT entry                              */
@@ -2203,12 +2240,13 @@ FRESULT dir_read (
 
 
 /*-----------------------------------------------------------------------*/
-/* Directory handling - Find an object in the directory                  */
+/* Directory handling - Find an object from the current entry on         */
 /*-----------------------------------------------------------------------*/
 
 static
-FRESULT dir_find (	/* FR_OK(0):succeeded, !=0:error */
-	DIR* dp			/* Pointer to the directory object with the file name */
+FRESULT dir_match (	/* FR_OK(0):succeeded, !=0:error */
+	DIR* dp,		/* Pointer to the directory object with the file name, at the entry to start from */
+	int one			/* 0:Up to the end of the directory, 1:Only the object at the entry */
 )
 {
 	FRESULT res;
@@ -2218,15 +2256,13 @@ FRESULT dir_find (	/* FR_OK(0):succeeded, !=0:error */
 	BYTE a, ord, sum;
 #endif
 
-	res = dir_sdi(dp, 0);			/* Rewind directory object */
-	if (res != FR_OK) return res;
 #if _FS_EXFAT
 	if (fs->fs_type == FS_EXFAT) {	/* On the exFAT volume */
 		BYTE nc;
-		UINT di, ni;
+		UINT di, ni, n = 0;
 		WORD hash = xname_sum(fs->lfnbuf);		/* Hash value of the name to find */
 
-		while ((res = dir_read(dp, 0)) == FR_OK) {	/* Read an item */
+		while ((res = (one && n++) ? FR_NO_FILE : dir_read(dp, 0)) == FR_OK) {	/* Read an item */
 #if _MAX_LFN < 255
 			if (fs->dirbuf[XDIR_NumName] > _MAX_LFN) continue;			/* Skip comparison if inaccessible object name */
 #endif
@@ -2268,6 +2304,7 @@ FRESULT dir_find (	/* FR_OK(0):succeeded, !=0:error */
 				if (!ord && sum == sum_sfn(dp->dir)) break;	/* LFN matched? */
 				if (!(dp->fn[NSFLAG] & NS_LOSS) && !mem_cmp(dp->dir, dp->fn, 11)) break;	/* SFN matched? */
 				ord = 0xFF; dp->blk_ofs = 0xFFFFFFFF;	/* Reset LFN sequence */
+				if (one) { res = FR_NO_FILE; break; }	/* Not the object at the entry */
 			}
 		}
 #else		/* Non LFN configuration */
@@ -2282,6 +2319,319 @@ FRESULT dir_find (	/* FR_OK(0):succeeded, !=0:error */
 
 
 
+#if _FS_DIRCACHE
+/*-----------------------------------------------------------------------*/
+/* Directory lookup cache                                                */
+/*-----------------------------------------------------------------------*/
+/* Each object in a cached directory has a record with hashes of its names
+/  and where its entry block starts, so a name is looked up in RAM and only
+/  the entry blocks of the records with the same hash are read from the
+/  volume. The records of all the cached directories share DcPool, table
+/  after table. A directory with more objects than fit has the records of
+/  its top part only, and what is past it is scanned as usual. */
+
+#if _USE_LFN == 0 || _DF1S
+#error _FS_DIRCACHE needs LFN and an SBCS code page
+#endif
+
+#define DC_DIRS		8			/* Number of directories cached at a time */
+#define DC_WHOLE	0xFFFFFFFF	/* DCTBL end: all of the directory is cached */
+#define DC_MAXREC	(_FS_DIRCACHE - _FS_DIRCACHE / 4)	/* Records of a directory at most: the rest is for the ones on the way to it */
+
+typedef struct {
+	WORD	lfn;		/* Hash of the LFN, upper-case (exFAT: the name hash in the entry) */
+	WORD	sfn;		/* Hash of the SFN */
+	WORD	idx;		/* Index of the top entry of the entry block */
+} DCREC;
+
+typedef struct {
+	WORD	id;			/* Volume mount ID (0:unused) */
+	DWORD	sclust;		/* Directory start cluster (0:root) */
+	UINT	top;		/* First record in DcPool */
+	UINT	nrec;		/* Number of records */
+	DWORD	end;		/* Offset of the first entry without a record, or DC_WHOLE */
+	DWORD	used;		/* Last use, for replacement */
+} DCTBL;
+
+static DCREC DcPool[_FS_DIRCACHE];	/* Records of the cached directories */
+static DCTBL DcTbl[DC_DIRS];		/* Cached directories */
+static UINT DcRecs;					/* Number of records in use */
+static DWORD DcClock;				/* Use counter */
+
+
+static
+DWORD dc_mix (		/* Mixed 32-bit value */
+	DWORD x
+)
+{
+	x ^= x >> 16; x *= 0x85EBCA6B;
+	x ^= x >> 13; x *= 0xC2B2AE35;
+	return x ^ (x >> 16);
+}
+
+
+static
+WORD dc_hash_lfn (	/* Hash of an upper-cased name, character by character in any order */
+	DWORD sum,		/* Sum of dc_mix(character | position << 16) of all its characters */
+	UINT len		/* Length of the name */
+)
+{
+	return (WORD)dc_mix(sum ^ len);
+}
+
+
+static
+WORD dc_hash_sfn (	/* Hash of an SFN */
+	const BYTE* sfn	/* SFN in directory form (11 bytes) */
+)
+{
+	DWORD h = 2166136261U;
+	UINT i;
+
+
+	for (i = 0; i < 11; i++) h = (h ^ sfn[i]) * 16777619U;
+	return (WORD)dc_mix(h);
+}
+
+
+static
+void dc_free (
+	DCTBL* tp		/* Table to be removed */
+)
+{
+	UINT i;
+
+
+	mem_cpy(DcPool + tp->top, DcPool + tp->top + tp->nrec,	/* (Copies upwards: fine to overlap this way) */ (DcRecs - tp->top - tp->nrec) * sizeof (DCREC));
+	for (i = 0; i < DC_DIRS; i++) {	/* Tables after it move down */
+		if (DcTbl[i].id && DcTbl[i].top > tp->top) DcTbl[i].top -= tp->nrec;
+	}
+	DcRecs -= tp->nrec;
+	tp->id = 0;
+}
+
+
+static
+DCTBL* dc_lru (		/* Least recently used table (NULL:none) */
+	const DCTBL* keep	/* Table not to be chosen */
+)
+{
+	DCTBL *tp = 0;
+	UINT i;
+
+
+	for (i = 0; i < DC_DIRS; i++) {
+		if (DcTbl[i].id && &DcTbl[i] != keep && (!tp || DcTbl[i].used < tp->used)) tp = &DcTbl[i];
+	}
+	return tp;
+}
+
+
+static
+void dc_drop (		/* Forget a directory (its objects are about to change) */
+	FATFS* fs,		/* File system object */
+	DWORD sclust	/* Directory start cluster (0:root) */
+)
+{
+	UINT i;
+
+
+	for (i = 0; i < DC_DIRS; i++) {
+		if (DcTbl[i].id == fs->id && DcTbl[i].sclust == sclust) dc_free(&DcTbl[i]);
+	}
+}
+
+
+static
+int dc_add (		/* 1:added, 0:no room */
+	DCTBL* tp,		/* Table being built (the last one in the pool) */
+	WORD lfn,		/* Hashes of the names */
+	WORD sfn,
+	DWORD ofs		/* Offset of the top entry of the entry block */
+)
+{
+	DCTBL *old;
+
+
+	if (ofs / SZDIRE > 0xFFFF || tp->nrec >= DC_MAXREC) return 0;	/* Cannot be indexed, or too many */
+	while (DcRecs == _FS_DIRCACHE) {		/* Make room by removing the others */
+		old = dc_lru(tp);
+		if (!old) return 0;
+		dc_free(old);
+	}
+	DcPool[DcRecs].lfn = lfn;
+	DcPool[DcRecs].sfn = sfn;
+	DcPool[DcRecs].idx = (WORD)(ofs / SZDIRE);
+	DcRecs++; tp->nrec++;
+	return 1;
+}
+
+
+static
+FRESULT dc_build (	/* FR_OK(0):succeeded, !=0:error */
+	DIR* dp,		/* Directory to be cached (dp->fn and the name to find are left as is) */
+	DCTBL* tp		/* Empty table to build */
+)
+{
+	FRESULT res;
+	FATFS *fs = dp->obj.fs;
+	DIR dj;
+	DWORD top = 0, sum = 0;
+	UINT i, k, len = 0;
+	WCHAR wc;
+	BYTE c, a, ord = 0xFF, lsum = 0xFF;
+
+
+	dj.obj = dp->obj;
+	tp->top = DcRecs; tp->nrec = 0; tp->end = DC_WHOLE;
+	res = dir_sdi(&dj, 0);
+	if (res != FR_OK) return res;
+#if _FS_EXFAT
+	if (fs->fs_type == FS_EXFAT) {	/* On the exFAT volume: the entries have a name hash */
+		while ((res = dir_read(&dj, 0)) == FR_OK) {
+			if (!dc_add(tp, ld_word(fs->dirbuf + XDIR_NameHash), 0, dj.blk_ofs)) {
+				tp->end = dj.blk_ofs; break;
+			}
+			res = dir_next(&dj, 0);
+			if (res != FR_OK) break;
+		}
+		return (res == FR_NO_FILE) ? FR_OK : res;
+	}
+#endif
+	/* On the FAT12/16/32 volume: LFN entries come last part first, so the LFN is hashed in any order */
+	do {
+		res = move_window(fs, dj.sect);
+		if (res != FR_OK) break;
+		c = dj.dir[DIR_Name];
+		if (c == 0) { res = FR_NO_FILE; break; }	/* Reached to end of table */
+		a = dj.dir[DIR_Attr] & AM_MASK;
+		if (c == DDEM || ((a & AM_VOL) && a != AM_LFN)) {	/* An entry without valid data */
+			ord = 0xFF;
+		} else if (a == AM_LFN) {	/* An LFN entry */
+			if (c & LLEF) {			/* Start of an LFN sequence: it has the end of the name */
+				lsum = dj.dir[LDIR_Chksum];
+				c &= (BYTE)~LLEF; ord = c;
+				top = dj.dptr; sum = 0; len = 0;
+			}
+			if (c == ord && lsum == dj.dir[LDIR_Chksum] && ld_word(dj.dir + LDIR_FstClusLO) == 0) {
+				i = (c - 1) * 13;
+				for (k = 0; k < 13 && (wc = ld_word(dj.dir + LfnOfs[k])) != 0; k++, i++) {
+					sum += dc_mix(ff_wtoupper(wc) | (DWORD)i << 16);
+				}
+				if (i > len) len = i;
+				ord--;
+			} else {
+				ord = 0xFF;
+			}
+		} else {					/* An SFN entry: the end of the entry block */
+			if (!ord && lsum == sum_sfn(dj.dir)) {	/* With an LFN */
+				k = dc_add(tp, dc_hash_lfn(sum, len), dc_hash_sfn(dj.dir), top);
+			} else {
+				top = dj.dptr;
+				k = dc_add(tp, 0, dc_hash_sfn(dj.dir), top);
+			}
+			if (!k) { tp->end = top; break; }
+			ord = 0xFF;
+		}
+		res = dir_next(&dj, 0);
+	} while (res == FR_OK);
+
+	return (res == FR_NO_FILE) ? FR_OK : res;
+}
+
+
+static
+FRESULT dc_find (	/* FR_OK(0):found, FR_NO_FILE:not in the cached part, !=0:error */
+	DIR* dp,		/* Directory object with the name to find */
+	DWORD* end		/* Where the cached part of the directory ends (DC_WHOLE: all of it) */
+)
+{
+	FRESULT res;
+	FATFS *fs = dp->obj.fs;
+	DCTBL *tp = 0;
+	DCREC *rp;
+	DWORD sum = 0;
+	UINT i, n, uselfn, usesfn;
+	WORD lfn = 0, sfn = 0;
+
+
+	*end = 0;
+	for (i = 0; i < DC_DIRS && !tp; i++) {
+		if (DcTbl[i].id == fs->id && DcTbl[i].sclust == dp->obj.sclust) tp = &DcTbl[i];
+	}
+	if (!tp) {							/* First lookup in the directory: cache it */
+		for (i = 0; i < DC_DIRS && DcTbl[i].id; i++) ;
+		if (i == DC_DIRS) {
+			tp = dc_lru(0);
+			dc_free(tp);
+		} else {
+			tp = &DcTbl[i];
+		}
+		tp->id = fs->id; tp->sclust = dp->obj.sclust;
+		fs->n_dcbld++;
+		res = dc_build(dp, tp);
+		if (res != FR_OK) {
+			dc_free(tp);
+			return res;
+		}
+	}
+	tp->used = ++DcClock;
+
+	/* Hashes of the name to find */
+	uselfn = !(dp->fn[NSFLAG] & NS_NOLFN);
+	usesfn = !(dp->fn[NSFLAG] & NS_LOSS) && !(_FS_EXFAT && fs->fs_type == FS_EXFAT);
+#if _FS_EXFAT
+	if (fs->fs_type == FS_EXFAT) {
+		lfn = xname_sum(fs->lfnbuf);
+	} else
+#endif
+	{
+		for (i = 0; fs->lfnbuf[i]; i++) sum += dc_mix(ff_wtoupper(fs->lfnbuf[i]) | (DWORD)i << 16);
+		lfn = dc_hash_lfn(sum, i);
+		sfn = dc_hash_sfn(dp->fn);
+	}
+
+	/* The objects with the same hash, checked as dir_find would */
+	for (n = 0; n < tp->nrec; n++) {
+		rp = &DcPool[tp->top + n];
+		if (!((uselfn && rp->lfn == lfn) || (usesfn && rp->sfn == sfn))) continue;
+		fs->n_dcchk++;
+		res = dir_sdi(dp, (DWORD)rp->idx * SZDIRE);
+		if (res == FR_OK) res = dir_match(dp, 1);
+		if (res != FR_NO_FILE) return res;
+	}
+	*end = tp->end;
+	return FR_NO_FILE;
+}
+#endif	/* _FS_DIRCACHE */
+
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Directory handling - Find an object in the directory                  */
+/*-----------------------------------------------------------------------*/
+
+static
+FRESULT dir_find (	/* FR_OK(0):succeeded, !=0:error */
+	DIR* dp			/* Pointer to the directory object with the file name */
+)
+{
+	FRESULT res;
+	DWORD ofs = 0;	/* Where to scan from */
+
+
+#if _FS_DIRCACHE
+	res = dc_find(dp, &ofs);		/* Look it up in the cache first */
+	if (res != FR_NO_FILE || ofs == DC_WHOLE) return res;
+#endif
+	res = dir_sdi(dp, ofs);			/* Rewind directory object (or go past the cached part) */
+	if (res != FR_OK) return res;
+	return dir_match(dp, 0);
+}
+
+
+
 
 #if !_FS_READONLY
 /*-----------------------------------------------------------------------*/
@@ -2308,6 +2658,9 @@ FRESULT dir_register (	/* FR_OK:succeeded, FR_DENIED:no free entry or too many S
 		DIR dj;
 
 		nent = (nlen + 14) / 15 + 2;	/* Number of entries to allocate (85+C0+C1s) */
+#if _FS_DIRCACHE
+		dc_drop(fs, dp->obj.sclust);	/* The directory's objects change */
+#endif
 		res = dir_alloc(dp, nent);		/* Allocate entries */
 		if (res != FR_OK) return res;
 		dp->blk_ofs = dp->dptr - SZDIRE * (nent - 1);	/* Set the allocated entry block offset */
@@ -2346,6 +2699,9 @@ FRESULT dir_register (	/* FR_OK:succeeded, FR_DENIED:no free entry or too many S
 	}
 
 	/* Create an SFN with/without LFNs. */
+#if _FS_DIRCACHE
+	dc_drop(fs, dp->obj.sclust);		/* The directory's objects change (after the collision checks above) */
+#endif
 	nent = (sn[NSFLAG] & NS_LFN) ? (nlen + 12) / 13 + 1 : 1;	/* Number of entries to allocate */
 	res = dir_alloc(dp, nent);		/* Allocate entries */
 	if (res == FR_OK && --nent) {	/* Set LFN entry if needed */
@@ -2402,6 +2758,9 @@ FRESULT dir_remove (	/* FR_OK:Succeeded, FR_DISK_ERR:A disk error */
 #if _USE_LFN != 0	/* LFN configuration */
 	DWORD last = dp->dptr;
 
+#if _FS_DIRCACHE
+	dc_drop(fs, dp->obj.sclust);		/* The directory's objects change */
+#endif
 	res = (dp->blk_ofs == 0xFFFFFFFF) ? FR_OK : dir_sdi(dp, dp->blk_ofs);	/* Goto top of the entry block if LFN is exist */
 	if (res == FR_OK) {
 		do {
@@ -3465,6 +3824,10 @@ FRESULT f_open (
 			fp->err = 0;			/* Clear error flag */
 			fp->sect = 0;			/* Invalidate current data sector */
 			fp->fptr = 0;			/* Set file pointer top of the file */
+#if _FS_CONTIG
+			fp->nskip = 0;
+			fp->ncont = (mode & FA_WRITE) ? 0 : contig_len(&fp->obj);	/* Find the contiguous run if read-only */
+#endif
 #if !_FS_READONLY
 #if !_FS_TINY
 			mem_set(fp->buf, 0, _MAX_SS);	/* Clear sector buffer */
@@ -3521,6 +3884,9 @@ FRESULT f_read (
 	FSIZE_t remain;
 	UINT rcnt, cc, csect;
 	BYTE *rbuff = (BYTE*)buff;
+#if _FS_CONTIG
+	DWORD ci, nrun;
+#endif
 
 
 	*br = 0;	/* Clear read byte counter */
@@ -3534,10 +3900,19 @@ FRESULT f_read (
 		rbuff += rcnt, fp->fptr += rcnt, *br += rcnt, btr -= rcnt) {
 		if (fp->fptr % SS(fs) == 0) {			/* On the sector boundary? */
 			csect = (UINT)(fp->fptr / SS(fs) & (fs->csize - 1));	/* Sector offset in the cluster */
+#if _FS_CONTIG
+			ci = (DWORD)(fp->fptr / ((DWORD)fs->csize * SS(fs)));	/* Cluster index in the file */
+#endif
 			if (csect == 0) {					/* On the cluster boundary? */
 				if (fp->fptr == 0) {			/* On the top of the file? */
 					clst = fp->obj.sclust;		/* Follow cluster chain from the origin */
 				} else {						/* Middle or end of the file */
+#if _FS_CONTIG
+					if (ci < fp->ncont) {
+						clst = fp->obj.sclust + ci;	/* In the contiguous run: no need to follow the FAT */
+						fp->nskip++;
+					} else
+#endif
 #if _USE_FASTSEEK
 					if (fp->cltbl) {
 						clst = clmt_clust(fp, fp->fptr);	/* Get cluster# from the CLMT */
@@ -3556,10 +3931,21 @@ FRESULT f_read (
 			sect += csect;
 			cc = btr / SS(fs);					/* When remaining bytes >= sector size, */
 			if (cc) {							/* Read maximum contiguous sectors directly */
+#if _FS_CONTIG
+				nrun = (ci < fp->ncont) ? fp->ncont - ci : 1;	/* Clusters ahead next to each other on the volume */
+				if ((csect + cc) / fs->csize >= nrun && csect + cc > nrun * fs->csize) {	/* Clip at end of the run */
+					cc = nrun * fs->csize - csect;
+				}
+#else
 				if (csect + cc > fs->csize) {	/* Clip at cluster boundary */
 					cc = fs->csize - csect;
 				}
+#endif
 				if (disk_read(fs->drv, rbuff, sect, cc) != RES_OK) ABORT(fs, FR_DISK_ERR);
+#if _FS_CONTIG
+				fp->clust += (csect + cc - 1) / fs->csize;	/* Last cluster read, the FAT is followed from it */
+				fp->nskip += (csect + cc - 1) / fs->csize;
+#endif
 #if !_FS_READONLY && _FS_MINIMIZE <= 2			/* Replace one of the read sectors with cached data if it contains a dirty sector */
 #if _FS_TINY
 				if (fs->wflag && fs->winsect - sect < cc) {
@@ -4115,6 +4501,11 @@ FRESULT f_lseek (
 							ofs = 0; break;
 						}
 					} else
+#endif
+#if _FS_CONTIG
+					if (fp->fptr / bcs < fp->ncont) {
+						clst = fp->obj.sclust + (DWORD)(fp->fptr / bcs);	/* In the contiguous run */
+					} else
 #endif
 					{
 						clst = get_fat(&fp->obj, clst);	/* Follow cluster chain if not in write mode */
@@ -4594,6 +4985,9 @@ FRESULT f_unlink (
 			}
 			if (res == FR_OK) {
 				res = dir_remove(&dj);			/* Remove the directory entry */
+#if _FS_DIRCACHE
+				if (res == FR_OK && (dj.obj.attr & AM_DIR)) dc_drop(fs, dclst);	/* The sub-directory is gone */
+#endif
 				if (res == FR_OK && dclst) {	/* Remove the cluster chain if exist */
 #if _FS_EXFAT
 					res = remove_chain(&obj, dclst, 0);
@@ -122,6 +122,13 @@ typedef struct {
 	DWORD	dirbase;		/* Root directory base sector/cluster */
 	DWORD	database;		/* Data base sector */
 	DWORD	winsect;		/* Current sector appearing in the win[] */
+#if _FS_CONTIG
+	DWORD	n_fatrd;		/* Number of FAT sectors read into the win[] (statistics) */
+#endif
+#if _FS_DIRCACHE
+	DWORD	n_dcbld;		/* Number of directories scanned into the lookup cache (statistics) */
+	DWORD	n_dcchk;		/* Number of entry blocks read to check a cached hash (statistics) */
+#endif
 	BYTE	win[_MAX_SS];	/* Disk access window for Directory, FAT (and file data at tiny cfg) */
 } FATFS;
 
@@ -166,6 +173,10 @@ typedef struct {
 #if _USE_FASTSEEK
 	DWORD*	cltbl;			/* Pointer to the cluster link map table (nulled on open, set by application) */
 #endif
+#if _FS_CONTIG
+	DWORD	ncont;			/* Number of contiguous clusters from the top of the file (0:not detected) */
+	DWORD	nskip;			/* Number of cluster boundaries crossed without following the FAT (statistics) */
+#endif
 #if !_FS_TINY
 	BYTE	buf[_MAX_SS];	/* File private data read/write window */
 #endif
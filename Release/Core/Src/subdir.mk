@@ -5,9 +5,30 @@
 
 # Add inputs and outputs from these tool invocations to the build variables 
 C_SRCS += \
+../Core/Src/blk.c \
+../Core/Src/bookmark.c \
+../Core/Src/crc32.c \
+../Core/Src/depth.c \
+../Core/Src/extsort.c \
+../Core/Src/format.c \
 ../Core/Src/i2s.c \
+../Core/Src/i2s_clock.c \
+../Core/Src/internal_flash.c \
+../Core/Src/library.c \
 ../Core/Src/main.c \
+../Core/Src/meter.c \
 ../Core/Src/microsd.c \
+../Core/Src/pcm.c \
+../Core/Src/player.c \
+../Core/Src/playlist.c \
+../Core/Src/recorder.c \
+../Core/Src/ring.c \
+../Core/Src/sd_bench.c \
+../Core/Src/sd_bus.c \
+../Core/Src/sd_ll.c \
+../Core/Src/sd_profile.c \
+../Core/Src/settings.c \
+../Core/Src/shuffle.c \
 ../Core/Src/stm32f4xx_hal_msp.c \
 ../Core/Src/stm32f4xx_it.c \
 ../Core/Src/syscalls.c \
@@ -16,9 +37,30 @@ C_SRCS += \
 ../Core/Src/wav.c 
 
 OBJS += \
+./Core/Src/blk.o \
+./Core/Src/bookmark.o \
+./Core/Src/crc32.o \
+./Core/Src/depth.o \
+./Core/Src/extsort.o \
+./Core/Src/format.o \
 ./Core/Src/i2s.o \
+./Core/Src/i2s_clock.o \
+./Core/Src/internal_flash.o \
+./Core/Src/library.o \
 ./Core/Src/main.o \
+./Core/Src/meter.o \
 ./Core/Src/microsd.o \
+./Core/Src/pcm.o \
+./Core/Src/player.o \
+./Core/Src/playlist.o \
+./Core/Src/recorder.o \
+./Core/Src/ring.o \
+./Core/Src/sd_bench.o \
+./Core/Src/sd_bus.o \
+./Core/Src/sd_ll.o \
+./Core/Src/sd_profile.o \
+./Core/Src/settings.o \
+./Core/Src/shuffle.o \
 ./Core/Src/stm32f4xx_hal_msp.o \
 ./Core/Src/stm32f4xx_it.o \
 ./Core/Src/syscalls.o \
@@ -27,9 +69,30 @@ OBJS += \
 ./Core/Src/wav.o 
 
 C_DEPS += \
+./Core/Src/blk.d \
+./Core/Src/bookmark.d \
+./Core/Src/crc32.d \
+./Core/Src/depth.d \
+./Core/Src/extsort.d \
+./Core/Src/format.d \
 ./Core/Src/i2s.d \
+./Core/Src/i2s_clock.d \
+./Core/Src/internal_flash.d \
+./Core/Src/library.d \
 ./Core/Src/main.d \
+./Core/Src/meter.d \
 ./Core/Src/microsd.d \
+./Core/Src/pcm.d \
+./Core/Src/player.d \
+./Core/Src/playlist.d \
+./Core/Src/recorder.d \
+./Core/Src/ring.d \
+./Core/Src/sd_bench.d \
+./Core/Src/sd_bus.d \
+./Core/Src/sd_ll.d \
+./Core/Src/sd_profile.d \
+./Core/Src/settings.d \
+./Core/Src/shuffle.d \
 ./Core/Src/stm32f4xx_hal_msp.d \
 ./Core/Src/stm32f4xx_it.d \
 ./Core/Src/syscalls.d \
@@ -45,7 +108,7 @@ Core/Src/%.o Core/Src/%.su Core/Src/%.cyclo: ../Core/Src/%.c Core/Src/subdir.mk
 clean: clean-Core-2f-Src
 
 clean-Core-2f-Src:
-	-$(RM) ./Core/Src/i2s.cyclo ./Core/Src/i2s.d ./Core/Src/i2s.o ./Core/Src/i2s.su ./Core/Src/main.cyclo ./Core/Src/main.d ./Core/Src/main.o ./Core/Src/main.su ./Core/Src/microsd.cyclo ./Core/Src/microsd.d ./Core/Src/microsd.o ./Core/Src/microsd.su ./Core/Src/stm32f4xx_hal_msp.cyclo ./Core/Src/stm32f4xx_hal_msp.d ./Core/Src/stm32f4xx_hal_msp.o ./Core/Src/stm32f4xx_hal_msp.su ./Core/Src/stm32f4xx_it.cyclo ./Core/Src/stm32f4xx_it.d ./Core/Src/stm32f4xx_it.o ./Core/Src/stm32f4xx_it.su ./Core/Src/syscalls.cyclo ./Core/Src/syscalls.d ./Core/Src/syscalls.o ./Core/Src/syscalls.su ./Core/Src/sysmem.cyclo ./Core/Src/sysmem.d ./Core/Src/sysmem.o ./Core/Src/sysmem.su ./Core/Src/system_stm32f4xx.cyclo ./Core/Src/system_stm32f4xx.d ./Core/Src/system_stm32f4xx.o ./Core/Src/system_stm32f4xx.su ./Core/Src/wav.cyclo ./Core/Src/wav.d ./Core/Src/wav.o ./Core/Src/wav.su
+	-$(RM) ./Core/Src/blk.cyclo ./Core/Src/blk.d ./Core/Src/blk.o ./Core/Src/blk.su ./Core/Src/bookmark.cyclo ./Core/Src/bookmark.d ./Core/Src/bookmark.o ./Core/Src/bookmark.su ./Core/Src/crc32.cyclo ./Core/Src/crc32.d ./Core/Src/crc32.o ./Core/Src/crc32.su ./Core/Src/depth.cyclo ./Core/Src/depth.d ./Core/Src/depth.o ./Core/Src/depth.su ./Core/Src/extsort.cyclo ./Core/Src/extsort.d ./Core/Src/extsort.o ./Core/Src/extsort.su ./Core/Src/format.cyclo ./Core/Src/format.d ./Core/Src/format.o ./Core/Src/format.su ./Core/Src/i2s.cyclo ./Core/Src/i2s.d ./Core/Src/i2s.o ./Core/Src/i2s.su ./Core/Src/i2s_clock.cyclo ./Core/Src/i2s_clock.d ./Core/Src/i2s_clock.o ./Core/Src/i2s_clock.su ./Core/Src/internal_flash.cyclo ./Core/Src/internal_flash.d ./Core/Src/internal_flash.o ./Core/Src/internal_flash.su ./Core/Src/library.cyclo ./Core/Src/library.d ./Core/Src/library.o ./Core/Src/library.su ./Core/Src/main.cyclo ./Core/Src/main.d ./Core/Src/main.o ./Core/Src/main.su ./Core/Src/meter.cyclo ./Core/Src/meter.d ./Core/Src/meter.o ./Core/Src/meter.su ./Core/Src/microsd.cyclo ./Core/Src/microsd.d ./Core/Src/microsd.o ./Core/Src/microsd.su ./Core/Src/pcm.cyclo ./Core/Src/pcm.d ./Core/Src/pcm.o ./Core/Src/pcm.su ./Core/Src/player.cyclo ./Core/Src/player.d ./Core/Src/player.o ./Core/Src/player.su ./Core/Src/playlist.cyclo ./Core/Src/playlist.d ./Core/Src/playlist.o ./Core/Src/playlist.su ./Core/Src/recorder.cyclo ./Core/Src/recorder.d ./Core/Src/recorder.o ./Core/Src/recorder.su ./Core/Src/ring.cyclo ./Core/Src/ring.d ./Core/Src/ring.o ./Core/Src/ring.su ./Core/Src/sd_bench.cyclo ./Core/Src/sd_bench.d ./Core/Src/sd_bench.o ./Core/Src/sd_bench.su ./Core/Src/sd_bus.cyclo ./Core/Src/sd_bus.d ./Core/Src/sd_bus.o ./Core/Src/sd_bus.su ./Core/Src/sd_ll.cyclo ./Core/Src/sd_ll.d ./Core/Src/sd_ll.o ./Core/Src/sd_ll.su ./Core/Src/sd_profile.cyclo ./Core/Src/sd_profile.d ./Core/Src/sd_profile.o ./Core/Src/sd_profile.su ./Core/Src/settings.cyclo ./Core/Src/settings.d ./Core/Src/settings.o ./Core/Src/settings.su ./Core/Src/shuffle.cyclo ./Core/Src/shuffle.d ./Core/Src/shuffle.o ./Core/Src/shuffle.su ./Core/Src/stm32f4xx_hal_msp.cyclo ./Core/Src/stm32f4xx_hal_msp.d ./Core/Src/stm32f4xx_hal_msp.o ./Core/Src/stm32f4xx_hal_msp.su ./Core/Src/stm32f4xx_it.cyclo ./Core/Src/stm32f4xx_it.d ./Core/Src/stm32f4xx_it.o ./Core/Src/stm32f4xx_it.su ./Core/Src/syscalls.cyclo ./Core/Src/syscalls.d ./Core/Src/syscalls.o ./Core/Src/syscalls.su ./Core/Src/sysmem.cyclo ./Core/Src/sysmem.d ./Core/Src/sysmem.o ./Core/Src/sysmem.su ./Core/Src/system_stm32f4xx.cyclo ./Core/Src/system_stm32f4xx.d ./Core/Src/system_stm32f4xx.o ./Core/Src/system_stm32f4xx.su ./Core/Src/wav.cyclo ./Core/Src/wav.d ./Core/Src/wav.o ./Core/Src/wav.su
 
 .PHONY: clean-Core-2f-Src
 